@@ -1,7 +1,10 @@
 #include "conn.h"
+#include "mqtt_trace.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <stddef.h>
 
 /* ==========================================
  * 私有变量
@@ -13,90 +16,513 @@ typedef struct {
     char topic[64];
     bool is_subscribed;
     MQTT_MessageHandler callback; /* 特定回调函数 */
+    MQTT_IdHandler id_handler;    /* 按句柄接收的回调 (MQTT_SubscribeId) */
+    MQTT_StreamHandler stream_handler; /* 二进制回调 (MQTT_SubscribeStream)，解码时直接调用 */
+    uint8_t qos;                  /* 订阅请求的 QoS (0 或 1) */
+    MQTT_TopicId topic_id;        /* 已注册的精确主题：入站按句柄比对，免去通配符匹配 */
+    uint8_t priority;             /* 分发优先级，数值越大越先分发 */
+    MQTT_Delivery delivery;       /* 投递策略 */
+    uint16_t interval;            /* SAMPLED 的最小分发间隔 (ms) */
+    uint32_t next_slot;           /* SAMPLED 下一次允许分发的时刻 */
 } MQTT_Subscription_t;
 
-static MQTT_Subscription_t subscriptions[MAX_SUBSCRIPTIONS];
 static uint8_t subscription_count = 0;
 
+/* 主题注册表：注册时编码一次，发布时整段拷贝 */
+typedef struct {
+    uint8_t encoded[2 + MQTT_TOPIC_SIZE]; /* 2 字节长度前缀 + 主题 + '\0' */
+    uint16_t len;                         /* 主题长度 (不含前缀) */
+} MQTT_TopicEntry_t;
+
+static MQTT_TopicEntry_t topic_registry[MQTT_MAX_TOPICS];
+static uint8_t topic_count = 0;
+
+/* 发布过滤状态：按主题句柄索引，记录上次实际发出的值 */
+typedef struct {
+    MQTT_PublishFilter cfg;
+    bool enabled;
+    bool has_last;
+    bool last_numeric;
+    float last_value;             /* 数值消息 */
+    uint32_t last_hash;           /* 非数值消息的内容指纹 */
+    uint16_t last_len;
+    uint32_t last_tick;
+} MQTT_FilterState_t;
+
+/* 一次发布的比较样本，发送成功后才写回状态 */
+typedef struct {
+    bool numeric;
+    float value;
+    uint32_t hash;
+} MQTT_FilterSample_t;
+
+static MQTT_FilterState_t publish_filters[MQTT_MAX_TOPICS];
+static bool filters_active = false; /* 任一主题设置过过滤，MQTT_Publish 才需查表 */
+
+/* 入站消息队列：解码与回调解耦，回调在 MQTT_Dispatch 中按优先级执行 */
+typedef struct {
+    char topic[MQTT_TOPIC_SIZE];
+    char payload[MQTT_PAYLOAD_SIZE];
+    MQTT_MessageHandler handler;
+    MQTT_IdHandler id_handler;
+    MQTT_TopicId topic_id;
+    uint8_t priority;
+    uint16_t seq;                 /* 入队序号，同优先级先进先出 */
+    uint32_t not_before;          /* 早于该时刻不分发 (SAMPLED 限速) */
+    bool coalesce;                /* 后到的同主题消息覆盖本项 */
+    bool used;
+} MQTT_InboundMsg_t;
+
+static uint8_t inbound_count = 0;
+static uint16_t inbound_seq = 0;
+
 /* ==========================================
- * 辅助函数
+ * 静态内存区：协议栈的收发、建链、日志、订阅与队列缓冲集中于此，
+ * 各区大小见 conn.h 内存预算配置。链接映射文件中 mqtt_arena 的大小即协议栈
+ * 缓冲的 RAM 总占用，这些缓冲不再占用调用者的栈。
  * ========================================== */
+typedef struct {
+    uint8_t rx[RX_BUFFER_SIZE];          /* MQTT 字节流 */
+    uint8_t esp_rx[ESP_RX_BUFFER_SIZE];  /* AT 后端 +IPD 暂存 */
+    char at[MQTT_AT_BUF_SIZE];           /* 建链阶段 AT 响应 */
+    char cmd[MQTT_CMD_BUF_SIZE];         /* 建链阶段 AT 指令 */
+    uint8_t tx[MQTT_TX_BUF_SIZE];        /* 控制报文构建 */
+    char topic[MQTT_TOPIC_SIZE];         /* MQTT_Service 解码出的主题与内容 */
+    char payload[MQTT_PAYLOAD_SIZE];
+#ifdef MQTT_LOG_UART_HANDLE
+    char log[MQTT_LOG_BUF_SIZE];         /* 日志格式化 */
+#endif
+#ifdef MQTT_UART_RX_DMA
+    uint8_t uart_ring[MQTT_UART_RX_RING]; /* AT 串口循环 DMA 接收 */
+#endif
+    MQTT_Subscription_t subs[MAX_SUBSCRIPTIONS];
+    MQTT_InboundMsg_t inbound[MQTT_INBOUND_QUEUE_LEN];
+} MQTT_Arena_t;
 
-static bool MQTT_SendSubscribePacket(const char *topic);
+static MQTT_Arena_t mqtt_arena;
+
+#ifdef MQTT_ARENA_BUDGET
+/* 超出预算时数组长度为负，编译报错 */
+typedef char MQTT_ArenaBudgetCheck[(sizeof(MQTT_Arena_t) <= MQTT_ARENA_BUDGET) ? 1 : -1];
+#endif
+
+#define MQTT_ARENA_SIZEOF(member) ((uint16_t)sizeof(((MQTT_Arena_t *)0)->member))
+
+static MQTT_ArenaUsage arena_usage[MQTT_ARENA_REGIONS] = {
+    [MQTT_ARENA_RX] = {"rx", MQTT_ARENA_SIZEOF(rx), 0},
+    [MQTT_ARENA_ESP_RX] = {"esp_rx", MQTT_ARENA_SIZEOF(esp_rx), 0},
+    [MQTT_ARENA_AT] = {"at", MQTT_ARENA_SIZEOF(at), 0},
+    [MQTT_ARENA_CMD] = {"cmd", MQTT_ARENA_SIZEOF(cmd), 0},
+    [MQTT_ARENA_TX] = {"tx", MQTT_ARENA_SIZEOF(tx), 0},
+    [MQTT_ARENA_DECODE] = {"decode", MQTT_ARENA_SIZEOF(topic) + MQTT_ARENA_SIZEOF(payload), 0},
+#ifdef MQTT_LOG_UART_HANDLE
+    [MQTT_ARENA_LOG] = {"log", MQTT_ARENA_SIZEOF(log), 0},
+#else
+    [MQTT_ARENA_LOG] = {"log", 0, 0},
+#endif
+#ifdef MQTT_UART_RX_DMA
+    [MQTT_ARENA_UART] = {"uart", MQTT_ARENA_SIZEOF(uart_ring), 0},
+#else
+    [MQTT_ARENA_UART] = {"uart", 0, 0},
+#endif
+    [MQTT_ARENA_SUBS] = {"subs", MQTT_ARENA_SIZEOF(subs), 0},
+    [MQTT_ARENA_INBOUND] = {"inbound", MQTT_ARENA_SIZEOF(inbound), 0},
+};
+
+static MQTT_Subscription_t *const subscriptions = mqtt_arena.subs;
+static MQTT_InboundMsg_t *const inbound_queue = mqtt_arena.inbound;
 
 /**
- * @brief 检查 Topic 是否匹配 Filter (支持 + 和 #)
+ * @brief 记录某区的使用量，更新高水位
+ * @details 日志/指令/AT 响应超过区大小时记录所需长度 (实际已截断)，
+ *          高水位大于区大小即说明该预算偏小
  */
-static bool MQTT_TopicMatched(const char *filter, const char *topic)
+static void MQTT_ArenaMark(MQTT_ArenaRegion region, uint32_t used)
 {
-    const char *f = filter;
-    const char *t = topic;
-    
-    while (*f && *t) {
-        if (*f == '+') {
-            /* + 匹配一个层级 */
-            f++;
-            while (*t && *t != '/') t++;
-            continue;
-        } else if (*f == '#') {
-            /* # 匹配剩余所有 */
-            return true; 
-        } else {
-            if (*f != *t) return false;
-        }
-        f++;
-        t++;
+    if (used > 0xFFFF) used = 0xFFFF;
+    if (used > arena_usage[region].peak) {
+        arena_usage[region].peak = (uint16_t)used;
     }
-    
-    /* 完全匹配 */
-    if (*f == '\0' && *t == '\0') return true;
-    
-    /* 特殊情况: "path/#" 匹配 "path" */
-    if (*f == '#' && f > filter && *(f-1) == '/' && *t == '\0') return true;
-    
-    return false;
 }
 
+static MQTT_Stats stats;
+
+/* AT 收发嵌套深度：定时器中断驱动时，禁止服务例程打断主循环中的 AT 交互 */
+static volatile uint8_t esp_busy = 0;
+
+/* 服务例程的定时任务，MQTT_NextDeadline 据此计算下一次需要运行的时刻 */
+static uint32_t last_ping = 0;
+static uint32_t last_reconnect = 0;
+#define MQTT_RECONNECT_INTERVAL 5000
+
+/* 中断置位，提前结束 MQTT_Idle 的睡眠 */
+static volatile bool wake_pending = false;
+
+#ifdef MQTT_UART_RX_DMA
+/* AT 串口循环 DMA：写位置由 DMA 计数器给出，读位置由本文件推进 */
+static uint16_t uart_tail = 0;
+#endif
+
+/* 临界区：入站队列可能同时被定时器中断 (入队) 与主循环 (出队) 访问 */
+#define MQTT_ENTER_CRITICAL() uint32_t primask_ = __get_PRIMASK(); __disable_irq()
+#define MQTT_EXIT_CRITICAL()  __set_PRIMASK(primask_)
+
+/* 传输链路类型 */
+#ifdef MQTT_USE_SSL
+#define MQTT_LINK_TYPE "SSL"
+#define MQTT_LINK_TIMEOUT AT_CMD_TIMEOUT_WIFI /* ESP8266 上 TLS 握手需数秒 */
+#else
+#define MQTT_LINK_TYPE "TCP"
+#define MQTT_LINK_TIMEOUT AT_CMD_TIMEOUT_LONG
+#endif
+
+/* AT+CIPSEND 单次最大长度 */
+#define ESP_SEND_MAX 2048
+
+/* 当前传输后端，默认 ESP8266 AT */
+static const MQTT_Transport *transport = &MQTT_TransportAT;
+
+/* MQTT 字节流缓冲区：由传输后端读入的 TCP 数据，在此定界并解码 */
+static uint8_t *const rx_buffer = mqtt_arena.rx;
+static uint16_t rx_idx = 0;
+static bool rx_overflow = false;
+
+/* AT 后端：+IPD / +CIPRECVDATA 截取出的 TCP 数据暂存，由 transport->read 取走 */
+static uint8_t *const esp_rx = mqtt_arena.esp_rx;
+static uint16_t esp_rx_len = 0;
+static bool esp_rx_overflow = false;
+static bool esp_link_up = false;
+
+/* 被动接收模式：模块缓存 TCP 数据，由主机按缓冲区余量拉取 */
+static bool recv_passive = false;
+static bool rx_pending = false;     /* 模块提示有数据待取 */
+static uint32_t last_recv_poll = 0;
+
+/* AT 响应 token 类型 */
+typedef enum {
+    ESP_TOKEN_OK = 0, /* 成功，结束当前指令 */
+    ESP_TOKEN_FAIL,   /* 失败，结束当前指令 */
+    ESP_TOKEN_URC,    /* 主动上报，不结束当前指令 */
+} ESP_TokenType;
+
+typedef enum {
+    ESP_URC_NONE = 0,
+    ESP_URC_WIFI_DISCONNECT,
+    ESP_URC_CLOSED,
+    ESP_URC_IPD,
+    ESP_URC_RECVDATA,
+} ESP_UrcEvent;
+
+typedef struct {
+    const char *str;
+    ESP_TokenType type;
+    ESP_UrcEvent event;
+} ESP_Token;
+
+typedef enum {
+    ESP_RESULT_OK = 0,
+    ESP_RESULT_FAIL,
+    ESP_RESULT_TIMEOUT,
+} ESP_Result;
+
+/* ==========================================
+ * 辅助函数
+ * ========================================== */
+
+static bool MQTT_SendSubscribePacket(const char *topic, uint8_t qos);
+static void MQTT_Enqueue(const char *topic, const char *payload);
+static bool MQTT_InboundReady(void);
+static bool MQTT_DecodeNext(char *topic, uint16_t topic_size, char *payload, uint16_t payload_size);
+static int32_t MQTT_ReadTransport(void);
+
 /**
  * @brief 日志输出
  */
 #ifdef MQTT_LOG_UART_HANDLE
 static void MQTT_Log(const char *fmt, ...)
 {
-    char log_buf[256];
+    static volatile bool log_busy = false;
+    char *log_buf = mqtt_arena.log;
     va_list args;
 
+    /* 日志缓冲只有一份：定时器中断打断主循环中的日志时丢弃本条 */
+    if (log_busy) return;
+    log_busy = true;
+
     va_start(args, fmt);
-    vsnprintf(log_buf, sizeof(log_buf), fmt, args);
+    int n = vsnprintf(log_buf, MQTT_LOG_BUF_SIZE, fmt, args);
     va_end(args);
+    if (n >= 0) MQTT_ArenaMark(MQTT_ARENA_LOG, (uint32_t)n + 1);
 
     HAL_UART_Transmit(MQTT_LOG_UART_HANDLE, (uint8_t *)log_buf, strlen(log_buf), 100);
+    log_busy = false;
 }
 #else
 #define MQTT_Log(...) ((void)0)
 #endif
 
+/* ==========================================
+ * AT 响应流式匹配
+ * ========================================== */
+
+/* 主动上报事件 (URC)：不属于任何指令的响应，随时可能出现 */
+static const ESP_Token esp_urc_tokens[] = {
+    {"WIFI DISCONNECT", ESP_TOKEN_URC, ESP_URC_WIFI_DISCONNECT},
+    {"CLOSED", ESP_TOKEN_URC, ESP_URC_CLOSED},
+    {"+IPD,", ESP_TOKEN_URC, ESP_URC_IPD},
+    {"+CIPRECVDATA,", ESP_TOKEN_URC, ESP_URC_RECVDATA},
+    {NULL, ESP_TOKEN_OK, ESP_URC_NONE}
+};
+
+/* 通用失败标志，ESP_SendAT 自动附加 */
+#define ESP_TOKEN_ERROR {"ERROR", ESP_TOKEN_FAIL, ESP_URC_NONE}
+#define ESP_TOKEN_BUSY  {"busy p", ESP_TOKEN_FAIL, ESP_URC_NONE}
+
+/**
+ * @brief 多模式流式匹配器
+ * @details 每个 token 维护一个 KMP 状态，token 数量与长度均有上限，
+ *          因此每收到一个字节的匹配代价为 O(1)，且不依赖接收缓冲区，
+ *          跨越缓冲区边界的 token 也不会漏检。
+ */
+typedef struct {
+    const ESP_Token *tokens[ESP_MATCH_MAX_TOKENS];
+    uint8_t len[ESP_MATCH_MAX_TOKENS];
+    uint8_t state[ESP_MATCH_MAX_TOKENS];
+    uint8_t fail[ESP_MATCH_MAX_TOKENS][ESP_MATCH_MAX_LEN];
+    uint8_t count;
+} ESP_Matcher;
+
+/* +IPD 数据截取状态 */
+typedef enum {
+    IPD_IDLE = 0,
+    IPD_LEN,  /* 正在读取 "+IPD," / "+CIPRECVDATA," 之后的长度字段 */
+    IPD_DATA, /* 正在截取 TCP 数据 */
+} ESP_IpdState;
+
+static ESP_Matcher esp_matcher;
+static ESP_IpdState ipd_state = IPD_IDLE;
+static uint16_t ipd_remain = 0;
+
+static void ESP_MatcherAdd(const ESP_Token *tok)
+{
+    uint8_t k = esp_matcher.count;
+    uint8_t n = strlen(tok->str);
+
+    if (k >= ESP_MATCH_MAX_TOKENS || n == 0 || n > ESP_MATCH_MAX_LEN) {
+        MQTT_Log("[匹配] token 超出限制: %s\r\n", tok->str);
+        return;
+    }
+
+    /* 预计算 KMP 失配表 */
+    uint8_t *fail = esp_matcher.fail[k];
+    fail[0] = 0;
+    for (uint8_t i = 1, j = 0; i < n; i++) {
+        while (j > 0 && tok->str[i] != tok->str[j]) j = fail[j - 1];
+        if (tok->str[i] == tok->str[j]) j++;
+        fail[i] = j;
+    }
+
+    esp_matcher.tokens[k] = tok;
+    esp_matcher.len[k] = n;
+    esp_matcher.state[k] = 0;
+    esp_matcher.count++;
+}
+
+/**
+ * @brief 装载指令 token 表 (NULL 表示仅监听 URC)
+ * @note 指令 token 优先于 URC，同一字节命中多个时先返回终止类 token
+ */
+static void ESP_MatcherLoad(const ESP_Token *cmd_tokens)
+{
+    esp_matcher.count = 0;
+    for (const ESP_Token *t = cmd_tokens; t != NULL && t->str != NULL; t++) {
+        ESP_MatcherAdd(t);
+    }
+    for (const ESP_Token *t = esp_urc_tokens; t->str != NULL; t++) {
+        ESP_MatcherAdd(t);
+    }
+}
+
+/**
+ * @brief 将截取的 TCP 数据写入 AT 后端暂存区
+ */
+static void ESP_RxPush(uint8_t byte)
+{
+    if (esp_rx_len < ESP_RX_BUFFER_SIZE) {
+        esp_rx[esp_rx_len++] = byte;
+        MQTT_ArenaMark(MQTT_ARENA_ESP_RX, esp_rx_len);
+    } else {
+        /* 字节流一旦丢字节即无法重新定界，由 ESP_Read 报告链路失效 */
+        esp_rx_overflow = true;
+    }
+}
+
+/**
+ * @brief 处理主动上报事件，同步到连接状态机
+ */
+static void ESP_HandleURC(ESP_UrcEvent event)
+{
+    switch (event) {
+    case ESP_URC_WIFI_DISCONNECT:
+        MQTT_Log("[URC] WiFi 断开\r\n");
+        esp_link_up = false;
+        MQTT_LinkLost();
+        break;
+    case ESP_URC_CLOSED:
+        MQTT_Log("[URC] TCP 连接关闭\r\n");
+        esp_link_up = false;
+        MQTT_LinkLost();
+        break;
+    case ESP_URC_IPD:
+    case ESP_URC_RECVDATA:
+        ipd_state = IPD_LEN;
+        ipd_remain = 0;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief 向匹配器输入一个字节
+ *
+ * @param byte 串口收到的字节
+ * @param hit [out] 命中的终止类 token (成功/失败)，未命中为 NULL
+ * @return true 该字节属于 +IPD 数据，已转入暂存区
+ * @return false 该字节为 AT 文本
+ */
+static bool ESP_FeedByte(uint8_t byte, const ESP_Token **hit)
+{
+    *hit = NULL;
+
+    if (esp_matcher.count == 0) {
+        ESP_MatcherLoad(NULL); /* 首次调用：仅监听 URC */
+    }
+
+    /* 1. +IPD 数据截取：数据内容不参与 token 匹配 */
+    if (ipd_state == IPD_DATA) {
+        ESP_RxPush(byte);
+        if (--ipd_remain == 0) {
+            ipd_state = IPD_IDLE;
+        }
+        return true;
+    }
+    if (ipd_state == IPD_LEN) {
+        if (byte >= '0' && byte <= '9') {
+            ipd_remain = ipd_remain * 10 + (byte - '0');
+            return false;
+        }
+        if (byte == '\r' && ipd_remain > 0) {
+            /* 被动模式下的到达通知 "+IPD,<len>\r\n"，数据仍在模块中 */
+            rx_pending = true;
+        }
+        ipd_state = (byte == ':' && ipd_remain > 0) ? IPD_DATA : IPD_IDLE;
+        if (ipd_state == IPD_DATA) return false;
+    }
+
+    /* 2. 所有 token 的 KMP 状态同步推进 */
+    for (uint8_t k = 0; k < esp_matcher.count; k++) {
+        const char *s = esp_matcher.tokens[k]->str;
+        uint8_t st = esp_matcher.state[k];
+
+        while (st > 0 && (uint8_t)s[st] != byte) st = esp_matcher.fail[k][st - 1];
+        if ((uint8_t)s[st] == byte) st++;
+
+        if (st == esp_matcher.len[k]) {
+            const ESP_Token *tok = esp_matcher.tokens[k];
+            st = esp_matcher.fail[k][st - 1];
+            if (tok->type == ESP_TOKEN_URC) {
+                ESP_HandleURC(tok->event);
+            } else if (*hit == NULL) {
+                *hit = tok;
+            }
+        }
+        esp_matcher.state[k] = st;
+    }
+    return false;
+}
+
+#ifdef MQTT_UART_RX_DMA
+/**
+ * @brief 启动 (或在出错被 HAL 中止后重新启动) 循环 DMA 接收
+ * @details 串口 RX 需在 CubeMX 中配置为 Circular DMA。数据到达与线路空闲时
+ *          产生中断，唤醒 MQTT_Idle 中的睡眠。
+ */
+static void ESP_UartStart(void)
+{
+    if ((MQTT_UART_HANDLE)->RxState == HAL_UART_STATE_READY) {
+        uart_tail = 0;
+        HAL_UARTEx_ReceiveToIdle_DMA(MQTT_UART_HANDLE, mqtt_arena.uart_ring, MQTT_UART_RX_RING);
+    }
+}
+
+/**
+ * @brief 环形缓冲中待读的字节数
+ */
+static uint16_t ESP_UartPending(void)
+{
+    uint16_t head = (uint16_t)((MQTT_UART_RX_RING - __HAL_DMA_GET_COUNTER((MQTT_UART_HANDLE)->hdmarx)) % MQTT_UART_RX_RING);
+    return (uint16_t)((head + MQTT_UART_RX_RING - uart_tail) % MQTT_UART_RX_RING);
+}
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+    (void)Size;
+    if (huart == MQTT_UART_HANDLE) {
+        wake_pending = true;
+    }
+}
+#endif
+
+/**
+ * @brief 从 AT 串口读取一个字节
+ * @param timeout_ms 0 表示不等待
+ */
+static bool ESP_UartGet(uint8_t *byte, uint32_t timeout_ms)
+{
+#ifdef MQTT_UART_RX_DMA
+    uint32_t start = HAL_GetTick();
+    do {
+        uint16_t pending = ESP_UartPending();
+        if (pending > 0) {
+            MQTT_ArenaMark(MQTT_ARENA_UART, pending);
+            *byte = mqtt_arena.uart_ring[uart_tail];
+            uart_tail = (uint16_t)((uart_tail + 1) % MQTT_UART_RX_RING);
+            return true;
+        }
+    } while (HAL_GetTick() - start < timeout_ms);
+    return false;
+#else
+    return HAL_UART_Receive(MQTT_UART_HANDLE, byte, 1, timeout_ms) == HAL_OK;
+#endif
+}
+
 /**
- * @brief 执行 AT 指令并等待期望的响应字符串
+ * @brief 执行 AT 指令并等待任一终止 token
  *
  * @param cmd 要发送的指令 (NULL 则不发送，仅接收)
- * @param expected 期望收到的响应子串 (NULL 则不检查，读到超时)
- * @param out_buf 输出缓冲区，用于存储收到的数据 (NULL 则使用内部临时缓冲)
+ * @param tokens 本指令的 token 表，以 {NULL} 结尾 (NULL 则读到超时)
+ * @param out_buf 输出缓冲区，用于存储收到的 AT 文本 (NULL 则不保存)
  * @param buf_len 输出缓冲区大小
  * @param timeout_ms 超时时间
- * @return true 找到 expected 字符串
- * @return false 超时或未找到
+ * @return ESP_RESULT_OK 命中成功 token
+ * @return ESP_RESULT_FAIL 命中失败 token (ERROR / FAIL / busy 等)，立即返回
+ * @return ESP_RESULT_TIMEOUT 超时
  */
-static bool ESP_Execute(const char *cmd, const char *expected, char *out_buf, uint16_t buf_len, uint32_t timeout_ms)
+static ESP_Result ESP_Execute(const char *cmd, const ESP_Token *tokens, char *out_buf, uint16_t buf_len, uint32_t timeout_ms)
 {
-    char local_buf[128]; // 若调用者不需要完整数据，使用小缓冲区
-    char *p_buf = out_buf ? out_buf : local_buf;
-    uint16_t p_len = out_buf ? buf_len : sizeof(local_buf);
+    ESP_Result result = ESP_RESULT_TIMEOUT;
     uint16_t idx = 0;
+    bool truncated = false;
     uint32_t start_time = HAL_GetTick();
 
-    /* 清空接收缓冲区 */
-    memset(p_buf, 0, p_len);
+    if (out_buf != NULL && buf_len > 0) {
+        out_buf[0] = '\0';
+    }
+
+    esp_busy++;
+    ESP_MatcherLoad(tokens);
+    MQTT_TRACE_BEGIN(MQTT_EV_AT, cmd ? MQTT_TraceHash(cmd, (uint16_t)strcspn(cmd, "=?\r")) : 0);
 
     /* 发送指令 */
     if (cmd != NULL) {
@@ -107,83 +533,144 @@ static bool ESP_Execute(const char *cmd, const char *expected, char *out_buf, ui
     /* 循环接收 */
     while ((HAL_GetTick() - start_time) < timeout_ms) {
         uint8_t rx_char;
+        const ESP_Token *hit;
+
         /* 使用短超时 (1ms) 轮询，提高响应速度 */
-        if (HAL_UART_Receive(MQTT_UART_HANDLE, &rx_char, 1, 1) == HAL_OK) {
-            if (idx < p_len - 1) {
-                p_buf[idx++] = rx_char;
-                p_buf[idx] = '\0';
-
-                /* 实时检查是否包含期望响应 */
-                if (expected != NULL && strstr(p_buf, expected) != NULL) {
-                    MQTT_Log("[响应] 成功 (%s)\r\n", expected);
-                    return true;
-                }
+        if (!ESP_UartGet(&rx_char, 1)) {
+            continue;
+        }
+
+        if (ESP_FeedByte(rx_char, &hit)) {
+            continue; /* +IPD 数据已转入暂存区 */
+        }
+
+        /* 保存 AT 文本：缓冲区满后截断而非回绕，匹配不受影响 */
+        if (out_buf != NULL && buf_len > 0) {
+            if (idx < buf_len - 1) {
+                out_buf[idx++] = rx_char;
+                out_buf[idx] = '\0';
             } else {
-                /* 缓冲区满，重置索引 (循环覆盖，防止溢出)
-                   注意：这可能会截断长响应，实际应用根据需要调整 */
-                idx = 0;
-                // 或者 break; 取决于策略
+                truncated = true;
             }
         }
+
+        if (hit != NULL) {
+            result = (hit->type == ESP_TOKEN_OK) ? ESP_RESULT_OK : ESP_RESULT_FAIL;
+            MQTT_Log("[响应] %s (%s)\r\n", result == ESP_RESULT_OK ? "成功" : "失败", hit->str);
+            break;
+        }
     }
 
-    if (expected == NULL) {
-        return true; /* 无期望响应，超时即完成 */
+    ESP_MatcherLoad(NULL);
+    esp_busy--;
+    MQTT_TRACE_END(MQTT_EV_AT, result);
+
+    if (cmd == mqtt_arena.cmd) {
+        MQTT_ArenaMark(MQTT_ARENA_CMD, strlen(cmd) + 1);
+    }
+    if (out_buf == mqtt_arena.at) {
+        MQTT_ArenaMark(MQTT_ARENA_AT, truncated ? (uint32_t)buf_len + 1 : (uint32_t)idx + 1);
     }
 
-    MQTT_Log("[响应] 超时或失败\r\n");
-    return false;
+    if (truncated) {
+        MQTT_Log("[响应] 输出缓冲区已满，响应被截断\r\n");
+    }
+    if (result == ESP_RESULT_TIMEOUT && tokens != NULL) {
+        MQTT_Log("[响应] 超时\r\n");
+    }
+    return result;
 }
 
+/**
+ * @brief 发送 AT 指令，等待 expected 或通用失败标志
+ */
 static bool ESP_SendAT(const char *cmd, const char *expected, uint32_t timeout_ms)
 {
-    return ESP_Execute(cmd, expected, NULL, 0, timeout_ms);
+    const ESP_Token tokens[] = {
+        {expected, ESP_TOKEN_OK, ESP_URC_NONE},
+        ESP_TOKEN_ERROR,
+        {"FAIL", ESP_TOKEN_FAIL, ESP_URC_NONE},
+        ESP_TOKEN_BUSY,
+        {NULL, ESP_TOKEN_OK, ESP_URC_NONE}
+    };
+    return ESP_Execute(cmd, tokens, NULL, 0, timeout_ms) == ESP_RESULT_OK;
 }
 
-static bool ESP_SendRaw(uint8_t *data, uint16_t len)
+/**
+ * @brief AT 后端发送：AT+CIPSEND 声明总长度，'>' 之后依次写出各段，等待 SEND OK
+ */
+static bool ESP_Writev(void *ctx, const MQTT_IoVec *iov, uint8_t iovcnt)
 {
-    HAL_UART_Transmit(MQTT_UART_HANDLE, data, len, 100);
-    return ESP_Execute(NULL, "SEND OK", NULL, 0, AT_CMD_TIMEOUT_LONG);
-}
+    static const ESP_Token prompt_tokens[] = {
+        {">", ESP_TOKEN_OK, ESP_URC_NONE},
+        ESP_TOKEN_ERROR,
+        ESP_TOKEN_BUSY,
+        {"CLOSED", ESP_TOKEN_FAIL, ESP_URC_NONE},
+        {NULL, ESP_TOKEN_OK, ESP_URC_NONE}
+    };
+    static const ESP_Token send_tokens[] = {
+        {"SEND OK", ESP_TOKEN_OK, ESP_URC_NONE},
+        {"SEND FAIL", ESP_TOKEN_FAIL, ESP_URC_NONE},
+        ESP_TOKEN_ERROR,
+        {"CLOSED", ESP_TOKEN_FAIL, ESP_URC_NONE},
+        {NULL, ESP_TOKEN_OK, ESP_URC_NONE}
+    };
+    char cmd_buf[32];
+    uint32_t total = 0;
 
-static uint8_t mqtt_encode_len(uint8_t *buf, uint32_t length)
-{
-    uint8_t len_bytes = 0;
-    do {
-        uint8_t encoded_byte = length % 128;
-        length /= 128;
-        if (length > 0) {
-            encoded_byte |= 0x80;
+    (void)ctx;
+    for (uint8_t i = 0; i < iovcnt; i++) {
+        total += iov[i].len;
+    }
+    if (total == 0 || total > ESP_SEND_MAX) {
+        MQTT_Log("发送失败: 报文长度 %lu 超出 AT+CIPSEND 限制\r\n", (unsigned long)total);
+        return false;
+    }
+    sprintf(cmd_buf, "AT+CIPSEND=%lu\r\n", (unsigned long)total);
+
+    /* '>' 提示符与数据之间同样不可被打断 */
+    bool sent = false;
+    esp_busy++;
+    if (ESP_Execute(cmd_buf, prompt_tokens, NULL, 0, AT_CMD_TIMEOUT_LONG) == ESP_RESULT_OK) {
+        for (uint8_t i = 0; i < iovcnt; i++) {
+            if (iov[i].len > 0) {
+                HAL_UART_Transmit(MQTT_UART_HANDLE, (uint8_t *)iov[i].data, iov[i].len, 100);
+            }
         }
-        buf[len_bytes++] = encoded_byte;
-    } while (length > 0);
-    return len_bytes;
+        sent = (ESP_Execute(NULL, send_tokens, NULL, 0, AT_CMD_TIMEOUT_LONG) == ESP_RESULT_OK);
+    }
+    esp_busy--;
+    return sent;
 }
 
-static uint16_t mqtt_encode_string(uint8_t *buf, const char *str)
-{
-    uint16_t len = strlen(str);
-    buf[0] = (len >> 8) & 0xFF;
-    buf[1] = len & 0xFF;
-    memcpy(&buf[2], str, len);
-    return len + 2;
-}
+/* ==========================================
+ * 协议引擎：只通过 transport 收发
+ * ========================================== */
 
-static bool MQTT_SendPacket(uint8_t *packet, uint16_t len)
+static bool MQTT_SendPacketV(const MQTT_IoVec *iov, uint8_t iovcnt)
 {
-    char cmd_buf[32];
-    sprintf(cmd_buf, "AT+CIPSEND=%d\r\n", len);
-
-    if (ESP_SendAT(cmd_buf, ">", AT_CMD_TIMEOUT_LONG)) {
-        if (ESP_SendRaw(packet, len)) {
-            return true;
-        }
+#ifdef MQTT_TRACE
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < iovcnt; i++) {
+        total += iov[i].len;
+    }
+    MQTT_TRACE_BEGIN(MQTT_EV_SEND, total);
+#endif
+    bool ok = transport->writev(transport->ctx, iov, iovcnt);
+    MQTT_TRACE_END(MQTT_EV_SEND, ok ? 0 : 1);
+    if (ok) {
+        return true;
     }
-
     is_connected = false;
     return false;
 }
 
+static bool MQTT_SendPacket(const uint8_t *packet, uint16_t len)
+{
+    MQTT_IoVec iov = {packet, len};
+    return MQTT_SendPacketV(&iov, 1);
+}
+
 void MQTT_Heartbeat(void)
 {
     uint8_t packet[2] = {MQTT_PKT_PINGREQ, 0x00};
@@ -192,10 +679,8 @@ void MQTT_Heartbeat(void)
 
 void MQTT_AutoReconnect(void)
 {
-    static uint32_t last_reconnect = 0;
-
     if (!is_connected) {
-        if (HAL_GetTick() - last_reconnect > 5000) {
+        if (HAL_GetTick() - last_reconnect > MQTT_RECONNECT_INTERVAL) {
             last_reconnect = HAL_GetTick();
             MQTT_Log("检测到连接断开，尝试重连...\r\n");
             MQTT_Start();
@@ -205,7 +690,8 @@ void MQTT_AutoReconnect(void)
 
 void MQTT_Service(void)
 {
-    static uint32_t last_ping = 0;
+    /* 定时器中断打断了主循环中的 AT 交互：本次跳过，避免串口数据交错 */
+    if (esp_busy) return;
     if (is_connected) {
         if (HAL_GetTick() - last_ping > (MQTT_KEEPALIVE * 1000) / 2) {
             last_ping = HAL_GetTick();
@@ -213,15 +699,7 @@ void MQTT_Service(void)
         }
 
         /* 检查并执行挂起的订阅 */
-        for (int i = 0; i < subscription_count; i++) {
-            if (!subscriptions[i].is_subscribed) {
-                if (MQTT_SendSubscribePacket(subscriptions[i].topic)) {
-                    subscriptions[i].is_subscribed = true;
-                    // 给模块一点处理时间
-                    HAL_Delay(50);
-                }
-            }
-        }
+        MQTT_FlushSubscriptions();
     } else {
         MQTT_AutoReconnect();
     }
@@ -233,7 +711,8 @@ void MQTT_Service(void)
     bool has_callbacks = (message_handler != NULL);
     if (!has_callbacks) {
         for (int i = 0; i < subscription_count; i++) {
-            if (subscriptions[i].callback != NULL) {
+            if (subscriptions[i].callback != NULL || subscriptions[i].id_handler != NULL ||
+                subscriptions[i].stream_handler != NULL) {
                 has_callbacks = true;
                 break;
             }
@@ -241,25 +720,322 @@ void MQTT_Service(void)
     }
 
     if (has_callbacks) {
-        char topic[64];
-        char payload[128];
-        if (MQTT_Process(topic, sizeof(topic), payload, sizeof(payload))) {
-            bool handled = false;
-            
-            /* 1. 查找并调用匹配的特定回调 */
-            for (int i = 0; i < subscription_count; i++) {
-                if (subscriptions[i].callback && MQTT_TopicMatched(subscriptions[i].topic, topic)) {
-                    subscriptions[i].callback(topic, payload);
-                    handled = true;
-                }
+        /* 解码后只入队，不在接收路径 (可能是定时器中断) 中执行回调
+         * 一次取尽缓冲区内所有完整报文，突发时 LATEST 订阅只会留下最新值
+         */
+        char *topic = mqtt_arena.topic;
+        char *payload = mqtt_arena.payload;
+        bool received = MQTT_InboundReady() && MQTT_Process(topic, MQTT_TOPIC_SIZE, payload, MQTT_PAYLOAD_SIZE);
+        for (;;) {
+            if (received) {
+                MQTT_ArenaMark(MQTT_ARENA_DECODE, strlen(topic) + strlen(payload) + 2);
+                MQTT_Enqueue(topic, payload);
             }
+            if (!MQTT_InboundReady()) break; /* 队列满：其余数据留在缓冲区，不丢弃 */
+            uint16_t before = rx_idx;
+            received = MQTT_DecodeNext(topic, MQTT_TOPIC_SIZE, payload, MQTT_PAYLOAD_SIZE);
+            if (rx_idx != before) continue;
+            /* 没有完整报文：后端还有数据则继续读入，否则结束 (溢出留给下次 MQTT_Process 处理) */
+            if (rx_overflow || transport->readable(transport->ctx) == 0 || MQTT_ReadTransport() <= 0) break;
+        }
+    }
+
+#ifndef MQTT_TIM_HANDLE
+    /* 主循环驱动：解码完成后在同一上下文分发；定时器驱动时由用户在主循环调用 */
+    MQTT_Dispatch();
+#endif
+}
+
+/**
+ * @brief 距 due 的剩余毫秒数，已到期返回 0
+ */
+static uint32_t MQTT_Remaining(uint32_t due, uint32_t now)
+{
+    int32_t left = (int32_t)(due - now);
+    return (left > 0) ? (uint32_t)left : 0;
+}
+
+static uint32_t MQTT_Earliest(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+uint32_t MQTT_NextDeadline(void)
+{
+    uint32_t now = HAL_GetTick();
+    uint32_t total;
+
+    /* 1. 已有待处理的事件或数据 */
+    if (wake_pending || esp_busy) return 0;
+    if (rx_idx > 0 && MQTT_PacketLength(rx_buffer, rx_idx, &total) != 0) return 0;
+    if (transport->readable(transport->ctx) > 0) return 0;
+
+    uint32_t wait = MQTT_WAIT_FOREVER;
+#ifdef MQTT_UART_RX_DMA
+    if (transport == &MQTT_TransportAT && ESP_UartPending() > 0) return 0;
+#else
+    /* 串口轮询接收：没有唤醒内核的接收事件，最多睡一个轮询周期 */
+    if (transport == &MQTT_TransportAT) wait = MQTT_IDLE_POLL_MS;
+#endif
+
+    /* 2. 连接相关的定时任务 */
+    if (is_connected) {
+        for (int i = 0; i < subscription_count; i++) {
+            if (!subscriptions[i].is_subscribed) return 0;
+        }
+        wait = MQTT_Earliest(wait, MQTT_Remaining(last_ping + (MQTT_KEEPALIVE * 1000) / 2, now));
+        if (recv_passive && esp_link_up) {
+            if (rx_pending) return 0;
+            wait = MQTT_Earliest(wait, MQTT_Remaining(last_recv_poll + MQTT_RECV_POLL_MS, now));
+        }
+    } else {
+        wait = MQTT_Earliest(wait, MQTT_Remaining(last_reconnect + MQTT_RECONNECT_INTERVAL + 1, now));
+    }
 
-            /* 2. 如果未被特定回调处理，调用全局回调 */
-            if (!handled && message_handler) {
-                message_handler(topic, payload);
+    /* 3. 入站队列中限速 (SAMPLED) 延后分发的消息 */
+    MQTT_ENTER_CRITICAL();
+    for (int i = 0; i < MQTT_INBOUND_QUEUE_LEN; i++) {
+        if (inbound_queue[i].used) {
+            wait = MQTT_Earliest(wait, MQTT_Remaining(inbound_queue[i].not_before, now));
+        }
+    }
+    MQTT_EXIT_CRITICAL();
+
+    return wait;
+}
+
+void MQTT_Wake(void)
+{
+    wake_pending = true;
+}
+
+void MQTT_LinkLost(void)
+{
+    /* 会话随链路失效：下一次服务例程即进入重连，不必等到 MQTT_Process 读到断开 */
+    is_connected = false;
+    wake_pending = true;
+}
+
+/**
+ * @brief 睡眠默认实现：WFI 等待中断，任一中断 (含 SysTick) 唤醒后检查是否有事件
+ */
+__weak void MQTT_Sleep(uint32_t ms)
+{
+    uint32_t start = HAL_GetTick();
+
+    while (!wake_pending && HAL_GetTick() - start < ms) {
+        __WFI();
+#ifdef MQTT_UART_RX_DMA
+        if (transport == &MQTT_TransportAT && ESP_UartPending() > 0) break;
+#endif
+        if (transport != &MQTT_TransportAT && transport->readable(transport->ctx) > 0) break;
+    }
+}
+
+void MQTT_Idle(uint32_t max_ms)
+{
+    /* 先清标志再计算：计算期间到达的中断会让睡眠立即结束 */
+    wake_pending = false;
+    uint32_t wait = MQTT_Earliest(MQTT_NextDeadline(), max_ms);
+    if (wait > 0) {
+        MQTT_Sleep(wait);
+    }
+}
+
+/**
+ * @brief 在注册表中查找主题 (先比长度再比内容)
+ */
+static MQTT_TopicId MQTT_FindTopic(const char *topic)
+{
+    size_t len = strlen(topic);
+    for (int i = 0; i < topic_count; i++) {
+        if (topic_registry[i].len == len && memcmp(&topic_registry[i].encoded[2], topic, len) == 0) {
+            return (MQTT_TopicId)i;
+        }
+    }
+    return MQTT_TOPIC_INVALID;
+}
+
+/**
+ * @brief 将一条消息交给一个订阅 (sub 为 NULL 时交给全局回调)
+ * @details 每个匹配的订阅各占一项 (携带该订阅的优先级)；队列满时丢弃并计数。
+ */
+static void MQTT_EnqueueOne(const char *topic, const char *payload, MQTT_TopicId topic_id, MQTT_Subscription_t *sub)
+{
+    MQTT_InboundMsg_t *msg = NULL;
+    MQTT_MessageHandler handler = sub ? sub->callback : message_handler;
+    MQTT_IdHandler id_handler = sub ? sub->id_handler : NULL;
+    bool coalesce = (sub != NULL && sub->delivery != MQTT_DELIVER_ALL);
+    uint32_t now = HAL_GetTick();
+
+    MQTT_ENTER_CRITICAL();
+
+    /* LATEST / SAMPLED: 同一主题尚未分发的旧值直接被覆盖，保留原排队位置 */
+    if (coalesce) {
+        for (int i = 0; i < MQTT_INBOUND_QUEUE_LEN; i++) {
+            MQTT_InboundMsg_t *old = &inbound_queue[i];
+            if (!old->used || !old->coalesce) continue;
+            if (old->handler != handler || old->id_handler != id_handler) continue;
+            bool same_topic = (topic_id != MQTT_TOPIC_INVALID)
+                ? (old->topic_id == topic_id)
+                : (strncmp(old->topic, topic, sizeof(old->topic) - 1) == 0);
+            if (same_topic) {
+                strncpy(old->payload, payload, sizeof(old->payload) - 1);
+                old->payload[sizeof(old->payload) - 1] = '\0';
+                stats.inbound_coalesced++;
+                MQTT_EXIT_CRITICAL();
+                return;
             }
         }
     }
+
+    for (int i = 0; i < MQTT_INBOUND_QUEUE_LEN; i++) {
+        if (!inbound_queue[i].used) {
+            msg = &inbound_queue[i];
+            break;
+        }
+    }
+    if (msg == NULL) {
+        stats.inbound_dropped++;
+        MQTT_EXIT_CRITICAL();
+        MQTT_Log("入站队列已满，丢弃: %s\r\n", topic);
+        return;
+    }
+
+    strncpy(msg->topic, topic, sizeof(msg->topic) - 1);
+    msg->topic[sizeof(msg->topic) - 1] = '\0';
+    strncpy(msg->payload, payload, sizeof(msg->payload) - 1);
+    msg->payload[sizeof(msg->payload) - 1] = '\0';
+    msg->handler = handler;
+    msg->id_handler = id_handler;
+    msg->topic_id = topic_id;
+    msg->priority = sub ? sub->priority : 0;
+    msg->seq = inbound_seq++;
+    msg->coalesce = coalesce;
+    msg->not_before = now;
+    msg->used = true;
+
+    /* SAMPLED: 新开一项时预约分发时刻，期间到达的消息都合并到这一项 */
+    if (sub != NULL && sub->delivery == MQTT_DELIVER_SAMPLED) {
+        if ((int32_t)(sub->next_slot - now) > 0) {
+            msg->not_before = sub->next_slot;
+        }
+        sub->next_slot = msg->not_before + sub->interval;
+    }
+
+    inbound_count++;
+    MQTT_TRACE_COUNTER(MQTT_EV_QUEUE, inbound_count);
+    stats.inbound_enqueued++;
+    if (inbound_count > stats.inbound_queue_peak) {
+        stats.inbound_queue_peak = inbound_count;
+        MQTT_ArenaMark(MQTT_ARENA_INBOUND, inbound_count * sizeof(MQTT_InboundMsg_t));
+    }
+    MQTT_EXIT_CRITICAL();
+}
+
+/**
+ * @brief 入站队列是否还有空位
+ * @details 队列满时，主循环驱动先分发腾出空间；定时器驱动不能在中断中执行回调，
+ *          则暂停解码，数据留在缓冲区 (被动模式下留在模块内，由 TCP 窗口反压)。
+ */
+static bool MQTT_InboundReady(void)
+{
+    if (inbound_count < MQTT_INBOUND_QUEUE_LEN) return true;
+#ifndef MQTT_TIM_HANDLE
+    MQTT_Dispatch();
+#endif
+    return inbound_count < MQTT_INBOUND_QUEUE_LEN;
+}
+
+static void MQTT_Enqueue(const char *topic, const char *payload)
+{
+    bool handled = false;
+
+    /* 入站主题只与注册表比对一次，之后按句柄匹配订阅 */
+    MQTT_TopicId topic_id = MQTT_FindTopic(topic);
+
+    /* 1. 查找匹配的特定回调 */
+    for (int i = 0; i < subscription_count; i++) {
+        MQTT_Subscription_t *sub = &subscriptions[i];
+        if (sub->callback == NULL && sub->id_handler == NULL) continue;
+
+        bool matched = (sub->topic_id != MQTT_TOPIC_INVALID)
+            ? (sub->topic_id == topic_id)
+            : MQTT_TopicMatched(sub->topic, topic);
+        if (matched) {
+            MQTT_EnqueueOne(topic, payload, topic_id, sub);
+            handled = true;
+        }
+    }
+
+    /* 2. 如果未被特定回调处理，交给全局回调 */
+    if (!handled && message_handler) {
+        MQTT_EnqueueOne(topic, payload, topic_id, NULL);
+    }
+}
+
+void MQTT_Dispatch(void)
+{
+    static bool dispatching = false;
+
+    /* 回调中再次进入 (如经 MQTT_Publish -> MQTT_Service) 时直接返回 */
+    if (dispatching) return;
+    dispatching = true;
+
+    for (;;) {
+        MQTT_InboundMsg_t msg;
+        int best = -1;
+
+        /* 取出已到期、优先级最高、最早入队的一项，复制后立即释放槽位 */
+        uint32_t now = HAL_GetTick();
+        MQTT_ENTER_CRITICAL();
+        for (int i = 0; i < MQTT_INBOUND_QUEUE_LEN; i++) {
+            if (!inbound_queue[i].used) continue;
+            if ((int32_t)(now - inbound_queue[i].not_before) < 0) continue;
+            if (best < 0
+                || inbound_queue[i].priority > inbound_queue[best].priority
+                || (inbound_queue[i].priority == inbound_queue[best].priority
+                    && (int16_t)(inbound_queue[i].seq - inbound_queue[best].seq) < 0)) {
+                best = i;
+            }
+        }
+        if (best >= 0) {
+            msg = inbound_queue[best];
+            inbound_queue[best].used = false;
+            inbound_count--;
+            MQTT_TRACE_COUNTER(MQTT_EV_QUEUE, inbound_count);
+        }
+        MQTT_EXIT_CRITICAL();
+
+        if (best < 0) break;
+
+        /* 回调在队列之外执行，可安全调用 MQTT_Publish */
+        MQTT_TRACE_BEGIN(MQTT_EV_CALLBACK, MQTT_TraceHash(msg.topic, (uint16_t)strlen(msg.topic)));
+        if (msg.id_handler) {
+            msg.id_handler(msg.topic_id, msg.payload);
+        } else {
+            msg.handler(msg.topic, msg.payload);
+        }
+        MQTT_TRACE_END(MQTT_EV_CALLBACK, 0);
+        stats.inbound_dispatched++;
+    }
+
+    dispatching = false;
+}
+
+const MQTT_ArenaUsage *MQTT_GetArenaUsage(void)
+{
+    return arena_usage;
+}
+
+uint32_t MQTT_GetArenaSize(void)
+{
+    return sizeof(mqtt_arena);
+}
+
+const MQTT_Stats *MQTT_GetStats(void)
+{
+    return &stats;
 }
 
 /* ==========================================
@@ -271,20 +1047,370 @@ bool MQTT_IsConnected(void)
     return is_connected;
 }
 
-bool MQTT_Start(void)
+static uint32_t MQTT_Fnv1a(uint32_t hash, const void *data, uint16_t len)
 {
-    char buf[RX_BUFFER_SIZE];
-    char cmd_buf[128];
-    uint8_t packet[128];
-    uint16_t idx = 0;
+    const uint8_t *p = (const uint8_t *)data;
+    while (len--) {
+        hash ^= *p++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* ==========================================
+ * 连接缓存 (快速重连)
+ * ========================================== */
+#ifdef MQTT_CONN_CACHE
+#define MQTT_CACHE_MAGIC 0x4D514331 /* "MQC1" */
+
+static MQTT_ConnCache conn_cache;
+static bool cache_valid = false;
+
+/* 默认存储位置：.noinit 段在看门狗/软件复位后保持不变
+ * 需在链接脚本中声明 .noinit (NOLOAD) 段；需掉电保持请重写下方两个弱函数 */
+static MQTT_ConnCache cache_noinit __attribute__((section(".noinit")));
+
+/* 配置指纹：SSID 或服务器变更后缓存自动失效 */
+static uint32_t MQTT_CacheConfigHash(void)
+{
+    uint32_t hash = 2166136261u;
+    hash = MQTT_Fnv1a(hash, WIFI_SSID, strlen(WIFI_SSID));
+    hash = MQTT_Fnv1a(hash, MQTT_BROKER, strlen(MQTT_BROKER));
+    return hash;
+}
+
+static uint32_t MQTT_CacheChecksum(const MQTT_ConnCache *cache)
+{
+    return MQTT_Fnv1a(2166136261u, cache, offsetof(MQTT_ConnCache, checksum));
+}
+
+__weak bool MQTT_CacheLoad(MQTT_ConnCache *cache)
+{
+    memcpy(cache, &cache_noinit, sizeof(MQTT_ConnCache));
+    return true;
+}
+
+__weak void MQTT_CacheSave(const MQTT_ConnCache *cache)
+{
+    memcpy(&cache_noinit, cache, sizeof(MQTT_ConnCache));
+}
+
+static void MQTT_CacheInit(void)
+{
+    static bool loaded = false;
+    if (loaded) return;
+    loaded = true;
+
+    cache_valid = MQTT_CacheLoad(&conn_cache)
+               && conn_cache.magic == MQTT_CACHE_MAGIC
+               && conn_cache.config_hash == MQTT_CacheConfigHash()
+               && conn_cache.checksum == MQTT_CacheChecksum(&conn_cache);
+    if (!cache_valid) {
+        memset(&conn_cache, 0, sizeof(conn_cache));
+    }
+    MQTT_Log("连接缓存: %s\r\n", cache_valid ? "有效" : "无");
+}
+
+static void MQTT_CacheCommit(void)
+{
+    conn_cache.magic = MQTT_CACHE_MAGIC;
+    conn_cache.config_hash = MQTT_CacheConfigHash();
+    conn_cache.checksum = MQTT_CacheChecksum(&conn_cache);
+    MQTT_CacheSave(&conn_cache);
+    cache_valid = true;
+}
+
+/**
+ * @brief 发送只作用于本次运行的设置指令 (AT 1.x 的 _CUR 形式，不写入模块 Flash)
+ * @details AT 2.x 取消了 _CUR 后缀，返回 ERROR 时改发不带后缀的形式
+ * @param name 指令名，如 "CIPSTA"
+ * @param args 参数部分
+ */
+static bool ESP_SendATCur(const char *name, const char *args)
+{
+    char *cmd_buf = mqtt_arena.cmd;
+
+    snprintf(cmd_buf, MQTT_CMD_BUF_SIZE, "AT+%s_CUR=%s\r\n", name, args);
+    if (ESP_SendAT(cmd_buf, "OK", AT_CMD_TIMEOUT_NORMAL)) {
+        return true;
+    }
+    snprintf(cmd_buf, MQTT_CMD_BUF_SIZE, "AT+%s=%s\r\n", name, args);
+    return ESP_SendAT(cmd_buf, "OK", AT_CMD_TIMEOUT_NORMAL);
+}
+
+static void MQTT_CacheInvalidate(void)
+{
+    /* 缓存中有地址即可能已用 AT+CIPSTA 设为静态 IP (含复位前的运行)：
+     * 模块仍连着 AP 时下次建链会跳过入网，因此在这里恢复 DHCP，
+     * 否则失效的静态地址会一直沿用 */
+    if (conn_cache.ip[0] != '\0') {
+        ESP_SendATCur("CWDHCP", "1,1");
+    }
+    memset(&conn_cache, 0, sizeof(conn_cache));
+    MQTT_CacheSave(&conn_cache);
+    cache_valid = false;
+}
+
+/**
+ * @brief 从 AT 响应中提取 key 之后、下一个 '"' 之前的字符串
+ */
+static bool ESP_ExtractField(const char *buf, const char *key, char *out, uint16_t out_size)
+{
+    const char *p = strstr(buf, key);
+    if (p == NULL) return false;
+    p += strlen(key);
+
+    uint16_t n = 0;
+    while (*p && *p != '"' && *p != '\r' && n < out_size - 1) {
+        out[n++] = *p++;
+    }
+    out[n] = '\0';
+    return n > 0;
+}
+
+/**
+ * @brief 记录当前 AP 的 BSSID/信道
+ * @param buf AT+CWJAP? 响应: +CWJAP:"<ssid>","<bssid>",<channel>,<rssi>
+ */
+static void MQTT_CacheCaptureAP(const char *buf)
+{
+    const char *p = strstr(buf, "+CWJAP:\"");
+    if (p == NULL) return;
+    p = strstr(p, "\",\"");
+    if (p == NULL) return;
+
+    if (ESP_ExtractField(p, "\",\"", conn_cache.bssid, sizeof(conn_cache.bssid))) {
+        const char *ch = strstr(p + 3, "\",");
+        conn_cache.channel = ch ? (uint8_t)atoi(ch + 2) : 0;
+    }
+}
+
+/**
+ * @brief 记录 DHCP 分配的地址，下次以静态 IP 入网跳过 DHCP
+ * @details AT+CIPSTA? 响应: +CIPSTA:ip:"x" / +CIPSTA:gateway:"x" / +CIPSTA:netmask:"x"
+ */
+static void MQTT_CacheCaptureIP(char *buf, uint16_t buf_len)
+{
+    static const ESP_Token tokens[] = {
+        {"OK", ESP_TOKEN_OK, ESP_URC_NONE},
+        ESP_TOKEN_ERROR,
+        {NULL, ESP_TOKEN_OK, ESP_URC_NONE}
+    };
+
+    if (ESP_Execute("AT+CIPSTA?\r\n", tokens, buf, buf_len, AT_CMD_TIMEOUT_NORMAL) != ESP_RESULT_OK) {
+        return;
+    }
+    if (!ESP_ExtractField(buf, "ip:\"", conn_cache.ip, sizeof(conn_cache.ip))
+        || !ESP_ExtractField(buf, "gateway:\"", conn_cache.gateway, sizeof(conn_cache.gateway))
+        || !ESP_ExtractField(buf, "netmask:\"", conn_cache.netmask, sizeof(conn_cache.netmask))) {
+        conn_cache.ip[0] = '\0';
+    }
+}
+
+#ifndef MQTT_USE_SSL
+/**
+ * @brief 解析服务器域名并缓存 IP，TCP 建连改用 IP 直连免去重复 DNS
+ * @details AT+CIPDOMAIN 响应: +CIPDOMAIN:<ip> (部分固件带引号)。SSL 须按域名建连，不使用
+ */
+static bool MQTT_CacheResolveBroker(char *buf, uint16_t buf_len)
+{
+    static const ESP_Token tokens[] = {
+        {"OK", ESP_TOKEN_OK, ESP_URC_NONE},
+        ESP_TOKEN_ERROR,
+        {"DNS Fail", ESP_TOKEN_FAIL, ESP_URC_NONE},
+        {NULL, ESP_TOKEN_OK, ESP_URC_NONE}
+    };
+    char *cmd_buf = mqtt_arena.cmd;
+
+    snprintf(cmd_buf, MQTT_CMD_BUF_SIZE, "AT+CIPDOMAIN=\"%s\"\r\n", MQTT_BROKER);
+    if (ESP_Execute(cmd_buf, tokens, buf, buf_len, AT_CMD_TIMEOUT_LONG) != ESP_RESULT_OK) {
+        return false;
+    }
+
+    const char *p = strstr(buf, "+CIPDOMAIN:");
+    if (p == NULL) return false;
+    p += strlen("+CIPDOMAIN:");
+    if (*p == '"') p++;
+    return ESP_ExtractField(p, "", conn_cache.broker_ip, sizeof(conn_cache.broker_ip));
+}
+#endif /* MQTT_USE_SSL */
+#endif /* MQTT_CONN_CACHE */
+
+/**
+ * @brief 加入 WiFi
+ * @details 有缓存时先以静态 IP (只作用于本次运行) + 指定 BSSID 快速入网
+ *          (跳过扫描与 DHCP)，失败则恢复 DHCP 并回退到完整扫描入网。
+ */
+static bool ESP_JoinWiFi(char *buf, uint16_t buf_len)
+{
+    char *cmd_buf = mqtt_arena.cmd;
+
+#ifdef MQTT_CONN_CACHE
+    if (cache_valid && conn_cache.bssid[0] != '\0') {
+        MQTT_Log("快速入网: BSSID %s 信道 %d\r\n", conn_cache.bssid, conn_cache.channel);
+
+        if (conn_cache.ip[0] != '\0') {
+            char args[56];
+            snprintf(args, sizeof(args), "\"%s\",\"%s\",\"%s\"",
+                     conn_cache.ip, conn_cache.gateway, conn_cache.netmask);
+            ESP_SendATCur("CIPSTA", args);
+        }
+
+        snprintf(cmd_buf, MQTT_CMD_BUF_SIZE, "AT+CWJAP=\"%s\",\"%s\",\"%s\"\r\n",
+                 WIFI_SSID, WIFI_PASSWORD, conn_cache.bssid);
+        if (ESP_SendAT(cmd_buf, "OK", AT_CMD_TIMEOUT_WIFI)) {
+            return true;
+        }
+
+        MQTT_Log("快速入网失败，回退完整扫描\r\n");
+        MQTT_CacheInvalidate(); /* 同时恢复 DHCP */
+    }
+#endif
+
+    MQTT_Log("正在连接 WiFi: %s...\r\n", WIFI_SSID);
+    snprintf(cmd_buf, MQTT_CMD_BUF_SIZE, "AT+CWJAP=\"%s\",\"%s\"\r\n", WIFI_SSID, WIFI_PASSWORD);
+    /* 密码错误/找不到 AP 时模块返回 "+CWJAP:<code>" + "FAIL"，无需等满超时 */
+    if (!ESP_SendAT(cmd_buf, "OK", AT_CMD_TIMEOUT_WIFI)) {
+        return false;
+    }
+
+#ifdef MQTT_CONN_CACHE
+    /* 完整入网成功：记录 AP 与地址供下次使用 */
+    static const ESP_Token query_tokens[] = {
+        {"OK", ESP_TOKEN_OK, ESP_URC_NONE},
+        ESP_TOKEN_ERROR,
+        {NULL, ESP_TOKEN_OK, ESP_URC_NONE}
+    };
+    if (ESP_Execute("AT+CWJAP?\r\n", query_tokens, buf, buf_len, AT_CMD_TIMEOUT_NORMAL) == ESP_RESULT_OK) {
+        MQTT_CacheCaptureAP(buf);
+    }
+    MQTT_CacheCaptureIP(buf, buf_len);
+#else
+    (void)buf;
+    (void)buf_len;
+#endif
+    return true;
+}
+
+#ifdef MQTT_USE_SSL
+/**
+ * @brief 配置 TLS 参数 (须在 AT+CIPSTART 之前)
+ * @details AT 固件不开放 TLS 会话票据/会话 ID，无法跨连接恢复会话，
+ *          降低重连代价只能依靠连接缓存跳过扫描与 DHCP (SSL 不使用缓存的
+ *          服务器 IP，见 ESP_ConnectTCP)。旧固件不支持 CIPSSLCCONF 时忽略。
+ */
+static void ESP_SetupSSL(void)
+{
+    char cmd_buf[32];
+
+    sprintf(cmd_buf, "AT+CIPSSLSIZE=%d\r\n", MQTT_SSL_BUF_SIZE);
+    ESP_SendAT(cmd_buf, "OK", AT_CMD_TIMEOUT_NORMAL);
+
+    sprintf(cmd_buf, "AT+CIPSSLCCONF=%d\r\n", MQTT_SSL_AUTH);
+    if (!ESP_SendAT(cmd_buf, "OK", AT_CMD_TIMEOUT_NORMAL)) {
+        MQTT_Log("固件不支持 AT+CIPSSLCCONF，使用默认 TLS 配置\r\n");
+    }
+}
+#endif
+
+/**
+ * @brief 发送 AT+CIPSTART 建立链路
+ * @details 模块上残留的旧链路 (如仅 MQTT 层失败后重连) 返回 ALREADY CONNECTED。
+ *          旧链路上的 MQTT 会话仍然有效，再发 CONNECT 违反协议 (MQTT 3.1.1
+ *          §3.1.0，服务器会断开连接)，因此先关闭旧链路再重新建立。
+ */
+static bool ESP_StartLink(const char *host, char *buf, uint16_t buf_len)
+{
+    /* 期望 CONNECT，但也可能已经是 ALREADY CONNECTED
+     * 匹配 "CONNECT\r\n" 以免与 "WIFI CONNECTED" 混淆 */
+    static const ESP_Token tcp_tokens[] = {
+        {"CONNECT\r\n", ESP_TOKEN_OK, ESP_URC_NONE},
+        {"ALREADY CONNECTED", ESP_TOKEN_OK, ESP_URC_NONE},
+        ESP_TOKEN_ERROR,
+        {NULL, ESP_TOKEN_OK, ESP_URC_NONE}
+    };
+    char *cmd_buf = mqtt_arena.cmd;
+    uint32_t link_start = HAL_GetTick();
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        snprintf(cmd_buf, MQTT_CMD_BUF_SIZE, "AT+CIPSTART=\"%s\",\"%s\",%d\r\n", MQTT_LINK_TYPE, host, MQTT_PORT);
+        if (ESP_Execute(cmd_buf, tcp_tokens, buf, buf_len, MQTT_LINK_TIMEOUT) != ESP_RESULT_OK) {
+            return false;
+        }
+        if (strstr(buf, "ALREADY") == NULL) {
+            stats.link_opens++;
+            stats.link_connect_ms = HAL_GetTick() - link_start;
+            return true;
+        }
+        MQTT_Log("%s 链路仍在，关闭后重建\r\n", MQTT_LINK_TYPE);
+        ESP_SendAT("AT+CIPCLOSE\r\n", "OK", AT_CMD_TIMEOUT_NORMAL);
+    }
+    return false;
+}
+
+/**
+ * @brief 建立 TCP 连接
+ * @details 有缓存的服务器 IP 时直接以 IP 建连；失败则清除该 IP 并按域名重试。
+ *          SSL 链路始终使用域名：以 IP 建连会丢失 SNI，MQTT_SSL_AUTH=2 时
+ *          证书主机名校验也会失败。
+ */
+static bool ESP_ConnectTCP(char *buf, uint16_t buf_len)
+{
+    const char *host = MQTT_BROKER;
+
+#if defined(MQTT_CONN_CACHE) && !defined(MQTT_USE_SSL)
+    bool cached_host = false;
+    if (conn_cache.broker_ip[0] == '\0') {
+        MQTT_CacheResolveBroker(buf, buf_len);
+    }
+    if (conn_cache.broker_ip[0] != '\0') {
+        host = conn_cache.broker_ip;
+        cached_host = true;
+    }
+#endif
+
+    MQTT_Log("正在连接 %s: %s:%d...\r\n", MQTT_LINK_TYPE, host, MQTT_PORT);
+    if (ESP_StartLink(host, buf, buf_len)) {
+        return true;
+    }
+
+#ifdef MQTT_CONN_CACHE
+#ifndef MQTT_USE_SSL
+    if (cached_host) {
+        /* 服务器 IP 可能已变更：按域名重新解析建连 */
+        MQTT_Log("缓存的服务器 IP 不可达，按域名重试\r\n");
+        conn_cache.broker_ip[0] = '\0';
+        if (ESP_StartLink(MQTT_BROKER, buf, buf_len)) {
+            return true;
+        }
+    }
+#endif
+    /* 仍然失败：可能静态 IP 已被回收，恢复 DHCP，下次走完整发现流程 */
+    MQTT_CacheInvalidate();
+#endif
+    return false;
+}
+
+/**
+ * @brief AT 后端建链：AT 检查、WiFi 接入、链路参数、TCP/SSL 连接
+ */
+static bool ESP_Open(void *ctx)
+{
+    char *buf = mqtt_arena.at;
 
-    is_connected = false;
+    (void)ctx;
 
-    MQTT_Log("=== MQTT 启动 ===\r\n");
+#ifdef MQTT_UART_RX_DMA
+    ESP_UartStart();
+#endif
+#ifdef MQTT_CONN_CACHE
+    MQTT_CacheInit();
+#endif
 
     /* 1. 基础 AT 检查 */
     /* 增加重试机制，防止模块未准备好 */
     bool at_ok = false;
+    MQTT_TRACE_BEGIN(MQTT_EV_STAGE, MQTT_STAGE_AT_CHECK);
     for (int i = 0; i < 5; i++) {
         if (ESP_SendAT("AT\r\n", "OK", AT_CMD_TIMEOUT_SHORT)) {
             at_ok = true;
@@ -293,6 +1419,7 @@ bool MQTT_Start(void)
         MQTT_Log("AT 检查重试 %d/5...\r\n", i + 1);
         HAL_Delay(500);
     }
+    MQTT_TRACE_END(MQTT_EV_STAGE, at_ok ? 0 : 1);
 
     if (!at_ok) {
         MQTT_Log("AT 检查失败，模块无响应\r\n");
@@ -300,71 +1427,109 @@ bool MQTT_Start(void)
     }
 
     /* 2. WiFi 配置与连接 */
+    MQTT_TRACE_BEGIN(MQTT_EV_STAGE, MQTT_STAGE_WIFI);
     ESP_SendAT("AT+CWMODE=1\r\n", "OK", AT_CMD_TIMEOUT_NORMAL);
 
     /* 检查是否已连接目标 WiFi */
     /* 发送 AT+CWJAP? 并检查响应中是否包含 SSID */
+    static const ESP_Token query_tokens[] = {
+        {"OK", ESP_TOKEN_OK, ESP_URC_NONE},
+        ESP_TOKEN_ERROR,
+        {NULL, ESP_TOKEN_OK, ESP_URC_NONE}
+    };
     bool wifi_connected = false;
-    if (ESP_Execute("AT+CWJAP?\r\n", "OK", buf, RX_BUFFER_SIZE, AT_CMD_TIMEOUT_NORMAL)) {
+    if (ESP_Execute("AT+CWJAP?\r\n", query_tokens, buf, MQTT_AT_BUF_SIZE, AT_CMD_TIMEOUT_NORMAL) == ESP_RESULT_OK) {
         if (strstr(buf, WIFI_SSID)) {
             wifi_connected = true;
             MQTT_Log("WiFi 已连接\r\n");
+#ifdef MQTT_CONN_CACHE
+            if (conn_cache.bssid[0] == '\0') {
+                MQTT_CacheCaptureAP(buf);
+            }
+#endif
         }
     }
 
     /* 未连接则尝试连接 */
     if (!wifi_connected) {
-        MQTT_Log("正在连接 WiFi: %s...\r\n", WIFI_SSID);
-        sprintf(cmd_buf, "AT+CWJAP=\"%s\",\"%s\"\r\n", WIFI_SSID, WIFI_PASSWORD);
-        if (!ESP_SendAT(cmd_buf, "OK", AT_CMD_TIMEOUT_WIFI)) {
-            // 这里也可以检查 "WIFI CONNECTED" 或 "FAIL"
-            // 简单起见，如果超时或无 OK 视为失败
-            // 注意：部分固件返回 WIFI CONNECTED 后才返回 OK，或者只返回 WIFI CONNECTED
-            // 严谨做法应检查 buf
+        if (!ESP_JoinWiFi(buf, MQTT_AT_BUF_SIZE)) {
             MQTT_Log("WiFi 连接失败\r\n");
         } else {
-             MQTT_Log("WiFi 连接成功\r\n");
+            wifi_connected = true;
+            MQTT_Log("WiFi 连接成功\r\n");
         }
     }
+    MQTT_TRACE_END(MQTT_EV_STAGE, wifi_connected ? 0 : 1);
+
+    /* 3. 链路参数：TLS 配置；被动接收模式 (旧固件不支持时退回主动推送)
+     * AT 固件的被动接收仅支持 TCP 链路，SSL 下保持主动推送 */
+#ifdef MQTT_USE_SSL
+    ESP_SetupSSL();
+#elif defined(MQTT_RECV_PASSIVE)
+    recv_passive = ESP_SendAT("AT+CIPRECVMODE=1\r\n", "OK", AT_CMD_TIMEOUT_NORMAL);
+    if (!recv_passive) {
+        MQTT_Log("固件不支持被动接收，使用主动模式\r\n");
+    }
+#endif
+    rx_pending = recv_passive; /* 连接建立后先拉取一次 */
+
+    /* 4. 建立 TCP/SSL 连接 */
+    MQTT_TRACE_BEGIN(MQTT_EV_STAGE, MQTT_STAGE_LINK);
+    bool linked = ESP_ConnectTCP(buf, MQTT_AT_BUF_SIZE);
+    MQTT_TRACE_END(MQTT_EV_STAGE, linked ? 0 : 1);
+    if (!linked) {
+        MQTT_Log("%s 连接失败\r\n", MQTT_LINK_TYPE);
+        return false;
+    }
+    MQTT_Log("%s 已连接 (耗时 %lu ms)\r\n", MQTT_LINK_TYPE, (unsigned long)stats.link_connect_ms);
 
-    /* 3. 建立 TCP 连接 */
-    /* 检查是否已连接或建立新连接 */
-    MQTT_Log("正在连接 TCP: %s:%d...\r\n", MQTT_BROKER, MQTT_PORT);
-    sprintf(cmd_buf, "AT+CIPSTART=\"TCP\",\"%s\",%d\r\n", MQTT_BROKER, MQTT_PORT);
+    /* 新链路：丢弃上一链路残留的数据 */
+    esp_rx_len = 0;
+    esp_rx_overflow = false;
+    ipd_state = IPD_IDLE;
+    esp_link_up = true;
 
-    /* 发送指令并读取响应到 buf */
-    /* 期望 CONNECT，但也可能已经是 ALREADY CONNECTED */
-    ESP_Execute(cmd_buf, NULL, buf, RX_BUFFER_SIZE, AT_CMD_TIMEOUT_LONG);
+#ifdef MQTT_CONN_CACHE
+    MQTT_CacheCommit();
+#endif
+    return true;
+}
 
-    if (strstr(buf, "CONNECT") || strstr(buf, "ALREADY CONNECTED")) {
-        // TCP 连接成功
-        MQTT_Log("TCP 已连接\r\n");
-    } else {
-        MQTT_Log("TCP 连接失败\r\n");
-        return false;
-    }
+bool MQTT_Start(void)
+{
+    uint8_t *packet = mqtt_arena.tx;
+    uint16_t idx = 0;
+    uint32_t start_tick = HAL_GetTick();
+
+    is_connected = false;
 
-    /* 4. 构建并发送 MQTT CONNECT 报文 */
-    /* Variable Header: Protocol Name(string) + Level(1) + Flags(1) + KeepAlive(2) */
-    /* Payload: Client ID (string) */
-    uint32_t remaining_len = (2 + 4) + 1 + 1 + 2 + (2 + strlen(MQTT_CLIENT_ID));
+    MQTT_Log("=== MQTT 启动 (%s) ===\r\n", transport->name);
 
-    idx = 0;
-    packet[idx++] = MQTT_PKT_CONNECT;
-    idx += mqtt_encode_len(&packet[idx], remaining_len);
+    /* 1~4. 由传输后端完成网络接入与建链 */
+    MQTT_TRACE_BEGIN(MQTT_EV_STAGE, MQTT_STAGE_OPEN);
+    bool opened = transport->open(transport->ctx);
+    MQTT_TRACE_END(MQTT_EV_STAGE, opened ? 0 : 1);
+    if (!opened) {
+        MQTT_Log("链路建立失败\r\n");
+        return false;
+    }
 
-    /* Variable Header */
-    idx += mqtt_encode_string(&packet[idx], MQTT_PROTOCOL_NAME);
-    packet[idx++] = MQTT_PROTOCOL_LEVEL;
-    packet[idx++] = MQTT_FLAG_CLEAN_SESSION;
-    packet[idx++] = (MQTT_KEEPALIVE >> 8) & 0xFF;
-    packet[idx++] = MQTT_KEEPALIVE & 0xFF;
+    /* 新的会话：丢弃上一会话残留的字节流 */
+    rx_idx = 0;
+    rx_overflow = false;
 
-    /* Payload: Client ID */
-    idx += mqtt_encode_string(&packet[idx], MQTT_CLIENT_ID);
+    /* 5. 构建并发送 MQTT CONNECT 报文
+     * 发送缓冲与服务例程共用：占用期间置 esp_busy，定时器中断不会同时构建报文 */
+    esp_busy++;
+    MQTT_TRACE_BEGIN(MQTT_EV_STAGE, MQTT_STAGE_CONNECT);
+    idx = MQTT_BuildConnect(packet, MQTT_TX_BUF_SIZE, MQTT_CLIENT_ID, MQTT_KEEPALIVE);
+    MQTT_ArenaMark(MQTT_ARENA_TX, idx);
+    bool sent = (idx > 0) && MQTT_SendPacket(packet, idx);
+    MQTT_TRACE_END(MQTT_EV_STAGE, sent ? 0 : 1);
+    esp_busy--;
 
     /* 发送报文 */
-    if (MQTT_SendPacket(packet, idx)) {
+    if (sent) {
         is_connected = true;
 
         /* 重置订阅状态，以便在 Service 中重新订阅 */
@@ -372,7 +1537,8 @@ bool MQTT_Start(void)
             subscriptions[i].is_subscribed = false;
         }
 
-        MQTT_Log("MQTT 已连接\r\n");
+        stats.connect_ms = HAL_GetTick() - start_tick;
+        MQTT_Log("MQTT 已连接 (耗时 %lu ms)\r\n", (unsigned long)stats.connect_ms);
         /* 启动后台服务驱动
          * 若定义 `MQTT_TIM_HANDLE` 为某定时器句柄，则使用定时中断周期性调用服务例程
          * 未定义亦可工作：服务例程在关键路径按需触发，无需用户额外轮询
@@ -387,7 +1553,109 @@ bool MQTT_Start(void)
     return false;
 }
 
-bool MQTT_Publish(const char *topic, const char *message)
+/**
+ * @brief 解析十进制数 ("-12", "23.50")，不接受指数与多余字符
+ * @details 不使用 strtof：避免在软浮点芯片上引入整套 libc 浮点解析
+ */
+static bool MQTT_ParseNumber(const uint8_t *s, uint16_t len, float *out)
+{
+    uint16_t i = 0;
+    bool neg = false, digits = false;
+    float value = 0.0f, scale = 1.0f;
+
+    if (i < len && (s[i] == '-' || s[i] == '+')) {
+        neg = (s[i++] == '-');
+    }
+    for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+        value = value * 10.0f + (float)(s[i] - '0');
+        digits = true;
+    }
+    if (i < len && s[i] == '.') {
+        for (i++; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+            scale *= 0.1f;
+            value += (float)(s[i] - '0') * scale;
+            digits = true;
+        }
+    }
+    if (!digits || i != len) return false;
+
+    *out = neg ? -value : value;
+    return true;
+}
+
+/**
+ * @brief 发布过滤判定
+ * @details 与上次实际发出的值比较：最小间隔内一律不发；数值消息超出死区、
+ *          非数值消息内容改变、或未变但已到心跳间隔时放行。
+ *          被拦截的发布计入统计 (按本应发送的报文长度计算节省字节)。
+ * @return true 需要发送 (sample 在发送成功后交给 MQTT_FilterCommit)
+ */
+static bool MQTT_FilterCheck(MQTT_TopicId id, const uint8_t *payload, uint16_t len, MQTT_FilterSample_t *sample)
+{
+    MQTT_FilterState_t *f = &publish_filters[id];
+    if (!f->enabled) return true;
+
+    sample->numeric = MQTT_ParseNumber(payload, len, &sample->value);
+    sample->hash = sample->numeric ? 0 : MQTT_Fnv1a(2166136261u, payload, len);
+    if (!f->has_last) return true;
+
+    uint32_t elapsed = HAL_GetTick() - f->last_tick;
+    bool send;
+    if (elapsed < f->cfg.min_interval_ms) {
+        send = false;
+    } else {
+        bool changed;
+        if (sample->numeric && f->last_numeric) {
+            float delta = sample->value - f->last_value;
+            float ref = f->last_value;
+            if (delta < 0) delta = -delta;
+            if (ref < 0) ref = -ref;
+            changed = delta > f->cfg.abs_deadband && delta > f->cfg.rel_deadband * ref;
+        } else {
+            changed = sample->numeric != f->last_numeric || len != f->last_len || sample->hash != f->last_hash;
+        }
+        send = changed || (f->cfg.max_interval_ms != 0 && elapsed >= f->cfg.max_interval_ms);
+    }
+
+    if (!send) {
+        uint32_t remaining = 2 + (uint32_t)topic_registry[id].len + len;
+        uint8_t header[5];
+        stats.publish_suppressed++;
+        stats.publish_bytes_saved += MQTT_BuildFixedHeader(header, MQTT_PKT_PUBLISH, remaining) + remaining;
+    }
+    return send;
+}
+
+static void MQTT_FilterCommit(MQTT_TopicId id, uint16_t len, const MQTT_FilterSample_t *sample)
+{
+    MQTT_FilterState_t *f = &publish_filters[id];
+    if (!f->enabled) return;
+
+    f->has_last = true;
+    f->last_numeric = sample->numeric;
+    f->last_value = sample->value;
+    f->last_hash = sample->hash;
+    f->last_len = len;
+    f->last_tick = HAL_GetTick();
+}
+
+/**
+ * @brief PUBLISH 报文能否由当前后端一次发出
+ * @details 报头最长 5 字节；AT 后端受 AT+CIPSEND 单次长度限制，
+ *          其余后端受 MQTT_IoVec 段长 (uint16_t) 限制
+ */
+static bool MQTT_PublishFits(size_t topic_len, size_t message_len)
+{
+    if (topic_len > 0xFFFF || message_len > 0xFFFF) return false;
+    if (transport == &MQTT_TransportAT) return 5 + 2 + topic_len + message_len <= ESP_SEND_MAX;
+    return true;
+}
+
+/**
+ * @brief 发布消息 (QoS 0)
+ * @param flags PUBLISH 固定报头标志位 (MQTT_PUBLISH_RETAIN)
+ */
+static bool MQTT_PublishFlags(const char *topic, const char *message, uint8_t flags)
 {
     if (!is_connected) {
         MQTT_Log("发布失败: 未连接\r\n");
@@ -400,72 +1668,196 @@ bool MQTT_Publish(const char *topic, const char *message)
         return false;
     }
 
-    /* 1. 计算总长度并检查缓冲区 */
-    uint16_t topic_len = strlen(topic);
-    uint16_t msg_len = strlen(message);
-    uint32_t remaining_len = (2 + topic_len) + msg_len;
-
-    /* 估算最大包长: FixedHeader(1+4) + VarHeader + Payload */
-    /* 为安全起见，使用较大的静态缓冲区或栈缓冲区 */
-    #define MQTT_TX_BUF_SIZE 1024
-    static uint8_t packet[MQTT_TX_BUF_SIZE];
-
-    /* 简单预判：头部最多5字节 + 剩余长度 */
-    if (remaining_len + 5 > MQTT_TX_BUF_SIZE) {
-        MQTT_Log("发布失败: 数据过长 (Topic+Msg > %d)\r\n", MQTT_TX_BUF_SIZE - 5);
+    size_t topic_len = strlen(topic);
+    size_t message_len = strlen(message);
+    if (!MQTT_PublishFits(topic_len, message_len)) {
+        MQTT_Log("发布失败: 数据过长\r\n");
         return false;
     }
 
+    /* 已注册且设置了过滤的主题：未变化的值在编码前丢弃 */
+    MQTT_TopicId id = filters_active ? MQTT_FindTopic(topic) : MQTT_TOPIC_INVALID;
+    MQTT_FilterSample_t sample;
+    if (id != MQTT_TOPIC_INVALID &&
+        !MQTT_FilterCheck(id, (const uint8_t *)message, (uint16_t)message_len, &sample)) {
+        return true;
+    }
+
+    /* 分段发送：报头 + 主题长度、主题、消息，无需拼接整包 */
+    uint8_t header[5 + 2];
+    uint8_t n = MQTT_BuildFixedHeader(header, MQTT_PKT_PUBLISH | flags, 2 + (uint32_t)topic_len + message_len);
+    header[n++] = (topic_len >> 8) & 0xFF;
+    header[n++] = topic_len & 0xFF;
+
+    const MQTT_IoVec iov[] = {
+        {header, n},
+        {(const uint8_t *)topic, (uint16_t)topic_len},
+        {(const uint8_t *)message, (uint16_t)message_len},
+    };
+
     MQTT_Log("发布: %s -> %s\r\n", topic, message);
 
-    uint16_t idx = 0;
+    if (!MQTT_SendPacketV(iov, 3)) return false;
+    if (id != MQTT_TOPIC_INVALID) MQTT_FilterCommit(id, (uint16_t)message_len, &sample);
+    return true;
+}
+
+bool MQTT_Publish(const char *topic, const char *message)
+{
+    return MQTT_PublishFlags(topic, message, 0);
+}
+
+bool MQTT_PublishRetained(const char *topic, const char *message)
+{
+    return MQTT_PublishFlags(topic, message, MQTT_PUBLISH_RETAIN);
+}
+
+MQTT_TopicId MQTT_RegisterTopic(const char *topic)
+{
+    if (topic == NULL) return MQTT_TOPIC_INVALID;
+
+    MQTT_TopicId id = MQTT_FindTopic(topic);
+    if (id != MQTT_TOPIC_INVALID) return id;
+
+    size_t len = strlen(topic);
+    if (len == 0 || len >= MQTT_TOPIC_SIZE || strpbrk(topic, "+#") != NULL) {
+        MQTT_Log("主题注册失败: %s\r\n", topic);
+        return MQTT_TOPIC_INVALID;
+    }
+    if (topic_count >= MQTT_MAX_TOPICS) {
+        MQTT_Log("主题注册失败: 注册表已满\r\n");
+        return MQTT_TOPIC_INVALID;
+    }
+
+    id = topic_count;
+    topic_registry[id].len = (uint16_t)len;
+    mqtt_encode_string(topic_registry[id].encoded, topic);
+    topic_registry[id].encoded[2 + len] = '\0';
+    topic_count++;
+
+    /* 已按字符串订阅的同名主题改为按句柄匹配 */
+    for (int i = 0; i < subscription_count; i++) {
+        if (strncmp(subscriptions[i].topic, topic, sizeof(subscriptions[i].topic)) == 0) {
+            subscriptions[i].topic_id = id;
+        }
+    }
+    return id;
+}
+
+const char *MQTT_TopicName(MQTT_TopicId id)
+{
+    if (id >= topic_count) return NULL;
+    return (const char *)&topic_registry[id].encoded[2];
+}
+
+bool MQTT_PublishById(MQTT_TopicId id, const uint8_t *payload, uint16_t len)
+{
+    if (!is_connected) {
+        MQTT_Log("发布失败: 未连接\r\n");
+        MQTT_Service();
+        return false;
+    }
 
-    /* Fixed Header */
-    packet[idx++] = MQTT_PKT_PUBLISH;
-    idx += mqtt_encode_len(&packet[idx], remaining_len);
+    if (id >= topic_count || (payload == NULL && len > 0)) {
+        MQTT_Log("发布失败: 参数无效\r\n");
+        return false;
+    }
+    if (!MQTT_PublishFits(topic_registry[id].len, len)) {
+        MQTT_Log("发布失败: 数据过长\r\n");
+        return false;
+    }
 
-    /* Variable Header: Topic */
-    idx += mqtt_encode_string(&packet[idx], topic);
+    MQTT_FilterSample_t sample;
+    if (!MQTT_FilterCheck(id, payload, len, &sample)) {
+        return true;
+    }
 
-    /* Payload: Message */
-    memcpy(&packet[idx], message, msg_len);
-    idx += msg_len;
+    /* 报头 + 预编码主题 + 消息，三段直接发送，不拷贝 */
+    const MQTT_TopicEntry_t *entry = &topic_registry[id];
+    uint8_t header[5];
+    uint8_t n = MQTT_BuildFixedHeader(header, MQTT_PKT_PUBLISH, (uint32_t)entry->len + 2 + len);
+
+    const MQTT_IoVec iov[] = {
+        {header, n},
+        {entry->encoded, (uint16_t)(entry->len + 2)},
+        {payload, len},
+    };
+    if (!MQTT_SendPacketV(iov, 3)) return false;
+    MQTT_FilterCommit(id, len, &sample);
+    return true;
+}
 
-    return MQTT_SendPacket(packet, idx);
+bool MQTT_SetPublishFilter(MQTT_TopicId id, const MQTT_PublishFilter *filter)
+{
+    if (id >= topic_count) return false;
+
+    MQTT_FilterState_t *f = &publish_filters[id];
+    memset(f, 0, sizeof(*f));
+    if (filter != NULL) {
+        f->cfg = *filter;
+        f->enabled = true;
+        filters_active = true;
+    }
+    return true;
 }
 
-static bool MQTT_SendSubscribePacket(const char *topic)
+static bool MQTT_SendSubscribePacket(const char *topic, uint8_t qos)
 {
     MQTT_Log("发送订阅请求: %s\r\n", topic);
 
-    uint8_t packet[128];
-    uint16_t idx = 0;
-    /* Variable Header: Packet ID(2) */
-    /* Payload: Topic Filter(string) + QoS(1) */
-    uint32_t remaining_len = 2 + (2 + strlen(topic)) + 1;
+    uint8_t *packet = mqtt_arena.tx;
+    esp_busy++; /* 发送缓冲与服务例程共用，见 MQTT_Start */
+    uint16_t idx = MQTT_BuildSubscribe(packet, MQTT_TX_BUF_SIZE, 0x0001, topic, qos);
+    MQTT_ArenaMark(MQTT_ARENA_TX, idx);
+    bool sent = (idx > 0) && MQTT_SendPacket(packet, idx);
+    esp_busy--;
 
-    /* Fixed Header */
-    packet[idx++] = MQTT_PKT_SUBSCRIBE;
-    idx += mqtt_encode_len(&packet[idx], remaining_len);
+    return sent;
+}
 
-    /* Variable Header: Packet ID */
-    packet[idx++] = 0x00;
-    packet[idx++] = 0x01;
+bool MQTT_FlushSubscriptions(void)
+{
+    bool all_sent = true;
 
-    /* Payload: Topic Filter + QoS */
-    idx += mqtt_encode_string(&packet[idx], topic);
-    packet[idx++] = 0x00; /* QoS 0 */
+    if (!is_connected) return false;
+    for (int i = 0; i < subscription_count; i++) {
+        if (!subscriptions[i].is_subscribed) {
+            if (MQTT_SendSubscribePacket(subscriptions[i].topic, subscriptions[i].qos)) {
+                subscriptions[i].is_subscribed = true;
+                // 给模块一点处理时间
+                HAL_Delay(50);
+            } else {
+                all_sent = false;
+            }
+        }
+    }
+    return all_sent;
+}
 
-    return MQTT_SendPacket(packet, idx);
+/* SAMPLED 的速率换算为分发间隔，0 视为每秒 1 次 */
+static uint16_t MQTT_RateToInterval(MQTT_Delivery delivery, uint16_t rate)
+{
+    if (delivery != MQTT_DELIVER_SAMPLED) return 0;
+    return (rate > 0) ? (uint16_t)(1000 / rate) : 1000;
 }
 
-bool MQTT_SubscribeCallback(const char *topic, MQTT_MessageHandler handler)
+static bool MQTT_SubscribeWithPolicy(const char *topic, MQTT_MessageHandler handler, uint8_t priority,
+                                     MQTT_Delivery delivery, uint16_t rate)
 {
+    /* 截断后订阅的是另一个主题 */
+    if (topic == NULL || strlen(topic) >= sizeof(subscriptions[0].topic)) return false;
+
     /* 检查是否已存在 */
     for (int i = 0; i < subscription_count; i++) {
         if (strncmp(subscriptions[i].topic, topic, sizeof(subscriptions[i].topic)) == 0) {
             /* 更新回调函数 */
             subscriptions[i].callback = handler;
+            subscriptions[i].id_handler = NULL;
+            subscriptions[i].stream_handler = NULL;
+            subscriptions[i].topic_id = MQTT_FindTopic(topic);
+            subscriptions[i].priority = priority;
+            subscriptions[i].delivery = delivery;
+            subscriptions[i].interval = MQTT_RateToInterval(delivery, rate);
             // MQTT_Log("订阅已注册: %s\r\n", topic);
             return true;
         }
@@ -477,7 +1869,16 @@ bool MQTT_SubscribeCallback(const char *topic, MQTT_MessageHandler handler)
         subscriptions[subscription_count].topic[sizeof(subscriptions[subscription_count].topic) - 1] = '\0';
         subscriptions[subscription_count].is_subscribed = false;
         subscriptions[subscription_count].callback = handler;
+        subscriptions[subscription_count].id_handler = NULL;
+        subscriptions[subscription_count].stream_handler = NULL;
+        subscriptions[subscription_count].qos = 0;
+        subscriptions[subscription_count].topic_id = MQTT_FindTopic(topic);
+        subscriptions[subscription_count].priority = priority;
+        subscriptions[subscription_count].delivery = delivery;
+        subscriptions[subscription_count].interval = MQTT_RateToInterval(delivery, rate);
+        subscriptions[subscription_count].next_slot = HAL_GetTick();
         subscription_count++;
+        MQTT_ArenaMark(MQTT_ARENA_SUBS, subscription_count * sizeof(MQTT_Subscription_t));
         MQTT_Log("订阅注册成功: %s\r\n", topic);
         return true;
     }
@@ -486,6 +1887,60 @@ bool MQTT_SubscribeCallback(const char *topic, MQTT_MessageHandler handler)
     return false;
 }
 
+bool MQTT_SubscribeCallback(const char *topic, MQTT_MessageHandler handler)
+{
+    return MQTT_SubscribeWithPolicy(topic, handler, 0, MQTT_DELIVER_ALL, 0);
+}
+
+bool MQTT_SubscribeId(MQTT_TopicId id, MQTT_IdHandler handler)
+{
+    const char *topic = MQTT_TopicName(id);
+    if (topic == NULL || !MQTT_SubscribeWithPolicy(topic, NULL, 0, MQTT_DELIVER_ALL, 0)) {
+        return false;
+    }
+
+    for (int i = 0; i < subscription_count; i++) {
+        if (subscriptions[i].topic_id == id) {
+            subscriptions[i].id_handler = handler;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MQTT_SubscribeStream(const char *topic, uint8_t qos, MQTT_StreamHandler handler)
+{
+    if (topic == NULL || handler == NULL || strpbrk(topic, "+#") != NULL ||
+        !MQTT_SubscribeWithPolicy(topic, NULL, 0, MQTT_DELIVER_ALL, 0)) {
+        return false;
+    }
+
+    if (qos > 1) qos = 1;
+    for (int i = 0; i < subscription_count; i++) {
+        if (strncmp(subscriptions[i].topic, topic, sizeof(subscriptions[i].topic)) == 0) {
+            if (subscriptions[i].qos != qos) {
+                subscriptions[i].qos = qos;
+                subscriptions[i].is_subscribed = false; /* 以新的 QoS 重新订阅 */
+            }
+            subscriptions[i].stream_handler = handler;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MQTT_SetDelivery(const char *topic, MQTT_Delivery delivery, uint16_t rate)
+{
+    for (int i = 0; i < subscription_count; i++) {
+        if (strncmp(subscriptions[i].topic, topic, sizeof(subscriptions[i].topic)) == 0) {
+            subscriptions[i].delivery = delivery;
+            subscriptions[i].interval = MQTT_RateToInterval(delivery, rate);
+            return true;
+        }
+    }
+    return false;
+}
+
 bool MQTT_Subscribe(const char *topic)
 {
     return MQTT_SubscribeCallback(topic, NULL);
@@ -512,24 +1967,14 @@ bool MQTT_Unsubscribe(const char *topic)
 
     MQTT_Log("取消订阅: %s\r\n", topic);
 
-    uint8_t packet[128];
-    uint16_t idx = 0;
-    /* Variable Header: Packet ID(2) */
-    /* Payload: Topic Filter(string) */
-    uint32_t remaining_len = 2 + (2 + strlen(topic));
-
-    /* Fixed Header */
-    packet[idx++] = MQTT_PKT_UNSUBSCRIBE;
-    idx += mqtt_encode_len(&packet[idx], remaining_len);
+    uint8_t *packet = mqtt_arena.tx;
+    esp_busy++; /* 发送缓冲与服务例程共用，见 MQTT_Start */
+    uint16_t idx = MQTT_BuildUnsubscribe(packet, MQTT_TX_BUF_SIZE, 0x0002, topic);
+    MQTT_ArenaMark(MQTT_ARENA_TX, idx);
+    bool sent = (idx > 0) && MQTT_SendPacket(packet, idx);
+    esp_busy--;
 
-    /* Variable Header: Packet ID */
-    packet[idx++] = 0x00;
-    packet[idx++] = 0x02; /* Packet ID 2 */
-
-    /* Payload: Topic Filter */
-    idx += mqtt_encode_string(&packet[idx], topic);
-
-    return MQTT_SendPacket(packet, idx);
+    return sent;
 }
 
 void MQTT_SetSubscriptions(const MQTT_SubscribeInfo *list)
@@ -569,7 +2014,8 @@ void MQTT_SetSubscriptions(const MQTT_SubscribeInfo *list)
          * - 若不存在：添加到列表并发送订阅请求
          * - 若已满：打印日志并返回 false
          */
-        MQTT_SubscribeCallback(list[j].topic, list[j].handler);
+        MQTT_SubscribeWithPolicy(list[j].topic, list[j].handler, list[j].priority,
+                                 list[j].delivery, list[j].rate);
     }
 }
 
@@ -625,133 +2071,281 @@ void MQTT_Test_Run(void)
         HAL_Delay(500);
         /* 演示：使用新的批量订阅接口 */
         static MQTT_SubscribeInfo test_subs[] = {
-            {"test/cmd", OnTestCmd},
+            {"test/cmd", OnTestCmd, 0, MQTT_DELIVER_ALL, 0},
             /* 可以在此添加更多测试订阅 */
+            {NULL, NULL, 0, MQTT_DELIVER_ALL, 0}
         };
-        
-        MQTT_SetSubscriptions(test_subs, sizeof(test_subs)/sizeof(test_subs[0]));
+
+        MQTT_SetSubscriptions(test_subs);
         is_subscribed = true;
     }
 
     if (MQTT_IsConnected() && (HAL_GetTick() - last_pub_time > 5000)) {
         last_pub_time = HAL_GetTick();
         char msg[64];
-        snprintf(msg, sizeof(msg), "online_tick_%lu", HAL_GetTick());
+        snprintf(msg, sizeof(msg), "online_tick_%lu", (unsigned long)HAL_GetTick());
         MQTT_Publish("test/status", msg);
     }
 
     /* 注意：由于注册了回调，消息接收由 MQTT_Service 自动处理，
-       此处无需手动调用 MQTT_Process。
+       此处无需手动调用 MQTT_Process。OnTestCmd 在 MQTT_Dispatch 中执行，
+       不在接收路径内，因此可以直接调用 MQTT_Publish。
     */
 }
 
 /* ==========================================
  * MQTT 接收处理
  * ========================================== */
-static uint8_t rx_buffer[RX_BUFFER_SIZE];
-static uint16_t rx_idx = 0;
 
-bool MQTT_Process(char *topic, uint16_t topic_size, char *payload, uint16_t payload_size)
+/**
+ * @brief 查找二进制订阅 (精确匹配)
+ */
+static MQTT_StreamHandler MQTT_FindStream(const uint8_t *topic, uint16_t len)
+{
+    for (int i = 0; i < subscription_count; i++) {
+        if (subscriptions[i].stream_handler != NULL && strlen(subscriptions[i].topic) == len &&
+            memcmp(subscriptions[i].topic, topic, len) == 0) {
+            return subscriptions[i].stream_handler;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 从 MQTT 字节流中取出一个完整报文
+ * @details 按固定报头的剩余长度定界，非 PUBLISH 报文 (CONNACK/SUBACK/PINGRESP 等)
+ *          直接丢弃。
+ */
+static bool MQTT_DecodeNext(char *topic, uint16_t topic_size, char *payload, uint16_t payload_size)
 {
-    uint8_t byte;
     bool msg_received = false;
+    uint32_t total_len = 0;
+    MQTT_PublishView view;
+
+    int ret = MQTT_PacketLength(rx_buffer, rx_idx, &total_len);
+    if (ret < 0 || (ret == 0 && total_len > RX_BUFFER_SIZE)) {
+        /* 长度字段非法，或报文超过缓冲区无法完整接收 */
+        MQTT_Log("接收失败: 报文过长或格式错误\r\n");
+        rx_overflow = true;
+        return false;
+    }
+    if (ret == 0) return false; /* 等待剩余数据 */
 
-    /* 非阻塞读取所有可用数据 */
-    while (HAL_UART_Receive(MQTT_UART_HANDLE, &byte, 1, 0) == HAL_OK) {
-        if (rx_idx < RX_BUFFER_SIZE - 1) {
-            rx_buffer[rx_idx++] = byte;
-            rx_buffer[rx_idx] = 0;
-        } else {
-            /* 缓冲区满，移位丢弃旧数据 */
-            memmove(rx_buffer, rx_buffer + 1, RX_BUFFER_SIZE - 2);
-            rx_buffer[RX_BUFFER_SIZE - 2] = byte;
-            rx_buffer[RX_BUFFER_SIZE - 1] = 0;
-        }
-    }
-
-    if (rx_idx == 0) return false;
-
-    /* 简单的解析逻辑：寻找 +IPD, */
-    char *ipd_ptr = strstr((char*)rx_buffer, "+IPD,");
-    if (ipd_ptr) {
-        /* 解析长度 */
-        int len = 0;
-        char *colon_ptr = strchr(ipd_ptr, ':');
-        if (colon_ptr) {
-            /* +IPD,123: */
-            if (sscanf(ipd_ptr, "+IPD,%d:", &len) == 1) {
-                int header_len = (colon_ptr - ipd_ptr) + 1; // "+IPD,len:" 的长度
-                int total_len = header_len + len;
-
-                /* 检查是否接收完整 */
-                int ipd_offset = ipd_ptr - (char*)rx_buffer;
-                if (rx_idx >= ipd_offset + total_len) {
-                    /* 获取 MQTT 数据起始地址 */
-                    uint8_t *mqtt_data = (uint8_t*)(colon_ptr + 1);
-
-                    /* 解析 MQTT PUBLISH 报文 */
-                    /* Fixed Header: Byte 0 (0x30 - 0x3F) */
-                    if ((mqtt_data[0] & 0xF0) == 0x30) {
-                        /* 是 PUBLISH 报文 */
-                        uint8_t qos = (mqtt_data[0] >> 1) & 0x03;
-                        uint32_t rem_len = 0;
-                        uint32_t multiplier = 1;
-                        int i = 1;
-
-                        /* 解析剩余长度 */
-                        do {
-                            rem_len += (mqtt_data[i] & 127) * multiplier;
-                            multiplier *= 128;
-                            i++;
-                        } while ((mqtt_data[i-1] & 128) != 0 && i < 5);
-
-                        int var_header_start = i;
-                        /* Topic Length */
-                        uint16_t t_len = (mqtt_data[var_header_start] << 8) | mqtt_data[var_header_start+1];
-
-                        /* Payload Start */
-                        int payload_start = var_header_start + 2 + t_len;
-                        if (qos > 0) {
-                            payload_start += 2; /* Packet ID */
-                        }
-
-                        int p_len = rem_len - (payload_start - var_header_start);
-
-                        /* 复制到用户缓冲区 */
-                        if (topic != NULL && topic_size > 0) {
-                             uint16_t copy_len = (t_len < topic_size) ? t_len : (topic_size - 1);
-                             memcpy(topic, &mqtt_data[var_header_start+2], copy_len);
-                             topic[copy_len] = 0;
-                        }
-
-
-                        if (payload != NULL && payload_size > 0) {
-                            uint16_t copy_len = (p_len < payload_size) ? p_len : (payload_size - 1);
-                            memcpy(payload, &mqtt_data[payload_start], copy_len);
-                            payload[copy_len] = 0;
-                        }
-
-                        msg_received = true;
-
-                        if (topic && payload) {
-                            MQTT_Log("接收: %s -> %s\r\n", topic, payload);
-                        }
-                    }
-
-                    /* 移除已处理的数据 */
-                    int bytes_processed = ipd_offset + total_len;
-                    memmove(rx_buffer, rx_buffer + bytes_processed, rx_idx - bytes_processed);
-                    rx_idx -= bytes_processed;
-
-                    return msg_received;
-                }
-            }
+    MQTT_StreamHandler stream = NULL;
+    bool parsed = MQTT_ParsePublish(rx_buffer, total_len, &view);
+    if (parsed) {
+        stream = MQTT_FindStream(view.topic, view.topic_len);
+    }
+
+    if (stream != NULL) {
+        /* 二进制订阅：直接交出缓冲区内的原始内容，不复制、不截断 */
+        MQTT_TRACE_BEGIN(MQTT_EV_CALLBACK, MQTT_TraceHash(view.topic, view.topic_len));
+        stream(view.payload, view.payload_len);
+        MQTT_TRACE_END(MQTT_EV_CALLBACK, 0);
+    } else if (parsed) {
+        /* 复制到用户缓冲区 */
+        if (topic != NULL && topic_size > 0) {
+            uint16_t copy_len = (view.topic_len < topic_size) ? view.topic_len : (topic_size - 1);
+            memcpy(topic, view.topic, copy_len);
+            topic[copy_len] = 0;
+        }
+
+        if (payload != NULL && payload_size > 0) {
+            uint16_t copy_len = (view.payload_len < payload_size) ? (uint16_t)view.payload_len : (payload_size - 1);
+            memcpy(payload, view.payload, copy_len);
+            payload[copy_len] = 0;
+        }
+
+        msg_received = true;
+
+        if (topic && payload) {
+            MQTT_Log("接收: %s -> %s\r\n", topic, payload);
         }
     }
 
-    /* 防止缓冲区溢出且未找到有效数据的情况 */
-    if (rx_idx == RX_BUFFER_SIZE && !strstr((char*)rx_buffer, "+IPD,")) {
-         rx_idx = 0;
+    /* QoS 1：处理完再确认，处理前断线则服务器会重发 */
+    if (parsed && view.qos == 1) {
+        uint8_t puback[4] = {MQTT_PKT_PUBACK, 0x02, (uint8_t)(view.packet_id >> 8), (uint8_t)(view.packet_id & 0xFF)};
+        MQTT_SendPacket(puback, sizeof(puback));
     }
-    return false;
+
+    /* 移除已处理的报文 */
+    memmove(rx_buffer, rx_buffer + total_len, rx_idx - total_len);
+    rx_idx -= total_len;
+
+    return msg_received;
+}
+
+/**
+ * @brief 被动模式下按字节流缓冲区余量从模块拉取数据
+ * @details 仅当收到到达通知或轮询周期已到时查询 AT+CIPRECVLEN?，
+ *          每次拉取量不超过缓冲区剩余空间，未取走的数据留在模块内，
+ *          由 TCP 窗口向服务器反压，因此任何突发都不会丢字节。
+ */
+static void ESP_PullPassive(void)
+{
+    static const ESP_Token ok_tokens[] = {
+        {"OK", ESP_TOKEN_OK, ESP_URC_NONE},
+        ESP_TOKEN_ERROR,
+        {NULL, ESP_TOKEN_OK, ESP_URC_NONE}
+    };
+    char buf[48];
+    char cmd_buf[32];
+
+    if (!rx_pending && (HAL_GetTick() - last_recv_poll) < MQTT_RECV_POLL_MS) {
+        return;
+    }
+    last_recv_poll = HAL_GetTick();
+    rx_pending = false;
+
+    uint16_t room = ESP_RX_BUFFER_SIZE - esp_rx_len;
+    if (room == 0) {
+        rx_pending = true; /* 先交给引擎解析，下次再取 */
+        return;
+    }
+
+    /* 1. 查询模块内待取数据长度: +CIPRECVLEN:<len> */
+    if (ESP_Execute("AT+CIPRECVLEN?\r\n", ok_tokens, buf, sizeof(buf), AT_CMD_TIMEOUT_NORMAL) != ESP_RESULT_OK) {
+        return;
+    }
+    char *p = strstr(buf, "+CIPRECVLEN:");
+    int pending = 0;
+    if (p == NULL || sscanf(p, "+CIPRECVLEN:%d", &pending) != 1 || pending <= 0) {
+        return;
+    }
+
+    /* 2. 拉取不超过剩余空间的数据: +CIPRECVDATA,<len>:<data> 由匹配器写入字节流 */
+    uint16_t want = ((uint32_t)pending < room) ? (uint16_t)pending : room;
+    sprintf(cmd_buf, "AT+CIPRECVDATA=%u\r\n", want);
+    ESP_Execute(cmd_buf, ok_tokens, NULL, 0, AT_CMD_TIMEOUT_NORMAL);
+
+    if (pending > want) {
+        rx_pending = true; /* 仍有剩余，解析后继续拉取 */
+    }
+}
+
+/* ==========================================
+ * AT 后端接口
+ * ========================================== */
+
+static void ESP_Poll(void *ctx)
+{
+    uint8_t byte;
+    const ESP_Token *hit;
+
+    (void)ctx;
+
+#ifdef MQTT_UART_RX_DMA
+    ESP_UartStart();
+#endif
+
+    /* 非阻塞读取所有可用数据，+IPD 数据由匹配器转入暂存区，URC 同步到链路状态 */
+    while (ESP_UartGet(&byte, 0)) {
+        ESP_FeedByte(byte, &hit);
+    }
+
+    if (recv_passive && esp_link_up) {
+        ESP_PullPassive();
+    }
+}
+
+static uint32_t ESP_Readable(void *ctx)
+{
+    (void)ctx;
+    return esp_rx_len;
+}
+
+static int32_t ESP_Read(void *ctx, uint8_t *buf, uint32_t len)
+{
+    (void)ctx;
+
+    if (esp_rx_overflow) {
+        MQTT_Log("AT 接收暂存区溢出\r\n");
+        return -1;
+    }
+    if (esp_rx_len == 0) {
+        return esp_link_up ? 0 : -1;
+    }
+
+    uint16_t n = (len < esp_rx_len) ? (uint16_t)len : esp_rx_len;
+    memcpy(buf, esp_rx, n);
+    memmove(esp_rx, esp_rx + n, esp_rx_len - n);
+    esp_rx_len -= n;
+    return n;
+}
+
+static void ESP_Close(void *ctx)
+{
+    (void)ctx;
+    if (esp_link_up) {
+        ESP_SendAT("AT+CIPCLOSE\r\n", "OK", AT_CMD_TIMEOUT_NORMAL);
+    }
+    esp_link_up = false;
+    esp_rx_len = 0;
+    esp_rx_overflow = false;
+    ipd_state = IPD_IDLE;
+}
+
+const MQTT_Transport MQTT_TransportAT = {
+    "ESP8266 AT",
+    ESP_Open,
+    ESP_Writev,
+    ESP_Readable,
+    ESP_Read,
+    ESP_Close,
+    ESP_Poll,
+    NULL
+};
+
+void MQTT_SetTransport(const MQTT_Transport *t)
+{
+    if (t != NULL) {
+        transport = t;
+    }
+}
+
+/**
+ * @brief 从传输后端读入字节流缓冲区
+ * @return 读到的字节数；-1 表示链路已断开
+ */
+static int32_t MQTT_ReadTransport(void)
+{
+    uint32_t room = RX_BUFFER_SIZE - rx_idx;
+    if (room == 0) return 0;
+
+    int32_t n = transport->read(transport->ctx, rx_buffer + rx_idx, room);
+    if (n > 0) {
+        rx_idx += n;
+        MQTT_ArenaMark(MQTT_ARENA_RX, rx_idx);
+    }
+    return n;
+}
+
+bool MQTT_Process(char *topic, uint16_t topic_size, char *payload, uint16_t payload_size)
+{
+    if (!is_connected) {
+        return false;
+    }
+
+    /* 字节流与服务例程共用：主循环中调用时，定时器中断里的 MQTT_Service 跳过本次 */
+    esp_busy++;
+    bool received = false;
+
+    if (transport->poll) {
+        transport->poll(transport->ctx);
+    }
+
+    if (MQTT_ReadTransport() < 0 || rx_overflow) {
+        /* 链路断开，或字节流已丢失数据、报文边界不可恢复：丢弃并触发重连 */
+        MQTT_Log("链路断开，重建会话\r\n");
+        transport->close(transport->ctx);
+        rx_idx = 0;
+        rx_overflow = false;
+        is_connected = false;
+    } else {
+        received = MQTT_DecodeNext(topic, topic_size, payload, payload_size);
+    }
+
+    esp_busy--;
+    return received;
 }
@@ -3,6 +3,8 @@
 
 #include "main.h"
 #include "usart.h"
+#include "mqtt_codec.h"
+#include "mqtt_transport.h"
 #include <stdbool.h>
 
 /* ==========================================
@@ -23,9 +25,18 @@
 
 #define MQTT_BROKER ""
 #define MQTT_PORT 1883
+// #define MQTT_USE_SSL /* TLS 链路 (AT+CIPSTART="SSL")，端口通常改为 8883；取消注释启用 */
+#define MQTT_SSL_BUF_SIZE 4096 /* AT+CIPSSLSIZE: TLS 握手缓冲 (2048~4096) */
+#define MQTT_SSL_AUTH 0        /* AT+CIPSSLCCONF: 0 不校验, 2 校验服务器证书 (需预置 CA) */
 #define MQTT_CLIENT_ID "xrak"
 #define MQTT_KEEPALIVE 60
-#define MAX_SUBSCRIPTIONS 10 /* 最大订阅数量 */
+#define MAX_SUBSCRIPTIONS 16 /* 最大订阅数量，各模块常驻占用：RPC 处理函数与响应主题 (MQTT_RPC_MAX_HANDLERS + MQTT_RPC_MAX_REPLY_TOPICS)、OTA 3、影子 1、时钟同步 1，其余留给应用 */
+#define MQTT_MAX_TOPICS 16   /* 主题注册表容量 (MQTT_RegisterTopic) */
+#define MQTT_INBOUND_QUEUE_LEN 8 /* 入站消息队列长度 (待分发的回调数) */
+#define MQTT_TOPIC_SIZE 64       /* 回调收到的主题最大长度 (含结束符) */
+#define MQTT_PAYLOAD_SIZE 128    /* 回调收到的消息最大长度 (含结束符) */
+#define MQTT_CONN_CACHE /* 连接缓存：记住 BSSID/IP/服务器 IP 加速重连；注释本宏禁用 */
+// #define MQTT_TRACE   /* 飞行记录器：事件写入 .noinit 环形缓冲 (约 4.3 KB RAM)，需同时编译 mqtt_trace.c；取消注释启用 */
 
 /* ==========================================
  * ESP8266 AT 指令配置
@@ -35,26 +46,38 @@
 #define AT_CMD_TIMEOUT_LONG 3000
 #define AT_CMD_TIMEOUT_WIFI 10000
 
-#define RX_BUFFER_SIZE 512 /* 接收缓冲区大小 */
+#define RX_BUFFER_SIZE 512 /* 接收缓冲区大小 (MQTT 字节流，单个报文不可超过) */
+#define ESP_RX_BUFFER_SIZE 512 /* AT 后端 +IPD 数据暂存区大小 */
+#define MQTT_RECV_PASSIVE  /* 被动接收 (AT+CIPRECVMODE=1，需 AT 固件 1.7+)；注释本宏恢复主动推送 */
+#define MQTT_RECV_POLL_MS 1000 /* 被动模式下无到达通知时的兜底轮询周期 */
+#define ESP_MATCH_MAX_TOKENS 10 /* 单条指令可同时监听的 token 数 (含 URC) */
+#define ESP_MATCH_MAX_LEN 20    /* 单个 token 最大长度 */
+// #define MQTT_UART_RX_DMA /* AT 串口改为循环 DMA + 空闲中断接收 (CubeMX 中 RX 配置 Circular DMA)，MQTT_Idle 才能睡眠；取消注释启用 */
+#define MQTT_UART_RX_RING 1024  /* 循环 DMA 环形缓冲大小，需容纳两次读取之间到达的数据 */
+#define MQTT_IDLE_POLL_MS 1     /* 未定义 MQTT_UART_RX_DMA 时 MQTT_Idle 的最长睡眠：1 即睡到下一个 SysTick；调大更省电，但睡眠期间到达的串口字节会丢失 */
 
 /* ==========================================
- * MQTT 协议常量
+ * 内存预算 (静态内存区 mqtt_arena，用量见 MQTT_GetArenaUsage)
+ * 协议栈缓冲全部在此分配，不占用调用者的栈；另含 RX_BUFFER_SIZE、
+ * ESP_RX_BUFFER_SIZE、MQTT_TOPIC_SIZE + MQTT_PAYLOAD_SIZE (解码)、
+ * MAX_SUBSCRIPTIONS 个订阅项与 MQTT_INBOUND_QUEUE_LEN 个队列项
  * ========================================== */
-#define MQTT_PKT_CONNECT 0x10     /* 连接请求 */
-#define MQTT_PKT_CONNACK 0x20     /* 连接确认 */
-#define MQTT_PKT_PUBLISH 0x30     /* 发布消息 */
-#define MQTT_PKT_PUBACK 0x40      /* 发布确认 */
-#define MQTT_PKT_SUBSCRIBE 0x82   /* 订阅请求 (QoS 1) */
-#define MQTT_PKT_SUBACK 0x90      /* 订阅确认 */
-#define MQTT_PKT_UNSUBSCRIBE 0xA2 /* 取消订阅请求 */
-#define MQTT_PKT_UNSUBACK 0xB0    /* 取消订阅确认 */
-#define MQTT_PKT_PINGREQ 0xC0     /* 心跳请求 */
-#define MQTT_PKT_PINGRESP 0xD0    /* 心跳响应 */
-#define MQTT_PKT_DISCONNECT 0xE0  /* 断开连接 */
-
-#define MQTT_PROTOCOL_NAME "MQTT"
-#define MQTT_PROTOCOL_LEVEL 0x04     /* MQTT 3.1.1 */
-#define MQTT_FLAG_CLEAN_SESSION 0x02 /* 清除会话标志 */
+#define MQTT_AT_BUF_SIZE RX_BUFFER_SIZE /* 建链阶段 AT 响应缓冲 (AT+CWJAP? / AT+CIPSTART 等) */
+#define MQTT_CMD_BUF_SIZE 160  /* 建链阶段 AT 指令拼接 (含 SSID、密码、服务器地址) */
+#define MQTT_TX_BUF_SIZE 128   /* 控制报文 (CONNECT/SUBSCRIBE/UNSUBSCRIBE) 构建缓冲 */
+#define MQTT_LOG_BUF_SIZE 256  /* 日志格式化缓冲 (定义 MQTT_LOG_UART_HANDLE 时占用) */
+// #define MQTT_ARENA_BUDGET 4096 /* 内存区总预算 (字节)，超出时编译报错；取消注释启用 */
+
+/* ==========================================
+ * SPI 链路配置 (mqtt_transport_spi.c，需模块运行配套固件，协议见 spi_link.h)
+ * ========================================== */
+// #define MQTT_SPI_HANDLE &hspi1 /* SPI 句柄 (需配置 DMA)；取消注释启用 MQTT_TransportSPI */
+#define MQTT_SPI_CS_PORT GPIOA
+#define MQTT_SPI_CS_PIN GPIO_PIN_4
+#define MQTT_SPI_READY_PORT GPIOB   /* 模块数据就绪引脚 (高电平请求传输) */
+#define MQTT_SPI_READY_PIN GPIO_PIN_0
+#define MQTT_SPI_BURST 8            /* 单次推进最多连续传输的块数 */
+#define MQTT_SPI_IDLE_MS 50         /* 无数据时刷新信用/确认的周期 */
 
 /* ==========================================
  * 公共接口函数
@@ -65,6 +88,44 @@
  */
 typedef void (*MQTT_MessageHandler)(const char *topic, const char *payload);
 
+/**
+ * @brief 已注册主题的句柄 (见 MQTT_RegisterTopic)
+ */
+typedef uint8_t MQTT_TopicId;
+#define MQTT_TOPIC_INVALID 0xFF
+
+/**
+ * @brief 按句柄接收的回调函数类型 (见 MQTT_SubscribeId)
+ */
+typedef void (*MQTT_IdHandler)(MQTT_TopicId id, const char *payload);
+
+/**
+ * @brief 连接缓存记录
+ * @details 记录上次成功连接时的 AP、DHCP 地址与服务器 IP。重连时使用指定
+ *          BSSID 入网、以静态 IP 跳过 DHCP、以 IP 直连跳过 DNS，任一步失败
+ *          则回退完整发现流程。配置 (SSID/服务器) 变更后自动失效。
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t config_hash;  /* WIFI_SSID + MQTT_BROKER 指纹 */
+    char bssid[18];        /* "aa:bb:cc:dd:ee:ff" */
+    uint8_t channel;
+    char ip[16];
+    char gateway[16];
+    char netmask[16];
+    char broker_ip[16];
+    uint32_t checksum;     /* 以上字段校验，必须位于末尾 */
+} MQTT_ConnCache;
+
+/**
+ * @brief 读取/保存连接缓存 (弱函数，可重写)
+ * @details 默认保存在 .noinit RAM 段，仅在复位后保留；若需冷启动也能加速，
+ *          请在工程中重写为写入 Flash 或备份域 (BKPSRAM/RTC 备份寄存器)。
+ *          读取的数据由库自行校验，无效时返回任意内容即可。
+ */
+bool MQTT_CacheLoad(MQTT_ConnCache *cache);
+void MQTT_CacheSave(const MQTT_ConnCache *cache);
+
 /**
  * @brief 一键启动 MQTT (初始化 + 入网 + TCP + CONNECT)
  * @details 初始化 ESP8266、配置 WiFi 并建立到服务器的 TCP 连接，随后发送 MQTT
@@ -79,7 +140,7 @@ typedef void (*MQTT_MessageHandler)(const char *topic, const char *payload);
  *       if (MQTT_IsConnected()) {
  *           MQTT_Publish("test/status", "ok");
  *       }
- *       HAL_Delay(50);
+ *       MQTT_Idle(MQTT_WAIT_FOREVER); // 睡眠到下一个事件，见 MQTT_Idle
  *   }
  * @return true 启动成功并进入已连接状态
  * @return false 任一阶段失败（AT、WiFi、TCP、MQTT）
@@ -88,7 +149,8 @@ bool MQTT_Start(void);
 
 /**
  * @brief MQTT 服务例程（非阻塞）
- * @details 放入 while 循环或定时器/任务中周期性调用（建议 50~200ms）。
+ * @details 放入 while 循环或定时器/任务中周期性调用；主循环中可配合 MQTT_Idle()
+ * 在两次调用之间睡眠，而不是固定 HAL_Delay。
  * 自动执行心跳与分阶段重连：仅补齐未就绪阶段（WiFi/TCP/MQTT
  * CONNECT），避免每次全重连。
  */
@@ -104,14 +166,241 @@ void MQTT_Service(void);
  */
 bool MQTT_Publish(const char *topic, const char *message);
 
+/**
+ * @brief 发布保留消息
+ * @details 服务器为该主题保存最后一条保留消息，之后订阅者一订阅即可收到，
+ *          适合状态、配置等“最新值”类数据。消息为空字符串时清除保留消息。
+ */
+bool MQTT_PublishRetained(const char *topic, const char *message);
+
+/**
+ * @brief 二进制消息回调
+ * @param payload 消息内容 (指向接收缓冲区，仅在回调期间有效，不以 '\0' 结尾)
+ * @param len 消息长度
+ */
+typedef void (*MQTT_StreamHandler)(const uint8_t *payload, uint32_t len);
+
+/**
+ * @brief 投递策略
+ */
+typedef enum {
+  MQTT_DELIVER_ALL = 0, /* 每条消息都回调 (默认) */
+  MQTT_DELIVER_LATEST,  /* 状态类主题：未分发的旧值被新值覆盖，只回调最新值 */
+  MQTT_DELIVER_SAMPLED  /* 限速：每秒最多回调 rate 次，期间只保留最新值 */
+} MQTT_Delivery;
+
+/**
+ * @brief 注册主题，返回句柄
+ * @details 主题只在注册时测长并编码一次 (含 2 字节长度前缀)，之后
+ *          MQTT_PublishById 直接拷贝编码结果，入站消息也只比对一次即可得到句柄。
+ *          重复注册同一主题返回同一句柄。主题不可含通配符。
+ *
+ * 示例：
+ *   static MQTT_TopicId status_id;
+ *   status_id = MQTT_RegisterTopic("device/status");   // 初始化时一次
+ *   MQTT_PublishById(status_id, (const uint8_t *)"ok", 2);
+ *
+ * @return 句柄；注册表已满、主题过长或含通配符时返回 MQTT_TOPIC_INVALID
+ */
+MQTT_TopicId MQTT_RegisterTopic(const char *topic);
+
+/**
+ * @brief 获取已注册主题的名称
+ * @return 主题字符串；句柄无效时返回 NULL
+ */
+const char *MQTT_TopicName(MQTT_TopicId id);
+
+/**
+ * @brief 按句柄发布消息 (快速路径)
+ *
+ * @param id MQTT_RegisterTopic 返回的句柄
+ * @param payload 消息内容 (可含二进制)
+ * @param len 消息长度
+ * @return true 发送成功
+ * @return false 未连接、句柄无效或数据过长
+ */
+bool MQTT_PublishById(MQTT_TopicId id, const uint8_t *payload, uint16_t len);
+
+/**
+ * @brief 发布过滤规则 (死区 / 变化才发)
+ * @details 数值消息 (如 "23.5") 的变化量同时超过 abs_deadband 与
+ *          rel_deadband × |上次值| 才算变化，两者为 0 时任何变化都算；
+ *          非数值消息按内容比较。比较对象始终是上次实际发出的值。
+ */
+typedef struct {
+  float abs_deadband;       /* 绝对死区，0 表示不限 */
+  float rel_deadband;       /* 相对死区 (比例，0.02 即 2%)，0 表示不限 */
+  uint32_t min_interval_ms; /* 两次发布的最小间隔，期间的值一律不发 */
+  uint32_t max_interval_ms; /* 值未变时的心跳间隔，到期照常发布；0 表示未变不发 */
+} MQTT_PublishFilter;
+
+/**
+ * @brief 为已注册主题设置发布过滤
+ * @details 对 MQTT_PublishById 与 MQTT_Publish (同名已注册主题) 生效。
+ *          被过滤的发布在编码与串口操作之前返回 true，并计入
+ *          MQTT_Stats 的 publish_suppressed / publish_bytes_saved。
+ *
+ * 示例：温度变化超过 0.2 才发，最快 1 秒一次，不变时 60 秒心跳一次
+ *   MQTT_PublishFilter f = {0.2f, 0.0f, 1000, 60000};
+ *   MQTT_SetPublishFilter(temp_id, &f);
+ *
+ * @param filter 规则 (内容被复制)；NULL 取消过滤
+ * @return false 句柄无效
+ */
+bool MQTT_SetPublishFilter(MQTT_TopicId id, const MQTT_PublishFilter *filter);
+
 /**
  * @brief 订阅配置结构体
  */
 typedef struct {
   const char *topic;           /* 主题名称 */
   MQTT_MessageHandler handler; /* 对应的回调函数 */
+  uint8_t priority;            /* 分发优先级 (可省略，默认 0)，数值越大越先分发 */
+  MQTT_Delivery delivery;      /* 投递策略 (可省略，默认 MQTT_DELIVER_ALL) */
+  uint16_t rate;               /* MQTT_DELIVER_SAMPLED 每秒最多回调次数 */
 } MQTT_SubscribeInfo;
 
+/**
+ * @brief 运行统计
+ */
+typedef struct {
+  uint32_t inbound_enqueued;   /* 入队的回调数 */
+  uint32_t inbound_dispatched; /* 已执行的回调数 */
+  uint32_t inbound_dropped;    /* 队列满被丢弃的回调数 */
+  uint32_t inbound_coalesced;  /* LATEST/SAMPLED 被新值覆盖的旧值数 */
+  uint8_t inbound_queue_peak;  /* 入站队列最高占用 */
+  uint32_t link_opens;         /* 新建 TCP/SSL 链路次数 (每次 SSL 都是完整握手) */
+  uint32_t link_connect_ms;    /* 最近一次建链耗时 (SSL 含握手，含关闭残留链路) */
+  uint32_t connect_ms;         /* 最近一次 MQTT_Start 总耗时 */
+  uint32_t publish_suppressed; /* 被发布过滤拦截的次数 */
+  uint32_t publish_bytes_saved; /* 被拦截发布本应发送的报文字节数 */
+} MQTT_Stats;
+
+/**
+ * @brief 分发入站消息
+ * @details 解码出的消息先进入有界队列，由本函数按订阅优先级 (同级先进先出)
+ *          依次调用回调。回调不在接收路径中执行，可以安全调用 MQTT_Publish，
+ *          耗时回调也不会阻塞后续报文的解码。
+ *          - 主循环/RTOS 任务驱动：MQTT_Service() 已自动调用，无需手动调用；
+ *          - 定义了 `MQTT_TIM_HANDLE`：服务例程在中断中只解码入队，
+ *            请在主循环或任务中周期性调用本函数执行回调。
+ */
+void MQTT_Dispatch(void);
+
+/**
+ * @brief ESP8266 AT 传输后端 (默认)
+ */
+extern const MQTT_Transport MQTT_TransportAT;
+
+#ifdef MQTT_SPI_HANDLE
+/**
+ * @brief SPI 二进制链路传输后端 (mqtt_transport_spi.c)
+ */
+extern const MQTT_Transport MQTT_TransportSPI;
+#endif
+
+/**
+ * @brief 切换传输后端，需在 MQTT_Start 之前调用
+ * @details 协议引擎 (心跳、订阅、分发、编解码) 与传输无关。板载以太网/LwIP
+ *          或主机上测试时，可改用套接字后端，完全绕开 AT 指令：
+ *
+ *   static MQTT_SocketCtx sock_ctx;
+ *   static MQTT_Transport sock;
+ *   MQTT_SocketTransportInit(&sock, &sock_ctx, "192.168.1.10", 1883);
+ *   MQTT_SetTransport(&sock);
+ *   MQTT_Start();
+ */
+void MQTT_SetTransport(const MQTT_Transport *t);
+
+#define MQTT_WAIT_FOREVER 0xFFFFFFFFu
+
+/**
+ * @brief 距离服务例程下一次必须运行的毫秒数
+ * @details 取以下各项的最小值：心跳、重连间隔、被动接收的兜底轮询、入站队列中
+ *          延后分发的消息。已有待处理的数据、未发出的订阅或 MQTT_Wake() 时返回 0。
+ *          AT 后端未定义 MQTT_UART_RX_DMA 时串口只能轮询，最多返回 MQTT_IDLE_POLL_MS。
+ */
+uint32_t MQTT_NextDeadline(void);
+
+/**
+ * @brief 睡眠到下一个事件
+ * @details 在 MQTT_Service() 之后调用，取 MQTT_NextDeadline() 与 max_ms 的较小值
+ *          交给 MQTT_Sleep()。串口 DMA/空闲中断或 MQTT_Wake() 会提前结束睡眠，
+ *          指令的响应延迟接近中断延迟，空闲时内核处于 WFI。
+ *
+ *   while (1) {
+ *       MQTT_Service();
+ *       App_Task();
+ *       MQTT_Idle(App_NextDeadline()); // 应用自己的定时任务也参与取最小值
+ *   }
+ *
+ * @param max_ms 最长睡眠时间，无应用定时任务时传 MQTT_WAIT_FOREVER
+ */
+void MQTT_Idle(uint32_t max_ms);
+
+/**
+ * @brief 结束当前或下一次 MQTT_Idle 睡眠，可在任意中断中调用
+ * @details 如 SPI 后端 READY 引脚的外部中断、按键中断等
+ */
+void MQTT_Wake(void);
+
+/**
+ * @brief 睡眠 (弱函数，可重写)
+ * @details 默认循环执行 __WFI()，直到超时、MQTT_Wake() 或有数据到达；SysTick
+ *          每毫秒唤醒一次内核检查条件。需要更低功耗时可重写为 STOP 模式 +
+ *          LPTIM/RTC 定时唤醒 (串口需支持从 STOP 唤醒，唤醒后恢复时钟)。
+ * @param ms 最长睡眠时间
+ */
+void MQTT_Sleep(uint32_t ms);
+
+/**
+ * @brief 获取运行统计 (只读)
+ */
+const MQTT_Stats *MQTT_GetStats(void);
+
+/**
+ * @brief 静态内存区的分区
+ */
+typedef enum {
+  MQTT_ARENA_RX = 0, /* MQTT 字节流 (RX_BUFFER_SIZE) */
+  MQTT_ARENA_ESP_RX, /* AT 后端 +IPD 暂存 (ESP_RX_BUFFER_SIZE) */
+  MQTT_ARENA_AT,     /* 建链阶段 AT 响应 (MQTT_AT_BUF_SIZE) */
+  MQTT_ARENA_CMD,    /* 建链阶段 AT 指令 (MQTT_CMD_BUF_SIZE) */
+  MQTT_ARENA_TX,     /* 控制报文 (MQTT_TX_BUF_SIZE) */
+  MQTT_ARENA_DECODE, /* 解码出的主题 + 内容 */
+  MQTT_ARENA_LOG,    /* 日志 (MQTT_LOG_BUF_SIZE) */
+  MQTT_ARENA_UART,   /* AT 串口 DMA 环形缓冲 (MQTT_UART_RX_RING，定义 MQTT_UART_RX_DMA 时) */
+  MQTT_ARENA_SUBS,   /* 订阅表 */
+  MQTT_ARENA_INBOUND, /* 入站队列 */
+  MQTT_ARENA_REGIONS
+} MQTT_ArenaRegion;
+
+/**
+ * @brief 分区用量
+ */
+typedef struct {
+  const char *name;
+  uint16_t size; /* 分区大小 (字节，编译期确定) */
+  uint16_t peak; /* 运行以来的最高用量；AT/指令/日志大于 size 表示发生过截断 */
+} MQTT_ArenaUsage;
+
+/**
+ * @brief 获取各分区用量 (只读)
+ * @details 返回按 MQTT_ArenaRegion 索引的数组。在最坏工况 (最长主题、最大报文、
+ *          订阅与队列满) 下运行后读取，据此把 conn.h 中各预算缩小到高水位之上。
+ *
+ *   const MQTT_ArenaUsage *u = MQTT_GetArenaUsage();
+ *   for (int i = 0; i < MQTT_ARENA_REGIONS; i++) {
+ *       printf("%-8s %5u / %5u\r\n", u[i].name, u[i].peak, u[i].size);
+ *   }
+ */
+const MQTT_ArenaUsage *MQTT_GetArenaUsage(void);
+
+/**
+ * @brief 静态内存区总大小 (字节)
+ */
+uint32_t MQTT_GetArenaSize(void);
+
 /**
  * @brief 批量设置订阅列表
  * @details 根据传入的列表自动管理订阅状态：
@@ -136,6 +425,31 @@ typedef struct {
  */
 void MQTT_SetSubscriptions(const MQTT_SubscribeInfo *list);
 
+/**
+ * @brief 订阅二进制主题 (分块传输、固件升级等)
+ * @details 普通订阅的内容按字符串截断到 MQTT_PAYLOAD_SIZE 并经队列延迟分发；
+ *          二进制订阅在解码时直接以原始内容回调，不复制、不截断，单条报文
+ *          上限为 RX_BUFFER_SIZE。回调在接收路径中执行 (定义 MQTT_TIM_HANDLE 时
+ *          位于中断)，应尽快返回，需要发布消息时请留到主循环中进行。
+ *          QoS 1 的消息在回调返回后才发送 PUBACK。
+ *
+ * @param topic 主题 (不支持通配符)
+ * @param qos 请求的 QoS，0 或 1
+ * @param handler 回调
+ * @return false 参数无效、主题超过 63 字节或订阅表已满
+ */
+bool MQTT_SubscribeStream(const char *topic, uint8_t qos, MQTT_StreamHandler handler);
+
+/**
+ * @brief 修改已订阅主题的投递策略 (用于手动订阅的主题)
+ *
+ * @param topic 订阅时使用的主题
+ * @param delivery 投递策略
+ * @param rate MQTT_DELIVER_SAMPLED 时每秒最多回调次数，其他策略忽略
+ * @return false 主题未订阅
+ */
+bool MQTT_SetDelivery(const char *topic, MQTT_Delivery delivery, uint16_t rate);
+
 /* ***************************无需调用******************************* */
 
 /**
@@ -164,10 +478,31 @@ bool MQTT_Unsubscribe(const char *topic);
  * @param topic 主题 (如 "sensor/temp" 或 "sensor/+")
  * @param handler 回调函数
  * @return true 订阅成功
- * @return false 失败（如列表已满）
+ * @return false 失败（如列表已满，或主题超过 63 字节）
  */
 bool MQTT_SubscribeCallback(const char *topic, MQTT_MessageHandler handler);
 
+/**
+ * @brief 立即发出尚未发送的 SUBSCRIBE 报文
+ * @details 订阅接口只登记主题，报文通常由下一次 MQTT_Service() 发出。
+ *          随后马上发布、且依赖该订阅接收回应的场景 (如 RPC 的响应主题)
+ *          应先调用本函数：同一连接上 Broker 按顺序处理，SUBSCRIBE 先于
+ *          PUBLISH 到达即可保证回应不丢。
+ * @return false 未连接或有报文发送失败 (下次 MQTT_Service 重试)
+ */
+bool MQTT_FlushSubscriptions(void);
+
+/**
+ * @brief 订阅已注册主题，回调收到句柄而非主题字符串
+ * @details 入站消息在解码时与注册表比对一次得到句柄，之后按整数分发，
+ *          回调中可直接 switch (id)，无需再比较字符串。
+ *
+ * @param id MQTT_RegisterTopic 返回的句柄
+ * @param handler 回调函数
+ * @return false 句柄无效或订阅列表已满
+ */
+bool MQTT_SubscribeId(MQTT_TopicId id, MQTT_IdHandler handler);
+
 /**
  * @brief 设置消息回调并启用回调式接收
  * @details 使用方法：
@@ -175,7 +510,7 @@ bool MQTT_SubscribeCallback(const char *topic, MQTT_MessageHandler handler);
  *    - `MQTT_Start();`
  *    - `MQTT_SetMessageHandler(handler);`
  *    - `MQTT_Subscribe("your/topic");`
- *    - `while (1) { MQTT_Service(); HAL_Delay(50); }`
+ *    - `while (1) { MQTT_Service(); MQTT_Idle(MQTT_WAIT_FOREVER); }`
  * 2) RTOS：
  *    - `MQTT_SetMessageHandler(handler);`
  *    - 在已有任务中周期性调用 `MQTT_Service()`，或定义 `MQTT_TIM_HANDLE`
@@ -0,0 +1,179 @@
+/**
+  * @file    arenareport.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   协议栈静态内存区与栈用量报告
+  *
+  * 用法:
+  *   arenareport [--host 127.0.0.1] [--port 1883] [--load 0] [--su conn.c.su ...]
+  *
+  * 1) 打印 mqtt_arena 各分区大小 (来自 conn.h 的预算配置，与固件编译结果一致)；
+  * 2) --load N：连接 Broker，注册满订阅表，以最长主题、最大内容发布 N 条并
+  *    回环接收，再打印各分区高水位，用于确认预算余量；
+  * 3) --su：读取 -fstack-usage 生成的 .su 文件，列出栈帧最大的函数。
+  *    主机构建已对 mqtt_engine 开启该选项，固件工程可在编译选项中加入
+  *    -fstack-usage (CubeIDE: "Generate per function stack usage information")。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "conn.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SU_MAX_ENTRIES 512
+#define SU_TOP 12
+
+typedef struct {
+    char func[96];
+    unsigned long bytes;
+    char kind[24];
+} StackEntry;
+
+static StackEntry su_entries[SU_MAX_ENTRIES];
+static int su_count = 0;
+static uint32_t received = 0;
+
+static void OnLoad(const char *topic, const char *payload)
+{
+    (void)topic;
+    (void)payload;
+    received++;
+}
+
+static void PrintArena(const char *title, bool with_peak)
+{
+    const MQTT_ArenaUsage *u = MQTT_GetArenaUsage();
+    uint32_t sum = 0;
+
+    printf("%s\n", title);
+    printf("  %-8s %8s%s\n", "分区", "大小", with_peak ? "    高水位  余量" : "");
+    for (int i = 0; i < MQTT_ARENA_REGIONS; i++) {
+        sum += u[i].size;
+        if (with_peak) {
+            printf("  %-8s %8u %9u %5d%s\n", u[i].name, u[i].size, u[i].peak, (int)u[i].size - (int)u[i].peak,
+                   u[i].peak > u[i].size ? "  (发生过截断)" : "");
+        } else {
+            printf("  %-8s %8u\n", u[i].name, u[i].size);
+        }
+    }
+    printf("  %-8s %8lu (含对齐填充 %lu)\n", "合计", (unsigned long)MQTT_GetArenaSize(),
+           (unsigned long)(MQTT_GetArenaSize() - sum));
+}
+
+static bool RunLoad(const char *host, uint16_t port, uint32_t count)
+{
+    static MQTT_SocketCtx sock_ctx;
+    static MQTT_Transport sock;
+    MQTT_SocketTransportInit(&sock, &sock_ctx, host, port);
+    MQTT_SetTransport(&sock);
+    if (!MQTT_Start()) {
+        fprintf(stderr, "连接 %s:%u 失败\n", host, port);
+        return false;
+    }
+
+    /* 主题取到 MQTT_TOPIC_SIZE - 1 的最长长度，订阅表填满 */
+    char topics[MAX_SUBSCRIPTIONS][MQTT_TOPIC_SIZE];
+    for (int i = 0; i < MAX_SUBSCRIPTIONS; i++) {
+        int n = snprintf(topics[i], sizeof(topics[i]), "arena/%d/%d/", (int)getpid(), i);
+        memset(&topics[i][n], 'x', MQTT_TOPIC_SIZE - 1 - n);
+        topics[i][MQTT_TOPIC_SIZE - 1] = '\0';
+        MQTT_SubscribeCallback(topics[i], OnLoad);
+    }
+    for (int i = 0; i < 4; i++) {
+        MQTT_Service();
+        HAL_Delay(20);
+    }
+
+    char payload[MQTT_PAYLOAD_SIZE];
+    memset(payload, 'p', sizeof(payload) - 1);
+    payload[sizeof(payload) - 1] = '\0';
+
+    /* 先连发再服务，让字节流与入站队列都出现积压 */
+    for (uint32_t sent = 0; sent < count; sent++) {
+        MQTT_Publish(topics[sent % MAX_SUBSCRIPTIONS], payload);
+        if (sent % (MQTT_INBOUND_QUEUE_LEN * 2) == 0) HAL_Delay(1);
+        if (sent % 64 == 63) MQTT_Service();
+    }
+    uint32_t deadline = HAL_GetTick() + 2000;
+    while (received < count && HAL_GetTick() < deadline) {
+        MQTT_Service();
+    }
+    printf("负载: 发布 %lu 条，回环收到 %lu 条\n\n", (unsigned long)count, (unsigned long)received);
+    return true;
+}
+
+/**
+ * @brief 解析 .su 行: "file:line:col:func<TAB>bytes<TAB>static|dynamic|bounded"
+ */
+static void LoadStackUsage(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+
+    if (f == NULL) {
+        fprintf(stderr, "无法打开 %s\n", path);
+        return;
+    }
+    while (fgets(line, sizeof(line), f) != NULL && su_count < SU_MAX_ENTRIES) {
+        char *tab = strchr(line, '\t');
+        if (tab == NULL) continue;
+        *tab = '\0';
+        char *name = strrchr(line, ':');
+        StackEntry *e = &su_entries[su_count];
+        snprintf(e->func, sizeof(e->func), "%.95s", name ? name + 1 : line);
+        if (sscanf(tab + 1, "%lu %23s", &e->bytes, e->kind) == 2) {
+            su_count++;
+        }
+    }
+    fclose(f);
+}
+
+static int CompareStack(const void *a, const void *b)
+{
+    const StackEntry *x = a;
+    const StackEntry *y = b;
+    return (x->bytes < y->bytes) - (x->bytes > y->bytes);
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    uint16_t port = 1883;
+    uint32_t load = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--su") == 0) {
+            while (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                LoadStackUsage(argv[++i]);
+            }
+        } else if (i + 1 < argc && strcmp(argv[i], "--host") == 0) host = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--port") == 0) port = (uint16_t)atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--load") == 0) load = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "未知参数: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (load > 0) {
+        if (!RunLoad(host, port, load)) return 1;
+        PrintArena("静态内存区 mqtt_arena (负载后)", true);
+    } else {
+        PrintArena("静态内存区 mqtt_arena", false);
+    }
+
+    if (su_count > 0) {
+        qsort(su_entries, su_count, sizeof(StackEntry), CompareStack);
+        printf("\n栈帧最大的函数 (共 %d 个)\n", su_count);
+        for (int i = 0; i < su_count && i < SU_TOP; i++) {
+            printf("  %6lu  %-9s %s\n", su_entries[i].bytes, su_entries[i].kind, su_entries[i].func);
+        }
+    }
+    return 0;
+}
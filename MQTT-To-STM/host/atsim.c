@@ -0,0 +1,300 @@
+/**
+  * @file    atsim.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   ESP8266 AT 模拟器：突发下行消息时 AT+CIPRECVDATA 的拉取节奏测试
+  *
+  * 用法:
+  *   atsim [--count 2000] [--size 100] [--window 4096] [--timeout-ms 20000] [--active]
+  *
+  * 协议引擎使用默认的 AT 后端。huart1 的输出经 HAL_PortUartOnTransmit 交给本模拟器：
+  * 解析 AT 指令与 AT+CIPSEND 数据，以 HAL_PortUartFeed 注入应答。模拟器同时充当
+  * Broker，CONNECT 之后连续下发 --count 条 PUBLISH (内容 --size 字节，含序号)，
+  * 只受模块内 TCP 缓冲 --window 字节的限制，远超 ESP_RX_BUFFER_SIZE。
+  *
+  * 被动模式 (默认) 下数据留在模块内，只发 "+IPD,<len>" 到达通知，由引擎按暂存区余量
+  * 发出 AT+CIPRECVDATA。主循环每轮只调用一次 MQTT_Process (只解出一条消息)，
+  * 消费明显慢于下发。全部消息按序收到、链路未重建、每次拉取不超过 ESP_RX_BUFFER_SIZE
+  * 时退出码为 0。--active 让模块拒绝 AT+CIPRECVMODE，数据以 "+IPD,<len>:<data>"
+  * 直接推送，用于对比：暂存区很快溢出，链路被关闭。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "conn.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ATSIM_WINDOW_MAX 16384 /* 模块内 TCP 缓冲上限 */
+#define ATSIM_SEGMENT 1460     /* 主动推送时单个 +IPD 的最大长度 (一个 TCP 报文段) */
+#define ATSIM_TOPIC "atsim/flood"
+
+typedef struct {
+    uint32_t pulls;        /* AT+CIPRECVDATA 次数 */
+    uint32_t pull_max;     /* 单次请求的最大长度 */
+    uint32_t pull_over;    /* 请求长度超过 ESP_RX_BUFFER_SIZE 的次数 */
+    uint32_t notifies;     /* 到达通知 / +IPD 次数 */
+    uint32_t backlog_max;  /* 模块内积压的峰值 */
+    uint32_t link_starts;  /* AT+CIPSTART 次数 */
+    uint32_t link_closes;  /* AT+CIPCLOSE 次数 */
+} AtSimStats;
+
+/* 模块 + Broker 状态 */
+static struct {
+    bool passive_ok;     /* 是否接受 AT+CIPRECVMODE=1 */
+    bool passive;
+    bool linked;
+    char line[256];      /* 正在接收的指令行 */
+    uint16_t line_len;
+    uint16_t send_remain; /* AT+CIPSEND 声明的剩余字节，非 0 时处于数据模式 */
+    uint8_t pkt[2048];
+    uint16_t pkt_len;
+    uint8_t tcp[ATSIM_WINDOW_MAX + 64]; /* 被动模式下模块内待取的数据 (留出控制报文余量) */
+    uint32_t tcp_len;
+    uint32_t window;
+    uint32_t flood_sent;
+    uint32_t flood_count;
+    uint16_t flood_size;
+} emu;
+
+static AtSimStats result;
+
+static void Feed(const char *s)
+{
+    HAL_PortUartFeed((const uint8_t *)s, (uint32_t)strlen(s));
+}
+
+/**
+ * @brief Broker 下发的数据到达模块
+ * @details 被动模式存入模块缓冲并发到达通知；主动模式按报文段直接推送到串口
+ */
+static void Emu_Deliver(const uint8_t *data, uint32_t len)
+{
+    char head[32];
+
+    if (!emu.linked || len == 0) return;
+    if (emu.passive) {
+        memcpy(emu.tcp + emu.tcp_len, data, len);
+        emu.tcp_len += len;
+        if (emu.tcp_len > result.backlog_max) result.backlog_max = emu.tcp_len;
+        snprintf(head, sizeof(head), "\r\n+IPD,%lu\r\n", (unsigned long)len);
+        Feed(head);
+        result.notifies++;
+        return;
+    }
+    for (uint32_t off = 0; off < len; off += ATSIM_SEGMENT) {
+        uint32_t n = (len - off < ATSIM_SEGMENT) ? len - off : ATSIM_SEGMENT;
+        snprintf(head, sizeof(head), "\r\n+IPD,%lu:", (unsigned long)n);
+        Feed(head);
+        HAL_PortUartFeed(data + off, n);
+        result.notifies++;
+    }
+}
+
+/**
+ * @brief Broker 处理设备发来的一个报文 (只应答 CONNECT / PINGREQ / SUBSCRIBE)
+ */
+static void Emu_Broker(const uint8_t *pkt, uint16_t len)
+{
+    switch (pkt[0] & 0xF0) {
+    case MQTT_PKT_CONNECT: {
+        static const uint8_t connack[] = {MQTT_PKT_CONNACK, 0x02, 0x00, 0x00};
+        Emu_Deliver(connack, sizeof(connack));
+        break;
+    }
+    case MQTT_PKT_PINGREQ: {
+        static const uint8_t pingresp[] = {MQTT_PKT_PINGRESP, 0x00};
+        Emu_Deliver(pingresp, sizeof(pingresp));
+        break;
+    }
+    case MQTT_PKT_SUBSCRIBE & 0xF0: /* 报文标识符紧跟单字节剩余长度 */
+        if (len >= 4) {
+            uint8_t suback[] = {MQTT_PKT_SUBACK, 0x03, pkt[2], pkt[3], 0x00};
+            Emu_Deliver(suback, sizeof(suback));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief 处理一行 AT 指令 (不含 \r\n)
+ */
+static void Emu_Command(const char *cmd)
+{
+    char reply[64];
+
+    if (strcmp(cmd, "AT+CIPRECVMODE=1") == 0) {
+        emu.passive = emu.passive_ok;
+        Feed(emu.passive ? "\r\nOK\r\n" : "\r\nERROR\r\n");
+    } else if (strncmp(cmd, "AT+CIPSTART=", 12) == 0) {
+        result.link_starts++;
+        emu.linked = true;
+        emu.tcp_len = 0;
+        Feed("CONNECT\r\n\r\nOK\r\n");
+    } else if (strcmp(cmd, "AT+CIPCLOSE") == 0) {
+        result.link_closes++;
+        emu.linked = false;
+        emu.tcp_len = 0;
+        Feed("CLOSED\r\n\r\nOK\r\n");
+    } else if (strncmp(cmd, "AT+CIPSEND=", 11) == 0) {
+        emu.send_remain = (uint16_t)atoi(cmd + 11);
+        emu.pkt_len = 0;
+        Feed("\r\nOK\r\n> ");
+    } else if (strcmp(cmd, "AT+CIPRECVLEN?") == 0) {
+        snprintf(reply, sizeof(reply), "+CIPRECVLEN:%lu,0,0,0,0\r\n\r\nOK\r\n", (unsigned long)emu.tcp_len);
+        Feed(reply);
+    } else if (strncmp(cmd, "AT+CIPRECVDATA=", 15) == 0) {
+        uint32_t want = (uint32_t)strtoul(cmd + 15, NULL, 10);
+        uint32_t n = (want < emu.tcp_len) ? want : emu.tcp_len;
+        result.pulls++;
+        if (want > result.pull_max) result.pull_max = want;
+        if (want > ESP_RX_BUFFER_SIZE) result.pull_over++;
+        snprintf(reply, sizeof(reply), "+CIPRECVDATA,%lu:", (unsigned long)n);
+        Feed(reply);
+        HAL_PortUartFeed(emu.tcp, n);
+        memmove(emu.tcp, emu.tcp + n, emu.tcp_len - n);
+        emu.tcp_len -= n;
+        Feed("\r\nOK\r\n");
+    } else if (strcmp(cmd, "AT+CWJAP?") == 0) {
+        Feed("+CWJAP:\"atsim\",\"aa:bb:cc:dd:ee:ff\",6,-52,0,0,0\r\n\r\nOK\r\n");
+    } else if (strncmp(cmd, "AT+CIPDOMAIN=", 13) == 0) {
+        Feed("+CIPDOMAIN:\"192.168.1.10\"\r\n\r\nOK\r\n");
+    } else {
+        Feed("\r\nOK\r\n");
+    }
+}
+
+/* 覆盖 hal_port.c 的弱函数：huart1 上的输出即发给模块的指令与数据 */
+void HAL_PortUartOnTransmit(const uint8_t *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        if (emu.send_remain > 0) {
+            if (emu.pkt_len < sizeof(emu.pkt)) emu.pkt[emu.pkt_len++] = data[i];
+            if (--emu.send_remain == 0) {
+                char reply[48];
+                snprintf(reply, sizeof(reply), "\r\nRecv %u bytes\r\n\r\nSEND OK\r\n", emu.pkt_len);
+                Feed(reply);
+                Emu_Broker(emu.pkt, emu.pkt_len);
+            }
+            continue;
+        }
+        if (data[i] == '\n' && emu.line_len > 0 && emu.line[emu.line_len - 1] == '\r') {
+            emu.line[emu.line_len - 1] = '\0';
+            Emu_Command(emu.line);
+            emu.line_len = 0;
+        } else if (emu.line_len < sizeof(emu.line) - 1) {
+            emu.line[emu.line_len++] = (char)data[i];
+        }
+    }
+}
+
+/**
+ * @brief Broker 继续下发：被动模式填满模块缓冲为止，主动模式每轮推送一个窗口
+ */
+static void Emu_Pump(void)
+{
+    static uint8_t burst[ATSIM_WINDOW_MAX];
+    uint32_t burst_len = 0;
+    uint32_t limit = emu.window;
+    if (emu.passive) limit = (emu.tcp_len < emu.window) ? emu.window - emu.tcp_len : 0;
+
+    if (!emu.linked) return;
+    while (emu.flood_sent < emu.flood_count) {
+        char payload[ESP_RX_BUFFER_SIZE];
+        snprintf(payload, sizeof(payload), "%08lu", (unsigned long)emu.flood_sent);
+        memset(payload + 8, 'x', emu.flood_size - 8);
+
+        uint8_t pkt[ESP_RX_BUFFER_SIZE];
+        uint16_t n = MQTT_BuildPublish(pkt, sizeof(pkt), ATSIM_TOPIC, (const uint8_t *)payload, emu.flood_size);
+        if (n == 0 || burst_len + n > limit) break;
+        memcpy(burst + burst_len, pkt, n);
+        burst_len += n;
+        emu.flood_sent++;
+    }
+    Emu_Deliver(burst, burst_len);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t count = 2000;
+    uint32_t size = 100;
+    uint32_t window = 4096;
+    uint32_t timeout_ms = 20000;
+
+    emu.passive_ok = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--active") == 0) {
+            emu.passive_ok = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "缺少参数值: %s\n", argv[i]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--count") == 0) count = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--size") == 0) size = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--window") == 0) window = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--timeout-ms") == 0) timeout_ms = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "未知参数: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    /* 单条报文须能放进接收缓冲区与用户缓冲 */
+    uint32_t size_max = MQTT_PAYLOAD_SIZE - 1;
+    if (size < 8 || size > size_max) {
+        fprintf(stderr, "--size 须在 8~%lu 之间\n", (unsigned long)size_max);
+        return 1;
+    }
+    /* 窗口至少容纳一条 PUBLISH：报头 + 主题 + 内容 */
+    uint32_t window_min = size + (uint32_t)sizeof(ATSIM_TOPIC) + 4;
+    if (window < window_min || window > ATSIM_WINDOW_MAX) {
+        fprintf(stderr, "--window 须在 %lu~%d 之间\n", (unsigned long)window_min, ATSIM_WINDOW_MAX);
+        return 1;
+    }
+    emu.flood_count = count;
+    emu.flood_size = (uint16_t)size;
+    emu.window = window;
+
+    if (!MQTT_Start()) {
+        fprintf(stderr, "AT 启动失败 (MQTT_LOG=1 查看引擎日志)\n");
+        return 1;
+    }
+
+    static char topic[MQTT_TOPIC_SIZE];
+    static char payload[MQTT_PAYLOAD_SIZE];
+    uint32_t received = 0;
+    uint32_t misordered = 0;
+    uint32_t start = HAL_GetTick();
+
+    while (received < count && MQTT_IsConnected() && HAL_GetTick() - start < timeout_ms) {
+        Emu_Pump();
+        if (!MQTT_Process(topic, sizeof(topic), payload, sizeof(payload))) continue;
+        if (strcmp(topic, ATSIM_TOPIC) != 0 || strlen(payload) != size ||
+            strtoul(payload, NULL, 10) != received) {
+            misordered++;
+        }
+        received++;
+    }
+    uint32_t elapsed = HAL_GetTick() - start;
+
+    printf("%s模式: 收到 %lu/%lu 条 (%lu 字节)，乱序/损坏 %lu，耗时 %lu ms\n",
+           emu.passive ? "被动" : "主动", (unsigned long)received, (unsigned long)count,
+           (unsigned long)size, (unsigned long)misordered, (unsigned long)elapsed);
+    printf("到达通知 %lu 次，AT+CIPRECVDATA %lu 次 (最大请求 %lu，超出暂存区 %lu 次)，模块积压峰值 %lu 字节\n",
+           (unsigned long)result.notifies, (unsigned long)result.pulls, (unsigned long)result.pull_max,
+           (unsigned long)result.pull_over, (unsigned long)result.backlog_max);
+    printf("建链 %lu 次，关闭 %lu 次%s\n", (unsigned long)result.link_starts, (unsigned long)result.link_closes,
+           MQTT_IsConnected() ? "" : "，链路已断开");
+
+    bool ok = received == count && misordered == 0 && result.pull_over == 0 &&
+              result.link_starts == 1 && result.link_closes == 0;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+/**
+  * @file    engineperf.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   以原生套接字速度运行固件协议引擎 (conn.c)，测量发布/接收吞吐
+  *
+  * 用法:
+  *   engineperf [--host 127.0.0.1] [--port 1883] [--count 100000] [--payload 64]
+  *              [--latency 0] [--poll-ms 0] [--trace trace.bin]
+  *
+  * 订阅自身的测试主题后连续 MQTT_PublishById，消息经 Broker 回到本机，
+  * 由 MQTT_Service 解码、入队、分发。输出发布与回环接收速率及引擎统计。
+  * --latency N：改为逐条往返 N 次，主循环为 MQTT_Service + MQTT_Idle
+  * (--poll-ms 0) 或 MQTT_Service + HAL_Delay(poll-ms)，输出往返延迟与 CPU 占用。
+  * --trace FILE：结束时把飞行记录器 (mqtt_trace.h) 的全部记录经 MQTT 上传并
+  * 回环写入 FILE，可用 trace2chrome.py 转换后查看。
+  * 可配合 `fleetsim broker` 使用。设置 MQTT_LOG=1 可查看引擎日志。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "conn.h"
+#include "mqtt_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint32_t received = 0;
+
+static void OnLoopback(MQTT_TopicId id, const char *payload)
+{
+    (void)id;
+    (void)payload;
+    received++;
+}
+
+static FILE *trace_out = NULL;
+
+static void OnTrace(const uint8_t *payload, uint32_t len)
+{
+    fwrite(payload, 1, len, trace_out);
+}
+
+/**
+ * @brief 上传飞行记录器的全部记录，回环写入文件
+ */
+static void DumpTrace(const char *path)
+{
+    MQTT_Trace_Flush();
+    uint32_t start = HAL_GetTick();
+    while (MQTT_Trace_Pending() && MQTT_IsConnected() && HAL_GetTick() - start < 5000) {
+        MQTT_Trace_Service();
+        MQTT_Service();
+    }
+    /* 等待最后几批回环到达 */
+    for (int i = 0; i < 10; i++) {
+        MQTT_Service();
+        HAL_Delay(20);
+    }
+    fclose(trace_out);
+
+    const MQTT_TraceStatus *ts = MQTT_Trace_GetStatus();
+    printf("飞行记录: 共写入 %lu 条，上传至 %lu，覆盖丢失 %lu 条 -> %s\n", (unsigned long)ts->seq,
+           (unsigned long)ts->flushed, (unsigned long)ts->lost, path);
+}
+
+static uint64_t NowUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/**
+ * @brief 逐条往返：比较 MQTT_Idle 与固定 HAL_Delay 轮询的延迟与 CPU 占用
+ */
+static void RunLatency(MQTT_TopicId topic, uint32_t rounds, uint32_t poll_ms)
+{
+    uint64_t sum_us = 0, max_us = 0;
+    uint32_t done = 0;
+    clock_t cpu_start = clock();
+    uint64_t wall_start = NowUs();
+
+    for (; done < rounds && MQTT_IsConnected(); done++) {
+        uint32_t before = received;
+        uint64_t t0 = NowUs();
+        if (!MQTT_PublishById(topic, (const uint8_t *)"ping", 4)) break;
+        while (received == before && NowUs() - t0 < 1000000u) {
+            MQTT_Service();
+            if (received != before) break;
+            if (poll_ms > 0) {
+                HAL_Delay(poll_ms);
+            } else {
+                MQTT_Idle(MQTT_WAIT_FOREVER);
+            }
+        }
+        uint64_t us = NowUs() - t0;
+        sum_us += us;
+        if (us > max_us) max_us = us;
+    }
+
+    double wall = (double)(NowUs() - wall_start) / 1e6;
+    double cpu = (double)(clock() - cpu_start) / CLOCKS_PER_SEC;
+    printf("主循环: MQTT_Service + %s\n", poll_ms ? "HAL_Delay" : "MQTT_Idle");
+    if (poll_ms) printf("轮询间隔 %u ms\n", poll_ms);
+    printf("往返 %u 次，平均 %.2f ms，最大 %.2f ms\n", done, done ? sum_us / 1000.0 / done : 0.0, max_us / 1000.0);
+    printf("CPU 占用 %.1f%% (%.3f s / %.3f s)\n", wall > 0 ? cpu * 100.0 / wall : 0.0, cpu, wall);
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    uint16_t port = 1883;
+    uint32_t count = 100000;
+    uint16_t payload_len = 64;
+    uint32_t latency = 0;
+    uint32_t poll_ms = 0;
+    const char *trace_path = NULL;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--host") == 0) host = argv[i + 1];
+        else if (strcmp(argv[i], "--port") == 0) port = (uint16_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--count") == 0) count = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--payload") == 0) payload_len = (uint16_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--latency") == 0) latency = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--poll-ms") == 0) poll_ms = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--trace") == 0) trace_path = argv[i + 1];
+        else {
+            fprintf(stderr, "未知参数: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    static MQTT_SocketCtx sock_ctx;
+    static MQTT_Transport sock;
+    MQTT_SocketTransportInit(&sock, &sock_ctx, host, port);
+    MQTT_SetTransport(&sock);
+
+    if (!MQTT_Start()) {
+        fprintf(stderr, "连接 %s:%u 失败\n", host, port);
+        return 1;
+    }
+
+    MQTT_TopicId topic = MQTT_RegisterTopic("engineperf/loop");
+    MQTT_SubscribeId(topic, OnLoopback);
+    if (trace_path != NULL) {
+        trace_out = fopen(trace_path, "wb");
+        if (trace_out == NULL || !MQTT_Trace_Init("engineperf/trace") ||
+            !MQTT_SubscribeStream("engineperf/trace", 0, OnTrace)) {
+            fprintf(stderr, "无法启用飞行记录上传: %s\n", trace_path);
+            return 1;
+        }
+    }
+
+    /* 等待订阅发出并生效 (引擎不跟踪 SUBACK，留出一个往返) */
+    for (int i = 0; i < 4; i++) {
+        MQTT_Service();
+        HAL_Delay(50);
+    }
+
+    if (latency > 0) {
+        RunLatency(topic, latency, poll_ms);
+        if (trace_path != NULL) DumpTrace(trace_path);
+        return 0;
+    }
+
+    uint8_t *payload = calloc(1, payload_len ? payload_len : 1);
+    uint32_t start = HAL_GetTick();
+    uint32_t sent = 0;
+
+    for (; sent < count && MQTT_IsConnected(); sent++) {
+        if (!MQTT_PublishById(topic, payload, payload_len)) break;
+        MQTT_Service();
+    }
+    uint32_t publish_ms = HAL_GetTick() - start;
+
+    /* 收尾：等待回环消息到齐或 2 秒无进展 */
+    uint32_t last = received, idle_since = HAL_GetTick();
+    while (received < sent && HAL_GetTick() - idle_since < 2000) {
+        MQTT_Service();
+        if (received != last) {
+            last = received;
+            idle_since = HAL_GetTick();
+        }
+    }
+    uint32_t total_ms = HAL_GetTick() - start;
+
+    const MQTT_Stats *st = MQTT_GetStats();
+    printf("发布 %u 条 (%u 字节)，耗时 %u ms，%.0f 条/秒\n", sent, payload_len, publish_ms,
+           publish_ms ? sent * 1000.0 / publish_ms : 0.0);
+    printf("回环收到 %u 条，耗时 %u ms，%.0f 条/秒\n", received, total_ms,
+           total_ms ? received * 1000.0 / total_ms : 0.0);
+    printf("引擎统计: 入队 %u 分发 %u 丢弃 %u 合并 %u 队列峰值 %u\n",
+           (unsigned)st->inbound_enqueued, (unsigned)st->inbound_dispatched,
+           (unsigned)st->inbound_dropped, (unsigned)st->inbound_coalesced,
+           (unsigned)st->inbound_queue_peak);
+
+    free(payload);
+    if (trace_path != NULL) DumpTrace(trace_path);
+    return 0;
+}
@@ -0,0 +1,977 @@
+/**
+  * @file    fleetsim.cpp
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   设备集群模拟器 / 压测工具 (Linux, epoll)，复用 mqtt_codec.c 编解码
+  *
+  * 用法:
+  *   fleetsim broker [--port 1883] [--time-offset-ms 0] [--time-skew-ppm 0]
+  *       启动本地最小 Broker 替身 (CONNECT/SUBSCRIBE/PUBLISH QoS0~1/保留消息/PING)
+  *       兼作时钟同步后端 (mqtt_time.h)：应答 ".../time" 主题的请求，后端时钟为
+  *       系统时间加 --time-offset-ms、并按 --time-skew-ppm 走快，用于验证设备侧的
+  *       偏移与频偏估计；统计带 "@capture,send|" 时间戳的消息的排队与网络耗时。
+  *   fleetsim client [--host 127.0.0.1] [--port 1883] [--devices 1000]
+  *                   [--rate 1] [--payload 64] [--duration 30] [--ramp 500]
+  *                   [--topic fleet/{id}/tele] [--subs fleet/{id}/tele]
+  *       模拟多台设备：每台设备独立 TCP 连接，按 --rate (条/秒) 发布
+  *       --payload 字节的消息并订阅 --subs (逗号分隔，{id} 替换为设备号)。
+  *       消息内容前 16 字节携带发送时间戳，收到后统计端到端延迟。
+  *
+  * 设备数较多时需放宽文件描述符限制: ulimit -n 65535
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_codec.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+/* ==========================================
+ * 通用工具
+ * ========================================== */
+
+uint64_t NowNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+volatile sig_atomic_t g_stop = 0;
+
+void OnSignal(int) { g_stop = 1; }
+
+bool SetNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+std::string Expand(const std::string &tmpl, uint32_t id)
+{
+    std::string out;
+    size_t pos = 0;
+    for (;;) {
+        size_t hit = tmpl.find("{id}", pos);
+        out.append(tmpl, pos, hit == std::string::npos ? std::string::npos : hit - pos);
+        if (hit == std::string::npos) break;
+        out += std::to_string(id);
+        pos = hit + 4;
+    }
+    return out;
+}
+
+std::vector<std::string> Split(const std::string &s, char sep)
+{
+    std::vector<std::string> out;
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t hit = s.find(sep, pos);
+        std::string part = s.substr(pos, hit == std::string::npos ? std::string::npos : hit - pos);
+        if (!part.empty()) out.push_back(part);
+        if (hit == std::string::npos) break;
+        pos = hit + 1;
+    }
+    return out;
+}
+
+/**
+ * @brief 对数-线性延迟直方图 (每个 2 的幂区间 64 档，相对误差 < 1.6%)
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts_(kBuckets, 0) {}
+
+    void Record(uint64_t v)
+    {
+        counts_[Index(v)]++;
+        total_++;
+        max_ = std::max(max_, v);
+    }
+
+    uint64_t Total() const { return total_; }
+    uint64_t Max() const { return max_; }
+
+    uint64_t Percentile(double p) const
+    {
+        if (total_ == 0) return 0;
+        uint64_t rank = uint64_t(p * double(total_ - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); i++) {
+            seen += counts_[i];
+            if (seen >= rank) return Value(i);
+        }
+        return max_;
+    }
+
+private:
+    static constexpr size_t kBuckets = 64 * 60;
+
+    static size_t Index(uint64_t v)
+    {
+        if (v < 128) return size_t(v);
+        int e = 63 - __builtin_clzll(v);
+        int shift = e - 6;
+        return size_t(shift + 1) * 64 + size_t((v >> shift) & 63);
+    }
+
+    static uint64_t Value(size_t idx)
+    {
+        if (idx < 128) return idx;
+        int shift = int(idx / 64) - 1;
+        return (uint64_t(idx % 64) + 64) << shift;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+    uint64_t max_ = 0;
+};
+
+/**
+ * @brief 连接缓冲：接收字节流与待发送队列
+ */
+struct Conn {
+    int fd = -1;
+    uint32_t tag = 0; /* epoll 事件标识 (Broker 为 fd，客户端为设备号) */
+    std::vector<uint8_t> in;
+    std::vector<uint8_t> out;
+    size_t out_off = 0;
+    bool want_write = false;
+
+    void Queue(const uint8_t *data, size_t len) { out.insert(out.end(), data, data + len); }
+    size_t Pending() const { return out.size() - out_off; }
+};
+
+/* 尽量写出待发送数据；返回 false 表示连接出错 */
+bool FlushConn(Conn &c)
+{
+    while (c.out_off < c.out.size()) {
+        ssize_t n = send(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off, MSG_NOSIGNAL);
+        if (n > 0) {
+            c.out_off += size_t(n);
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    if (c.out_off == c.out.size()) {
+        c.out.clear();
+        c.out_off = 0;
+    } else if (c.out_off > (1u << 16)) {
+        c.out.erase(c.out.begin(), c.out.begin() + long(c.out_off));
+        c.out_off = 0;
+    }
+    return true;
+}
+
+/* 读取全部可用数据；返回 false 表示对端关闭或出错 */
+bool DrainConn(Conn &c)
+{
+    uint8_t buf[16384];
+    for (;;) {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            c.in.insert(c.in.end(), buf, buf + n);
+        } else if (n == 0) {
+            return false;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+        } else if (errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief 按报文拆分接收缓冲区，逐个回调；返回 false 表示流格式错误
+ */
+bool ForEachPacket(Conn &c, const std::function<void(const uint8_t *, uint32_t)> &fn)
+{
+    size_t off = 0;
+    while (off < c.in.size()) {
+        uint32_t total = 0;
+        int ret = MQTT_PacketLength(c.in.data() + off, uint32_t(c.in.size() - off), &total);
+        if (ret < 0) return false;
+        if (ret == 0) break;
+        fn(c.in.data() + off, total);
+        off += total;
+    }
+    if (off > 0) c.in.erase(c.in.begin(), c.in.begin() + long(off));
+    return true;
+}
+
+void UpdateEpoll(int ep, Conn &c)
+{
+    bool want = c.Pending() > 0;
+    if (want == c.want_write) return;
+    c.want_write = want;
+    epoll_event ev{};
+    ev.events = EPOLLIN | (want ? uint32_t(EPOLLOUT) : 0u);
+    ev.data.u32 = c.tag;
+    epoll_ctl(ep, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+/* ==========================================
+ * Broker 替身
+ * ========================================== */
+
+class StandInBroker {
+public:
+    StandInBroker(uint16_t port, int64_t time_offset_ms, double time_skew_ppm)
+        : port_(port), time_offset_ms_(time_offset_ms), time_skew_ppm_(time_skew_ppm)
+    {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        start_unix_ms_ = int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+        start_ns_ = NowNs();
+    }
+
+    int Run()
+    {
+        int lfd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port_);
+        if (bind(lfd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(lfd, 4096) < 0) {
+            perror("bind/listen");
+            return 1;
+        }
+        SetNonBlocking(lfd);
+
+        ep_ = epoll_create1(0);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u32 = uint32_t(lfd);
+        epoll_ctl(ep_, EPOLL_CTL_ADD, lfd, &ev);
+
+        std::printf("broker stand-in listening on :%u\n", port_);
+        uint64_t last_report = NowNs();
+        std::vector<epoll_event> events(1024);
+
+        while (!g_stop) {
+            int n = epoll_wait(ep_, events.data(), int(events.size()), 200);
+            for (int i = 0; i < n; i++) {
+                int fd = int(events[i].data.u32);
+                if (fd == lfd) {
+                    Accept(lfd);
+                    continue;
+                }
+                auto it = sessions_.find(fd);
+                if (it == sessions_.end()) continue;
+                Conn &c = it->second.conn;
+                bool ok = true;
+                if (events[i].events & (EPOLLHUP | EPOLLERR)) ok = false;
+                if (ok && (events[i].events & EPOLLIN)) {
+                    ok = DrainConn(c) && ForEachPacket(c, [&](const uint8_t *p, uint32_t len) { OnPacket(fd, p, len); });
+                }
+                if (ok && (events[i].events & EPOLLOUT)) ok = FlushConn(c);
+                if (!ok) {
+                    Close(fd);
+                    continue;
+                }
+                UpdateEpoll(ep_, c);
+            }
+            /* 发布扇出会写入其他连接，统一刷新 */
+            for (int fd : dirty_) {
+                auto it = sessions_.find(fd);
+                if (it == sessions_.end()) continue;
+                if (!FlushConn(it->second.conn)) {
+                    Close(fd);
+                } else {
+                    UpdateEpoll(ep_, it->second.conn);
+                }
+            }
+            dirty_.clear();
+
+            uint64_t now = NowNs();
+            if (now - last_report >= 1000000000ull) {
+                std::printf("sessions=%zu in=%" PRIu64 "/s out=%" PRIu64 "/s dropped=%" PRIu64 "\n",
+                            sessions_.size(), in_count_, out_count_, dropped_);
+                in_count_ = out_count_ = 0;
+                if (queue_ms_.Total() > 0) {
+                    std::printf("  stamped=%" PRIu64 " queue p50=%" PRIu64 " max=%" PRIu64 " ms"
+                                "  network p50=%" PRIu64 " max=%" PRIu64 " ms  time-sync=%" PRIu64 "\n",
+                                queue_ms_.Total(), queue_ms_.Percentile(0.5), queue_ms_.Max(),
+                                net_ms_.Percentile(0.5), net_ms_.Max(), time_replies_);
+                    queue_ms_ = LatencyHistogram();
+                    net_ms_ = LatencyHistogram();
+                }
+                last_report = now;
+            }
+        }
+        close(ep_);
+        close(lfd);
+        return 0;
+    }
+
+private:
+    struct Session {
+        Conn conn;
+        std::vector<std::string> filters;
+        uint8_t qos = 0; /* 授予的最高 QoS：为 0 时 QoS 1 消息降级转发 */
+    };
+
+    static constexpr size_t kMaxBacklog = 4u << 20; /* 单连接积压上限，超出丢弃 */
+
+    void Accept(int lfd)
+    {
+        for (;;) {
+            int fd = accept(lfd, nullptr, nullptr);
+            if (fd < 0) return;
+            SetNonBlocking(fd);
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            Session &s = sessions_[fd];
+            s.conn.fd = fd;
+            s.conn.tag = uint32_t(fd);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u32 = uint32_t(fd);
+            epoll_ctl(ep_, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    void Close(int fd)
+    {
+        auto it = sessions_.find(fd);
+        if (it == sessions_.end()) return;
+        for (const std::string &f : it->second.filters) Unroute(f, fd);
+        epoll_ctl(ep_, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        sessions_.erase(it);
+    }
+
+    static bool IsWildcard(const std::string &f) { return f.find_first_of("+#") != std::string::npos; }
+
+    void Unroute(const std::string &f, int fd)
+    {
+        if (IsWildcard(f)) {
+            wildcard_.erase(std::remove(wildcard_.begin(), wildcard_.end(), std::make_pair(f, fd)), wildcard_.end());
+        } else {
+            auto &v = exact_[f];
+            v.erase(std::remove(v.begin(), v.end(), fd), v.end());
+            if (v.empty()) exact_.erase(f);
+        }
+    }
+
+    void Send(int fd, const uint8_t *p, size_t len)
+    {
+        auto it = sessions_.find(fd);
+        if (it == sessions_.end()) return;
+        Conn &c = it->second.conn;
+        if (c.Pending() > kMaxBacklog) {
+            dropped_++;
+            return;
+        }
+        c.Queue(p, len);
+        dirty_.push_back(fd);
+    }
+
+    void OnPacket(int fd, const uint8_t *p, uint32_t len)
+    {
+        uint8_t type = p[0] & 0xF0;
+        if (type == MQTT_PKT_CONNECT) {
+            static const uint8_t connack[] = {MQTT_PKT_CONNACK, 0x02, 0x00, 0x00};
+            Send(fd, connack, sizeof(connack));
+        } else if (type == (MQTT_PKT_SUBSCRIBE & 0xF0)) {
+            OnSubscribe(fd, p, len);
+        } else if (type == MQTT_PKT_PUBLISH) {
+            OnPublish(fd, p, len);
+        } else if (type == MQTT_PKT_PINGREQ) {
+            static const uint8_t pingresp[] = {MQTT_PKT_PINGRESP, 0x00};
+            Send(fd, pingresp, sizeof(pingresp));
+        }
+    }
+
+    void OnSubscribe(int fd, const uint8_t *p, uint32_t len)
+    {
+        uint32_t i = 1;
+        while (i < len && (p[i] & 0x80)) i++;
+        i++;
+        if (i + 2 > len) return;
+        uint16_t pid = uint16_t((p[i] << 8) | p[i + 1]);
+        i += 2;
+
+        std::vector<uint8_t> granted;
+        while (i + 2 <= len) {
+            uint16_t flen = uint16_t((p[i] << 8) | p[i + 1]);
+            if (i + 2 + flen + 1 > len) break;
+            std::string f(reinterpret_cast<const char *>(p + i + 2), flen);
+            uint8_t qos = std::min<uint8_t>(p[i + 2 + flen] & 0x03, 1);
+            i += 2 + flen + 1;
+            sessions_[fd].filters.push_back(f);
+            if (IsWildcard(f)) {
+                wildcard_.emplace_back(f, fd);
+            } else {
+                exact_[f].push_back(fd);
+            }
+            sessions_[fd].qos = std::max(sessions_[fd].qos, qos);
+            granted.push_back(qos); /* 最高支持 QoS 1 */
+        }
+
+        uint8_t suback[64];
+        size_t n = 0;
+        suback[n++] = MQTT_PKT_SUBACK;
+        suback[n++] = uint8_t(2 + granted.size());
+        suback[n++] = uint8_t(pid >> 8);
+        suback[n++] = uint8_t(pid & 0xFF);
+        for (uint8_t g : granted) {
+            if (n < sizeof(suback)) suback[n++] = g;
+        }
+        Send(fd, suback, n);
+
+        /* 新订阅立即收到匹配的保留消息 */
+        for (size_t k = sessions_[fd].filters.size() - granted.size(); k < sessions_[fd].filters.size(); k++) {
+            const std::string &f = sessions_[fd].filters[k];
+            for (const auto &r : retained_) {
+                if (MQTT_TopicMatched(f.c_str(), r.first.c_str())) {
+                    Forward(fd, r.second.data(), uint32_t(r.second.size()));
+                    out_count_++;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief 按订阅者授予的 QoS 转发：QoS 1 报文原样转发 (沿用发布者的报文标识符，
+     *        替身不跟踪重发)，只订阅了 QoS 0 的会话收到去掉报文标识符的副本
+     */
+    void Forward(int fd, const uint8_t *p, uint32_t len)
+    {
+        MQTT_PublishView view;
+        if ((p[0] & 0x06) == 0 || sessions_[fd].qos > 0 || !MQTT_ParsePublish(p, len, &view)) {
+            Send(fd, p, len);
+            return;
+        }
+        uint32_t body = 2 + view.topic_len + view.payload_len;
+        std::vector<uint8_t> out(5 + body);
+        size_t n = MQTT_BuildFixedHeader(out.data(), uint8_t(p[0] & ~0x06), body);
+        out[n++] = uint8_t(view.topic_len >> 8);
+        out[n++] = uint8_t(view.topic_len & 0xFF);
+        memcpy(&out[n], view.topic, view.topic_len);
+        n += view.topic_len;
+        memcpy(&out[n], view.payload, view.payload_len);
+        n += view.payload_len;
+        Send(fd, out.data(), n);
+    }
+
+    void OnPublish(int fd, const uint8_t *p, uint32_t len)
+    {
+        MQTT_PublishView view;
+        if (!MQTT_ParsePublish(p, len, &view)) return;
+        in_count_++;
+
+        if (view.qos == 1) {
+            const uint8_t puback[] = {MQTT_PKT_PUBACK, 0x02, uint8_t(view.packet_id >> 8),
+                                      uint8_t(view.packet_id & 0xFF)};
+            Send(fd, puback, sizeof(puback));
+        }
+
+        std::string topic(reinterpret_cast<const char *>(view.topic), view.topic_len);
+        if (view.payload_len > 0 && view.payload[0] == '@') {
+            OnStamped(view.payload, view.payload_len);
+        } else if (topic.size() > 5 && topic.compare(topic.size() - 5, 5, "/time") == 0) {
+            OnTimeRequest(topic, view.payload, view.payload_len);
+        }
+        if (view.retain) {
+            if (view.payload_len == 0) {
+                retained_.erase(topic);
+            } else {
+                retained_[topic].assign(p, p + len);
+            }
+        }
+
+        /* 转发给现有订阅者时清除保留标志 */
+        std::vector<uint8_t> fwd;
+        if (view.retain) {
+            fwd.assign(p, p + len);
+            fwd[0] &= uint8_t(~MQTT_PUBLISH_RETAIN);
+            p = fwd.data();
+        }
+        Route(topic, p, len);
+    }
+
+    void Route(const std::string &topic, const uint8_t *p, uint32_t len)
+    {
+        auto it = exact_.find(topic);
+        if (it != exact_.end()) {
+            for (int sub : it->second) {
+                Forward(sub, p, len);
+                out_count_++;
+            }
+        }
+        for (const auto &w : wildcard_) {
+            if (MQTT_TopicMatched(w.first.c_str(), topic.c_str())) {
+                Forward(w.second, p, len);
+                out_count_++;
+            }
+        }
+    }
+
+    /**
+     * @brief 后端时钟 (Unix 毫秒)：系统时间 + 偏移，并按频偏走快/走慢
+     */
+    uint64_t BackendMs() const
+    {
+        double elapsed_ms = double(NowNs() - start_ns_) / 1e6;
+        return uint64_t(start_unix_ms_ + time_offset_ms_ + int64_t(elapsed_ms * (1.0 + time_skew_ppm_ * 1e-6)));
+    }
+
+    /**
+     * @brief 时钟同步请求 "<seq>|<t1>" → 应答 "<seq>|<t1>,<t2>,<t3>" 发往 <topic>/reply
+     */
+    void OnTimeRequest(const std::string &topic, const uint8_t *payload, uint32_t len)
+    {
+        uint64_t t2 = BackendMs();
+        std::string req(reinterpret_cast<const char *>(payload), len);
+        size_t bar = req.find('|');
+        if (bar != 4 || req.find_first_not_of("0123456789", bar + 1) != std::string::npos || bar + 1 == req.size()) {
+            return;
+        }
+
+        std::string reply_topic = topic + "/reply";
+        uint8_t pkt[128];
+        std::string body = req + "," + std::to_string(t2) + "," + std::to_string(BackendMs());
+        uint16_t n = MQTT_BuildPublish(pkt, sizeof(pkt), reply_topic.c_str(),
+                                       reinterpret_cast<const uint8_t *>(body.data()), uint16_t(body.size()));
+        if (n == 0) return;
+        time_replies_++;
+        Route(reply_topic, pkt, n);
+    }
+
+    /**
+     * @brief 带时间戳的消息 "@<capture>,<send>|..."：设备排队 = send - capture，网络 = 到达 - send
+     */
+    void OnStamped(const uint8_t *payload, uint32_t len)
+    {
+        uint64_t rx = BackendMs();
+        std::string head(reinterpret_cast<const char *>(payload), std::min<uint32_t>(len, 48));
+        unsigned long long capture = 0, send = 0;
+        if (std::sscanf(head.c_str(), "@%llu,%llu|", &capture, &send) != 2 || send < capture) return;
+        queue_ms_.Record(send - capture);
+        net_ms_.Record(rx > send ? rx - send : 0);
+    }
+
+    uint16_t port_;
+    int64_t time_offset_ms_;
+    double time_skew_ppm_;
+    int64_t start_unix_ms_ = 0;
+    uint64_t start_ns_ = 0;
+    uint64_t time_replies_ = 0;
+    LatencyHistogram queue_ms_;
+    LatencyHistogram net_ms_;
+    int ep_ = -1;
+    std::unordered_map<int, Session> sessions_;
+    std::unordered_map<std::string, std::vector<int>> exact_;
+    std::vector<std::pair<std::string, int>> wildcard_;
+    std::unordered_map<std::string, std::vector<uint8_t>> retained_; /* 主题 → 保留的 PUBLISH 报文 */
+    std::vector<int> dirty_;
+    uint64_t in_count_ = 0;
+    uint64_t out_count_ = 0;
+    uint64_t dropped_ = 0;
+};
+
+/* ==========================================
+ * 设备模拟
+ * ========================================== */
+
+struct ClientOptions {
+    std::string host = "127.0.0.1";
+    uint16_t port = 1883;
+    uint32_t devices = 1000;
+    double rate = 1.0;          /* 每台设备每秒发布条数 */
+    uint32_t payload = 64;      /* 消息字节数 (>= 16) */
+    uint32_t duration = 30;     /* 压测秒数 (不含建连) */
+    uint32_t ramp = 500;        /* 每秒新建连接数 */
+    uint16_t keepalive = 60;
+    std::string topic = "fleet/{id}/tele";
+    std::string subs = "fleet/{id}/tele";
+};
+
+class Fleet {
+public:
+    explicit Fleet(const ClientOptions &opt) : opt_(opt) {}
+
+    int Run()
+    {
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *res = nullptr;
+        if (getaddrinfo(opt_.host.c_str(), std::to_string(opt_.port).c_str(), &hints, &res) != 0 || !res) {
+            std::fprintf(stderr, "cannot resolve %s\n", opt_.host.c_str());
+            return 1;
+        }
+        std::memcpy(&addr_, res->ai_addr, sizeof(addr_));
+        freeaddrinfo(res);
+
+        ep_ = epoll_create1(0);
+        devices_.resize(opt_.devices);
+
+        const uint64_t start = NowNs();
+        const uint64_t ramp_ns = opt_.ramp ? 1000000000ull / opt_.ramp : 0;
+        const uint64_t period_ns = opt_.rate > 0 ? uint64_t(1e9 / opt_.rate) : 0;
+        uint32_t next_connect = 0;
+        uint64_t bench_start = 0;
+        uint64_t bench_end = 0;
+        uint64_t last_report = start;
+        std::vector<epoll_event> events(1024);
+
+        while (!g_stop) {
+            uint64_t now = NowNs();
+
+            /* 1. 按 ramp 速率建立连接 */
+            while (next_connect < opt_.devices && (ramp_ns == 0 || now - start >= next_connect * ramp_ns)) {
+                Connect(next_connect++);
+            }
+
+            /* 2. 全部就绪后开始计时 */
+            if (bench_start == 0 && next_connect == opt_.devices && ready_ + failed_ == opt_.devices) {
+                bench_start = now;
+                bench_end = now + uint64_t(opt_.duration) * 1000000000ull;
+                std::printf("%u devices ready (%u failed) in %.2fs, publishing...\n", ready_, failed_,
+                            double(now - start) / 1e9);
+                for (uint32_t i = 0; i < opt_.devices; i++) {
+                    if (devices_[i].ready && period_ns) {
+                        /* 错开各设备首次发布时间，避免同相突发 */
+                        schedule_.push({now + (period_ns * i) / opt_.devices, i});
+                    }
+                }
+            }
+            if (bench_end && now >= bench_end) break;
+
+            /* 3. 到期的发布 */
+            while (!schedule_.empty() && schedule_.top().first <= now) {
+                auto item = schedule_.top();
+                schedule_.pop();
+                Device &d = devices_[item.second];
+                if (!d.ready) continue;
+                Publish(item.second, now);
+                schedule_.push({item.first + period_ns, item.second});
+            }
+
+            /* 4. 心跳 */
+            if (keepalive_due_ <= now) {
+                static const uint8_t ping[] = {MQTT_PKT_PINGREQ, 0x00};
+                for (Device &d : devices_) {
+                    if (d.ready) d.conn.Queue(ping, sizeof(ping));
+                }
+                keepalive_due_ = now + uint64_t(opt_.keepalive) * 500000000ull;
+                FlushAll();
+            }
+
+            /* 5. 网络事件 */
+            int timeout_ms = 1;
+            int n = epoll_wait(ep_, events.data(), int(events.size()), timeout_ms);
+            for (int i = 0; i < n; i++) {
+                uint32_t id = events[i].data.u32;
+                OnEvent(id, events[i].events);
+            }
+
+            if (now - last_report >= 1000000000ull) {
+                double secs = double(now - last_report) / 1e9;
+                std::printf("ready=%u sent=%.0f/s recv=%.0f/s tx=%.2fMB/s p50=%.3fms p99=%.3fms\n", ready_,
+                            double(sent_ - sent_mark_) / secs, double(recv_ - recv_mark_) / secs,
+                            double(bytes_ - bytes_mark_) / secs / 1e6, double(window_.Percentile(0.50)) / 1e6,
+                            double(window_.Percentile(0.99)) / 1e6);
+                sent_mark_ = sent_;
+                recv_mark_ = recv_;
+                bytes_mark_ = bytes_;
+                window_ = LatencyHistogram();
+                last_report = now;
+            }
+        }
+
+        Report(bench_start ? NowNs() - bench_start : 0);
+        for (Device &d : devices_) {
+            if (d.conn.fd >= 0) close(d.conn.fd);
+        }
+        close(ep_);
+        return 0;
+    }
+
+private:
+    struct Device {
+        Conn conn;
+        bool connecting = false;
+        bool ready = false;
+        uint32_t seq = 0;
+        std::string topic;
+    };
+
+    void Connect(uint32_t id)
+    {
+        Device &d = devices_[id];
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            failed_++;
+            return;
+        }
+        SetNonBlocking(fd);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        d.conn.fd = fd;
+        d.conn.tag = id;
+        d.topic = Expand(opt_.topic, id);
+
+        int ret = connect(fd, reinterpret_cast<sockaddr *>(&addr_), sizeof(addr_));
+        if (ret < 0 && errno != EINPROGRESS) {
+            Fail(id);
+            return;
+        }
+        d.connecting = true;
+
+        /* CONNECT 与 SUBSCRIBE 先入队，TCP 建立后一次写出 */
+        uint8_t pkt[512];
+        std::string client_id = "fleetsim_" + std::to_string(id);
+        uint16_t n = MQTT_BuildConnect(pkt, sizeof(pkt), client_id.c_str(), opt_.keepalive);
+        d.conn.Queue(pkt, n);
+        uint16_t pid = 1;
+        for (const std::string &tmpl : Split(opt_.subs, ',')) {
+            std::string f = Expand(tmpl, id);
+            n = MQTT_BuildSubscribe(pkt, sizeof(pkt), pid++, f.c_str(), 0);
+            if (n) d.conn.Queue(pkt, n);
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.u32 = id;
+        d.conn.want_write = true;
+        epoll_ctl(ep_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    void Fail(uint32_t id)
+    {
+        Device &d = devices_[id];
+        if (d.conn.fd >= 0) {
+            epoll_ctl(ep_, EPOLL_CTL_DEL, d.conn.fd, nullptr);
+            close(d.conn.fd);
+            d.conn.fd = -1;
+        }
+        if (d.ready) ready_--;
+        d.ready = false;
+        d.connecting = false;
+        failed_++;
+    }
+
+    void Publish(uint32_t id, uint64_t now)
+    {
+        Device &d = devices_[id];
+        uint32_t len = std::max<uint32_t>(opt_.payload, 16);
+        payload_.resize(len, 'x');
+        std::memcpy(&payload_[0], &now, 8);
+        std::memcpy(&payload_[8], &id, 4);
+        std::memcpy(&payload_[12], &d.seq, 4);
+        d.seq++;
+
+        pkt_.resize(len + d.topic.size() + 16);
+        uint16_t n = MQTT_BuildPublish(pkt_.data(), uint16_t(pkt_.size()), d.topic.c_str(), payload_.data(),
+                                       uint16_t(len));
+        if (n == 0) return;
+        d.conn.Queue(pkt_.data(), n);
+        sent_++;
+        bytes_ += n;
+        if (!FlushConn(d.conn)) {
+            Fail(id);
+            return;
+        }
+        UpdateEpoll(ep_, d.conn);
+    }
+
+    void FlushAll()
+    {
+        for (uint32_t i = 0; i < devices_.size(); i++) {
+            Device &d = devices_[i];
+            if (!d.ready) continue;
+            if (!FlushConn(d.conn)) {
+                Fail(i);
+            } else {
+                UpdateEpoll(ep_, d.conn);
+            }
+        }
+    }
+
+    void OnEvent(uint32_t id, uint32_t events)
+    {
+        Device &d = devices_[id];
+        if (d.conn.fd < 0) return;
+
+        if (events & (EPOLLHUP | EPOLLERR)) {
+            Fail(id);
+            return;
+        }
+        if (d.connecting && (events & EPOLLOUT)) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(d.conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err != 0) {
+                Fail(id);
+                return;
+            }
+            d.connecting = false;
+        }
+        if ((events & EPOLLOUT) && !FlushConn(d.conn)) {
+            Fail(id);
+            return;
+        }
+        if (events & EPOLLIN) {
+            bool ok = DrainConn(d.conn)
+                   && ForEachPacket(d.conn, [&](const uint8_t *p, uint32_t len) { OnPacket(id, p, len); });
+            if (!ok) {
+                Fail(id);
+                return;
+            }
+        }
+        UpdateEpoll(ep_, d.conn);
+    }
+
+    void OnPacket(uint32_t id, const uint8_t *p, uint32_t len)
+    {
+        Device &d = devices_[id];
+        uint8_t type = p[0] & 0xF0;
+        if (type == MQTT_PKT_CONNACK) {
+            if (len >= 4 && p[3] == 0x00 && !d.ready) {
+                d.ready = true;
+                ready_++;
+            } else if (len >= 4 && p[3] != 0x00) {
+                Fail(id);
+            }
+        } else if (type == MQTT_PKT_PUBLISH) {
+            MQTT_PublishView view;
+            if (!MQTT_ParsePublish(p, len, &view)) return;
+            recv_++;
+            if (view.payload_len >= 16) {
+                uint64_t sent_at;
+                std::memcpy(&sent_at, view.payload, 8);
+                uint64_t lat = NowNs() - sent_at;
+                total_.Record(lat);
+                window_.Record(lat);
+            }
+        }
+    }
+
+    void Report(uint64_t elapsed_ns)
+    {
+        double secs = elapsed_ns ? double(elapsed_ns) / 1e9 : 1.0;
+        std::printf("\n=== fleetsim summary ===\n");
+        std::printf("devices      %u (ready %u, failed %u)\n", opt_.devices, ready_, failed_);
+        std::printf("duration     %.2f s\n", secs);
+        std::printf("published    %" PRIu64 " (%.0f msg/s, %.2f MB/s)\n", sent_, double(sent_) / secs,
+                    double(bytes_) / secs / 1e6);
+        std::printf("received     %" PRIu64 " (%.0f msg/s)\n", recv_, double(recv_) / secs);
+        std::printf("latency p50  %.3f ms\n", double(total_.Percentile(0.50)) / 1e6);
+        std::printf("latency p99  %.3f ms\n", double(total_.Percentile(0.99)) / 1e6);
+        std::printf("latency p999 %.3f ms\n", double(total_.Percentile(0.999)) / 1e6);
+        std::printf("latency max  %.3f ms\n", double(total_.Max()) / 1e6);
+    }
+
+    ClientOptions opt_;
+    sockaddr_in addr_{};
+    int ep_ = -1;
+    std::vector<Device> devices_;
+    std::priority_queue<std::pair<uint64_t, uint32_t>, std::vector<std::pair<uint64_t, uint32_t>>,
+                        std::greater<std::pair<uint64_t, uint32_t>>>
+        schedule_;
+    std::vector<uint8_t> payload_;
+    std::vector<uint8_t> pkt_;
+    uint64_t keepalive_due_ = 0;
+    uint32_t ready_ = 0;
+    uint32_t failed_ = 0;
+    uint64_t sent_ = 0, recv_ = 0, bytes_ = 0;
+    uint64_t sent_mark_ = 0, recv_mark_ = 0, bytes_mark_ = 0;
+    LatencyHistogram total_;
+    LatencyHistogram window_;
+};
+
+void Usage()
+{
+    std::fprintf(stderr,
+                 "usage:\n"
+                 "  fleetsim broker [--port N] [--time-offset-ms N] [--time-skew-ppm N]\n"
+                 "  fleetsim client [--host H] [--port N] [--devices N] [--rate R] [--payload B]\n"
+                 "                  [--duration S] [--ramp N] [--keepalive S] [--topic T] [--subs F1,F2]\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        Usage();
+        return 2;
+    }
+
+    std::map<std::string, std::string> args;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (std::strncmp(argv[i], "--", 2) != 0) {
+            Usage();
+            return 2;
+        }
+        args[argv[i] + 2] = argv[i + 1];
+    }
+    auto get = [&](const char *key, const std::string &def) {
+        auto it = args.find(key);
+        return it == args.end() ? def : it->second;
+    };
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    std::string mode = argv[1];
+    if (mode == "broker") {
+        StandInBroker broker(uint16_t(std::stoi(get("port", "1883"))), std::stoll(get("time-offset-ms", "0")),
+                             std::stod(get("time-skew-ppm", "0")));
+        return broker.Run();
+    }
+    if (mode == "client") {
+        ClientOptions opt;
+        opt.host = get("host", opt.host);
+        opt.port = uint16_t(std::stoi(get("port", std::to_string(opt.port))));
+        opt.devices = uint32_t(std::stoul(get("devices", std::to_string(opt.devices))));
+        opt.rate = std::stod(get("rate", std::to_string(opt.rate)));
+        opt.payload = uint32_t(std::stoul(get("payload", std::to_string(opt.payload))));
+        opt.duration = uint32_t(std::stoul(get("duration", std::to_string(opt.duration))));
+        opt.ramp = uint32_t(std::stoul(get("ramp", std::to_string(opt.ramp))));
+        opt.keepalive = uint16_t(std::stoul(get("keepalive", std::to_string(opt.keepalive))));
+        opt.topic = get("topic", opt.topic);
+        opt.subs = get("subs", opt.subs);
+        Fleet fleet(opt);
+        return fleet.Run();
+    }
+    Usage();
+    return 2;
+}
@@ -0,0 +1,278 @@
+/**
+  * @file    lzsim.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   压缩发布 (mqtt_lz.c) 回环测试：压缩率与模拟 AT 链路上的净吞吐
+  *
+  * 用法:
+  *   lzsim [--host 127.0.0.1] [--port 1883] [--data json|log|config|random|all]
+  *         [--file 路径] [--size 65536] [--baud 115200] [--cpu-scale 40]
+  *
+  * 协议引擎订阅自身的二进制主题，同一段数据先以普通消息 (每条 MQTT_LZ_CHUNK
+  * 字节)、再以 MQTT_Lz_Write 压缩发布，经 Broker 回环后由 MQTT_Lz_Receive 解压
+  * 并逐字节比对。链路时间按 AT 后端在 --baud 串口上的实际收发量计算：
+  * "AT+CIPSEND=<n>\r\n"、PUBLISH 报文、"OK >" 与 "Recv <n> bytes ... SEND OK"。
+  * 压缩耗时取两种模式的主机 CPU 时间差，乘以 --cpu-scale 估算 MCU 上的耗时
+  * (Cortex-M4 @ 72~168 MHz 约为桌面 CPU 的 20~60 倍)。需配合 `fleetsim broker`。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_lz.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    uint32_t messages;
+    uint32_t payload_bytes; /* 消息内容 */
+    uint32_t uart_bytes;    /* AT 串口上的收发总量 */
+    double cpu_s;
+} LinkStats;
+
+static const uint8_t *expect;
+static uint32_t expect_len;
+static uint32_t received = 0;
+static bool mismatch = false;
+static bool segment_done = false;
+static LinkStats rx_stats;
+static MQTT_LzDecoder decoder;
+static bool compressed = false;
+static uint32_t baud = 115200;
+static const char *topic;
+
+/* ==========================================
+ * 测试数据
+ * ========================================== */
+
+static uint32_t seed = 12345;
+
+static uint32_t Rand(void)
+{
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 16;
+}
+
+static uint32_t Generate(const char *kind, uint8_t *buf, uint32_t size)
+{
+    static const char *levels = "IIIIWE";
+    static const char *modules[] = {"conn", "ota", "shadow", "rpc", "app"};
+    static const char *states[] = {"ok", "ok", "ok", "idle", "alarm"};
+    uint32_t n = 0;
+    char line[160];
+
+    seed = 12345;
+    while (n < size) {
+        int len;
+        uint32_t r = Rand();
+        if (strcmp(kind, "json") == 0) {
+            len = snprintf(line, sizeof(line),
+                           "{\"ts\":%lu,\"dev\":\"xrak-%02u\",\"temp\":%u.%u,\"humi\":%u,\"rssi\":-%u,\"state\":\"%s\"}\n",
+                           1760000000ul + n / 64, r % 16, 18 + r % 10, r % 10, 40 + r % 20, 50 + r % 30, states[r % 5]);
+        } else if (strcmp(kind, "log") == 0) {
+            len = snprintf(line, sizeof(line), "[%8lu.%03u] %c %s: %s %u\r\n", (unsigned long)(n / 40), r % 1000,
+                           levels[r % 6], modules[r % 5],
+                           (r & 1) ? "发布: sensor/temp ->" : "[CMD] AT+CIPSEND=", 20 + r % 200);
+        } else if (strcmp(kind, "config") == 0) {
+            len = snprintf(line, sizeof(line), "node.%u.%s=%u\nnode.%u.enabled=%s\n", r % 64, modules[r % 5],
+                           r % 5000, r % 64, (r & 2) ? "true" : "false");
+        } else {
+            len = snprintf(line, sizeof(line), "%08x%08x", Rand() * 2654435761u, Rand() * 2246822519u);
+            for (int i = 0; i < len; i++) line[i] = (char)(Rand() >> 3);
+        }
+        for (int i = 0; i < len && n < size; i++) {
+            buf[n++] = (uint8_t)line[i];
+        }
+    }
+    return n;
+}
+
+/* ==========================================
+ * 接收与链路计量
+ * ========================================== */
+
+/**
+ * @brief AT 后端发送一条 PUBLISH 在串口上的收发字节数
+ */
+static uint32_t UartCost(uint32_t payload_len)
+{
+    uint32_t remaining = 2 + (uint32_t)strlen(topic) + payload_len;
+    uint32_t packet = 1 + (remaining < 128 ? 1 : remaining < 16384 ? 2 : 3) + remaining;
+    char text[64];
+    int cmd = snprintf(text, sizeof(text), "AT+CIPSEND=%lu\r\n", (unsigned long)packet);
+    int recv = snprintf(text, sizeof(text), "\r\nRecv %lu bytes\r\n\r\nSEND OK\r\n", (unsigned long)packet);
+    return (uint32_t)cmd + packet + 8 /* "\r\nOK\r\n> " */ + (uint32_t)recv;
+}
+
+static void OnData(const uint8_t *data, uint32_t len, uint8_t flags)
+{
+    if (received + len > expect_len || memcmp(&expect[received], data, len) != 0) {
+        mismatch = true;
+    }
+    received += len;
+    if (flags & MQTT_LZ_LAST) segment_done = true;
+}
+
+static void OnMessage(const uint8_t *payload, uint32_t len)
+{
+    rx_stats.messages++;
+    rx_stats.payload_bytes += len;
+    rx_stats.uart_bytes += UartCost(len);
+    if (!compressed) {
+        /* 普通消息可能以 0xA0~0xAF 开头 (随机数据、切断的 UTF-8)，不经解压判定 */
+        OnData(payload, len, MQTT_LZ_FIRST | MQTT_LZ_LAST);
+    } else if (!MQTT_Lz_Receive(&decoder, payload, len, OnData)) {
+        mismatch = true;
+    }
+}
+
+/* ==========================================
+ * 测试流程
+ * ========================================== */
+
+static bool WaitAll(void)
+{
+    uint32_t deadline = HAL_GetTick() + 5000;
+    while (received < expect_len && HAL_GetTick() < deadline) {
+        MQTT_Service();
+    }
+    return received == expect_len && !mismatch;
+}
+
+static bool RunOnce(MQTT_TopicId id, const uint8_t *data, uint32_t len, bool compress, LinkStats *out)
+{
+    static MQTT_LzEncoder enc;
+    clock_t cpu = clock();
+
+    expect = data;
+    expect_len = len;
+    received = 0;
+    mismatch = false;
+    segment_done = false;
+    compressed = compress;
+    memset(&rx_stats, 0, sizeof(rx_stats));
+
+    if (compress) {
+        /* 模拟分批产生的数据：每次写入 100 字节 */
+        MQTT_Lz_Begin(&enc, id);
+        for (uint32_t off = 0; off < len; off += 100) {
+            if (!MQTT_Lz_Write(&enc, &data[off], len - off < 100 ? len - off : 100)) return false;
+            MQTT_Service();
+        }
+        if (!MQTT_Lz_End(&enc)) return false;
+    } else {
+        for (uint32_t off = 0; off < len; off += MQTT_LZ_CHUNK) {
+            uint16_t n = (uint16_t)(len - off < MQTT_LZ_CHUNK ? len - off : MQTT_LZ_CHUNK);
+            if (!MQTT_PublishById(id, &data[off], n)) return false;
+            MQTT_Service();
+        }
+    }
+    bool ok = WaitAll() && (!compress || segment_done);
+    *out = rx_stats;
+    out->cpu_s = (double)(clock() - cpu) / CLOCKS_PER_SEC;
+    return ok;
+}
+
+static bool Report(const char *name, MQTT_TopicId id, const uint8_t *data, uint32_t len, double cpu_scale)
+{
+    LinkStats raw, lz;
+    if (!RunOnce(id, data, len, false, &raw)) {
+        fprintf(stderr, "%s: 普通消息回环失败\n", name);
+        return false;
+    }
+    if (!RunOnce(id, data, len, true, &lz)) {
+        fprintf(stderr, "%s: 压缩消息回环失败 (已收 %lu/%lu，%s)\n", name, (unsigned long)received,
+                (unsigned long)len, mismatch ? "内容不一致" : "超时");
+        return false;
+    }
+
+    double mcu_s = (lz.cpu_s > raw.cpu_s ? lz.cpu_s - raw.cpu_s : 0.0) * cpu_scale;
+    double raw_s = raw.uart_bytes * 10.0 / baud;
+    double lz_s = lz.uart_bytes * 10.0 / baud + mcu_s;
+    printf("%-8s %8lu %8lu %7.1f%% %6lu/%-6lu %9.2f %9.2f %7.2fx\n", name, (unsigned long)len,
+           (unsigned long)lz.payload_bytes, 100.0 * lz.payload_bytes / len, (unsigned long)raw.messages,
+           (unsigned long)lz.messages, len / 1024.0 / raw_s, len / 1024.0 / lz_s, raw_s / lz_s);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    uint16_t port = 1883;
+    const char *kind = "all";
+    const char *file = NULL;
+    uint32_t size = 65536;
+    double cpu_scale = 40.0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--host") == 0) host = argv[i + 1];
+        else if (strcmp(argv[i], "--port") == 0) port = (uint16_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--data") == 0) kind = argv[i + 1];
+        else if (strcmp(argv[i], "--file") == 0) file = argv[i + 1];
+        else if (strcmp(argv[i], "--size") == 0) size = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--baud") == 0) baud = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--cpu-scale") == 0) cpu_scale = atof(argv[i + 1]);
+        else {
+            fprintf(stderr, "未知参数: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (size == 0 || baud == 0) {
+        fprintf(stderr, "--size 与 --baud 须大于 0\n");
+        return 1;
+    }
+
+    static MQTT_SocketCtx sock_ctx;
+    static MQTT_Transport sock;
+    static char topic_buf[48];
+    snprintf(topic_buf, sizeof(topic_buf), "lzsim/%d/blob", (int)getpid());
+    topic = topic_buf;
+    MQTT_SocketTransportInit(&sock, &sock_ctx, host, port);
+    MQTT_SetTransport(&sock);
+    MQTT_TopicId id = MQTT_RegisterTopic(topic);
+    if (!MQTT_Start() || id == MQTT_TOPIC_INVALID || !MQTT_SubscribeStream(topic, 0, OnMessage)) {
+        fprintf(stderr, "连接 %s:%u 失败\n", host, port);
+        return 1;
+    }
+    for (int i = 0; i < 4; i++) {
+        MQTT_Service();
+        HAL_Delay(20);
+    }
+
+    printf("窗口 %u 字节，最长匹配 %u 字节，每条消息 %u 字节，串口 %lu bps，MCU 耗时 = 主机 x %.0f\n",
+           (unsigned)MQTT_LZ_WINDOW, (unsigned)MQTT_LZ_MAX_MATCH, (unsigned)MQTT_LZ_CHUNK,
+           (unsigned long)baud, cpu_scale);
+    printf("%-8s %8s %8s %8s %13s %9s %9s %8s\n", "数据", "原始", "压缩后", "比例", "消息数", "KB/s",
+           "压缩KB/s", "提升");
+
+    bool ok = true;
+    uint8_t *buf;
+    if (file != NULL) {
+        FILE *f = fopen(file, "rb");
+        if (f == NULL) {
+            fprintf(stderr, "无法打开 %s\n", file);
+            return 1;
+        }
+        buf = malloc(size);
+        uint32_t len = (uint32_t)fread(buf, 1, size, f);
+        fclose(f);
+        ok = Report("file", id, buf, len, cpu_scale);
+    } else {
+        static const char *kinds[] = {"json", "log", "config", "random"};
+        buf = malloc(size);
+        for (int i = 0; i < 4; i++) {
+            if (strcmp(kind, "all") != 0 && strcmp(kind, kinds[i]) != 0) continue;
+            uint32_t len = Generate(kinds[i], buf, size);
+            ok = Report(kinds[i], id, buf, len, cpu_scale) && ok;
+        }
+    }
+    printf("解压状态: 缺块 %lu，格式错误 %lu\n", (unsigned long)decoder.gaps, (unsigned long)decoder.errors);
+    free(buf);
+    return ok ? 0 : 1;
+}
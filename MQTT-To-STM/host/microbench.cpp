@@ -0,0 +1,363 @@
+/**
+  * @file    microbench.cpp
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   编解码与匹配原语的微基准 (Google Benchmark)
+  *
+  * 用法:
+  *   microbench [--benchmark_filter=<正则>] [--benchmark_format=json]
+  *              [--benchmark_out=result.json --benchmark_out_format=json]
+  *
+  * 覆盖固件热路径上的原语，供优化前后对比 (JSON 输出可直接存档比较):
+  *   EncodeLen / EncodeString / BuildPublish / ParsePublish   mqtt_codec.c，内容 0~2 KB
+  *   TopicMatch                                               10/100/1000 条过滤器
+  *   Telemetry{Pack,Unpack} / Telemetry{Json,JsonParse}        schemac.py 生成的二进制编解码
+  *                对比 snprintf/sscanf 文本 JSON，计数器 payload_bytes 为消息长度
+  *   AtIpd        AT 后端 "+IPD,<n>:" 截取 + MQTT_Process 解码 (录制的模块输出)
+  *   AtHeartbeat  ESP_Execute 扫描 AT+CIPSEND 应答 (">"、"Recv"、"SEND OK")
+  *
+  * AT 用例以 HAL_PortUartFeed 注入模块输出，先回放一段启动记录完成 MQTT_Start。
+  * +IPD 单包受 ESP_RX_BUFFER_SIZE / RX_BUFFER_SIZE 限制，内容最大取 480 字节。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+extern "C" {
+#include "conn.h"
+#include "usart.h"
+}
+#include "telemetry_msg.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+void Feed(const std::string &s)
+{
+    HAL_PortUartFeed(reinterpret_cast<const uint8_t *>(s.data()), static_cast<uint32_t>(s.size()));
+}
+
+std::string Payload(size_t len)
+{
+    std::string s(len, '\0');
+    for (size_t i = 0; i < len; i++) {
+        s[i] = static_cast<char>('a' + i % 26);
+    }
+    return s;
+}
+
+/* ==========================================
+ * mqtt_codec.c
+ * ========================================== */
+
+void BM_EncodeLen(benchmark::State &state)
+{
+    /* 覆盖 1~4 字节的全部编码长度 */
+    static const uint32_t values[] = {0, 100, 127, 128, 1000, 16383, 16384, 200000, 2097152, 268435455};
+    uint8_t buf[4];
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mqtt_encode_len(buf, values[i]));
+        benchmark::ClobberMemory();
+        i = (i + 1) % (sizeof(values) / sizeof(values[0]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EncodeLen);
+
+void BM_EncodeString(benchmark::State &state)
+{
+    std::string str = Payload(static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t> buf(str.size() + 2);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mqtt_encode_string(buf.data(), str.c_str()));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(str.size() + 2));
+}
+BENCHMARK(BM_EncodeString)->Arg(0)->Arg(16)->Arg(64)->Arg(256)->Arg(1024)->Arg(2048);
+
+void BM_BuildPublish(benchmark::State &state)
+{
+    std::string payload = Payload(static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t> buf(payload.size() + 64);
+    uint16_t len = 0;
+    for (auto _ : state) {
+        len = MQTT_BuildPublish(buf.data(), static_cast<uint16_t>(buf.size()), "site/3/dev/42/temp",
+                                reinterpret_cast<const uint8_t *>(payload.data()),
+                                static_cast<uint16_t>(payload.size()));
+        benchmark::DoNotOptimize(len);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK(BM_BuildPublish)->Arg(0)->Arg(16)->Arg(128)->Arg(512)->Arg(2048);
+
+/**
+ * @brief 字节流定界 + PUBLISH 解析 (MQTT_DecodeNext 的无状态部分)
+ */
+void BM_ParsePublish(benchmark::State &state)
+{
+    std::string payload = Payload(static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t> pkt(payload.size() + 64);
+    uint16_t len = MQTT_BuildPublish(pkt.data(), static_cast<uint16_t>(pkt.size()), "site/3/dev/42/temp",
+                                     reinterpret_cast<const uint8_t *>(payload.data()),
+                                     static_cast<uint16_t>(payload.size()));
+    for (auto _ : state) {
+        uint32_t total = 0;
+        MQTT_PublishView view;
+        if (MQTT_PacketLength(pkt.data(), len, &total) != 1 || !MQTT_ParsePublish(pkt.data(), total, &view)) {
+            state.SkipWithError("解析失败");
+            break;
+        }
+        benchmark::DoNotOptimize(view);
+    }
+    state.SetBytesProcessed(state.iterations() * len);
+}
+BENCHMARK(BM_ParsePublish)->Arg(0)->Arg(16)->Arg(128)->Arg(512)->Arg(2048);
+
+/**
+ * @brief 一条主题依次与整组过滤器比较 (Broker 转发 / 多订阅分发的形态)
+ * @details 过滤器混合精确匹配、'+' 与 '#'，主题轮换使命中位置分散
+ */
+void BM_TopicMatch(benchmark::State &state)
+{
+    const int count = static_cast<int>(state.range(0));
+    std::vector<std::string> filters;
+    for (int i = 0; i < count; i++) {
+        char f[MQTT_TOPIC_SIZE];
+        switch (i % 4) {
+        case 0: snprintf(f, sizeof(f), "site/%d/dev/%d/temp", i % 16, i); break;
+        case 1: snprintf(f, sizeof(f), "site/%d/dev/+/humi", i % 16); break;
+        case 2: snprintf(f, sizeof(f), "site/%d/cmd/%d/#", i % 16, i); break;
+        default: snprintf(f, sizeof(f), "fleet/+/ota/%d/status", i); break;
+        }
+        filters.push_back(f);
+    }
+    std::vector<std::string> topics;
+    for (int i = 0; i < 64; i++) {
+        char t[MQTT_TOPIC_SIZE];
+        switch (i % 4) {
+        case 0: snprintf(t, sizeof(t), "site/%d/dev/%d/temp", i % 16, i * 7 % count); break;
+        case 1: snprintf(t, sizeof(t), "site/%d/dev/%d/humi", i % 16, i); break;
+        case 2: snprintf(t, sizeof(t), "site/%d/cmd/%d/reboot/now", i % 16, i * 5 % count); break;
+        default: snprintf(t, sizeof(t), "fleet/node%d/ota/%d/status", i, i * 3 % count); break;
+        }
+        topics.push_back(t);
+    }
+
+    size_t k = 0;
+    int64_t matched = 0;
+    for (auto _ : state) {
+        const char *topic = topics[k].c_str();
+        for (const std::string &f : filters) {
+            matched += MQTT_TopicMatched(f.c_str(), topic);
+        }
+        k = (k + 1) % topics.size();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.counters["hits_per_topic"] =
+        benchmark::Counter(static_cast<double>(matched) / static_cast<double>(state.iterations()));
+}
+BENCHMARK(BM_TopicMatch)->Arg(10)->Arg(100)->Arg(1000);
+
+/* ==========================================
+ * 消息编码：schemac.py 生成代码 vs 文本 JSON
+ * ========================================== */
+
+Telemetry SampleTelemetry(uint32_t i)
+{
+    Telemetry t = {};
+    t.tick = 1234567u + i * 1000u;
+    t.temp_c10 = -35 + static_cast<int32_t>(i % 400);
+    t.humi = 40 + i % 20;
+    t.voltage = 3.3f - static_cast<float>(i % 10) * 0.01f;
+    t.online = true;
+    snprintf(t.fw, sizeof(t.fw), "1.4.2");
+    return t;
+}
+
+/* 固件中常见的文本写法 */
+int TelemetryJson(const Telemetry &t, char *buf, size_t size)
+{
+    return snprintf(buf, size, "{\"tick\":%lu,\"temp\":%ld.%ld,\"humi\":%lu,\"voltage\":%.2f,\"online\":%s,\"fw\":\"%s\"}",
+                    static_cast<unsigned long>(t.tick), static_cast<long>(t.temp_c10 / 10),
+                    static_cast<long>(t.temp_c10 < 0 ? -t.temp_c10 % 10 : t.temp_c10 % 10),
+                    static_cast<unsigned long>(t.humi), static_cast<double>(t.voltage), t.online ? "true" : "false", t.fw);
+}
+
+void BM_TelemetryPack(benchmark::State &state)
+{
+    uint8_t buf[Telemetry_MAX_SIZE];
+    uint16_t len = 0;
+    uint32_t i = 0;
+    for (auto _ : state) {
+        Telemetry t = SampleTelemetry(i++ & 1023);
+        Telemetry_Pack(&t, buf, sizeof(buf), &len);
+        benchmark::DoNotOptimize(buf);
+    }
+    state.counters["payload_bytes"] = len;
+}
+BENCHMARK(BM_TelemetryPack);
+
+void BM_TelemetryJson(benchmark::State &state)
+{
+    char buf[160];
+    int len = 0;
+    uint32_t i = 0;
+    for (auto _ : state) {
+        Telemetry t = SampleTelemetry(i++ & 1023);
+        len = TelemetryJson(t, buf, sizeof(buf));
+        benchmark::DoNotOptimize(buf);
+    }
+    state.counters["payload_bytes"] = len;
+}
+BENCHMARK(BM_TelemetryJson);
+
+void BM_TelemetryUnpack(benchmark::State &state)
+{
+    Telemetry src = SampleTelemetry(7);
+    uint8_t buf[Telemetry_MAX_SIZE];
+    uint16_t len;
+    Telemetry_Pack(&src, buf, sizeof(buf), &len);
+    for (auto _ : state) {
+        Telemetry t;
+        if (!Telemetry_Unpack(&t, buf, len)) {
+            state.SkipWithError("解码失败");
+            break;
+        }
+        benchmark::DoNotOptimize(t);
+    }
+    state.counters["payload_bytes"] = len;
+}
+BENCHMARK(BM_TelemetryUnpack);
+
+void BM_TelemetryJsonParse(benchmark::State &state)
+{
+    char buf[160];
+    int len = TelemetryJson(SampleTelemetry(7), buf, sizeof(buf));
+    for (auto _ : state) {
+        Telemetry t = {};
+        unsigned long tick, humi;
+        float temp;
+        char online[8];
+        if (sscanf(buf, "{\"tick\":%lu,\"temp\":%f,\"humi\":%lu,\"voltage\":%f,\"online\":%7[a-z],\"fw\":\"%15[^\"]\"}",
+                   &tick, &temp, &humi, &t.voltage, online, t.fw) != 6) {
+            state.SkipWithError("解析失败");
+            break;
+        }
+        t.tick = static_cast<uint32_t>(tick);
+        t.temp_c10 = static_cast<int32_t>(temp * 10.0f);
+        t.humi = static_cast<uint32_t>(humi);
+        t.online = online[0] == 't';
+        benchmark::DoNotOptimize(t);
+    }
+    state.counters["payload_bytes"] = len;
+}
+BENCHMARK(BM_TelemetryJsonParse);
+
+/* ==========================================
+ * conn.c AT 后端 (回放模块输出)
+ * ========================================== */
+
+/**
+ * @brief 回放启动记录，经 AT 后端完成 MQTT_Start
+ * @details 顺序对应 ESP_Open：AT、CWMODE、CWJAP? (已连接)、CIPRECVMODE
+ *          (返回 ERROR，按旧固件走主动推送以产生 +IPD)、CIPDOMAIN、CIPSTART、
+ *          CONNECT 报文的 CIPSEND
+ */
+bool StartAt()
+{
+    Feed("AT\r\r\n\r\nOK\r\n");
+    Feed("AT+CWMODE=1\r\r\n\r\nOK\r\n");
+    Feed("AT+CWJAP?\r\r\n+CWJAP:\"bench\",\"aa:bb:cc:dd:ee:ff\",6,-52,0,0,0\r\n\r\nOK\r\n");
+    Feed("AT+CIPRECVMODE=1\r\r\n\r\nERROR\r\n");
+    Feed("AT+CIPDOMAIN=\"\"\r\r\n+CIPDOMAIN:\"192.168.1.10\"\r\n\r\nOK\r\n");
+    Feed("AT+CIPSTART=\"TCP\",\"192.168.1.10\",1883\r\r\nCONNECT\r\n\r\nOK\r\n");
+    Feed("\r\nOK\r\n> ");
+    Feed("\r\nRecv 18 bytes\r\n\r\nSEND OK\r\n");
+    Feed("\r\n+IPD,4:");
+    Feed(std::string("\x20\x02\x00\x00", 4)); /* CONNACK */
+    return MQTT_Start();
+}
+
+/**
+ * @brief 模块推送 "+IPD,<n>:<PUBLISH>"，MQTT_Process 截取、定界并解码
+ */
+void BM_AtIpd(benchmark::State &state)
+{
+    static char topic[MQTT_TOPIC_SIZE];
+    static char payload[ESP_RX_BUFFER_SIZE];
+    std::string content = Payload(static_cast<size_t>(state.range(0)));
+    uint8_t pkt[RX_BUFFER_SIZE];
+    uint16_t len = MQTT_BuildPublish(pkt, sizeof(pkt), "site/3/dev/42/temp",
+                                     reinterpret_cast<const uint8_t *>(content.data()),
+                                     static_cast<uint16_t>(content.size()));
+    std::string frame = "\r\n+IPD," + std::to_string(len) + ":" + std::string(reinterpret_cast<char *>(pkt), len);
+
+    while (MQTT_Process(topic, sizeof(topic), payload, sizeof(payload))) {
+        /* 清空上一个用例残留的数据 */
+    }
+    for (auto _ : state) {
+        Feed(frame);
+        if (!MQTT_Process(topic, sizeof(topic), payload, sizeof(payload))) {
+            state.SkipWithError(MQTT_IsConnected() ? "未解出消息" : "链路断开");
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(frame.size()));
+}
+BENCHMARK(BM_AtIpd)->Arg(0)->Arg(16)->Arg(128)->Arg(480);
+
+/**
+ * @brief 一次 PINGREQ 的 AT 交互：匹配器逐字节扫描两段应答
+ * @details range(0) 为 1 时应答后跟随 PINGRESP 的 +IPD，并由 MQTT_Process 取走
+ */
+void BM_AtHeartbeat(benchmark::State &state)
+{
+    static char topic[MQTT_TOPIC_SIZE];
+    static char payload[MQTT_PAYLOAD_SIZE];
+    std::string trace = "\r\nOK\r\n> \r\nRecv 2 bytes\r\n\r\nSEND OK\r\n";
+    const bool with_resp = state.range(0) != 0;
+    if (with_resp) {
+        trace += std::string("\r\n+IPD,2:\xD0\x00", 11);
+    }
+
+    for (auto _ : state) {
+        Feed(trace);
+        MQTT_Heartbeat();
+        if (with_resp) {
+            MQTT_Process(topic, sizeof(topic), payload, sizeof(payload));
+        }
+        if (!MQTT_IsConnected()) {
+            state.SkipWithError("AT+CIPSEND 失败");
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(trace.size()));
+}
+BENCHMARK(BM_AtHeartbeat)->ArgName("pingresp")->Arg(0)->Arg(1);
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    if (!StartAt()) {
+        fprintf(stderr, "AT 启动记录回放失败 (MQTT_LOG=1 查看引擎日志)\n");
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,381 @@
+/**
+  * @file    otasim.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   固件升级 (mqtt_ota.c) 端到端模拟：内存模拟 Flash + 进程内升级后端
+  *
+  * 用法:
+  *   otasim [--host 127.0.0.1] [--port 1883] [--size 200000] [--chunk 256]
+  *          [--prog-us 300] [--drop 0] [--restart 0]
+  *
+  * 设备侧运行协议引擎 (conn.c + mqtt_ota.c)，Flash 操作由内存数组模拟：
+  * 检查块对齐、写前已擦除、编程期间不得再次写入，每块编程耗时 --prog-us 微秒。
+  * 后端侧是同一进程内的另一条 MQTT 连接：发布 begin，收到 ready 后连续发布
+  * 全部分块 (QoS 1，不等待逐块应答)，收到 verified 后发布 commit。
+  *   --drop N     丢弃第 N 个分块 (不发送)，验证缺口检测与 resume 续传
+  *   --restart N  发送 N 字节后后端断开重连并重新发布 begin，验证 ready 续传
+  * 切换时比对模拟 Flash 与原始镜像，输出传输耗时与吞吐。需配合 `fleetsim broker`。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_ota.h"
+#include "mqtt_codec.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ==========================================
+ * 模拟 Flash
+ * ========================================== */
+static uint8_t flash[MQTT_OTA_MAX_SIZE];
+static uint64_t flash_busy_until = 0;
+static uint32_t prog_us = 300;
+static uint32_t flash_errors = 0;
+static uint32_t flash_writes = 0;
+static bool swapped = false;
+
+static uint64_t NowUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+bool MQTT_OTA_FlashErase(uint32_t offset, uint32_t len)
+{
+    if (offset + len > sizeof(flash)) return false;
+    memset(&flash[offset], 0xFF, len + (MQTT_OTA_BLOCK - len % MQTT_OTA_BLOCK) % MQTT_OTA_BLOCK);
+    return true;
+}
+
+bool MQTT_OTA_FlashWrite(uint32_t offset, const uint8_t *data, uint32_t len)
+{
+    if (NowUs() < flash_busy_until || offset % MQTT_OTA_BLOCK != 0 || offset + len > sizeof(flash)) {
+        flash_errors++;
+        return false;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        if (flash[offset + i] != 0xFF) {
+            flash_errors++; /* 未擦除 */
+            return false;
+        }
+    }
+    memcpy(&flash[offset], data, len); /* 真实硬件在编程结束前读取 data，这里一次复制 */
+    flash_busy_until = NowUs() + prog_us;
+    flash_writes++;
+    return true;
+}
+
+bool MQTT_OTA_FlashBusy(void)
+{
+    return NowUs() < flash_busy_until;
+}
+
+bool MQTT_OTA_FlashRead(uint32_t offset, uint8_t *buf, uint32_t len)
+{
+    if (offset + len > sizeof(flash)) return false;
+    memcpy(buf, &flash[offset], len);
+    return true;
+}
+
+void MQTT_OTA_FlashSwap(void)
+{
+    swapped = true;
+}
+
+/* ==========================================
+ * 升级后端 (非阻塞原生套接字)
+ * ========================================== */
+typedef struct {
+    int fd;
+    uint8_t out[1 << 16];
+    uint32_t out_len;
+    uint8_t in[4096];
+    uint32_t in_len;
+    uint16_t packet_id;
+} Backend;
+
+static Backend backend;
+static char topic_begin[64], topic_chunk[64], topic_commit[64], topic_status[64];
+static char last_status[64];
+static bool status_changed = false;
+
+static bool Backend_Connect(const char *host, uint16_t port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return false;
+
+    backend.fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (backend.fd < 0 || connect(backend.fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) return false;
+    int one = 1;
+    setsockopt(backend.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    backend.out_len = 0;
+    backend.in_len = 0;
+
+    uint8_t pkt[128];
+    char id[32];
+    snprintf(id, sizeof(id), "otasim-backend-%d", (int)getpid());
+    uint16_t n = MQTT_BuildConnect(pkt, sizeof(pkt), id, 60);
+    memcpy(backend.out, pkt, n);
+    backend.out_len = n;
+    n = MQTT_BuildSubscribe(pkt, sizeof(pkt), 1, topic_status, 0);
+    memcpy(&backend.out[backend.out_len], pkt, n);
+    backend.out_len += n;
+    return true;
+}
+
+static void Backend_Flush(void)
+{
+    while (backend.out_len > 0) {
+        ssize_t n = send(backend.fd, backend.out, backend.out_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n <= 0) return;
+        memmove(backend.out, backend.out + n, backend.out_len - (uint32_t)n);
+        backend.out_len -= (uint32_t)n;
+    }
+}
+
+/**
+ * @brief 排队一条 PUBLISH
+ * @return false 发送缓冲已满 (调用方稍后重试)
+ */
+static bool Backend_Publish(const char *topic, const uint8_t *payload, uint32_t len, uint8_t qos)
+{
+    uint16_t topic_len = (uint16_t)strlen(topic);
+    uint32_t body = 2 + topic_len + (qos ? 2 : 0) + len;
+    if (backend.out_len + 5 + body > sizeof(backend.out)) {
+        Backend_Flush();
+        if (backend.out_len + 5 + body > sizeof(backend.out)) return false;
+    }
+
+    uint8_t *p = &backend.out[backend.out_len];
+    uint32_t n = MQTT_BuildFixedHeader(p, (uint8_t)(MQTT_PKT_PUBLISH | (qos << 1)), body);
+    p[n++] = (uint8_t)(topic_len >> 8);
+    p[n++] = (uint8_t)(topic_len & 0xFF);
+    memcpy(&p[n], topic, topic_len);
+    n += topic_len;
+    if (qos) {
+        if (++backend.packet_id == 0) backend.packet_id = 1;
+        p[n++] = (uint8_t)(backend.packet_id >> 8);
+        p[n++] = (uint8_t)(backend.packet_id & 0xFF);
+    }
+    memcpy(&p[n], payload, len);
+    backend.out_len += n + len;
+    return true;
+}
+
+/**
+ * @brief 收取并解析状态消息 (PUBACK/SUBACK 等直接丢弃)
+ */
+static void Backend_Poll(void)
+{
+    Backend_Flush();
+
+    ssize_t n = recv(backend.fd, backend.in + backend.in_len, sizeof(backend.in) - backend.in_len, MSG_DONTWAIT);
+    if (n > 0) backend.in_len += (uint32_t)n;
+
+    uint32_t total;
+    while (backend.in_len > 0 && MQTT_PacketLength(backend.in, backend.in_len, &total) == 1) {
+        MQTT_PublishView view;
+        if (MQTT_ParsePublish(backend.in, total, &view) && view.topic_len == strlen(topic_status) &&
+            memcmp(view.topic, topic_status, view.topic_len) == 0 && view.payload_len < sizeof(last_status)) {
+            memcpy(last_status, view.payload, view.payload_len);
+            last_status[view.payload_len] = '\0';
+            status_changed = true;
+        }
+        memmove(backend.in, backend.in + total, backend.in_len - total);
+        backend.in_len -= total;
+    }
+}
+
+/* ==========================================
+ * 主流程
+ * ========================================== */
+
+static void ToHex(const uint8_t *in, uint16_t len, char *out)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        sprintf(&out[2 * i], "%02x", in[i]);
+    }
+}
+
+static void Service(void)
+{
+    MQTT_Service();
+    MQTT_OTA_Service();
+    Backend_Poll();
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    uint16_t port = 1883;
+    uint32_t size = 200000;
+    uint32_t chunk = 256;
+    uint32_t drop = 0;
+    uint32_t restart = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--host") == 0) host = argv[i + 1];
+        else if (strcmp(argv[i], "--port") == 0) port = (uint16_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--size") == 0) size = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--chunk") == 0) chunk = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--prog-us") == 0) prog_us = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--drop") == 0) drop = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--restart") == 0) restart = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else {
+            fprintf(stderr, "未知参数: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (size == 0 || size > MQTT_OTA_MAX_SIZE || chunk == 0 || chunk > 400) {
+        fprintf(stderr, "--size 须在 1~%u 之间，--chunk 须在 1~400 之间\n", (unsigned)MQTT_OTA_MAX_SIZE);
+        return 1;
+    }
+
+    /* 0. SHA-256 自检 ("abc") */
+    static const uint8_t abc_digest[32] = {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+        0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+    };
+    MQTT_Sha256 sha;
+    uint8_t digest[32];
+    MQTT_Sha256_Init(&sha);
+    MQTT_Sha256_Update(&sha, (const uint8_t *)"abc", 3);
+    MQTT_Sha256_Final(&sha, digest);
+    if (memcmp(digest, abc_digest, sizeof(digest)) != 0) {
+        fprintf(stderr, "SHA-256 自检失败\n");
+        return 1;
+    }
+
+    /* 1. 生成镜像 */
+    uint8_t *image = malloc(size);
+    uint32_t seed = 12345;
+    for (uint32_t i = 0; i < size; i++) {
+        seed = seed * 1103515245u + 12345u;
+        image[i] = (uint8_t)(seed >> 16);
+    }
+    MQTT_Sha256_Init(&sha);
+    MQTT_Sha256_Update(&sha, image, size);
+    MQTT_Sha256_Final(&sha, digest);
+
+    char prefix[48], begin[96];
+    snprintf(prefix, sizeof(prefix), "otasim/%d", (int)getpid()); /* 避开上次运行的保留状态 */
+    snprintf(topic_begin, sizeof(topic_begin), "%s/ota/begin", prefix);
+    snprintf(topic_chunk, sizeof(topic_chunk), "%s/ota/chunk", prefix);
+    snprintf(topic_commit, sizeof(topic_commit), "%s/ota/commit", prefix);
+    snprintf(topic_status, sizeof(topic_status), "%s/ota/status", prefix);
+    int n = snprintf(begin, sizeof(begin), "%lu:", (unsigned long)size);
+    ToHex(digest, sizeof(digest), &begin[n]);
+
+    /* 2. 设备侧 */
+    static MQTT_SocketCtx sock_ctx;
+    static MQTT_Transport sock;
+    MQTT_SocketTransportInit(&sock, &sock_ctx, host, port);
+    MQTT_SetTransport(&sock);
+    if (!MQTT_Start() || !MQTT_OTA_Init(prefix)) {
+        fprintf(stderr, "设备连接 %s:%u 失败\n", host, port);
+        return 1;
+    }
+    for (int i = 0; i < 4; i++) {
+        MQTT_Service(); /* 发出订阅 */
+        HAL_Delay(20);
+    }
+
+    /* 3. 后端侧 */
+    if (!Backend_Connect(host, port)) {
+        fprintf(stderr, "后端连接 %s:%u 失败\n", host, port);
+        return 1;
+    }
+    Backend_Publish(topic_begin, (const uint8_t *)begin, (uint32_t)strlen(begin), 1);
+
+    uint8_t msg[4 + 400];
+    uint32_t next = 0;          /* 下一个要发送的偏移 */
+    bool sending = false;
+    bool restarted = false;
+    uint32_t chunks_sent = 0;
+    uint32_t resumes = 0;
+    uint64_t start = NowUs();
+    uint64_t done_us = 0;
+    uint32_t deadline = HAL_GetTick() + 30000;
+
+    while (!swapped && HAL_GetTick() < deadline) {
+        Service();
+
+        if (status_changed) {
+            status_changed = false;
+            unsigned long off;
+            if (sscanf(last_status, "ready %lu", &off) == 1 || sscanf(last_status, "resume %lu", &off) == 1) {
+                if (last_status[0] == 'r' && last_status[1] == 'e' && last_status[2] == 's') resumes++;
+                next = (uint32_t)off;
+                sending = true;
+            } else if (strcmp(last_status, "verified") == 0) {
+                done_us = NowUs();
+                Backend_Publish(topic_commit, (const uint8_t *)"1", 1, 1);
+            } else if (strncmp(last_status, "error", 5) == 0) {
+                fprintf(stderr, "设备报告: %s\n", last_status);
+                break;
+            }
+        }
+
+        /* 连续发送，发送缓冲满时让出 */
+        while (sending && next < size) {
+            if (restart && !restarted && next >= restart) {
+                restarted = true;
+                sending = false;
+                close(backend.fd);
+                Backend_Connect(host, port);
+                Backend_Publish(topic_begin, (const uint8_t *)begin, (uint32_t)strlen(begin), 1);
+                break;
+            }
+            uint32_t len = size - next < chunk ? size - next : chunk;
+            msg[0] = (uint8_t)next;
+            msg[1] = (uint8_t)(next >> 8);
+            msg[2] = (uint8_t)(next >> 16);
+            msg[3] = (uint8_t)(next >> 24);
+            memcpy(&msg[4], &image[next], len);
+            chunks_sent++;
+            if (drop && chunks_sent == drop) {
+                next += len; /* 模拟丢失 */
+                continue;
+            }
+            if (!Backend_Publish(topic_chunk, msg, 4 + len, 1)) {
+                chunks_sent--;
+                break;
+            }
+            next += len;
+        }
+        if (next >= size) sending = false;
+    }
+
+    const MQTT_OtaStatus *st = MQTT_OTA_GetStatus();
+    bool image_ok = swapped && memcmp(flash, image, size) == 0;
+    double secs = (double)((done_us ? done_us : NowUs()) - start) / 1e6;
+
+    printf("镜像           %lu 字节，分块 %lu 字节\n", (unsigned long)size, (unsigned long)chunk);
+    printf("结果           %s\n", image_ok ? "已切换，Flash 内容与镜像一致" : "失败");
+    printf("传输+校验耗时  %.3f s，%.1f KB/s\n", secs, secs > 0 ? size / 1024.0 / secs : 0.0);
+    printf("发送分块       %lu (续传请求 %lu，重复 %lu，缺口 %lu，缓冲排满 %lu)\n", (unsigned long)chunks_sent,
+           (unsigned long)resumes, (unsigned long)st->duplicates, (unsigned long)st->gaps,
+           (unsigned long)st->stalls);
+    printf("Flash 编程     %lu 块，错误 %lu，编程速率上限 %.1f KB/s\n", (unsigned long)flash_writes,
+           (unsigned long)flash_errors, prog_us ? MQTT_OTA_BLOCK * 1e6 / 1024.0 / prog_us : 0.0);
+
+    free(image);
+    close(backend.fd);
+    return image_ok ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+/**
+  * @file    hal_port.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   主机移植层实现 (POSIX)
+  *
+  * 日志串口 huart2 默认丢弃输出，设置环境变量 MQTT_LOG=1 后输出到 stderr。
+  * AT 串口 huart1 不连接任何设备，只读出 HAL_PortUartFeed 注入的数据；
+  * 写入的数据交给 HAL_PortUartOnTransmit，AT 模拟器 (atsim) 据此应答。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#define _POSIX_C_SOURCE 200809L
+#include "main.h"
+#include "usart.h"
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+UART_HandleTypeDef huart1 = {-1};
+UART_HandleTypeDef huart2 = {-2}; /* -2: 首次使用时根据 MQTT_LOG 决定 */
+
+uint32_t HAL_GetTick(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000u + ts.tv_nsec / 1000000u);
+}
+
+void HAL_Delay(uint32_t ms)
+{
+    struct timespec ts = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+void __WFI(void)
+{
+    HAL_Delay(1);
+}
+
+/* 飞行记录器的微秒时钟 (覆盖 mqtt_trace.c 的弱函数)：主机上没有 SysTick */
+uint32_t MQTT_TraceClock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u);
+}
+
+/* 默认丢弃 AT 串口输出 */
+__weak void HAL_PortUartOnTransmit(const uint8_t *data, uint16_t len)
+{
+    (void)data;
+    (void)len;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *data, uint16_t len, uint32_t timeout)
+{
+    (void)timeout;
+    if (huart == &huart1) {
+        HAL_PortUartOnTransmit(data, len);
+        return HAL_OK;
+    }
+    if (huart->fd == -2) {
+        const char *env = getenv("MQTT_LOG");
+        huart->fd = (env != NULL && env[0] != '0') ? STDERR_FILENO : -1;
+    }
+    if (huart->fd >= 0 && write(huart->fd, data, len) < 0) {
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+/* huart1 的注入数据 (HAL_PortUartFeed) */
+static uint8_t uart_feed[1 << 16];
+static uint32_t feed_head = 0;
+static uint32_t feed_tail = 0;
+
+void HAL_PortUartFeed(const uint8_t *data, uint32_t len)
+{
+    for (uint32_t i = 0; i < len && feed_head - feed_tail < sizeof(uart_feed); i++) {
+        uart_feed[feed_head++ % sizeof(uart_feed)] = data[i];
+    }
+}
+
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef *huart, uint8_t *data, uint16_t len, uint32_t timeout)
+{
+    if (huart == &huart1 && feed_head - feed_tail >= len) {
+        for (uint16_t i = 0; i < len; i++) {
+            data[i] = uart_feed[feed_tail++ % sizeof(uart_feed)];
+        }
+        return HAL_OK;
+    }
+    if (timeout > 0) {
+        HAL_Delay(timeout);
+    }
+    return HAL_TIMEOUT;
+}
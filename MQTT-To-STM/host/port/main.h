@@ -0,0 +1,61 @@
+/**
+  * @file    main.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   主机移植层：以 POSIX 实现 conn.c 用到的少量 HAL 接口，
+  *          使协议引擎可在 Linux 上通过套接字后端运行 (见 MQTT_SetTransport)
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    HAL_OK = 0,
+    HAL_ERROR,
+    HAL_BUSY,
+    HAL_TIMEOUT
+} HAL_StatusTypeDef;
+
+typedef struct {
+    int fd; /* 日志输出的文件描述符，-1 表示丢弃 */
+} UART_HandleTypeDef;
+
+typedef struct {
+    int unused;
+} TIM_HandleTypeDef;
+
+#ifndef __weak
+#define __weak __attribute__((weak))
+#endif
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t ms);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *data, uint16_t len, uint32_t timeout);
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef *huart, uint8_t *data, uint16_t len, uint32_t timeout);
+
+/* 主机上单线程运行，临界区为空操作 */
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t primask) { (void)primask; }
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+
+/* 等待中断：主机上以 1 ms 睡眠模拟 SysTick 唤醒 */
+void __WFI(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MAIN_H */
@@ -0,0 +1,27 @@
+/**
+  * @file    usart.h
+  * @brief   主机移植层：串口句柄 (huart1 为 AT 串口占位，huart2 为日志输出)
+  */
+#ifndef __USART_H
+#define __USART_H
+
+#include "main.h"
+
+extern UART_HandleTypeDef huart1;
+extern UART_HandleTypeDef huart2;
+
+/**
+ * @brief 向 AT 串口 (huart1) 注入模块输出，供 HAL_UART_Receive 依次读出
+ * @details 用于以录制的 AT 响应驱动 conn.c 的 AT 后端 (microbench)。
+ *          缓冲满时多余数据被丢弃。
+ */
+void HAL_PortUartFeed(const uint8_t *data, uint32_t len);
+
+/**
+ * @brief AT 串口 (huart1) 发送钩子 (弱函数，默认丢弃)
+ * @details 在 HAL_UART_Transmit 内同步调用。重写后可解析 conn.c 发出的指令与数据，
+ *          并以 HAL_PortUartFeed 注入应答，在主机上模拟 ESP8266 (atsim)。
+ */
+void HAL_PortUartOnTransmit(const uint8_t *data, uint16_t len);
+
+#endif /* __USART_H */
@@ -0,0 +1,171 @@
+/**
+  * @file    rpcsim.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   请求/响应 (mqtt_rpc.c) 回环测试：每个响应主题上的首次调用须完成
+  *
+  * 用法:
+  *   fleetsim broker --port 1883 &
+  *   rpcsim [--host 127.0.0.1] [--port 1883] [--topics 4] [--calls 8] [--timeout-ms 2000]
+  *
+  * 同一个协议引擎既是调用方也是处理方：对 --topics 个请求主题逐个注册处理函数，
+  * 注册后立即发起第一次调用 (此时请求主题与响应主题都还只是登记，未发出
+  * SUBSCRIBE)，随后每个主题再连续发出 --calls 个并发调用 (不超过
+  * MQTT_RPC_MAX_CALLS)。任一调用超时或响应内容不符即失败，退出码为 1。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_rpc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RPCSIM_MAX_TOPICS 4 /* 受 MQTT_RPC_MAX_HANDLERS 与 MQTT_RPC_MAX_REPLY_TOPICS 限制 */
+
+typedef struct {
+    uint32_t ok;
+    uint32_t mismatch;
+    uint32_t timeout;
+    uint32_t first_ok;
+    uint32_t max_rtt;
+} RpcSimStats;
+
+typedef struct {
+    char expect[32];
+    uint32_t sent_at;
+    bool first;
+    bool done;
+} RpcSimCall;
+
+static RpcSimStats result;
+
+static bool OnEcho(const char *body, char *reply, uint16_t reply_size)
+{
+    snprintf(reply, reply_size, "echo:%s", body);
+    return true;
+}
+
+static void OnReply(MQTT_RpcStatus status, const char *reply, void *ctx)
+{
+    RpcSimCall *call = (RpcSimCall *)ctx;
+    uint32_t rtt = HAL_GetTick() - call->sent_at;
+
+    call->done = true;
+    if (status == MQTT_RPC_TIMEOUT) {
+        result.timeout++;
+        fprintf(stderr, "超时: %s%s\n", call->expect, call->first ? " (首次调用)" : "");
+        return;
+    }
+    if (status != MQTT_RPC_OK || strcmp(reply, call->expect) != 0) {
+        result.mismatch++;
+        fprintf(stderr, "响应不符: 期望 \"%s\"，收到 \"%s\"\n", call->expect, reply);
+        return;
+    }
+    result.ok++;
+    if (call->first) result.first_ok++;
+    if (rtt > result.max_rtt) result.max_rtt = rtt;
+}
+
+/* 运行服务例程直到给定调用全部完成 (超时由 MQTT_RPC_Service 回调) */
+static void WaitCalls(RpcSimCall *calls, int n)
+{
+    for (;;) {
+        bool pending = false;
+        for (int i = 0; i < n; i++) {
+            if (!calls[i].done) pending = true;
+        }
+        if (!pending) return;
+        MQTT_Service();
+        MQTT_RPC_Service();
+        HAL_Delay(1);
+    }
+}
+
+static bool Issue(RpcSimCall *call, const char *topic, const char *body, uint32_t timeout_ms, bool first)
+{
+    snprintf(call->expect, sizeof(call->expect), "echo:%s", body);
+    call->sent_at = HAL_GetTick();
+    call->first = first;
+    call->done = false;
+    if (MQTT_RPC_Call(topic, body, timeout_ms, OnReply, call) == 0) {
+        call->done = true;
+        fprintf(stderr, "发起调用失败: %s\n", topic);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    uint16_t port = 1883;
+    int topic_count = RPCSIM_MAX_TOPICS;
+    int call_count = MQTT_RPC_MAX_CALLS;
+    uint32_t timeout_ms = 2000;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--host") == 0) host = argv[i + 1];
+        else if (strcmp(argv[i], "--port") == 0) port = (uint16_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--topics") == 0) topic_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--calls") == 0) call_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--timeout-ms") == 0) timeout_ms = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else {
+            fprintf(stderr, "未知参数: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (topic_count < 1 || topic_count > RPCSIM_MAX_TOPICS) {
+        fprintf(stderr, "--topics 须在 1~%d 之间\n", RPCSIM_MAX_TOPICS);
+        return 1;
+    }
+    if (call_count < 0 || call_count > MQTT_RPC_MAX_CALLS) {
+        call_count = MQTT_RPC_MAX_CALLS;
+    }
+
+    static MQTT_SocketCtx sock_ctx;
+    static MQTT_Transport sock;
+    MQTT_SocketTransportInit(&sock, &sock_ctx, host, port);
+    MQTT_SetTransport(&sock);
+    if (!MQTT_Start()) {
+        fprintf(stderr, "连接 %s:%u 失败\n", host, port);
+        return 1;
+    }
+
+    static char topics[RPCSIM_MAX_TOPICS][48];
+    static RpcSimCall calls[MQTT_RPC_MAX_CALLS];
+    uint32_t issued = 0;
+
+    for (int t = 0; t < topic_count; t++) {
+        snprintf(topics[t], sizeof(topics[t]), "rpcsim/%d/echo%d", (int)getpid(), t);
+        if (!MQTT_RPC_Register(topics[t], OnEcho)) {
+            fprintf(stderr, "注册处理函数失败: %s\n", topics[t]);
+            return 1;
+        }
+
+        /* 首次调用：注册后不经过 MQTT_Service，直接发起 */
+        issued++;
+        if (Issue(&calls[0], topics[t], "first", timeout_ms, true)) {
+            WaitCalls(calls, 1);
+        }
+
+        /* 同一主题上的并发调用 */
+        for (int i = 0; i < call_count; i++) {
+            char body[16];
+            snprintf(body, sizeof(body), "%d-%d", t, i);
+            issued++;
+            Issue(&calls[i], topics[t], body, timeout_ms, false);
+        }
+        WaitCalls(calls, call_count);
+    }
+
+    printf("调用 %lu 次: 成功 %lu，首次调用成功 %lu/%d，超时 %lu，响应不符 %lu，最大往返 %lu ms\n",
+           (unsigned long)issued, (unsigned long)result.ok, (unsigned long)result.first_ok, topic_count,
+           (unsigned long)result.timeout, (unsigned long)result.mismatch, (unsigned long)result.max_rtt);
+    return (result.ok == issued) ? 0 : 1;
+}
@@ -0,0 +1,308 @@
+"""
+消息定义编译器：从 .schema 文件生成 mqtt_pack.h 格式的 C 编解码函数
+
+用法:
+    python3 schemac.py telemetry.schema -o <输出目录> [--proto telemetry.proto]
+
+定义文件语法 (proto3 的子集，字符串与字节串需给出容量):
+
+    # 注释
+    message Telemetry {
+        uint32 tick = 1;
+        sint32 temp_c10 = 2;     # 有符号数用 sint32/sint64 (zigzag)
+        float voltage = 3;
+        bool online = 4;
+        string fw[16] = 5;       # char fw[16]，含结束符
+        bytes raw[32] = 6;       # struct { uint16_t len; uint8_t data[32]; }
+    }
+
+对每个消息生成 (<名> 为定义文件名，如 telemetry_msg.h / telemetry_msg.c):
+    typedef struct {...} Telemetry;
+    #define Telemetry_MAX_SIZE      编码后最大长度，可直接用作缓冲区大小
+    bool Telemetry_Pack(const Telemetry *msg, uint8_t *buf, uint16_t size, uint16_t *len);
+    bool Telemetry_Unpack(Telemetry *msg, const uint8_t *buf, uint32_t len);
+    bool Telemetry_Publish(MQTT_TopicId id, const Telemetry *msg);   (--no-publish 时不生成)
+
+--proto 同时输出等价的 proto3 定义，后端可用 protoc 生成任意语言的解析代码。
+"""
+import argparse
+import os
+import re
+import sys
+
+# 类型: (C 类型, 编码函数, 最大值长度, 解码表达式, 线上类型)
+SCALARS = {
+    "uint32": ("uint32_t", "MQTT_PackU32", 5, "(uint32_t)f.value", 0),
+    "uint64": ("uint64_t", "MQTT_PackU64", 10, "f.value", 0),
+    "sint32": ("int32_t", "MQTT_PackS32", 5, "MQTT_UnpackS32(f.value)", 0),
+    "sint64": ("int64_t", "MQTT_PackS64", 10, "MQTT_UnpackS64(f.value)", 0),
+    "bool": ("bool", "MQTT_PackU32", 1, "f.value != 0", 0),
+    "float": ("float", "MQTT_PackFloat", 4, "MQTT_UnpackFloat(f.value)", 5),
+}
+WIRE_NAMES = {0: "MQTT_WIRE_VARINT", 2: "MQTT_WIRE_BYTES", 5: "MQTT_WIRE_FIXED32"}
+
+TOKEN_RE = re.compile(r"\s*(?:(#[^\n]*)|([A-Za-z_]\w*)|(\d+)|(\S))")
+
+
+class SchemaError(Exception):
+    pass
+
+
+def varint_size(v):
+    n = 1
+    while v >= 0x80:
+        v >>= 7
+        n += 1
+    return n
+
+
+def tokenize(text, path):
+    tokens = []
+    for lineno, line in enumerate(text.splitlines(), 1):
+        pos = 0
+        while pos < len(line):
+            m = TOKEN_RE.match(line, pos)
+            if m is None:
+                break
+            pos = m.end()
+            if m.group(1):
+                continue
+            tok = m.group(2) or m.group(3) or m.group(4)
+            if tok:
+                tokens.append((tok, "%s:%d" % (path, lineno)))
+    return tokens
+
+
+def parse(text, path):
+    tokens = tokenize(text, path)
+    pos = 0
+
+    def take(expect=None):
+        nonlocal pos
+        if pos >= len(tokens):
+            raise SchemaError("%s: 意外的文件结尾" % path)
+        tok, where = tokens[pos]
+        if expect is not None and tok != expect:
+            raise SchemaError("%s: 期望 '%s'，得到 '%s'" % (where, expect, tok))
+        pos += 1
+        return tok, where
+
+    messages = []
+    names = set()
+    while pos < len(tokens):
+        take("message")
+        name, where = take()
+        if not re.match(r"^[A-Za-z_]\w*$", name) or name in names:
+            raise SchemaError("%s: 消息名无效或重复: %s" % (where, name))
+        names.add(name)
+        take("{")
+        fields = []
+        while pos < len(tokens) and tokens[pos][0] != "}":
+            ftype, where = take()
+            fname, _ = take()
+            cap = None
+            if ftype in ("string", "bytes"):
+                take("[")
+                cap = int(take()[0])
+                take("]")
+                if cap < 1 or cap > 4096:
+                    raise SchemaError("%s: %s 容量需在 1~4096 之间" % (where, fname))
+            elif ftype not in SCALARS:
+                raise SchemaError("%s: 不支持的类型 %s" % (where, ftype))
+            take("=")
+            number = int(take()[0])
+            take(";")
+            if not 1 <= number <= 0x1FFFFFFF or 19000 <= number <= 19999:
+                raise SchemaError("%s: 字段号 %d 无效" % (where, number))
+            if any(f["name"] == fname or f["number"] == number for f in fields):
+                raise SchemaError("%s: 字段名或字段号重复: %s = %d" % (where, fname, number))
+            fields.append({"type": ftype, "name": fname, "cap": cap, "number": number})
+        take("}")
+        if not fields:
+            raise SchemaError("%s: 消息 %s 没有字段" % (where, name))
+        messages.append({"name": name, "fields": fields})
+    return messages
+
+
+def field_max_size(f):
+    key = varint_size(f["number"] << 3)
+    if f["type"] == "string":
+        return key + varint_size(f["cap"] - 1) + f["cap"] - 1
+    if f["type"] == "bytes":
+        return key + varint_size(f["cap"]) + f["cap"]
+    return key + SCALARS[f["type"]][2]
+
+
+def gen_header(base, messages, publish, source):
+    guard = "__%s_H" % base.upper()
+    out = []
+    out.append("/* 由 schemac.py 从 %s 生成，请勿手工修改 */" % source)
+    out.append("#ifndef %s" % guard)
+    out.append("#define %s" % guard)
+    out.append("")
+    out.append('#include "mqtt_pack.h"')
+    if publish:
+        out.append('#include "conn.h"')
+    out.append("")
+    out.append("#ifdef __cplusplus")
+    out.append('extern "C" {')
+    out.append("#endif")
+    for m in messages:
+        name = m["name"]
+        out.append("")
+        out.append("typedef struct {")
+        for f in m["fields"]:
+            if f["type"] == "string":
+                out.append("    char %s[%d];" % (f["name"], f["cap"]))
+            elif f["type"] == "bytes":
+                out.append("    struct {")
+                out.append("        uint16_t len;")
+                out.append("        uint8_t data[%d];" % f["cap"])
+                out.append("    } %s;" % f["name"])
+            else:
+                out.append("    %s %s;" % (SCALARS[f["type"]][0], f["name"]))
+        out.append("} %s;" % name)
+        out.append("")
+        total = sum(field_max_size(f) for f in m["fields"])
+        if total > 0xFFFF:
+            raise SchemaError("消息 %s 最大编码长度 %d 超过 65535" % (name, total))
+        out.append("#define %s_MAX_SIZE %d" % (name, total))
+        out.append("")
+        out.append("bool %s_Pack(const %s *msg, uint8_t *buf, uint16_t size, uint16_t *len);" % (name, name))
+        out.append("bool %s_Unpack(%s *msg, const uint8_t *buf, uint32_t len);" % (name, name))
+        if publish:
+            out.append("bool %s_Publish(MQTT_TopicId id, const %s *msg);" % (name, name))
+    out.append("")
+    out.append("#ifdef __cplusplus")
+    out.append("}")
+    out.append("#endif")
+    out.append("")
+    out.append("#endif /* %s */" % guard)
+    return "\n".join(out) + "\n"
+
+
+def gen_source(base, messages, publish, source):
+    out = []
+    out.append("/* 由 schemac.py 从 %s 生成，请勿手工修改 */" % source)
+    out.append('#include "%s.h"' % base)
+    out.append("#include <string.h>")
+    if any(f["type"] == "string" for m in messages for f in m["fields"]):
+        out.append("")
+        out.append("/* 字符串字段未以 '\\0' 结尾时按容量截断 */")
+        out.append("static uint16_t %s_StrLen(const char *s, uint16_t max)" % base)
+        out.append("{")
+        out.append("    const char *end = memchr(s, '\\0', max);")
+        out.append("    return end ? (uint16_t)(end - s) : max;")
+        out.append("}")
+    for m in messages:
+        name = m["name"]
+        out.append("")
+        out.append("bool %s_Pack(const %s *msg, uint8_t *buf, uint16_t size, uint16_t *len)" % (name, name))
+        out.append("{")
+        out.append("    MQTT_PackWriter w;")
+        out.append("")
+        out.append("    MQTT_PackInit(&w, buf, size);")
+        for f in m["fields"]:
+            n, fn = f["number"], f["name"]
+            if f["type"] == "string":
+                out.append("    MQTT_PackBytes(&w, %d, msg->%s, %s_StrLen(msg->%s, %d));"
+                           % (n, fn, base, fn, f["cap"] - 1))
+            elif f["type"] == "bytes":
+                out.append("    MQTT_PackBytes(&w, %d, msg->%s.data, msg->%s.len > %d ? %d : msg->%s.len);"
+                           % (n, fn, fn, f["cap"], f["cap"], fn))
+            elif f["type"] == "bool":
+                out.append("    MQTT_PackU32(&w, %d, msg->%s ? 1 : 0);" % (n, fn))
+            else:
+                out.append("    %s(&w, %d, msg->%s);" % (SCALARS[f["type"]][1], n, fn))
+        out.append("    return MQTT_PackEnd(&w, len);")
+        out.append("}")
+        out.append("")
+        out.append("bool %s_Unpack(%s *msg, const uint8_t *buf, uint32_t len)" % (name, name))
+        out.append("{")
+        out.append("    MQTT_UnpackReader r;")
+        out.append("    MQTT_PackField f;")
+        out.append("    int ret;")
+        out.append("")
+        out.append("    memset(msg, 0, sizeof(*msg));")
+        out.append("    MQTT_UnpackInit(&r, buf, len);")
+        out.append("    while ((ret = MQTT_UnpackNext(&r, &f)) > 0) {")
+        out.append("        switch (f.field) {")
+        for f in m["fields"]:
+            n, fn = f["number"], f["name"]
+            wire = 2 if f["type"] in ("string", "bytes") else SCALARS[f["type"]][4]
+            out.append("        case %d:" % n)
+            out.append("            if (f.wire != %s) return false;" % WIRE_NAMES[wire])
+            if f["type"] == "string":
+                out.append("            if (f.len >= sizeof(msg->%s)) return false;" % fn)
+                out.append("            memcpy(msg->%s, f.data, f.len);" % fn)
+                out.append("            msg->%s[f.len] = '\\0';" % fn)
+            elif f["type"] == "bytes":
+                out.append("            if (f.len > sizeof(msg->%s.data)) return false;" % fn)
+                out.append("            memcpy(msg->%s.data, f.data, f.len);" % fn)
+                out.append("            msg->%s.len = (uint16_t)f.len;" % fn)
+            else:
+                out.append("            msg->%s = %s;" % (fn, SCALARS[f["type"]][3]))
+            out.append("            break;")
+        out.append("        default:")
+        out.append("            break; /* 未知字段 (新版本定义)：跳过 */")
+        out.append("        }")
+        out.append("    }")
+        out.append("    return ret == 0;")
+        out.append("}")
+        if publish:
+            out.append("")
+            out.append("bool %s_Publish(MQTT_TopicId id, const %s *msg)" % (name, name))
+            out.append("{")
+            out.append("    uint8_t buf[%s_MAX_SIZE];" % name)
+            out.append("    uint16_t len;")
+            out.append("")
+            out.append("    if (!%s_Pack(msg, buf, sizeof(buf), &len)) return false;" % name)
+            out.append("    return MQTT_PublishById(id, buf, len);")
+            out.append("}")
+    return "\n".join(out) + "\n"
+
+
+def gen_proto(messages, source):
+    out = ["// 由 schemac.py 从 %s 生成" % source, 'syntax = "proto3";']
+    for m in messages:
+        out.append("")
+        out.append("message %s {" % m["name"])
+        for f in m["fields"]:
+            out.append("  %s %s = %d;" % (f["type"], f["name"], f["number"]))
+        out.append("}")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="消息定义编译器 (生成 mqtt_pack.h 编解码函数)")
+    parser.add_argument("schema", help="消息定义文件")
+    parser.add_argument("-o", "--out", default=".", help="输出目录")
+    parser.add_argument("--proto", help="同时输出等价的 proto3 定义")
+    parser.add_argument("--no-publish", action="store_true", help="不生成依赖 conn.h 的 <消息>_Publish")
+    args = parser.parse_args()
+
+    with open(args.schema, encoding="utf-8") as fp:
+        text = fp.read()
+    source = os.path.basename(args.schema)
+    try:
+        messages = parse(text, source)
+        base = re.sub(r"\W", "_", os.path.splitext(source)[0]) + "_msg"
+        header = gen_header(base, messages, not args.no_publish, source)
+        body = gen_source(base, messages, not args.no_publish, source)
+    except SchemaError as e:
+        print("schemac: %s" % e, file=sys.stderr)
+        return 1
+
+    os.makedirs(args.out, exist_ok=True)
+    with open(os.path.join(args.out, base + ".h"), "w", encoding="utf-8") as fp:
+        fp.write(header)
+    with open(os.path.join(args.out, base + ".c"), "w", encoding="utf-8") as fp:
+        fp.write(body)
+    if args.proto:
+        with open(args.proto, "w", encoding="utf-8") as fp:
+            fp.write(gen_proto(messages, source))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
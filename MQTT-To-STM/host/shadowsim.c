@@ -0,0 +1,367 @@
+/**
+  * @file    shadowsim.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   设备影子 (mqtt_shadow.c) 增量同步测试：跨复位的版本号保持与缺口补发
+  *
+  * 用法:
+  *   fleetsim broker --port 1883 &
+  *   shadowsim [--host 127.0.0.1] [--port 1883] [--settle-ms 800] [--no-persist]
+  *
+  * 后端是本进程内的原生 MQTT 连接，设备每次"上电"是一个新的子进程 (协议引擎与
+  * 影子模块的静态状态全部从零开始)。MQTT_Shadow_Load / MQTT_Shadow_Save 被重写为
+  * 读写临时文件，模拟掉电保持的 Flash。依次进行三次启动:
+  *   1  后端已保留 0:1 增量：设备应用后回报，再在本地修改一个键并上报
+  *   2  期间无变化：恢复的版本号使保留增量被忽略，设备不应发出任何消息
+  *   3  离线期间后端发布了 1:2、2:3，只保留了 2:3：设备发现缺口，发布 get，
+  *      后端按版本补发 1:2、2:3，设备追上版本 3
+  * 每次启动检查设备的版本号与键值，后端统计设备发出的 reported / get 消息数，
+  * 并检查上报版本是否连续。--no-persist 让读取钩子返回 false，用于对比复位后
+  * 丢失版本号的同步流量 (第 2 次启动会重新应用并上报，上报版本回退)。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_shadow.h"
+#include "mqtt_codec.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define SHADOWSIM_KEYS 6
+#define SHADOWSIM_VERSIONS 3
+
+static const char *const keys[SHADOWSIM_KEYS] = {"k0", "k1", "k2", "k3", "k4", "k5"};
+
+/* 后端发布的期望增量，下标为应用后的版本 */
+static const char *const deltas[SHADOWSIM_VERSIONS + 1] = {
+    NULL,
+    "0:1|k0=a;k1=b",
+    "1:2|k3=x",
+    "2:3|k4=y;k0=c",
+};
+
+static char prefix[48];
+static char topic_desired[64], topic_reported[64], topic_get[64];
+static char state_path[64];
+static bool persist = true;
+
+/* ==========================================
+ * 掉电保持存储 (覆盖 mqtt_shadow.c 的弱函数)
+ * ========================================== */
+
+bool MQTT_Shadow_Load(MQTT_ShadowState *state)
+{
+    FILE *f = persist ? fopen(state_path, "rb") : NULL;
+    if (f == NULL) return false;
+    bool ok = fread(state, sizeof(*state), 1, f) == 1;
+    fclose(f);
+    return ok;
+}
+
+void MQTT_Shadow_Save(const MQTT_ShadowState *state)
+{
+    FILE *f = fopen(state_path, "wb");
+    if (f == NULL) return;
+    fwrite(state, sizeof(*state), 1, f);
+    fclose(f);
+}
+
+/* ==========================================
+ * 后端 (阻塞建连，非阻塞收发的原生套接字)
+ * ========================================== */
+typedef struct {
+    int fd;
+    uint8_t in[4096];
+    uint32_t in_len;
+    uint32_t reported;    /* 本次启动期间收到的上报 */
+    uint32_t gets;        /* 本次启动期间收到的补发请求 */
+    uint32_t regressions; /* 上报的 base 与已知上报版本不连续 */
+    uint32_t reported_version;
+    char reported_values[SHADOWSIM_KEYS][MQTT_SHADOW_VALUE_SIZE];
+} Backend;
+
+static Backend backend;
+
+static bool Backend_Send(const uint8_t *pkt, uint16_t len)
+{
+    return len > 0 && send(backend.fd, pkt, len, MSG_NOSIGNAL) == (ssize_t)len;
+}
+
+static bool Backend_Publish(const char *topic, const char *payload, bool retain)
+{
+    uint8_t pkt[256];
+    uint16_t n = MQTT_BuildPublish(pkt, sizeof(pkt), topic, (const uint8_t *)payload, (uint16_t)strlen(payload));
+    if (retain) pkt[0] |= MQTT_PUBLISH_RETAIN;
+    return Backend_Send(pkt, n);
+}
+
+static bool Backend_Connect(const char *host, uint16_t port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return false;
+
+    backend.fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (backend.fd < 0 || connect(backend.fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) return false;
+    int one = 1;
+    setsockopt(backend.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    uint8_t pkt[128];
+    char id[32];
+    snprintf(id, sizeof(id), "shadowsim-backend-%d", (int)getpid());
+    return Backend_Send(pkt, MQTT_BuildConnect(pkt, sizeof(pkt), id, 60)) &&
+           Backend_Send(pkt, MQTT_BuildSubscribe(pkt, sizeof(pkt), 1, topic_reported, 0)) &&
+           Backend_Send(pkt, MQTT_BuildSubscribe(pkt, sizeof(pkt), 2, topic_get, 0));
+}
+
+/**
+ * @brief 记录一条上报："<base>:<ver>|k=v;..."
+ */
+static void Backend_OnReported(const char *doc)
+{
+    unsigned long base, ver;
+    int pos = 0;
+
+    backend.reported++;
+    if (sscanf(doc, "%lu:%lu|%n", &base, &ver, &pos) != 2 || pos == 0) return;
+    if (base != backend.reported_version) backend.regressions++;
+    backend.reported_version = (uint32_t)ver;
+
+    for (const char *p = doc + pos; *p;) {
+        size_t len = strcspn(p, ";");
+        const char *eq = memchr(p, '=', len);
+        for (int i = 0; eq != NULL && i < SHADOWSIM_KEYS; i++) {
+            size_t key_len = (size_t)(eq - p);
+            size_t value_len = len - key_len - 1;
+            if (strlen(keys[i]) == key_len && memcmp(keys[i], p, key_len) == 0 && value_len < MQTT_SHADOW_VALUE_SIZE) {
+                memcpy(backend.reported_values[i], eq + 1, value_len);
+                backend.reported_values[i][value_len] = '\0';
+            }
+        }
+        p += len;
+        if (*p == ';') p++;
+    }
+}
+
+/**
+ * @brief 补发请求 "<ver>"：按版本顺序补发之后的全部增量
+ */
+static void Backend_OnGet(const char *ver, uint32_t latest)
+{
+    backend.gets++;
+    for (uint32_t v = (uint32_t)strtoul(ver, NULL, 10) + 1; v <= latest; v++) {
+        Backend_Publish(topic_desired, deltas[v], false);
+    }
+}
+
+static void Backend_Poll(uint32_t latest)
+{
+    ssize_t n = recv(backend.fd, backend.in + backend.in_len, sizeof(backend.in) - backend.in_len, MSG_DONTWAIT);
+    if (n > 0) backend.in_len += (uint32_t)n;
+
+    uint32_t total;
+    while (backend.in_len > 0 && MQTT_PacketLength(backend.in, backend.in_len, &total) == 1) {
+        MQTT_PublishView view;
+        char topic[64], payload[MQTT_SHADOW_DOC_SIZE];
+        if (MQTT_ParsePublish(backend.in, total, &view) && view.topic_len < sizeof(topic) &&
+            view.payload_len < sizeof(payload)) {
+            memcpy(topic, view.topic, view.topic_len);
+            topic[view.topic_len] = '\0';
+            memcpy(payload, view.payload, view.payload_len);
+            payload[view.payload_len] = '\0';
+            if (strcmp(topic, topic_reported) == 0) Backend_OnReported(payload);
+            else if (strcmp(topic, topic_get) == 0) Backend_OnGet(payload, latest);
+        }
+        memmove(backend.in, backend.in + total, backend.in_len - total);
+        backend.in_len -= total;
+    }
+}
+
+/* ==========================================
+ * 设备 (子进程)
+ * ========================================== */
+
+static uint32_t changes = 0;
+
+static void OnShadow(const char *key, const char *value)
+{
+    (void)key;
+    (void)value;
+    changes++;
+}
+
+/**
+ * @brief 检查设备键值
+ * @param expect 各键的期望值，NULL 表示初始值 "0"
+ */
+static bool Device_Check(int boot, uint32_t version, const char *const expect[SHADOWSIM_KEYS])
+{
+    bool ok = MQTT_Shadow_Version() == version;
+    for (int i = 0; i < SHADOWSIM_KEYS; i++) {
+        const char *want = expect[i] ? expect[i] : "0";
+        if (strcmp(MQTT_Shadow_Get(keys[i]), want) != 0) {
+            fprintf(stderr, "启动 %d: %s = \"%s\"，期望 \"%s\"\n", boot, keys[i], MQTT_Shadow_Get(keys[i]), want);
+            ok = false;
+        }
+    }
+    if (MQTT_Shadow_Version() != version) {
+        fprintf(stderr, "启动 %d: 版本 %lu，期望 %lu\n", boot, (unsigned long)MQTT_Shadow_Version(),
+                (unsigned long)version);
+    }
+    return ok;
+}
+
+static int Device_Boot(int boot, const char *host, uint16_t port, uint32_t settle_ms)
+{
+    static const char *const expect[4][SHADOWSIM_KEYS] = {
+        {NULL},
+        {"a", "b", "local", NULL, NULL, NULL},
+        {"a", "b", "local", NULL, NULL, NULL},
+        {"c", "b", "local", "x", "y", NULL},
+    };
+    static const uint32_t expect_version[4] = {0, 1, 1, 3};
+
+    for (int i = 0; i < SHADOWSIM_KEYS; i++) {
+        MQTT_Shadow_Define(keys[i], "0");
+    }
+    if (!MQTT_Shadow_Init(prefix, OnShadow)) return 2;
+    uint32_t restored = MQTT_Shadow_Version();
+
+    static MQTT_SocketCtx sock_ctx;
+    static MQTT_Transport sock;
+    MQTT_SocketTransportInit(&sock, &sock_ctx, host, port);
+    MQTT_SetTransport(&sock);
+    if (!MQTT_Start()) return 2;
+
+    uint32_t start = HAL_GetTick();
+    bool local_set = false;
+    while (HAL_GetTick() - start < settle_ms) {
+        MQTT_Service();
+        MQTT_Shadow_Service();
+        /* 第 1 次启动：应用期望值之后在本地修改一个键 */
+        if (boot == 1 && !local_set && MQTT_Shadow_Version() == 1) {
+            MQTT_Shadow_Set("k2", "local");
+            local_set = true;
+        }
+        MQTT_Idle(10);
+    }
+
+    bool ok = Device_Check(boot, expect_version[boot], expect[boot]) && MQTT_Shadow_Oversize() == 0;
+    printf("启动 %d: 恢复版本 %lu，当前版本 %lu，期望值回调 %lu 次%s\n", boot, (unsigned long)restored,
+           (unsigned long)MQTT_Shadow_Version(), (unsigned long)changes, ok ? "" : "，状态不符");
+    fflush(stdout);
+    return ok ? 0 : 1;
+}
+
+/* ==========================================
+ * 主流程
+ * ========================================== */
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    uint16_t port = 1883;
+    uint32_t settle_ms = 800;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-persist") == 0) {
+            persist = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "缺少参数值: %s\n", argv[i]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--host") == 0) host = argv[++i];
+        else if (strcmp(argv[i], "--port") == 0) port = (uint16_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--settle-ms") == 0) settle_ms = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "未知参数: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    snprintf(prefix, sizeof(prefix), "shadowsim/%d", (int)getpid()); /* 避开上次运行的保留状态 */
+    snprintf(topic_desired, sizeof(topic_desired), "%s/desired", prefix);
+    snprintf(topic_reported, sizeof(topic_reported), "%s/reported", prefix);
+    snprintf(topic_get, sizeof(topic_get), "%s/get", prefix);
+    snprintf(state_path, sizeof(state_path), "/tmp/shadowsim-%d.state", (int)getpid());
+
+    if (!Backend_Connect(host, port)) {
+        fprintf(stderr, "后端连接 %s:%u 失败\n", host, port);
+        return 1;
+    }
+
+    /* 第 1 次启动前保留 0:1；第 3 次启动前依次发布 1:2、2:3，只剩 2:3 被保留 */
+    static const uint32_t publish_before[4][2] = {{0, 0}, {1, 1}, {0, 0}, {2, 3}};
+    /* 各次启动期间设备应发出的 reported / get 消息数
+     * 第 3 次启动补发的两条增量可能在同一次服务例程中应用，合成一条上报 */
+    static const uint32_t expect_reported_min[4] = {0, 2, 0, 1};
+    static const uint32_t expect_reported_max[4] = {0, 2, 0, 2};
+    static const uint32_t expect_gets[4] = {0, 0, 0, 1};
+    uint32_t latest = 0;
+    bool ok = true;
+
+    for (int boot = 1; boot <= 3; boot++) {
+        for (uint32_t v = publish_before[boot][0]; v != 0 && v <= publish_before[boot][1]; v++) {
+            Backend_Publish(topic_desired, deltas[v], true);
+            latest = v;
+        }
+        backend.reported = 0;
+        backend.gets = 0;
+
+        fflush(stdout); /* 子进程会继承未输出的缓冲 */
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(backend.fd);
+            _exit(Device_Boot(boot, host, port, settle_ms));
+        }
+        int status = 0;
+        while (waitpid(pid, &status, WNOHANG) == 0) {
+            Backend_Poll(latest);
+            HAL_Delay(1);
+        }
+        for (int i = 0; i < 50; i++) { /* 收完子进程退出前发出的消息 */
+            Backend_Poll(latest);
+            HAL_Delay(1);
+        }
+
+        bool boot_ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 && backend.reported >= expect_reported_min[boot] &&
+                       backend.reported <= expect_reported_max[boot] && backend.gets == expect_gets[boot];
+        printf("  后端: 上报 %lu 条 (期望 %lu~%lu)，补发请求 %lu 条 (期望 %lu)，上报版本 %lu%s\n",
+               (unsigned long)backend.reported, (unsigned long)expect_reported_min[boot],
+               (unsigned long)expect_reported_max[boot], (unsigned long)backend.gets,
+               (unsigned long)expect_gets[boot], (unsigned long)backend.reported_version, boot_ok ? "" : "  <-- 不符");
+        ok = ok && boot_ok;
+    }
+
+    /* 后端视角的设备状态须与设备一致 */
+    static const char *const final_values[SHADOWSIM_KEYS] = {"c", "b", "local", "x", "y", ""};
+    for (int i = 0; i < SHADOWSIM_KEYS; i++) {
+        if (strcmp(backend.reported_values[i], final_values[i]) != 0) {
+            fprintf(stderr, "后端记录的 %s = \"%s\"，期望 \"%s\"\n", keys[i], backend.reported_values[i], final_values[i]);
+            ok = false;
+        }
+    }
+    printf("上报版本不连续 %lu 次\n", (unsigned long)backend.regressions);
+    ok = ok && backend.regressions == 0;
+
+    Backend_Publish(topic_desired, "", true); /* 清除保留消息 */
+    HAL_Delay(50);
+    close(backend.fd);
+    unlink(state_path);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+/**
+  * @file    spilinkbench.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   SPI 链路协议 (spi_link.c) 回环测试：两端在内存中交换块，测量成帧开销与吞吐
+  *
+  * 用法:
+  *   spilinkbench [--bytes 1048576] [--ber 0] [--clock 20] [--seed 1]
+  *
+  *   --bytes  每个方向传输的数据量
+  *   --ber    每个块在传输中被破坏的概率 (0~1)，用于验证 CRC 与重发
+  *   --clock  折算线上耗时所用的 SPI 时钟 (MHz)
+  *
+  * 双向同时在数据通道上传输递增字节序列，接收端逐字节校验。输出块数、重发、
+  * CRC 错误、线上效率 (每方向负载字节 / 交换字节)、按 SPI 时钟折算的有效吞吐，
+  * 以及本机处理成帧与 CRC 的速度。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "spi_link.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    SPI_Link link;
+    uint32_t written; /* 已写入发送缓冲区的字节 */
+    uint32_t verified; /* 已收到并校验的字节 */
+    uint32_t mismatches;
+} Endpoint;
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void Feed(Endpoint *e, uint32_t total)
+{
+    uint8_t chunk[SPI_LINK_RING_SIZE];
+    uint32_t room = SPI_LinkWritable(&e->link, SPI_LINK_CH_DATA);
+    uint32_t n = total - e->written;
+    if (n > room) n = room;
+    for (uint32_t i = 0; i < n; i++) chunk[i] = (uint8_t)(e->written + i);
+    e->written += SPI_LinkWrite(&e->link, SPI_LINK_CH_DATA, chunk, (uint16_t)n);
+}
+
+static void Drain(Endpoint *e)
+{
+    uint8_t chunk[SPI_LINK_RING_SIZE];
+    uint16_t n = SPI_LinkRead(&e->link, SPI_LINK_CH_DATA, chunk, sizeof(chunk));
+    for (uint16_t i = 0; i < n; i++) {
+        if (chunk[i] != (uint8_t)(e->verified + i)) e->mismatches++;
+    }
+    e->verified += n;
+}
+
+static void Corrupt(uint8_t *block, double ber)
+{
+    if (ber > 0 && rand() < ber * RAND_MAX) {
+        block[rand() % SPI_LINK_BLOCK] ^= (uint8_t)(1u << (rand() % 8));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t bytes = 1u << 20;
+    double ber = 0.0;
+    double clock_mhz = 20.0;
+    unsigned seed = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--bytes") == 0) bytes = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--ber") == 0) ber = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--clock") == 0) clock_mhz = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0) seed = (unsigned)atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "未知参数: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    srand(seed);
+
+    static Endpoint host, module;
+    static uint8_t host_block[SPI_LINK_BLOCK], module_block[SPI_LINK_BLOCK];
+    SPI_LinkInit(&host.link);
+    SPI_LinkInit(&module.link);
+
+    /* 每次循环相当于一次 SPI 传输：双方各自生成块，同时交换 */
+    uint32_t transfers = 0;
+    uint32_t limit = (bytes / SPI_LINK_MAX_PAYLOAD + 1) * 64 + 1000;
+    double start = Now();
+    while ((host.verified < bytes || module.verified < bytes) && transfers < limit) {
+        Feed(&host, bytes);
+        Feed(&module, bytes);
+
+        SPI_LinkBuild(&host.link, host_block);
+        SPI_LinkBuild(&module.link, module_block);
+        Corrupt(host_block, ber);
+        Corrupt(module_block, ber);
+        SPI_LinkReceive(&module.link, host_block);
+        SPI_LinkReceive(&host.link, module_block);
+        transfers++;
+
+        Drain(&host);
+        Drain(&module);
+    }
+    double elapsed = Now() - start;
+
+    const SPI_LinkStats *hs = &host.link.stats;
+    const SPI_LinkStats *ms = &module.link.stats;
+    double wire_bytes = (double)transfers * SPI_LINK_BLOCK;
+    double payload = (double)host.verified + module.verified;
+    double wire_s = wire_bytes * 8 / (clock_mhz * 1e6);
+
+    printf("块 %u 字节，负载上限 %u，窗口 %u，通道 %u\n", SPI_LINK_BLOCK, SPI_LINK_MAX_PAYLOAD,
+           SPI_LINK_WINDOW, SPI_LINK_CHANNELS);
+    printf("传输 %u 次，主机→模块 %u 字节，模块→主机 %u 字节，校验错误 %u\n", transfers,
+           module.verified, host.verified, host.mismatches + module.mismatches);
+    printf("重发 %u/%u 帧，CRC 错误 %u，丢弃 %u\n", hs->retransmits + ms->retransmits,
+           hs->data_frames + ms->data_frames, hs->crc_errors + ms->crc_errors,
+           hs->rx_dropped + ms->rx_dropped);
+    printf("线上效率 %.1f%% (每方向负载/交换字节)，%.1f MHz 下每方向 %.2f Mbit/s\n",
+           wire_bytes ? payload / 2 / wire_bytes * 100.0 : 0.0, clock_mhz,
+           wire_s > 0 ? payload / 2 * 8 / wire_s / 1e6 : 0.0);
+    printf("本机成帧处理 %.1f MB/s (%.2f us/块)\n", elapsed > 0 ? payload / elapsed / 1e6 : 0.0,
+           transfers ? elapsed * 1e6 / transfers / 2 : 0.0);
+
+    bool ok = host.verified == bytes && module.verified == bytes &&
+              host.mismatches == 0 && module.mismatches == 0;
+    return ok ? 0 : 1;
+}
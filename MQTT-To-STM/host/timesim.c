@@ -0,0 +1,115 @@
+/**
+  * @file    timesim.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   时钟同步 (mqtt_time.c) 回环测试：偏移 / 频偏收敛与带时间戳发布
+  *
+  * 用法:
+  *   fleetsim broker --port 18830 --time-offset-ms 123456 --time-skew-ppm 80 &
+  *   timesim [--host 127.0.0.1] [--port 1883] [--duration 60] [--period 5]
+  *           [--rate 5] [--queue-ms 30]
+  *
+  * 协议引擎每 --period 秒强制一轮同步 (代替默认的 MQTT_TIME_INTERVAL_MS)，
+  * 并以 --rate 条/秒发布带时间戳的消息，采集时刻在发出前 0~--queue-ms 毫秒内
+  * 随机，模拟设备内排队。每秒打印偏移、频偏与 MQTT_Time_Now() 相对本机系统
+  * 时间的差值；Broker 替身每秒打印排队与网络耗时。频偏估计至少需要
+  * MQTT_TIME_DRIFT_SPAN_MS 的历史。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static int64_t UnixMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    uint16_t port = 1883;
+    uint32_t duration = 60;
+    uint32_t period = 5;
+    double rate = 5.0;
+    uint32_t queue_ms = 30;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--host") == 0) host = argv[i + 1];
+        else if (strcmp(argv[i], "--port") == 0) port = (uint16_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--duration") == 0) duration = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--period") == 0) period = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--rate") == 0) rate = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--queue-ms") == 0) queue_ms = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else {
+            fprintf(stderr, "未知参数: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (period == 0) {
+        fprintf(stderr, "--period 须大于 0\n");
+        return 1;
+    }
+
+    static MQTT_SocketCtx sock_ctx;
+    static MQTT_Transport sock;
+    static char time_topic[48], tele_topic[48];
+    snprintf(time_topic, sizeof(time_topic), "timesim/%d/time", (int)getpid());
+    snprintf(tele_topic, sizeof(tele_topic), "timesim/%d/tele", (int)getpid());
+    MQTT_SocketTransportInit(&sock, &sock_ctx, host, port);
+    MQTT_SetTransport(&sock);
+    MQTT_TopicId tele = MQTT_RegisterTopic(tele_topic);
+    if (!MQTT_Start() || tele == MQTT_TOPIC_INVALID || !MQTT_Time_Init(time_topic)) {
+        fprintf(stderr, "连接 %s:%u 失败\n", host, port);
+        return 1;
+    }
+
+    const MQTT_TimeStatus *st = MQTT_Time_GetStatus();
+    uint32_t start = HAL_GetTick();
+    uint32_t last_sync = start, last_report = start, last_pub = start;
+    uint32_t pub_interval = rate > 0 ? (uint32_t)(1000.0 / rate) : 0;
+    uint32_t seq = 0;
+
+    printf("%6s %14s %10s %8s %7s %7s %12s\n", "秒", "偏移(ms)", "频偏(ppm)", "RTT", "轮数", "超时",
+           "Now-系统(ms)");
+    while (HAL_GetTick() - start < duration * 1000u) {
+        MQTT_Service();
+        MQTT_Time_Service();
+        uint32_t now = HAL_GetTick();
+
+        if (now - last_sync >= period * 1000u) {
+            last_sync = now;
+            MQTT_Time_Sync();
+        }
+        if (pub_interval > 0 && now - last_pub >= pub_interval) {
+            char msg[32];
+            last_pub = now;
+            uint32_t capture = now - (queue_ms ? (uint32_t)rand() % (queue_ms + 1) : 0);
+            int n = snprintf(msg, sizeof(msg), "seq=%lu", (unsigned long)seq++);
+            MQTT_Time_Publish(tele, capture, (const uint8_t *)msg, (uint16_t)n);
+        }
+        if (now - last_report >= 1000) {
+            last_report = now;
+            int64_t vs_system = st->synced ? (int64_t)MQTT_Time_Now() - UnixMs() : 0;
+            printf("%6lu %14lld %10.1f %8lu %7lu %7lu %12lld\n", (unsigned long)((now - start) / 1000),
+                   (long long)st->offset_ms, st->drift_ppb / 1000.0, (unsigned long)st->rtt_ms,
+                   (unsigned long)st->rounds, (unsigned long)st->timeouts, (long long)vs_system);
+        }
+        HAL_Delay(2);
+    }
+
+    printf("交换 %lu 次，超时 %lu 次，带时间戳发布 %lu 条\n", (unsigned long)st->exchanges,
+           (unsigned long)st->timeouts, (unsigned long)st->stamped);
+    return st->synced ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+"""飞行记录器 (mqtt_trace.h) 转 Chrome trace。
+
+用法:
+  mosquitto_sub -h broker -t dev/xrak/trace -N > trace.bin     # 收集上传的消息
+  python3 trace2chrome.py trace.bin -o trace.json [--topic dev/xrak/led ...]
+  python3 trace2chrome.py --ring ram.bin -o trace.json         # 调试器导出的 .noinit 环形缓冲
+
+输入为上传消息首尾相接的二进制流 (可多个文件，按序号排序去重)；--ring 时为
+MQTT_TraceRing_t 的内存镜像。输出在 chrome://tracing 或 ui.perfetto.dev 打开，
+每次启动为一个进程。复位前未结束的区间 (如卡住的 AT 指令) 同时打印到终端。
+"""
+import argparse
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<2sBBII")  # "TR", 版本, 条数, 首条序号, 启动次数
+RECORD = struct.Struct("<IBBH")    # time_us, event, phase, arg
+RING_HEADER = struct.Struct("<IIIII")  # magic, check, boot, seq, flushed
+RING_MAGIC = 0x4D545231
+
+EV_BOOT, EV_AT, EV_SEND, EV_STAGE, EV_QUEUE, EV_CALLBACK = 1, 2, 3, 4, 5, 6
+EV_USER = 64
+
+STAGES = {1: "open", 2: "at_check", 3: "wifi", 4: "link", 5: "mqtt_connect"}
+AT_RESULTS = {0: "ok", 1: "fail", 2: "timeout"}
+
+# conn.c 使用的 AT 指令及常见指令：按指令名 (截至 '=' / '?' / '\r') 哈希还原
+AT_COMMANDS = [
+    "AT", "ATE0", "AT+RST", "AT+GMR", "AT+CWMODE", "AT+CWJAP", "AT+CWQAP", "AT+CWLAP",
+    "AT+CWDHCP", "AT+CIPSTA", "AT+CIPDOMAIN", "AT+CIPSTART", "AT+CIPSEND", "AT+CIPCLOSE",
+    "AT+CIPSTATUS", "AT+CIPMUX", "AT+CIPRECVMODE", "AT+CIPRECVLEN", "AT+CIPRECVDATA",
+    "AT+CIPSSLSIZE", "AT+CIPSSLCCONF", "AT+CIPSNTPCFG", "AT+CIPSNTPTIME", "AT+SLEEP",
+]
+
+
+def trace_hash(text):
+    """与 MQTT_TraceHash 相同：FNV-1a 32 位折叠为 16 位"""
+    h = 2166136261
+    for b in text.encode():
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return ((h >> 16) ^ h) & 0xFFFF
+
+
+def read_batches(data):
+    """拆分首尾相接的上传消息，返回 [(首条序号, [记录...])]"""
+    batches = []
+    pos = 0
+    while pos + HEADER.size <= len(data):
+        magic, version, count, first, _boot = HEADER.unpack_from(data, pos)
+        end = pos + HEADER.size + count * RECORD.size
+        if magic != b"TR" or version != 1 or end > len(data):
+            # 跳过无法识别的字节 (如 mosquitto_sub 未加 -N 时的换行)
+            pos += 1
+            continue
+        records = [RECORD.unpack_from(data, pos + HEADER.size + i * RECORD.size) for i in range(count)]
+        batches.append((first, records))
+        pos = end
+    return batches
+
+
+def read_ring(data):
+    """解析 .noinit 环形缓冲镜像，返回一个覆盖全部有效记录的批次"""
+    magic, check, boot, seq, _flushed = RING_HEADER.unpack_from(data, 0)
+    if magic != RING_MAGIC or check != (~RING_MAGIC ^ boot) & 0xFFFFFFFF:
+        sys.exit("环形缓冲校验失败 (magic/check 不符)")
+    size = (len(data) - RING_HEADER.size) // RECORD.size
+    if size & (size - 1):
+        sys.exit(f"记录条数 {size} 不是 2 的幂，请按 sizeof(MQTT_TraceRing_t) 导出")
+    first = max(0, seq - size)
+    records = []
+    for s in range(first, seq):
+        records.append(RECORD.unpack_from(data, RING_HEADER.size + (s % size) * RECORD.size))
+    return [(first, records)]
+
+
+def merge(batches):
+    """按序号排序去重，返回 [(序号, 记录)]；缺失处为 (首个缺失序号, 缺失条数)"""
+    by_seq = {}
+    for first, records in batches:
+        for i, rec in enumerate(records):
+            by_seq[first + i] = rec
+    out = []
+    prev = None
+    for seq in sorted(by_seq):
+        if prev is not None and seq != prev + 1:
+            out.append((prev + 1, seq - prev - 1))  # 丢失 n 条
+        out.append((seq, by_seq[seq]))
+        prev = seq
+    return out
+
+
+def convert(entries, topics):
+    names = {trace_hash(c): c for c in AT_COMMANDS}
+    topic_names = {trace_hash(t): t for t in topics}
+    events = []
+    pid = 0
+    base = 0       # 当前启动的时间展开量 (32 位微秒回绕)
+    last = None
+    stacks = {}    # pid -> [(名称, 开始时间)]
+    reports = []
+
+    def process_name(p, label):
+        events.append({"ph": "M", "name": "process_name", "pid": p, "tid": 0, "args": {"name": label}})
+
+    def close_session(p):
+        if stacks.get(p):
+            open_names = " > ".join(f"{n} (已持续 {(last - t) / 1000:.1f} ms)" for n, t in stacks[p])
+            reports.append(f"启动 {p} 结束时未完成: {open_names}")
+
+    process_name(0, "复位前 (部分记录已被覆盖)")
+    for seq, rec in entries:
+        if isinstance(rec, int):
+            events.append({"ph": "i", "s": "p", "name": f"丢失 {rec} 条记录", "pid": pid, "tid": 0,
+                           "ts": last or 0})
+            continue
+        t, event, phase, arg = rec
+        if event == EV_BOOT:
+            close_session(pid)
+            pid += 1
+            base = 0
+            last = None
+            process_name(pid, f"启动 {pid} (复位原因 0x{arg:02X})")
+        if last is not None and t + base < last and last - (t + base) > 1 << 31:
+            base += 1 << 32
+        ts = t + base
+        last = ts
+        phase = chr(phase)
+
+        if event == EV_BOOT:
+            events.append({"ph": "i", "s": "p", "name": "boot", "pid": pid, "tid": 0, "ts": ts,
+                           "args": {"reset_cause": arg, "seq": seq}})
+            continue
+        if event == EV_QUEUE:
+            events.append({"ph": "C", "name": "inbound_queue", "pid": pid, "tid": 0, "ts": ts,
+                           "args": {"depth": arg}})
+            continue
+
+        stack = stacks.setdefault(pid, [])
+        if phase == "B":
+            if event == EV_AT:
+                name = names.get(arg, f"AT#{arg:04X}") if arg else "AT wait"
+                args = {}
+            elif event == EV_SEND:
+                name, args = "send", {"bytes": arg}
+            elif event == EV_STAGE:
+                name, args = STAGES.get(arg, f"stage {arg}"), {}
+            elif event == EV_CALLBACK:
+                name, args = f"callback {topic_names.get(arg, f'#{arg:04X}')}", {}
+            else:
+                name, args = f"user {event - EV_USER}", {"arg": arg}
+            stack.append((name, ts))
+            events.append({"ph": "B", "name": name, "pid": pid, "tid": 0, "ts": ts, "args": args})
+        elif phase == "E":
+            if stack:
+                stack.pop()
+            if event == EV_AT:
+                args = {"result": AT_RESULTS.get(arg, arg)}
+            elif event in (EV_SEND, EV_STAGE):
+                args = {"ok": arg == 0}
+            else:
+                args = {"arg": arg}
+            events.append({"ph": "E", "pid": pid, "tid": 0, "ts": ts, "args": args})
+        else:
+            events.append({"ph": "i", "s": "t", "name": f"event {event}", "pid": pid, "tid": 0, "ts": ts,
+                           "args": {"arg": arg}})
+    close_session(pid)
+    return events, reports, pid
+
+
+def main():
+    parser = argparse.ArgumentParser(description="飞行记录器转 Chrome trace")
+    parser.add_argument("inputs", nargs="+", help="上传消息的二进制流 (或 --ring 内存镜像)")
+    parser.add_argument("-o", "--output", default="trace.json")
+    parser.add_argument("--ring", action="store_true", help="输入为 .noinit 环形缓冲的内存镜像")
+    parser.add_argument("--topic", action="append", default=[], help="用于还原回调名称的主题 (可重复)")
+    args = parser.parse_args()
+
+    batches = []
+    for path in args.inputs:
+        with open(path, "rb") as f:
+            data = f.read()
+        batches += read_ring(data) if args.ring else read_batches(data)
+    entries = merge(batches)
+    lost = sum(rec for _, rec in entries if isinstance(rec, int))
+    total = sum(1 for _, rec in entries if not isinstance(rec, int))
+    events, reports, sessions = convert(entries, args.topic)
+
+    with open(args.output, "w") as f:
+        json.dump({"traceEvents": events, "displayTimeUnit": "ms"}, f)
+    print(f"{total} 条记录 ({lost} 条丢失)，{sessions} 次启动 -> {args.output}")
+    for line in reports:
+        print(line)
+
+
+if __name__ == "__main__":
+    main()
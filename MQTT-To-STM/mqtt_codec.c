@@ -0,0 +1,233 @@
+/**
+  * @file    mqtt_codec.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   MQTT 3.1.1 报文编解码 (不依赖 HAL，可在主机上编译)
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件，从 conn.c 拆分编解码与主题匹配
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_codec.h"
+#include <string.h>
+
+/* ==========================================
+ * 基础编码
+ * ========================================== */
+
+uint8_t mqtt_encode_len(uint8_t *buf, uint32_t length)
+{
+    uint8_t len_bytes = 0;
+    do {
+        uint8_t encoded_byte = length % 128;
+        length /= 128;
+        if (length > 0) {
+            encoded_byte |= 0x80;
+        }
+        buf[len_bytes++] = encoded_byte;
+    } while (length > 0);
+    return len_bytes;
+}
+
+uint16_t mqtt_encode_string(uint8_t *buf, const char *str)
+{
+    uint16_t len = strlen(str);
+    buf[0] = (len >> 8) & 0xFF;
+    buf[1] = len & 0xFF;
+    memcpy(&buf[2], str, len);
+    return len + 2;
+}
+
+uint8_t MQTT_BuildFixedHeader(uint8_t *buf, uint8_t type, uint32_t remaining_len)
+{
+    buf[0] = type;
+    return 1 + mqtt_encode_len(&buf[1], remaining_len);
+}
+
+/* 固定报头最多 5 字节：类型 1 字节 + 剩余长度 4 字节 */
+static bool mqtt_fits(uint16_t size, uint32_t remaining_len)
+{
+    return remaining_len + 5 <= size;
+}
+
+/* ==========================================
+ * 报文构建
+ * ========================================== */
+
+uint16_t MQTT_BuildConnect(uint8_t *buf, uint16_t size, const char *client_id, uint16_t keepalive)
+{
+    /* Variable Header: Protocol Name(string) + Level(1) + Flags(1) + KeepAlive(2) */
+    /* Payload: Client ID (string) */
+    uint32_t remaining_len = (2 + 4) + 1 + 1 + 2 + (2 + strlen(client_id));
+    uint16_t idx = 0;
+
+    if (!mqtt_fits(size, remaining_len)) return 0;
+
+    buf[idx++] = MQTT_PKT_CONNECT;
+    idx += mqtt_encode_len(&buf[idx], remaining_len);
+
+    /* Variable Header */
+    idx += mqtt_encode_string(&buf[idx], MQTT_PROTOCOL_NAME);
+    buf[idx++] = MQTT_PROTOCOL_LEVEL;
+    buf[idx++] = MQTT_FLAG_CLEAN_SESSION;
+    buf[idx++] = (keepalive >> 8) & 0xFF;
+    buf[idx++] = keepalive & 0xFF;
+
+    /* Payload: Client ID */
+    idx += mqtt_encode_string(&buf[idx], client_id);
+    return idx;
+}
+
+uint16_t MQTT_BuildPublish(uint8_t *buf, uint16_t size, const char *topic,
+                           const uint8_t *payload, uint16_t payload_len)
+{
+    uint32_t remaining_len = (2 + strlen(topic)) + payload_len;
+    uint16_t idx = 0;
+
+    if (!mqtt_fits(size, remaining_len)) return 0;
+
+    /* Fixed Header */
+    buf[idx++] = MQTT_PKT_PUBLISH;
+    idx += mqtt_encode_len(&buf[idx], remaining_len);
+
+    /* Variable Header: Topic */
+    idx += mqtt_encode_string(&buf[idx], topic);
+
+    /* Payload: Message */
+    memcpy(&buf[idx], payload, payload_len);
+    idx += payload_len;
+    return idx;
+}
+
+uint16_t MQTT_BuildSubscribe(uint8_t *buf, uint16_t size, uint16_t packet_id,
+                             const char *filter, uint8_t qos)
+{
+    /* Variable Header: Packet ID(2) */
+    /* Payload: Topic Filter(string) + QoS(1) */
+    uint32_t remaining_len = 2 + (2 + strlen(filter)) + 1;
+    uint16_t idx = 0;
+
+    if (!mqtt_fits(size, remaining_len)) return 0;
+
+    /* Fixed Header */
+    buf[idx++] = MQTT_PKT_SUBSCRIBE;
+    idx += mqtt_encode_len(&buf[idx], remaining_len);
+
+    /* Variable Header: Packet ID */
+    buf[idx++] = (packet_id >> 8) & 0xFF;
+    buf[idx++] = packet_id & 0xFF;
+
+    /* Payload: Topic Filter + QoS */
+    idx += mqtt_encode_string(&buf[idx], filter);
+    buf[idx++] = qos;
+    return idx;
+}
+
+uint16_t MQTT_BuildUnsubscribe(uint8_t *buf, uint16_t size, uint16_t packet_id, const char *filter)
+{
+    /* Variable Header: Packet ID(2) */
+    /* Payload: Topic Filter(string) */
+    uint32_t remaining_len = 2 + (2 + strlen(filter));
+    uint16_t idx = 0;
+
+    if (!mqtt_fits(size, remaining_len)) return 0;
+
+    /* Fixed Header */
+    buf[idx++] = MQTT_PKT_UNSUBSCRIBE;
+    idx += mqtt_encode_len(&buf[idx], remaining_len);
+
+    /* Variable Header: Packet ID */
+    buf[idx++] = (packet_id >> 8) & 0xFF;
+    buf[idx++] = packet_id & 0xFF;
+
+    /* Payload: Topic Filter */
+    idx += mqtt_encode_string(&buf[idx], filter);
+    return idx;
+}
+
+/* ==========================================
+ * 报文解析
+ * ========================================== */
+
+int MQTT_PacketLength(const uint8_t *buf, uint32_t len, uint32_t *total_len)
+{
+    uint32_t rem_len = 0;
+    uint32_t multiplier = 1;
+    uint32_t i = 1;
+
+    /* 解析剩余长度 (最多 4 字节) */
+    do {
+        if (i >= len) return 0; /* 长度字段尚未收全 */
+        if (i > 4) return -1;
+        rem_len += (buf[i] & 127) * multiplier;
+        multiplier *= 128;
+        i++;
+    } while ((buf[i - 1] & 128) != 0);
+
+    *total_len = i + rem_len;
+    return (len >= *total_len) ? 1 : 0;
+}
+
+bool MQTT_ParsePublish(const uint8_t *pkt, uint32_t total_len, MQTT_PublishView *view)
+{
+    if ((pkt[0] & 0xF0) != MQTT_PKT_PUBLISH) return false;
+
+    /* 跳过固定报头 */
+    uint32_t i = 1;
+    while (i < total_len && (pkt[i] & 128) != 0) i++;
+    i++;
+    if (i + 2 > total_len) return false;
+
+    view->qos = (pkt[0] >> 1) & 0x03;
+    view->retain = (pkt[0] & 0x01) != 0;
+
+    /* Topic Length */
+    view->topic_len = (pkt[i] << 8) | pkt[i + 1];
+    view->topic = &pkt[i + 2];
+
+    /* Payload Start */
+    uint32_t payload_start = i + 2 + view->topic_len;
+    view->packet_id = 0;
+    if (view->qos > 0) {
+        if (payload_start + 2 > total_len) return false;
+        view->packet_id = (pkt[payload_start] << 8) | pkt[payload_start + 1];
+        payload_start += 2; /* Packet ID */
+    }
+    if (payload_start > total_len) return false;
+
+    view->payload = &pkt[payload_start];
+    view->payload_len = total_len - payload_start;
+    return true;
+}
+
+bool MQTT_TopicMatched(const char *filter, const char *topic)
+{
+    const char *f = filter;
+    const char *t = topic;
+
+    while (*f && *t) {
+        if (*f == '+') {
+            /* + 匹配一个层级 */
+            f++;
+            while (*t && *t != '/') t++;
+            continue;
+        } else if (*f == '#') {
+            /* # 匹配剩余所有 */
+            return true;
+        } else {
+            if (*f != *t) return false;
+        }
+        f++;
+        t++;
+    }
+
+    /* 完全匹配 */
+    if (*f == '\0' && *t == '\0') return true;
+
+    /* 特殊情况: "path/#" 匹配 "path" */
+    if (*f == '#' && f > filter && *(f-1) == '/' && *t == '\0') return true;
+
+    return false;
+}
@@ -0,0 +1,124 @@
+/**
+  * @file    mqtt_codec.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   MQTT 3.1.1 报文编解码 (不依赖 HAL，可在主机上编译)
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件，从 conn.c 拆分编解码与主题匹配
+  * -----------------------------------------------------------------------------
+  */
+#ifndef __MQTT_CODEC_H
+#define __MQTT_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ==========================================
+ * MQTT 协议常量
+ * ========================================== */
+#define MQTT_PKT_CONNECT 0x10     /* 连接请求 */
+#define MQTT_PKT_CONNACK 0x20     /* 连接确认 */
+#define MQTT_PKT_PUBLISH 0x30     /* 发布消息 */
+#define MQTT_PKT_PUBACK 0x40      /* 发布确认 */
+#define MQTT_PKT_SUBSCRIBE 0x82   /* 订阅请求 (QoS 1) */
+#define MQTT_PKT_SUBACK 0x90      /* 订阅确认 */
+#define MQTT_PKT_UNSUBSCRIBE 0xA2 /* 取消订阅请求 */
+#define MQTT_PKT_UNSUBACK 0xB0    /* 取消订阅确认 */
+#define MQTT_PKT_PINGREQ 0xC0     /* 心跳请求 */
+#define MQTT_PKT_PINGRESP 0xD0    /* 心跳响应 */
+#define MQTT_PKT_DISCONNECT 0xE0  /* 断开连接 */
+
+#define MQTT_PUBLISH_RETAIN 0x01  /* PUBLISH 标志：保留消息 */
+
+#define MQTT_PROTOCOL_NAME "MQTT"
+#define MQTT_PROTOCOL_LEVEL 0x04     /* MQTT 3.1.1 */
+#define MQTT_FLAG_CLEAN_SESSION 0x02 /* 清除会话标志 */
+
+/**
+ * @brief 收到的 PUBLISH 报文视图 (指向原缓冲区，不复制)
+ */
+typedef struct {
+    const uint8_t *topic;    /* 主题 (不以 '\0' 结尾) */
+    uint16_t topic_len;
+    const uint8_t *payload;  /* 消息内容 (可含二进制) */
+    uint32_t payload_len;
+    uint8_t qos;
+    bool retain;
+    uint16_t packet_id;      /* QoS > 0 时有效 */
+} MQTT_PublishView;
+
+/* ==========================================
+ * 基础编码
+ * ========================================== */
+
+/**
+ * @brief 编码剩余长度 (变长整数，1~4 字节)
+ * @return 写入的字节数
+ */
+uint8_t mqtt_encode_len(uint8_t *buf, uint32_t length);
+
+/**
+ * @brief 编码带 2 字节长度前缀的字符串
+ * @return 写入的字节数 (长度 + 2)
+ */
+uint16_t mqtt_encode_string(uint8_t *buf, const char *str);
+
+/**
+ * @brief 编码固定报头 (类型 + 剩余长度)，用于分段 (writev) 发送
+ * @param buf 至少 5 字节
+ * @return 写入的字节数 (2~5)
+ */
+uint8_t MQTT_BuildFixedHeader(uint8_t *buf, uint8_t type, uint32_t remaining_len);
+
+/* ==========================================
+ * 报文构建
+ * 均返回报文总长度；缓冲区不足时返回 0
+ * ========================================== */
+uint16_t MQTT_BuildConnect(uint8_t *buf, uint16_t size, const char *client_id, uint16_t keepalive);
+uint16_t MQTT_BuildPublish(uint8_t *buf, uint16_t size, const char *topic,
+                           const uint8_t *payload, uint16_t payload_len);
+uint16_t MQTT_BuildSubscribe(uint8_t *buf, uint16_t size, uint16_t packet_id,
+                             const char *filter, uint8_t qos);
+uint16_t MQTT_BuildUnsubscribe(uint8_t *buf, uint16_t size, uint16_t packet_id, const char *filter);
+
+/* ==========================================
+ * 报文解析
+ * ========================================== */
+
+/**
+ * @brief 从字节流开头定界一个完整报文
+ *
+ * @param buf 字节流
+ * @param len 已收到的字节数
+ * @param total_len [out] 报文总长度 (固定报头 + 剩余长度)
+ * @return 1 报文已完整；0 尚未收全；-1 剩余长度字段非法
+ */
+int MQTT_PacketLength(const uint8_t *buf, uint32_t len, uint32_t *total_len);
+
+/**
+ * @brief 解析完整的 PUBLISH 报文
+ * @param pkt 报文起始地址
+ * @param total_len 报文总长度 (来自 MQTT_PacketLength)
+ * @param view [out] 报文视图
+ * @return true 解析成功
+ * @return false 非 PUBLISH 或格式错误
+ */
+bool MQTT_ParsePublish(const uint8_t *pkt, uint32_t total_len, MQTT_PublishView *view);
+
+/**
+ * @brief 检查 Topic 是否匹配 Filter (支持 + 和 #)
+ */
+bool MQTT_TopicMatched(const char *filter, const char *topic);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MQTT_CODEC_H */
@@ -0,0 +1,243 @@
+/**
+  * @file    mqtt_lz.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   大消息的流式压缩发布与解压接收 (LZSS，窗口有界)
+  *
+  * 编码与 heatshrink 相同：标志位 1 + 8 位字面量，或标志位 0 + 回溯距离-1
+  * (WINDOW_BITS 位) + 匹配长度-1 (LOOKAHEAD_BITS 位)，高位在前，末字节补 0。
+  * 匹配在窗口内逐位置比较 (先比首字节)，不建索引，省去索引表的 RAM。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_lz.h"
+#include <string.h>
+
+#if MQTT_LZ_WINDOW_BITS < 4 || MQTT_LZ_WINDOW_BITS > 12 || \
+    MQTT_LZ_LOOKAHEAD_BITS < 3 || MQTT_LZ_LOOKAHEAD_BITS >= MQTT_LZ_WINDOW_BITS
+#error "MQTT_LZ_WINDOW_BITS / MQTT_LZ_LOOKAHEAD_BITS 超出范围"
+#endif
+
+#define MQTT_LZ_REF_BITS (1 + MQTT_LZ_WINDOW_BITS + MQTT_LZ_LOOKAHEAD_BITS)
+#define MQTT_LZ_MIN_MATCH (MQTT_LZ_REF_BITS / 9 + 1) /* 回溯比等长字面量更短的最小长度 */
+
+/* ==========================================
+ * 发送端
+ * ========================================== */
+
+static void MQTT_Lz_PutBits(MQTT_LzEncoder *enc, uint16_t value, uint8_t count)
+{
+    while (count-- > 0) {
+        if (enc->bits == 0) {
+            enc->out[enc->out_len] = 0;
+        }
+        if ((value >> count) & 1) {
+            enc->out[enc->out_len] |= (uint8_t)(0x80 >> enc->bits);
+        }
+        if (++enc->bits == 8) {
+            enc->bits = 0;
+            enc->out_len++;
+        }
+    }
+}
+
+/**
+ * @brief 发布当前块，下一块从当前位置重新开始窗口
+ */
+static bool MQTT_Lz_Flush(MQTT_LzEncoder *enc, bool last)
+{
+    uint16_t len = enc->out_len + (enc->bits ? 1 : 0);
+
+    enc->out[0] = (uint8_t)(MQTT_LZ_MAGIC | (enc->first ? MQTT_LZ_FIRST : 0) | (last ? MQTT_LZ_LAST : 0));
+    enc->out[1] = enc->seq;
+    if (!MQTT_PublishById(enc->id, enc->out, len)) return false;
+
+    enc->out_total += len;
+    enc->seq++;
+    enc->first = false;
+    enc->out_len = MQTT_LZ_HEADER;
+    enc->bits = 0;
+    enc->floor = enc->start;
+    return true;
+}
+
+/**
+ * @brief 输出一个字面量或回溯
+ * @param avail 当前位置可用于匹配的数据量
+ */
+static bool MQTT_Lz_Step(MQTT_LzEncoder *enc, uint16_t avail)
+{
+    /* 放不下最长的记号：先发出本块 */
+    if ((uint32_t)(MQTT_LZ_CHUNK - enc->out_len) * 8 - enc->bits < MQTT_LZ_REF_BITS) {
+        if (!MQTT_Lz_Flush(enc, false)) return false;
+    }
+
+    const uint8_t *cur = &enc->win[enc->start];
+    uint16_t lo = (enc->start > enc->floor + MQTT_LZ_WINDOW) ? enc->start - MQTT_LZ_WINDOW : enc->floor;
+    uint16_t best_len = 0, best_pos = 0;
+
+    if (avail > MQTT_LZ_MAX_MATCH) avail = MQTT_LZ_MAX_MATCH;
+    /* 由近及远，同样长度取距离最近者 */
+    for (uint16_t p = enc->start; p-- > lo;) {
+        if (enc->win[p] != cur[0]) continue;
+        uint16_t n = 1;
+        while (n < avail && enc->win[p + n] == cur[n]) n++;
+        if (n > best_len) {
+            best_len = n;
+            best_pos = p;
+            if (n == avail) break;
+        }
+    }
+
+    if (best_len >= MQTT_LZ_MIN_MATCH) {
+        MQTT_Lz_PutBits(enc, 0, 1);
+        MQTT_Lz_PutBits(enc, (uint16_t)(enc->start - best_pos - 1), MQTT_LZ_WINDOW_BITS);
+        MQTT_Lz_PutBits(enc, (uint16_t)(best_len - 1), MQTT_LZ_LOOKAHEAD_BITS);
+        enc->start += best_len;
+    } else {
+        MQTT_Lz_PutBits(enc, 1, 1);
+        MQTT_Lz_PutBits(enc, cur[0], 8);
+        enc->start++;
+    }
+    return true;
+}
+
+void MQTT_Lz_Begin(MQTT_LzEncoder *enc, MQTT_TopicId id)
+{
+    enc->start = 0;
+    enc->fill = 0;
+    enc->floor = 0;
+    enc->out_len = MQTT_LZ_HEADER;
+    enc->bits = 0;
+    enc->seq = 0;
+    enc->first = true;
+    enc->id = id;
+    enc->in_total = 0;
+    enc->out_total = 0;
+}
+
+bool MQTT_Lz_Write(MQTT_LzEncoder *enc, const uint8_t *data, uint32_t len)
+{
+    while (len > 0) {
+        /* 缓冲已满：丢弃窗口之外的历史 */
+        if (enc->fill == sizeof(enc->win)) {
+            uint16_t keep = (enc->start > enc->floor + MQTT_LZ_WINDOW) ? enc->start - MQTT_LZ_WINDOW : enc->floor;
+            memmove(enc->win, &enc->win[keep], enc->fill - keep);
+            enc->fill -= keep;
+            enc->start -= keep;
+            enc->floor -= keep;
+        }
+
+        uint16_t n = sizeof(enc->win) - enc->fill;
+        if (n > len) n = (uint16_t)len;
+        memcpy(&enc->win[enc->fill], data, n);
+        enc->fill += n;
+        enc->in_total += n;
+        data += n;
+        len -= n;
+
+        /* 攒够最长匹配再压缩，保证匹配长度不受分段写入影响 */
+        while ((uint16_t)(enc->fill - enc->start) >= MQTT_LZ_MAX_MATCH) {
+            if (!MQTT_Lz_Step(enc, MQTT_LZ_MAX_MATCH)) return false;
+        }
+    }
+    return true;
+}
+
+bool MQTT_Lz_End(MQTT_LzEncoder *enc)
+{
+    while (enc->start < enc->fill) {
+        if (!MQTT_Lz_Step(enc, enc->fill - enc->start)) return false;
+    }
+    return MQTT_Lz_Flush(enc, true);
+}
+
+bool MQTT_Lz_Publish(MQTT_LzEncoder *enc, MQTT_TopicId id, const uint8_t *data, uint32_t len)
+{
+    MQTT_Lz_Begin(enc, id);
+    return MQTT_Lz_Write(enc, data, len) && MQTT_Lz_End(enc);
+}
+
+/* ==========================================
+ * 接收端
+ * ========================================== */
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t bit;   /* 已读位数 */
+    uint32_t total; /* 总位数 */
+} MQTT_LzBits;
+
+static uint16_t MQTT_Lz_GetBits(MQTT_LzBits *in, uint8_t count)
+{
+    uint16_t value = 0;
+    while (count-- > 0) {
+        value = (uint16_t)((value << 1) | ((in->data[in->bit >> 3] >> (7 - (in->bit & 7))) & 1));
+        in->bit++;
+    }
+    return value;
+}
+
+bool MQTT_Lz_Receive(MQTT_LzDecoder *dec, const uint8_t *payload, uint32_t len, MQTT_LzHandler handler)
+{
+    if (len < MQTT_LZ_HEADER || (payload[0] & 0xF0) != MQTT_LZ_MAGIC) {
+        handler(payload, len, MQTT_LZ_FIRST | MQTT_LZ_LAST); /* 未压缩的消息 */
+        return true;
+    }
+
+    uint8_t flags = payload[0] & (MQTT_LZ_FIRST | MQTT_LZ_LAST);
+    uint8_t seq = payload[1];
+    bool ok = true;
+
+    /* 每块独立解压：缺块只记录，不影响本块 */
+    if ((flags & MQTT_LZ_FIRST) ? (dec->active || seq != 0) : (!dec->active || seq != dec->next_seq)) {
+        dec->gaps++;
+        ok = false;
+    }
+    dec->next_seq = (uint8_t)(seq + 1);
+    dec->active = (flags & MQTT_LZ_LAST) == 0;
+
+    MQTT_LzBits in = {payload + MQTT_LZ_HEADER, 0, (len - MQTT_LZ_HEADER) * 8};
+    uint8_t pending = flags & MQTT_LZ_FIRST;
+    uint16_t head = 0;
+    uint32_t produced = 0;
+
+    while (in.total - in.bit >= 1 + 8) {
+        uint16_t offset = 0, count = 1;
+        uint8_t literal = 0;
+
+        if (MQTT_Lz_GetBits(&in, 1)) {
+            literal = (uint8_t)MQTT_Lz_GetBits(&in, 8);
+        } else {
+            if (in.total - in.bit < MQTT_LZ_WINDOW_BITS + MQTT_LZ_LOOKAHEAD_BITS) break; /* 末字节补位 */
+            offset = MQTT_Lz_GetBits(&in, MQTT_LZ_WINDOW_BITS) + 1;
+            count = MQTT_Lz_GetBits(&in, MQTT_LZ_LOOKAHEAD_BITS) + 1;
+            if (offset > produced) {
+                dec->errors++;
+                ok = false;
+                break;
+            }
+        }
+
+        while (count-- > 0) {
+            dec->win[head] = offset ? dec->win[(head - offset) & (MQTT_LZ_WINDOW - 1)] : literal;
+            produced++;
+            if (++head == MQTT_LZ_WINDOW) {
+                /* 窗口写满一圈：先交出，回溯读取的仍是最近 WINDOW 字节 */
+                handler(dec->win, MQTT_LZ_WINDOW, pending);
+                pending = 0;
+                head = 0;
+            }
+        }
+    }
+
+    pending |= flags & MQTT_LZ_LAST;
+    if (head > 0 || pending) {
+        handler(dec->win, head, pending);
+    }
+    return ok;
+}
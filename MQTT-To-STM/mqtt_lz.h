@@ -0,0 +1,127 @@
+/**
+  * @file    mqtt_lz.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   大消息的流式压缩发布与解压接收 (LZSS，窗口有界)
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef __MQTT_LZ_H
+#define __MQTT_LZ_H
+
+#include "conn.h"
+
+/* ==========================================
+ * 用户配置区域
+ * ========================================== */
+#define MQTT_LZ_WINDOW_BITS 8   /* 滑动窗口 2^8 = 256 字节 (4~12) */
+#define MQTT_LZ_LOOKAHEAD_BITS 4 /* 最长匹配 2^4 = 16 字节 (3~WINDOW_BITS-1) */
+#define MQTT_LZ_CHUNK 256       /* 每条消息的最大长度 (含 2 字节报头)，需小于 RX_BUFFER_SIZE 减去报头与主题 */
+
+/* ==========================================
+ * 报文格式
+ *
+ * 一段数据被切成若干条消息，每条内容为:
+ *   [0xA0 | 标志][序号][压缩数据]
+ *   标志 MQTT_LZ_FIRST 首块 (序号从 0 开始)、MQTT_LZ_LAST 末块
+ * 压缩数据为 heatshrink 格式 (window_sz2 = WINDOW_BITS，lookahead_sz2 =
+ * LOOKAHEAD_BITS)，每条消息独立压缩 (窗口不跨消息)，丢失一条不影响其余
+ * 消息的解压，后端可直接用 heatshrink 库逐条解压。
+ * 首字节 0xA0~0xAF 不是合法的 UTF-8 起始字节，接收端据此区分压缩消息与
+ * 普通文本 (UTF-8)，两者可以在同一主题上混用。二进制消息不行：例如首字段
+ * 编号为 20、21 的 mqtt_pack 消息首字节正是 0xA0~0xAF，会被当作压缩块，
+ * 须发往单独的主题。
+ * ========================================== */
+#define MQTT_LZ_MAGIC 0xA0
+#define MQTT_LZ_FIRST 0x01
+#define MQTT_LZ_LAST 0x02
+#define MQTT_LZ_HEADER 2
+
+#define MQTT_LZ_WINDOW (1u << MQTT_LZ_WINDOW_BITS)
+#define MQTT_LZ_MAX_MATCH (1u << MQTT_LZ_LOOKAHEAD_BITS)
+
+/**
+ * @brief 压缩发布状态 (约 2 * WINDOW + CHUNK 字节)
+ */
+typedef struct {
+    uint8_t win[2 * MQTT_LZ_WINDOW]; /* 历史 + 待压缩数据 */
+    uint16_t start;  /* 下一个待压缩字节在 win 中的位置 */
+    uint16_t fill;   /* win 中的数据量 */
+    uint16_t floor;  /* 当前消息的首字节位置，匹配不会越过它 */
+    uint8_t out[MQTT_LZ_CHUNK];
+    uint16_t out_len;
+    uint8_t bits;    /* out[out_len] 中已写入的位数 */
+    uint8_t seq;
+    bool first;
+    MQTT_TopicId id;
+    uint32_t in_total;  /* 本段原始字节数 */
+    uint32_t out_total; /* 本段发出的消息内容字节数 (含报头) */
+} MQTT_LzEncoder;
+
+/**
+ * @brief 解压接收状态 (约 WINDOW 字节)
+ */
+typedef struct {
+    uint8_t win[MQTT_LZ_WINDOW];
+    uint8_t next_seq;
+    bool active;     /* 已收到首块，末块尚未到达 */
+    uint32_t gaps;   /* 序号不连续 (消息丢失或乱序) */
+    uint32_t errors; /* 格式错误 */
+} MQTT_LzDecoder;
+
+/**
+ * @brief 解压数据回调
+ * @details 一条消息的解压结果分若干次交出，每次不超过 WINDOW 字节，
+ *          data 仅在回调期间有效
+ * @param flags MQTT_LZ_FIRST：一段数据的第一次回调；MQTT_LZ_LAST：最后一次回调
+ */
+typedef void (*MQTT_LzHandler)(const uint8_t *data, uint32_t len, uint8_t flags);
+
+/* ==========================================
+ * 发送端
+ * ========================================== */
+
+/**
+ * @brief 开始一段压缩数据，发往已注册主题
+ */
+void MQTT_Lz_Begin(MQTT_LzEncoder *enc, MQTT_TopicId id);
+
+/**
+ * @brief 追加原始数据；压缩结果攒满 MQTT_LZ_CHUNK 即发布一条消息
+ * @return false 发布失败 (本段应重新开始)
+ */
+bool MQTT_Lz_Write(MQTT_LzEncoder *enc, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief 压缩剩余数据并发布末块
+ */
+bool MQTT_Lz_End(MQTT_LzEncoder *enc);
+
+/**
+ * @brief 一次性压缩发布 (数据已在内存中时使用)
+ */
+bool MQTT_Lz_Publish(MQTT_LzEncoder *enc, MQTT_TopicId id, const uint8_t *data, uint32_t len);
+
+/* ==========================================
+ * 接收端
+ * 在 MQTT_SubscribeStream 的回调中调用:
+ *
+ *   static MQTT_LzDecoder cfg_rx;
+ *   static void OnConfig(const uint8_t *payload, uint32_t len)
+ *   {
+ *       MQTT_Lz_Receive(&cfg_rx, payload, len, OnConfigData);
+ *   }
+ * ========================================== */
+
+/**
+ * @brief 解压一条消息并交给 handler
+ * @details 首字节不在 0xA0~0xAF 的消息视为未压缩文本，原样交出 (flags 为 FIRST | LAST)
+ * @return false 格式错误或序号不连续 (仍会交出能解出的数据)
+ */
+bool MQTT_Lz_Receive(MQTT_LzDecoder *dec, const uint8_t *payload, uint32_t len, MQTT_LzHandler handler);
+
+#endif /* __MQTT_LZ_H */
@@ -0,0 +1,488 @@
+/**
+  * @file    mqtt_ota.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   基于 MQTT 的固件升级：分块接收、双缓冲写入备用 Flash 区、SHA-256 校验
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_ota.h"
+#include <string.h>
+#include <stdio.h>
+
+/* ==========================================
+ * 私有变量
+ * ========================================== */
+static char topic_begin[MQTT_TOPIC_SIZE];
+static char topic_chunk[MQTT_TOPIC_SIZE];
+static char topic_commit[MQTT_TOPIC_SIZE];
+static char topic_status[MQTT_TOPIC_SIZE];
+
+static MQTT_OtaStatus ota;
+static uint8_t expected_digest[32];
+
+#if MQTT_OTA_BUFFERS < 2
+#error "MQTT_OTA_BUFFERS 至少为 2"
+#endif
+
+/* 接收缓冲环：第 k 块 (Flash 偏移 k * MQTT_OTA_BLOCK) 位于 ota_buf[k % MQTT_OTA_BUFFERS]。
+ * 接收路径 (可能在中断中) 只写 blocks_filled，主循环只写 blocks_started / blocks_done，
+ * 各自单写者，无需关中断 */
+static uint8_t ota_buf[MQTT_OTA_BUFFERS][MQTT_OTA_BLOCK];
+static uint16_t fill_len = 0;                /* 正在填充的块已有字节数 */
+static volatile uint32_t blocks_filled = 0;  /* 已填满 (等待编程) 的块数 */
+static volatile uint32_t blocks_started = 0; /* 已交给 MQTT_OTA_FlashWrite 的块数 */
+static volatile uint32_t blocks_done = 0;    /* 编程完成、缓冲已释放的块数 */
+
+static MQTT_Sha256 verify_ctx;
+static uint32_t verify_offset = 0;
+
+static char status_msg[24];
+static bool status_pending = false;
+static bool resume_pending = false;
+static uint32_t resume_sent_at = 0;
+static uint32_t next_progress = 0;
+static bool commit_pending = false;
+
+/* ==========================================
+ * Flash 操作默认实现 (弱函数)
+ * ========================================== */
+
+__weak bool MQTT_OTA_FlashErase(uint32_t offset, uint32_t len)
+{
+    (void)offset;
+    (void)len;
+    return false;
+}
+
+__weak bool MQTT_OTA_FlashWrite(uint32_t offset, const uint8_t *data, uint32_t len)
+{
+    (void)offset;
+    (void)data;
+    (void)len;
+    return false;
+}
+
+__weak bool MQTT_OTA_FlashBusy(void)
+{
+    return false;
+}
+
+__weak bool MQTT_OTA_FlashRead(uint32_t offset, uint8_t *buf, uint32_t len)
+{
+    (void)offset;
+    (void)buf;
+    (void)len;
+    return false;
+}
+
+__weak void MQTT_OTA_FlashSwap(void)
+{
+}
+
+/* ==========================================
+ * SHA-256
+ * ========================================== */
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void MQTT_Sha256_Block(MQTT_Sha256 *ctx, const uint8_t *p)
+{
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h;
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)p[4 * i] << 24) | ((uint32_t)p[4 * i + 1] << 16) |
+               ((uint32_t)p[4 * i + 2] << 8) | p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = ctx->state[0]; b = ctx->state[1]; c = ctx->state[2]; d = ctx->state[3];
+    e = ctx->state[4]; f = ctx->state[5]; g = ctx->state[6]; h = ctx->state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    ctx->state[0] += a; ctx->state[1] += b; ctx->state[2] += c; ctx->state[3] += d;
+    ctx->state[4] += e; ctx->state[5] += f; ctx->state[6] += g; ctx->state[7] += h;
+}
+
+void MQTT_Sha256_Init(MQTT_Sha256 *ctx)
+{
+    static const uint32_t init[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, init, sizeof(init));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+void MQTT_Sha256_Update(MQTT_Sha256 *ctx, const uint8_t *data, uint32_t len)
+{
+    ctx->length += len;
+    while (len > 0) {
+        if (ctx->used == 0 && len >= 64) {
+            MQTT_Sha256_Block(ctx, data);
+            data += 64;
+            len -= 64;
+            continue;
+        }
+        uint32_t n = 64 - ctx->used;
+        if (n > len) n = len;
+        memcpy(&ctx->block[ctx->used], data, n);
+        ctx->used += n;
+        data += n;
+        len -= n;
+        if (ctx->used == 64) {
+            MQTT_Sha256_Block(ctx, ctx->block);
+            ctx->used = 0;
+        }
+    }
+}
+
+void MQTT_Sha256_Final(MQTT_Sha256 *ctx, uint8_t digest[32])
+{
+    uint64_t bits = ctx->length * 8;
+
+    ctx->block[ctx->used++] = 0x80;
+    if (ctx->used > 56) {
+        memset(&ctx->block[ctx->used], 0, 64 - ctx->used);
+        MQTT_Sha256_Block(ctx, ctx->block);
+        ctx->used = 0;
+    }
+    memset(&ctx->block[ctx->used], 0, 56 - ctx->used);
+    for (int i = 0; i < 8; i++) {
+        ctx->block[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+    }
+    MQTT_Sha256_Block(ctx, ctx->block);
+
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = (uint8_t)(ctx->state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+/* ==========================================
+ * 辅助函数
+ * ========================================== */
+
+static void MQTT_OTA_SetStatus(const char *fmt, uint32_t value)
+{
+    snprintf(status_msg, sizeof(status_msg), fmt, (unsigned long)value);
+    status_pending = true;
+}
+
+static void MQTT_OTA_Fail(const char *reason)
+{
+    ota.state = MQTT_OTA_FAILED;
+    snprintf(status_msg, sizeof(status_msg), "error %s", reason);
+    status_pending = true;
+}
+
+static bool MQTT_OTA_WaitFlash(void)
+{
+    uint32_t start = HAL_GetTick();
+    while (MQTT_OTA_FlashBusy()) {
+        if (HAL_GetTick() - start > MQTT_OTA_FLASH_TIMEOUT) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 按顺序编程已填满的块 (主循环中执行)
+ * @details 上一块编程完成后释放其缓冲并启动下一块，同步实现的 Flash 一次调用
+ *          即可写完全部排队的块；编程进行中则立即返回，下次再继续。
+ */
+static void MQTT_OTA_Program(void)
+{
+    for (;;) {
+        if (blocks_started != blocks_done) {
+            if (MQTT_OTA_FlashBusy()) return;
+            blocks_done++;
+        }
+        if (blocks_started == blocks_filled) return;
+
+        uint32_t k = blocks_started;
+        if (!MQTT_OTA_FlashWrite(k * MQTT_OTA_BLOCK, ota_buf[k % MQTT_OTA_BUFFERS], MQTT_OTA_BLOCK)) {
+            MQTT_OTA_Fail("write");
+            return;
+        }
+        blocks_started = k + 1;
+    }
+}
+
+static bool MQTT_OTA_ParseHex(const char *hex, uint8_t *out, uint16_t len)
+{
+    for (uint16_t i = 0; i < 2 * len; i++) {
+        char c = hex[i];
+        uint8_t v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+        else return false;
+        out[i / 2] = (i & 1) ? (uint8_t)(out[i / 2] | v) : (uint8_t)(v << 4);
+    }
+    return hex[2 * len] == '\0';
+}
+
+/**
+ * @brief 接收缓冲环已满时腾出一块
+ * @details 与入站队列满时的处理相同 (见 conn.c MQTT_InboundReady)：主循环驱动时接收路径
+ *          就在主循环中，可以直接编程并等待，等待期间不读入新数据，被动接收下由 TCP 窗口
+ *          反压后端；定时器驱动时接收路径位于中断，不能操作 Flash，只能放弃本块。
+ * @return false 未能腾出 (调用者丢弃余下数据并请求续传)
+ */
+static bool MQTT_OTA_MakeRoom(void)
+{
+#ifdef MQTT_TIM_HANDLE
+    return false;
+#else
+    uint32_t start = HAL_GetTick();
+    while (blocks_filled - blocks_done >= MQTT_OTA_BUFFERS) {
+        MQTT_OTA_Program();
+        if (ota.state == MQTT_OTA_FAILED || HAL_GetTick() - start > MQTT_OTA_FLASH_TIMEOUT) return false;
+    }
+    return true;
+#endif
+}
+
+/* ==========================================
+ * 消息回调
+ * ========================================== */
+
+/**
+ * @brief "<size>:<sha256>"：相同镜像续传，否则重新开始
+ */
+static void MQTT_OTA_OnBegin(const char *topic, const char *payload)
+{
+    uint8_t digest[32];
+    uint32_t size = 0;
+    const char *p = payload;
+
+    (void)topic;
+    while (*p >= '0' && *p <= '9') {
+        size = size * 10 + (uint32_t)(*p++ - '0');
+    }
+    if (p == payload || *p++ != ':' || !MQTT_OTA_ParseHex(p, digest, sizeof(digest))) {
+        MQTT_OTA_Fail("format");
+        return;
+    }
+    if (size == 0 || size > MQTT_OTA_MAX_SIZE) {
+        MQTT_OTA_Fail("size");
+        return;
+    }
+
+    /* 同一镜像：从已接收位置续传 (接收缓冲中的数据仍在) */
+    if (ota.state != MQTT_OTA_IDLE && ota.state != MQTT_OTA_FAILED && ota.size == size &&
+        memcmp(expected_digest, digest, sizeof(digest)) == 0) {
+        if (ota.state == MQTT_OTA_VERIFIED) {
+            MQTT_OTA_SetStatus("verified", 0);
+        } else {
+            MQTT_OTA_SetStatus("ready %lu", ota.received);
+        }
+        return;
+    }
+
+    /* 先离开接收状态，接收路径不再写缓冲；等待进行中的编程结束后再复位缓冲环 */
+    ota.state = MQTT_OTA_IDLE;
+    bool flash_idle = MQTT_OTA_WaitFlash();
+    memset(&ota, 0, sizeof(ota));
+    memcpy(expected_digest, digest, sizeof(digest));
+    ota.size = size;
+    fill_len = 0;
+    blocks_filled = 0;
+    blocks_started = 0;
+    blocks_done = 0;
+    resume_pending = false;
+    commit_pending = false;
+    next_progress = MQTT_OTA_PROGRESS_STEP;
+
+    if (!flash_idle || !MQTT_OTA_FlashErase(0, size)) {
+        MQTT_OTA_Fail("erase");
+        return;
+    }
+    ota.state = MQTT_OTA_RECEIVING;
+    MQTT_OTA_SetStatus("ready %lu", 0);
+}
+
+/**
+ * @brief 分块：[offset u32 小端][数据]，只接受紧接已接收位置的分块
+ * @details 在接收路径中执行，只拷贝进缓冲环，编程与状态上报由 MQTT_OTA_Service 完成。
+ *          缓冲环排满时见 MQTT_OTA_MakeRoom；定义 MQTT_TIM_HANDLE 时不操作 Flash。
+ */
+static void MQTT_OTA_OnChunk(const uint8_t *payload, uint32_t len)
+{
+    if (ota.state != MQTT_OTA_RECEIVING || len < 4) return;
+
+    uint32_t offset = payload[0] | ((uint32_t)payload[1] << 8) | ((uint32_t)payload[2] << 16) |
+                      ((uint32_t)payload[3] << 24);
+    const uint8_t *data = payload + 4;
+    len -= 4;
+
+    if (offset < ota.received) {
+        ota.duplicates++; /* QoS 1 重发或续传重叠 */
+        return;
+    }
+    if (offset > ota.received) {
+        if (!resume_pending) ota.gaps++;
+        resume_pending = true;
+        return;
+    }
+    if (len > ota.size - ota.received) len = ota.size - ota.received;
+
+    resume_pending = false;
+    while (len > 0) {
+        if (blocks_filled - blocks_done >= MQTT_OTA_BUFFERS && !MQTT_OTA_MakeRoom()) {
+            /* 全部缓冲都在等待编程：已拷贝的部分保留，从 ota.received 续传 */
+            if (ota.state == MQTT_OTA_RECEIVING) {
+                ota.stalls++;
+                resume_pending = true;
+            }
+            return;
+        }
+
+        uint32_t k = blocks_filled;
+        uint8_t *block = ota_buf[k % MQTT_OTA_BUFFERS];
+        uint32_t n = MQTT_OTA_BLOCK - fill_len;
+        if (n > len) n = len;
+        memcpy(&block[fill_len], data, n);
+        fill_len += n;
+        data += n;
+        len -= n;
+        ota.received += n;
+
+        if (fill_len == MQTT_OTA_BLOCK || ota.received == ota.size) {
+            /* 末块不足 MQTT_OTA_BLOCK 时以 0xFF (擦除态) 补齐 */
+            memset(&block[fill_len], 0xFF, MQTT_OTA_BLOCK - fill_len);
+            fill_len = 0;
+            blocks_filled = k + 1;
+        }
+    }
+
+    if (ota.received == ota.size) {
+        ota.state = MQTT_OTA_VERIFYING;
+        verify_offset = 0;
+        MQTT_Sha256_Init(&verify_ctx);
+    } else if (ota.received >= next_progress) {
+        next_progress += MQTT_OTA_PROGRESS_STEP;
+        MQTT_OTA_SetStatus("progress %lu", ota.received);
+    }
+}
+
+static void MQTT_OTA_OnCommit(const char *topic, const char *payload)
+{
+    (void)topic;
+    (void)payload;
+
+    if (ota.state == MQTT_OTA_VERIFIED) {
+        commit_pending = true;
+    } else {
+        MQTT_OTA_SetStatus("error state %lu", ota.state);
+    }
+}
+
+/* ==========================================
+ * 公共接口函数实现
+ * ========================================== */
+
+bool MQTT_OTA_Init(const char *prefix)
+{
+#ifdef MQTT_USE_SSL
+    /* SSL 链路没有被动接收，分块突发会冲掉 AT 暂存区并反复重连，见 mqtt_ota.h */
+    return false;
+#endif
+    if (prefix == NULL) return false;
+
+    int n = snprintf(topic_status, sizeof(topic_status), "%s/ota/status", prefix);
+    if (n < 0 || n >= (int)sizeof(topic_status)) return false;
+    snprintf(topic_begin, sizeof(topic_begin), "%s/ota/begin", prefix);
+    snprintf(topic_chunk, sizeof(topic_chunk), "%s/ota/chunk", prefix);
+    snprintf(topic_commit, sizeof(topic_commit), "%s/ota/commit", prefix);
+
+    return MQTT_SubscribeCallback(topic_begin, MQTT_OTA_OnBegin) &&
+           MQTT_SubscribeCallback(topic_commit, MQTT_OTA_OnCommit) &&
+           MQTT_SubscribeStream(topic_chunk, 1, MQTT_OTA_OnChunk);
+}
+
+void MQTT_OTA_Service(void)
+{
+    /* 1. 编程接收路径交来的块 */
+    if (ota.state == MQTT_OTA_RECEIVING || ota.state == MQTT_OTA_VERIFYING) {
+        MQTT_OTA_Program();
+    }
+
+    /* 2. 读回校验：全部块编程完成后开始，每次最多 MQTT_OTA_VERIFY_STEP 字节，不长时间占用主循环 */
+    if (ota.state == MQTT_OTA_VERIFYING && blocks_done == blocks_filled && !MQTT_OTA_FlashBusy()) {
+        uint32_t end = verify_offset + MQTT_OTA_VERIFY_STEP;
+        if (end > ota.size) end = ota.size;
+
+        while (verify_offset < end) {
+            uint32_t n = end - verify_offset;
+            if (n > MQTT_OTA_BLOCK) n = MQTT_OTA_BLOCK;
+            if (!MQTT_OTA_FlashRead(verify_offset, ota_buf[0], n)) {
+                MQTT_OTA_Fail("read");
+                break;
+            }
+            MQTT_Sha256_Update(&verify_ctx, ota_buf[0], n);
+            verify_offset += n;
+        }
+
+        if (ota.state == MQTT_OTA_VERIFYING && verify_offset == ota.size) {
+            uint8_t digest[32];
+            MQTT_Sha256_Final(&verify_ctx, digest);
+            if (memcmp(digest, expected_digest, sizeof(digest)) == 0) {
+                ota.state = MQTT_OTA_VERIFIED;
+                MQTT_OTA_SetStatus("verified", 0);
+            } else {
+                MQTT_OTA_Fail("sha256");
+            }
+        }
+    }
+
+    if (!MQTT_IsConnected()) return;
+
+    /* 3. 缺口：请求从已接收位置续传 (限频，缺口期间的后续分块都会被丢弃) */
+    if (resume_pending && HAL_GetTick() - resume_sent_at >= MQTT_OTA_RESUME_MS) {
+        MQTT_OTA_SetStatus("resume %lu", ota.received);
+        resume_sent_at = HAL_GetTick();
+    }
+
+    /* 4. 上报状态 */
+    if (status_pending && MQTT_PublishRetained(topic_status, status_msg)) {
+        status_pending = false;
+    }
+
+    /* 5. 切换 */
+    if (commit_pending && !status_pending) {
+        commit_pending = false;
+        MQTT_OTA_FlashSwap();
+    }
+}
+
+const MQTT_OtaStatus *MQTT_OTA_GetStatus(void)
+{
+    return &ota;
+}
@@ -0,0 +1,138 @@
+/**
+  * @file    mqtt_ota.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   基于 MQTT 的固件升级：分块接收、双缓冲写入备用 Flash 区、SHA-256 校验
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef __MQTT_OTA_H
+#define __MQTT_OTA_H
+
+#include "conn.h"
+
+/* ==========================================
+ * 用户配置区域
+ * ========================================== */
+#define MQTT_OTA_BLOCK 256              /* 编程块大小 (须为 Flash 编程单位的整数倍) */
+#define MQTT_OTA_BUFFERS 4              /* 接收缓冲块数 (>= 2)，等待编程的块在此排队 */
+#define MQTT_OTA_MAX_SIZE (512 * 1024)  /* 镜像上限 (备用区大小) */
+#define MQTT_OTA_PROGRESS_STEP 16384    /* 每接收该字节数上报一次进度 */
+#define MQTT_OTA_VERIFY_STEP 4096       /* 每次 MQTT_OTA_Service 校验的字节数 */
+#define MQTT_OTA_RESUME_MS 1000         /* 出现缺口后重复请求续传的最小间隔 */
+#define MQTT_OTA_FLASH_TIMEOUT 100      /* 等待上一块编程完成的超时 (ms) */
+
+/* ==========================================
+ * 报文格式 (前缀 <p> 由 MQTT_OTA_Init 指定)
+ *
+ * <p>/ota/begin   后端 → 设备   "<size>:<sha256 十六进制>"
+ *                 与进行中的镜像相同则续传，否则擦除备用区重新开始
+ * <p>/ota/chunk   后端 → 设备   二进制 [offset u32 小端][数据]，QoS 1
+ * <p>/ota/commit  后端 → 设备   校验通过后切换到新固件
+ * <p>/ota/status  设备 → 后端   (保留) "ready <offset>"    可从 offset 开始发送
+ *                                     "resume <offset>"   出现缺口，请从 offset 重发
+ *                                     "progress <offset>" 已接收字节数
+ *                                     "verified"          SHA-256 校验通过
+ *                                     "error <原因>"
+ *
+ * 后端收到 ready 后连续发布全部分块，不等待逐块应答，传输时间只受链路吞吐
+ * 限制。CONNECT 使用 Clean Session，断线后服务器不会补发未确认的分块：
+ * 丢失的分块、Flash 编程跟不上时丢弃的分块都靠设备发布的 resume <offset>
+ * 由后端从该位置重发；设备重连后后端应重新发布 begin，按 ready <offset> 续传。
+ * 单个分块需小于 RX_BUFFER_SIZE 减去报头与主题长度 (默认 512 字节缓冲下
+ * 建议 256 字节)。
+ *
+ * 分块在接收路径中只拷贝进 MQTT_OTA_BUFFERS 块的缓冲环，编程在 MQTT_OTA_Service
+ * 中进行。缓冲环排满时，主循环驱动直接在接收路径中编程腾出缓冲 (阻塞读入即反压
+ * 后端)；定义 MQTT_TIM_HANDLE 时接收路径位于定时器中断，不擦写、不等待 Flash，
+ * 改为丢弃余下数据并请求续传，此时应频繁调用 MQTT_OTA_Service 或加大缓冲块数。
+ *
+ * MQTT_USE_SSL 时不支持升级 (MQTT_OTA_Init 返回 false)：AT 固件的 SSL 链路
+ * 没有被动接收，连续的分块会冲掉 ESP_RX_BUFFER_SIZE 的暂存区并导致反复重连。
+ * ========================================== */
+
+typedef enum {
+    MQTT_OTA_IDLE = 0,
+    MQTT_OTA_RECEIVING, /* 接收并写入中 */
+    MQTT_OTA_VERIFYING, /* 接收完毕，正在读回校验 */
+    MQTT_OTA_VERIFIED,  /* 校验通过，等待 commit */
+    MQTT_OTA_FAILED
+} MQTT_OtaState;
+
+typedef struct {
+    MQTT_OtaState state;
+    uint32_t size;      /* 镜像大小 */
+    uint32_t received;  /* 已按序接收的字节数 (续传位置) */
+    uint32_t duplicates; /* 重复分块 (QoS 1 重发) */
+    uint32_t gaps;      /* 乱序/缺口次数 */
+    uint32_t stalls;    /* 接收缓冲排满、丢弃分块并请求续传的次数 (定时器驱动时) */
+} MQTT_OtaStatus;
+
+/**
+ * @brief 初始化并订阅升级主题
+ * @param prefix 主题前缀 (内容被复制)
+ * @return false 前缀过长、订阅表已满，或定义了 MQTT_USE_SSL
+ */
+bool MQTT_OTA_Init(const char *prefix);
+
+/**
+ * @brief 升级服务例程：编程已接收的块、上报状态、读回校验、执行切换
+ * @details 与 MQTT_Service() 一同在主循环中周期性调用 (不可在中断中调用)，
+ *          调用越频繁，接收缓冲越不容易排满
+ */
+void MQTT_OTA_Service(void);
+
+const MQTT_OtaStatus *MQTT_OTA_GetStatus(void);
+
+/* ==========================================
+ * Flash 操作 (弱函数，按芯片重写)
+ * offset 为相对备用区起始的偏移。默认实现返回失败。
+ * ========================================== */
+
+/**
+ * @brief 擦除备用区 [offset, offset + len)
+ */
+bool MQTT_OTA_FlashErase(uint32_t offset, uint32_t len);
+
+/**
+ * @brief 开始写入一块 (len 为 MQTT_OTA_BLOCK)
+ * @details 不在中断中调用。可以只启动编程就返回 (如
+ *          HAL_FLASH_Program_IT 或外部 Flash 的 DMA)，data 在
+ *          MQTT_OTA_FlashBusy() 返回 false 之前保持有效，期间后续数据写入其他缓冲块。
+ */
+bool MQTT_OTA_FlashWrite(uint32_t offset, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief 上一次写入是否仍在进行 (同步实现返回 false 即可)
+ */
+bool MQTT_OTA_FlashBusy(void);
+
+/**
+ * @brief 读回备用区内容，用于校验
+ */
+bool MQTT_OTA_FlashRead(uint32_t offset, uint8_t *buf, uint32_t len);
+
+/**
+ * @brief 切换到备用区固件 (如设置 BFB2/SWAP_BANK 选项字节后复位)，通常不返回
+ */
+void MQTT_OTA_FlashSwap(void);
+
+/* ==========================================
+ * SHA-256
+ * ========================================== */
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[64];
+    uint8_t used;
+} MQTT_Sha256;
+
+void MQTT_Sha256_Init(MQTT_Sha256 *ctx);
+void MQTT_Sha256_Update(MQTT_Sha256 *ctx, const uint8_t *data, uint32_t len);
+void MQTT_Sha256_Final(MQTT_Sha256 *ctx, uint8_t digest[32]);
+
+#endif /* __MQTT_OTA_H */
@@ -0,0 +1,191 @@
+/**
+  * @file    mqtt_pack.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   紧凑二进制消息编解码 (不依赖 HAL，可在主机上编译)
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_pack.h"
+#include <string.h>
+
+/* ==========================================
+ * 编码
+ * ========================================== */
+
+static void MQTT_PackRaw(MQTT_PackWriter *w, const void *data, uint16_t len)
+{
+    if (w->overflow || len > w->size - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(&w->buf[w->len], data, len);
+    w->len += len;
+}
+
+static void MQTT_PackVarint32(MQTT_PackWriter *w, uint32_t v)
+{
+    uint8_t tmp[5];
+    uint8_t n = 0;
+    while (v >= 0x80) {
+        tmp[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    tmp[n++] = (uint8_t)v;
+    MQTT_PackRaw(w, tmp, n);
+}
+
+static void MQTT_PackVarint64(MQTT_PackWriter *w, uint64_t v)
+{
+    uint8_t tmp[10];
+    uint8_t n = 0;
+    while (v >= 0x80) {
+        tmp[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    tmp[n++] = (uint8_t)v;
+    MQTT_PackRaw(w, tmp, n);
+}
+
+static void MQTT_PackKey(MQTT_PackWriter *w, uint32_t field, uint8_t wire)
+{
+    MQTT_PackVarint32(w, (field << 3) | wire);
+}
+
+void MQTT_PackInit(MQTT_PackWriter *w, uint8_t *buf, uint16_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = false;
+}
+
+void MQTT_PackU32(MQTT_PackWriter *w, uint32_t field, uint32_t value)
+{
+    if (value == 0) return;
+    MQTT_PackKey(w, field, MQTT_WIRE_VARINT);
+    MQTT_PackVarint32(w, value);
+}
+
+void MQTT_PackU64(MQTT_PackWriter *w, uint32_t field, uint64_t value)
+{
+    if (value == 0) return;
+    MQTT_PackKey(w, field, MQTT_WIRE_VARINT);
+    MQTT_PackVarint64(w, value);
+}
+
+void MQTT_PackS32(MQTT_PackWriter *w, uint32_t field, int32_t value)
+{
+    /* zigzag：小的负数也只占 1~2 字节 */
+    MQTT_PackU32(w, field, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+void MQTT_PackS64(MQTT_PackWriter *w, uint32_t field, int64_t value)
+{
+    MQTT_PackU64(w, field, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void MQTT_PackFloat(MQTT_PackWriter *w, uint32_t field, float value)
+{
+    uint32_t bits;
+    uint8_t le[4];
+
+    if (value == 0.0f) return;
+    memcpy(&bits, &value, sizeof(bits));
+    le[0] = (uint8_t)bits;
+    le[1] = (uint8_t)(bits >> 8);
+    le[2] = (uint8_t)(bits >> 16);
+    le[3] = (uint8_t)(bits >> 24);
+    MQTT_PackKey(w, field, MQTT_WIRE_FIXED32);
+    MQTT_PackRaw(w, le, 4);
+}
+
+void MQTT_PackBytes(MQTT_PackWriter *w, uint32_t field, const void *data, uint16_t len)
+{
+    if (len == 0) return;
+    MQTT_PackKey(w, field, MQTT_WIRE_BYTES);
+    MQTT_PackVarint32(w, len);
+    MQTT_PackRaw(w, data, len);
+}
+
+bool MQTT_PackEnd(const MQTT_PackWriter *w, uint16_t *len)
+{
+    *len = w->overflow ? 0 : w->len;
+    return !w->overflow;
+}
+
+/* ==========================================
+ * 解码
+ * ========================================== */
+
+static bool MQTT_UnpackVarint(MQTT_UnpackReader *r, uint64_t *out)
+{
+    uint64_t v = 0;
+    for (uint8_t shift = 0; shift < 64; shift += 7) {
+        if (r->p >= r->end) return false;
+        uint8_t b = *r->p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            *out = v;
+            return true;
+        }
+    }
+    return false; /* 超过 10 字节 */
+}
+
+void MQTT_UnpackInit(MQTT_UnpackReader *r, const uint8_t *buf, uint32_t len)
+{
+    r->p = buf;
+    r->end = buf + len;
+}
+
+int MQTT_UnpackNext(MQTT_UnpackReader *r, MQTT_PackField *f)
+{
+    uint64_t key;
+
+    if (r->p >= r->end) return 0;
+    if (!MQTT_UnpackVarint(r, &key) || (key >> 3) == 0 || (key >> 3) > 0x1FFFFFFF) return -1;
+
+    f->field = (uint32_t)(key >> 3);
+    f->wire = (uint8_t)(key & 0x07);
+    f->value = 0;
+    f->data = NULL;
+    f->len = 0;
+
+    switch (f->wire) {
+    case MQTT_WIRE_VARINT:
+        return MQTT_UnpackVarint(r, &f->value) ? 1 : -1;
+    case MQTT_WIRE_FIXED32:
+    case MQTT_WIRE_FIXED64: {
+        uint8_t n = (f->wire == MQTT_WIRE_FIXED32) ? 4 : 8;
+        if (r->end - r->p < n) return -1;
+        for (uint8_t i = 0; i < n; i++) {
+            f->value |= (uint64_t)r->p[i] << (8 * i);
+        }
+        r->p += n;
+        return 1;
+    }
+    case MQTT_WIRE_BYTES: {
+        uint64_t len;
+        if (!MQTT_UnpackVarint(r, &len) || len > (uint64_t)(r->end - r->p)) return -1;
+        f->data = r->p;
+        f->len = (uint32_t)len;
+        r->p += len;
+        return 1;
+    }
+    default:
+        return -1; /* 分组 (wire 3/4) 已废弃，不支持 */
+    }
+}
+
+float MQTT_UnpackFloat(uint64_t v)
+{
+    uint32_t bits = (uint32_t)v;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
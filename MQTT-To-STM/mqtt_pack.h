@@ -0,0 +1,113 @@
+/**
+  * @file    mqtt_pack.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   紧凑二进制消息编解码 (不依赖 HAL，可在主机上编译)
+  *
+  * 线上格式与 Protocol Buffers (proto3) 兼容的子集：
+  *   每个字段为 键 (field << 3 | wire) + 值；
+  *   wire 0 变长整数 (uint32/uint64/bool，sint32/sint64 先做 zigzag)，
+  *   wire 5 定长 4 字节小端 (float)，wire 2 长度前缀 (string/bytes)。
+  * 值为 0 / 空的字段不编码，解码时未出现的字段为 0，未知字段跳过，
+  * 因此新增字段前后兼容。后端可直接用 protoc 生成的代码解析。
+  *
+  * 通常不直接调用本文件接口，而是由 host/schemac.py 根据消息定义生成
+  * <消息>_Pack / <消息>_Unpack。编码写入调用者提供的缓冲区，解码直接读取
+  * 接收缓冲区中的视图 (MQTT_StreamHandler 的 payload)，均不分配内存。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef __MQTT_PACK_H
+#define __MQTT_PACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MQTT_WIRE_VARINT 0
+#define MQTT_WIRE_FIXED64 1
+#define MQTT_WIRE_BYTES 2
+#define MQTT_WIRE_FIXED32 5
+
+/* ==========================================
+ * 编码
+ * ========================================== */
+typedef struct {
+    uint8_t *buf;
+    uint16_t size;
+    uint16_t len;
+    bool overflow; /* 缓冲区不足，之后的写入全部忽略 */
+} MQTT_PackWriter;
+
+void MQTT_PackInit(MQTT_PackWriter *w, uint8_t *buf, uint16_t size);
+
+/**
+ * @brief 写入变长整数字段 (uint32 / bool)
+ * @details 32 位路径不使用 64 位运算，避免在 Cortex-M 上调用库函数
+ */
+void MQTT_PackU32(MQTT_PackWriter *w, uint32_t field, uint32_t value);
+void MQTT_PackU64(MQTT_PackWriter *w, uint32_t field, uint64_t value);
+void MQTT_PackS32(MQTT_PackWriter *w, uint32_t field, int32_t value);
+void MQTT_PackS64(MQTT_PackWriter *w, uint32_t field, int64_t value);
+void MQTT_PackFloat(MQTT_PackWriter *w, uint32_t field, float value);
+void MQTT_PackBytes(MQTT_PackWriter *w, uint32_t field, const void *data, uint16_t len);
+
+/**
+ * @brief 结束编码
+ * @param len [out] 编码长度 (可以为 0：所有字段都是默认值)
+ * @return false 缓冲区不足
+ */
+bool MQTT_PackEnd(const MQTT_PackWriter *w, uint16_t *len);
+
+/* ==========================================
+ * 解码
+ * ========================================== */
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} MQTT_UnpackReader;
+
+/**
+ * @brief 解码出的一个字段
+ * @details wire 为 MQTT_WIRE_BYTES 时 data/len 指向原缓冲区，其余类型的值在 value 中
+ */
+typedef struct {
+    uint32_t field;
+    uint8_t wire;
+    uint64_t value;
+    const uint8_t *data;
+    uint32_t len;
+} MQTT_PackField;
+
+void MQTT_UnpackInit(MQTT_UnpackReader *r, const uint8_t *buf, uint32_t len);
+
+/**
+ * @brief 读取下一个字段
+ * @return 1 读到字段；0 已到结尾；-1 格式错误
+ */
+int MQTT_UnpackNext(MQTT_UnpackReader *r, MQTT_PackField *f);
+
+static inline int32_t MQTT_UnpackS32(uint64_t v)
+{
+    return (int32_t)((uint32_t)v >> 1) ^ -(int32_t)((uint32_t)v & 1);
+}
+
+static inline int64_t MQTT_UnpackS64(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+float MQTT_UnpackFloat(uint64_t v);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MQTT_PACK_H */
@@ -0,0 +1,263 @@
+/**
+  * @file    mqtt_rpc.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   基于 MQTT 的请求/响应 (RPC) 层：关联 ID、超时与并发调用
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_rpc.h"
+#include <string.h>
+#include <stdio.h>
+
+/* ==========================================
+ * 私有变量
+ * ========================================== */
+typedef struct {
+    uint16_t id;               /* 0 表示空闲 */
+    uint32_t deadline;
+    MQTT_RpcCallback callback;
+    void *ctx;
+} MQTT_RpcCall_t;
+
+typedef struct {
+    const char *topic;
+    MQTT_RpcHandler handler;
+} MQTT_RpcEntry_t;
+
+/* 处理函数与响应主题都常驻订阅表，须给其他模块 (OTA、影子、时钟同步) 留出位置 */
+#if MQTT_RPC_MAX_HANDLERS + MQTT_RPC_MAX_REPLY_TOPICS > MAX_SUBSCRIPTIONS
+#error "MQTT_RPC_MAX_HANDLERS + MQTT_RPC_MAX_REPLY_TOPICS 超过 MAX_SUBSCRIPTIONS"
+#endif
+
+static MQTT_RpcCall_t calls[MQTT_RPC_MAX_CALLS];
+static MQTT_RpcEntry_t handlers[MQTT_RPC_MAX_HANDLERS];
+static uint8_t handler_count = 0;
+static uint16_t next_id = 1;
+static char reply_topics[MQTT_RPC_MAX_REPLY_TOPICS][64]; /* 已订阅的响应主题 */
+static uint8_t reply_count = 0;
+
+/* ==========================================
+ * 辅助函数
+ * ========================================== */
+
+/**
+ * @brief 解析 "<id>|" / "<id>!" 前缀
+ * @param payload 消息内容
+ * @param id [out] 关联 ID
+ * @param ok [out] 分隔符是否为 '|'
+ * @return 去除前缀后的内容；无前缀时返回 NULL
+ */
+static const char *MQTT_RPC_ParseId(const char *payload, uint16_t *id, bool *ok)
+{
+    uint16_t value = 0;
+
+    for (int i = 0; i < 4; i++) {
+        char c = payload[i];
+        uint8_t digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else return NULL;
+        value = (value << 4) | digit;
+    }
+
+    if (payload[4] != '|' && payload[4] != '!') return NULL;
+
+    *id = value;
+    *ok = (payload[4] == '|');
+    return payload + 5;
+}
+
+/**
+ * @brief 拼接响应主题
+ * @return false 放不下 (截断后会订阅或发布到另一个主题)
+ */
+static bool MQTT_RPC_ReplyTopic(char *buf, uint16_t size, const char *topic)
+{
+    int n = snprintf(buf, size, "%s%s", topic, MQTT_RPC_REPLY_SUFFIX);
+    return n >= 0 && n < size;
+}
+
+/**
+ * @brief 响应主题回调：按关联 ID 找到在途调用并完成
+ */
+static void MQTT_RPC_OnReply(const char *topic, const char *payload)
+{
+    uint16_t id;
+    bool ok;
+    const char *body = MQTT_RPC_ParseId(payload, &id, &ok);
+
+    (void)topic;
+    if (body == NULL) return;
+
+    for (int i = 0; i < MQTT_RPC_MAX_CALLS; i++) {
+        if (calls[i].id == id) {
+            MQTT_RpcCallback cb = calls[i].callback;
+            void *ctx = calls[i].ctx;
+            calls[i].id = 0; /* 先释放槽位，回调中可再次发起调用 */
+            if (cb) {
+                cb(ok ? MQTT_RPC_OK : MQTT_RPC_ERROR, body, ctx);
+            }
+            return;
+        }
+    }
+    /* 已超时或已取消的调用：丢弃迟到的响应 */
+}
+
+/**
+ * @brief 订阅响应主题 (已订阅时不再占用订阅表)
+ */
+static bool MQTT_RPC_SubscribeReply(const char *reply_topic)
+{
+    for (int i = 0; i < reply_count; i++) {
+        if (strcmp(reply_topics[i], reply_topic) == 0) return true;
+    }
+    if (reply_count >= MQTT_RPC_MAX_REPLY_TOPICS || !MQTT_SubscribeCallback(reply_topic, MQTT_RPC_OnReply)) {
+        return false;
+    }
+    strcpy(reply_topics[reply_count++], reply_topic);
+    return true;
+}
+
+/**
+ * @brief 请求主题回调：查找处理函数并发布带相同 ID 的响应
+ */
+static void MQTT_RPC_OnRequest(const char *topic, const char *payload)
+{
+    char reply[MQTT_RPC_BODY_SIZE];
+    char packet[MQTT_RPC_BODY_SIZE + 8];
+    char reply_topic[64 + sizeof(MQTT_RPC_REPLY_SUFFIX)];
+    uint16_t id = 0;
+    bool unused;
+
+    for (int i = 0; i < handler_count; i++) {
+        if (strcmp(handlers[i].topic, topic) != 0) continue;
+
+        const char *body = MQTT_RPC_ParseId(payload, &id, &unused);
+        bool has_id = (body != NULL);
+        if (!has_id) body = payload;
+
+        reply[0] = '\0';
+        bool ok = handlers[i].handler(body, reply, sizeof(reply));
+
+        if (has_id) {
+            snprintf(packet, sizeof(packet), "%04X%c%s", id, ok ? '|' : '!', reply);
+        } else {
+            snprintf(packet, sizeof(packet), "%s", reply);
+        }
+
+        if (MQTT_RPC_ReplyTopic(reply_topic, sizeof(reply_topic), topic)) {
+            MQTT_Publish(reply_topic, packet);
+        }
+        return;
+    }
+}
+
+/* ==========================================
+ * 公共接口函数实现
+ * ========================================== */
+
+uint16_t MQTT_RPC_Call(const char *topic, const char *body, uint32_t timeout_ms,
+                       MQTT_RpcCallback callback, void *ctx)
+{
+    char reply_topic[sizeof(reply_topics[0])];
+    char packet[MQTT_RPC_BODY_SIZE + 8];
+    int slot = -1;
+
+    if (topic == NULL || body == NULL || !MQTT_IsConnected()) {
+        return 0;
+    }
+
+    /* 仅发送的调用不等待响应，不占用调用槽位与响应主题 */
+    if (callback != NULL) {
+        for (int i = 0; i < MQTT_RPC_MAX_CALLS; i++) {
+            if (calls[i].id == 0) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            return 0; /* 在途调用已满 */
+        }
+
+        /* 订阅接口只登记主题，须在发布请求前发出 SUBSCRIBE，
+         * 否则首次调用的响应先于订阅到达而丢失 */
+        if (!MQTT_RPC_ReplyTopic(reply_topic, sizeof(reply_topic), topic) ||
+            !MQTT_RPC_SubscribeReply(reply_topic) || !MQTT_FlushSubscriptions()) {
+            return 0;
+        }
+    }
+
+    uint16_t id = next_id++;
+    if (next_id == 0) next_id = 1;
+
+    int n = snprintf(packet, sizeof(packet), "%04X|%s", id, body);
+    if (n < 0 || n >= (int)sizeof(packet)) {
+        return 0; /* 截断的请求不发出 */
+    }
+    if (!MQTT_Publish(topic, packet)) {
+        return 0;
+    }
+
+    if (callback != NULL) {
+        calls[slot].id = id;
+        calls[slot].deadline = HAL_GetTick() + timeout_ms;
+        calls[slot].callback = callback;
+        calls[slot].ctx = ctx;
+    }
+    return id;
+}
+
+void MQTT_RPC_Cancel(uint16_t id)
+{
+    for (int i = 0; i < MQTT_RPC_MAX_CALLS; i++) {
+        if (id != 0 && calls[i].id == id) {
+            calls[i].id = 0;
+        }
+    }
+}
+
+bool MQTT_RPC_Register(const char *topic, MQTT_RpcHandler handler)
+{
+    if (topic == NULL || handler == NULL) return false;
+
+    for (int i = 0; i < handler_count; i++) {
+        if (strcmp(handlers[i].topic, topic) == 0) {
+            handlers[i].handler = handler;
+            return true;
+        }
+    }
+
+    if (handler_count >= MQTT_RPC_MAX_HANDLERS) {
+        return false;
+    }
+    if (!MQTT_SubscribeCallback(topic, MQTT_RPC_OnRequest)) {
+        return false;
+    }
+
+    handlers[handler_count].topic = topic;
+    handlers[handler_count].handler = handler;
+    handler_count++;
+    return true;
+}
+
+void MQTT_RPC_Service(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    for (int i = 0; i < MQTT_RPC_MAX_CALLS; i++) {
+        if (calls[i].id != 0 && (int32_t)(now - calls[i].deadline) >= 0) {
+            MQTT_RpcCallback cb = calls[i].callback;
+            void *ctx = calls[i].ctx;
+            calls[i].id = 0;
+            if (cb) {
+                cb(MQTT_RPC_TIMEOUT, "", ctx);
+            }
+        }
+    }
+}
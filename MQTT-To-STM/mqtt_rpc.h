@@ -0,0 +1,102 @@
+/**
+  * @file    mqtt_rpc.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   基于 MQTT 的请求/响应 (RPC) 层：关联 ID、超时与并发调用
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef __MQTT_RPC_H
+#define __MQTT_RPC_H
+
+#include "conn.h"
+
+/* ==========================================
+ * 用户配置区域
+ * ========================================== */
+#define MQTT_RPC_MAX_CALLS 8        /* 同时在途的调用数量 */
+#define MQTT_RPC_MAX_HANDLERS 4     /* 设备侧可注册的处理函数数量 (各占一个订阅) */
+#define MQTT_RPC_MAX_REPLY_TOPICS 4 /* 可调用的不同请求主题数量 (各自的响应主题占一个订阅，不退订) */
+#define MQTT_RPC_REPLY_SUFFIX "/reply" /* 响应主题 = 请求主题 + 后缀 */
+#define MQTT_RPC_BODY_SIZE 112      /* 响应内容缓冲区大小 */
+
+/* ==========================================
+ * 报文格式
+ * 请求: 主题 <topic>，内容 "<id>|<body>"
+ * 响应: 主题 <topic>/reply，内容 "<id>|<body>" (成功) 或 "<id>!<body>" (失败)
+ * <id> 为 4 位十六进制关联 ID；不带 ID 的请求按普通消息处理，响应也不带 ID。
+ * MQTT 3.1.1 没有 Correlation Data 属性，因此 ID 嵌在内容中。
+ * ========================================== */
+
+typedef enum {
+    MQTT_RPC_OK = 0,   /* 对端处理成功 */
+    MQTT_RPC_ERROR,    /* 对端返回失败 */
+    MQTT_RPC_TIMEOUT,  /* 截止时间内未收到响应 */
+} MQTT_RpcStatus;
+
+/**
+ * @brief 调用完成回调
+ * @param status 调用结果
+ * @param reply 响应内容 (超时时为空字符串)
+ * @param ctx 发起调用时传入的用户指针
+ */
+typedef void (*MQTT_RpcCallback)(MQTT_RpcStatus status, const char *reply, void *ctx);
+
+/**
+ * @brief 设备侧请求处理函数
+ * @param body 请求内容 (已去除关联 ID)
+ * @param reply [out] 响应内容缓冲区
+ * @param reply_size 响应缓冲区大小
+ * @return true 处理成功
+ * @return false 处理失败 (响应内容作为错误信息返回)
+ */
+typedef bool (*MQTT_RpcHandler)(const char *body, char *reply, uint16_t reply_size);
+
+/**
+ * @brief 发起异步调用
+ * @details 立即发布请求并返回，不等待响应，多个调用可同时在途。
+ *          响应到达或超时后在 MQTT_Service / MQTT_RPC_Service 中回调。
+ *
+ * 示例：
+ *   void OnReply(MQTT_RpcStatus st, const char *reply, void *ctx) { ... }
+ *   MQTT_RPC_Call("backend/config/get", "key=rate", 2000, OnReply, NULL);
+ *
+ * @param topic 请求主题 (响应主题为 topic + MQTT_RPC_REPLY_SUFFIX)
+ * @param body 请求内容
+ * @param timeout_ms 截止时间
+ * @param callback 完成回调 (可为 NULL，仅发送)
+ * @param ctx 透传给回调的用户指针
+ * @return 非 0 的关联 ID；0 表示失败 (未连接、调用表已满、请求内容过长、
+ *         响应主题过长或超出 MQTT_RPC_MAX_REPLY_TOPICS)
+ */
+uint16_t MQTT_RPC_Call(const char *topic, const char *body, uint32_t timeout_ms,
+                       MQTT_RpcCallback callback, void *ctx);
+
+/**
+ * @brief 取消在途调用 (不再回调)
+ */
+void MQTT_RPC_Cancel(uint16_t id);
+
+/**
+ * @brief 注册设备侧处理函数
+ * @details 订阅 topic，收到请求后调用 handler，并将结果以相同关联 ID
+ *          发布到 topic + MQTT_RPC_REPLY_SUFFIX。
+ *
+ * @param topic 请求主题 (需为静态字符串，不支持通配符)
+ * @param handler 处理函数
+ * @return true 注册成功
+ * @return false 注册表或订阅表已满，或主题过长
+ */
+bool MQTT_RPC_Register(const char *topic, MQTT_RpcHandler handler);
+
+/**
+ * @brief RPC 服务例程：检查调用截止时间并回调超时
+ * @details 与 MQTT_Service() 一同在主循环中周期性调用
+ */
+void MQTT_RPC_Service(void);
+
+#endif /* __MQTT_RPC_H */
@@ -0,0 +1,388 @@
+/**
+  * @file    mqtt_shadow.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   设备影子：带版本号的键值存储，只交换变化的键 (增量文档)
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_shadow.h"
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+
+/* ==========================================
+ * 私有变量
+ * ========================================== */
+typedef struct {
+    const char *key;
+    char value[MQTT_SHADOW_VALUE_SIZE];
+    bool dirty; /* 本地值尚未上报 */
+} MQTT_ShadowEntry_t;
+
+static MQTT_ShadowEntry_t entries[MQTT_SHADOW_MAX_KEYS];
+static uint8_t entry_count = 0;
+
+static char topic_desired[MQTT_SHADOW_TOPIC_SIZE];
+static char topic_reported[MQTT_SHADOW_TOPIC_SIZE];
+static char topic_get[MQTT_SHADOW_TOPIC_SIZE];
+static MQTT_ShadowHandler change_handler = NULL;
+
+static uint32_t desired_version = 0;  /* 已应用的期望版本 */
+static uint32_t reported_version = 0; /* 已发出的上报版本 */
+static bool get_pending = false;      /* 期望增量有缺口，需请求补发 */
+static uint32_t oversize_count = 0;   /* 放不进任何一条增量而放弃上报的次数 */
+
+#if MQTT_SHADOW_RX_QUEUE < 1 || (MQTT_SHADOW_RX_QUEUE & (MQTT_SHADOW_RX_QUEUE - 1)) != 0
+#error "MQTT_SHADOW_RX_QUEUE 须为 2 的幂"
+#endif
+
+/* 接收路径只复制期望增量，应用 (回调、持久化) 留到 MQTT_Shadow_Service；
+ * 头尾计数各由一方写入，无需关中断 */
+static char rx_queue[MQTT_SHADOW_RX_QUEUE][MQTT_SHADOW_DOC_SIZE];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+
+#ifdef MQTT_SHADOW_PERSIST
+#define MQTT_SHADOW_MAGIC 0x4D515331 /* "MQS1" */
+
+/* 超出 32 个键时数组长度为负，编译报错 (待上报位图为 uint32_t) */
+typedef char MQTT_ShadowKeysCheck[(MQTT_SHADOW_MAX_KEYS <= 32) ? 1 : -1];
+
+static MQTT_ShadowState shadow_state;
+
+/* 默认存储位置：.noinit 段在看门狗/软件复位后保持不变，与连接缓存相同 */
+static MQTT_ShadowState shadow_noinit __attribute__((section(".noinit")));
+#endif
+
+/* ==========================================
+ * 辅助函数
+ * ========================================== */
+
+static MQTT_ShadowEntry_t *MQTT_Shadow_Find(const char *key, uint16_t len)
+{
+    for (int i = 0; i < entry_count; i++) {
+        if (strlen(entries[i].key) == len && memcmp(entries[i].key, key, len) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 解析十进制版本号
+ * @return 数字之后的位置；没有数字时返回 NULL
+ */
+static const char *MQTT_Shadow_ParseVersion(const char *p, uint32_t *out)
+{
+    uint32_t value = 0;
+    const char *start = p;
+
+    while (*p >= '0' && *p <= '9') {
+        value = value * 10 + (uint32_t)(*p++ - '0');
+    }
+    if (p == start) return NULL;
+
+    *out = value;
+    return p;
+}
+
+#ifdef MQTT_SHADOW_PERSIST
+static uint32_t MQTT_Shadow_Fnv1a(uint32_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/* 键名指纹：键的名称或顺序变化后，保存的值不再对应 */
+static uint32_t MQTT_Shadow_KeysHash(void)
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < entry_count; i++) {
+        hash = MQTT_Shadow_Fnv1a(hash, entries[i].key, strlen(entries[i].key) + 1);
+    }
+    return hash;
+}
+
+static uint32_t MQTT_Shadow_Checksum(const MQTT_ShadowState *state)
+{
+    return MQTT_Shadow_Fnv1a(2166136261u, state, offsetof(MQTT_ShadowState, checksum));
+}
+
+__weak bool MQTT_Shadow_Load(MQTT_ShadowState *state)
+{
+    memcpy(state, &shadow_noinit, sizeof(MQTT_ShadowState));
+    return true;
+}
+
+__weak void MQTT_Shadow_Save(const MQTT_ShadowState *state)
+{
+    memcpy(&shadow_noinit, state, sizeof(MQTT_ShadowState));
+}
+
+/**
+ * @brief 恢复复位前的版本号与键值，无有效记录时保持初始值
+ */
+static void MQTT_Shadow_Restore(void)
+{
+    MQTT_ShadowState *s = &shadow_state;
+
+    if (!MQTT_Shadow_Load(s) || s->magic != MQTT_SHADOW_MAGIC || s->keys_hash != MQTT_Shadow_KeysHash() ||
+        s->checksum != MQTT_Shadow_Checksum(s)) {
+        return;
+    }
+
+    desired_version = s->desired_version;
+    reported_version = s->reported_version;
+    for (int i = 0; i < entry_count; i++) {
+        MQTT_ShadowEntry_t *e = &entries[i];
+        bool changed = strncmp(e->value, s->values[i], MQTT_SHADOW_VALUE_SIZE) != 0;
+        memcpy(e->value, s->values[i], MQTT_SHADOW_VALUE_SIZE);
+        e->value[MQTT_SHADOW_VALUE_SIZE - 1] = '\0';
+        e->dirty = (s->dirty >> i) & 1u;
+        if (changed && change_handler) {
+            change_handler(e->key, e->value);
+        }
+    }
+}
+
+/**
+ * @brief 保存当前版本号与键值 (版本号变化时调用)
+ */
+static void MQTT_Shadow_Persist(void)
+{
+    MQTT_ShadowState *s = &shadow_state;
+
+    memset(s, 0, sizeof(*s));
+    s->magic = MQTT_SHADOW_MAGIC;
+    s->keys_hash = MQTT_Shadow_KeysHash();
+    s->desired_version = desired_version;
+    s->reported_version = reported_version;
+    for (int i = 0; i < entry_count; i++) {
+        memcpy(s->values[i], entries[i].value, MQTT_SHADOW_VALUE_SIZE);
+        if (entries[i].dirty) s->dirty |= 1u << i;
+    }
+    s->checksum = MQTT_Shadow_Checksum(s);
+    MQTT_Shadow_Save(s);
+}
+#else
+#define MQTT_Shadow_Persist() ((void)0)
+#endif
+
+/**
+ * @brief 应用一对 "k=v"：值变化时更新、标记待上报并回调
+ */
+static void MQTT_Shadow_Apply(const char *pair, uint16_t len)
+{
+    const char *eq = memchr(pair, '=', len);
+    if (eq == NULL) return;
+
+    uint16_t key_len = (uint16_t)(eq - pair);
+    uint16_t value_len = (uint16_t)(len - key_len - 1);
+    MQTT_ShadowEntry_t *e = MQTT_Shadow_Find(pair, key_len);
+    if (e == NULL || value_len >= MQTT_SHADOW_VALUE_SIZE) return; /* 未定义的键或值过长 */
+
+    if (strlen(e->value) == value_len && memcmp(e->value, eq + 1, value_len) == 0) return;
+
+    memcpy(e->value, eq + 1, value_len);
+    e->value[value_len] = '\0';
+    e->dirty = true; /* 应用后的值作为已上报状态回传 */
+    if (change_handler) {
+        change_handler(e->key, e->value);
+    }
+}
+
+/**
+ * @brief 期望主题回调 (接收路径内)
+ * @details 以原始长度接收：普通订阅会把内容截断到 MQTT_PAYLOAD_SIZE，被截断的
+ *          最后一对 (如 rate=100 变成 rate=1) 仍会被应用且版本前进，后端不再补发。
+ */
+static void MQTT_Shadow_OnDesiredStream(const uint8_t *payload, uint32_t len)
+{
+    /* 后端检测到上报缺口：全部重报 */
+    if (len == 1 && payload[0] == '?') {
+        for (int i = 0; i < entry_count; i++) {
+            entries[i].dirty = true;
+        }
+        return;
+    }
+
+    /* 放不下或队列已满：丢弃，版本不变，由 get 请求补发 */
+    if (len >= MQTT_SHADOW_DOC_SIZE || (uint8_t)(rx_head - rx_tail) >= MQTT_SHADOW_RX_QUEUE) {
+        get_pending = true;
+        return;
+    }
+    char *slot = rx_queue[rx_head % MQTT_SHADOW_RX_QUEUE];
+    memcpy(slot, payload, len);
+    slot[len] = '\0';
+    rx_head++;
+}
+
+/**
+ * @brief 应用一条期望增量
+ */
+static void MQTT_Shadow_OnDesired(const char *payload)
+{
+    uint32_t base, ver;
+    const char *p;
+
+    p = MQTT_Shadow_ParseVersion(payload, &base);
+    if (p == NULL || *p++ != ':') return;
+    p = MQTT_Shadow_ParseVersion(p, &ver);
+    if (p == NULL || *p++ != '|') return;
+
+    if (ver <= desired_version) return; /* 已应用 (如重连后收到的保留消息) */
+    if (base > desired_version) {
+        get_pending = true; /* 缺少 desired_version..base 之间的增量 */
+        return;
+    }
+
+    while (*p) {
+        const char *end = strchr(p, ';');
+        uint16_t len = end ? (uint16_t)(end - p) : (uint16_t)strlen(p);
+        MQTT_Shadow_Apply(p, len);
+        p += len;
+        if (*p == ';') p++;
+    }
+    desired_version = ver;
+    MQTT_Shadow_Persist();
+}
+
+/**
+ * @brief 将待上报的键打包成一条增量文档并发布 (保留)
+ * @return true 已无待上报的键或发布成功
+ */
+static bool MQTT_Shadow_Report(void)
+{
+    char doc[MQTT_SHADOW_DOC_SIZE];
+    bool included[MQTT_SHADOW_MAX_KEYS] = {false};
+    bool any = false;
+
+    int n = snprintf(doc, sizeof(doc), "%lu:%lu|", (unsigned long)reported_version,
+                     (unsigned long)(reported_version + 1));
+    const int header = n;
+    for (int i = 0; i < entry_count; i++) {
+        if (!entries[i].dirty) continue;
+
+        int need = snprintf(NULL, 0, "%s%s=%s", any ? ";" : "", entries[i].key, entries[i].value);
+        if (n + need >= (int)sizeof(doc)) {
+            if (header + need - (any ? 1 : 0) >= (int)sizeof(doc)) {
+                /* 单独一条也放不下，以后也不会放下 (版本号只增不减)：放弃并计数 */
+                entries[i].dirty = false;
+                oversize_count++;
+            }
+            continue; /* 放不下的留给下一条 */
+        }
+
+        n += snprintf(&doc[n], sizeof(doc) - n, "%s%s=%s", any ? ";" : "", entries[i].key, entries[i].value);
+        included[i] = true;
+        any = true;
+    }
+    if (!any) return true;
+
+    if (!MQTT_PublishRetained(topic_reported, doc)) return false;
+
+    for (int i = 0; i < entry_count; i++) {
+        if (included[i]) entries[i].dirty = false;
+    }
+    reported_version++;
+    MQTT_Shadow_Persist();
+    return true;
+}
+
+/* ==========================================
+ * 公共接口函数实现
+ * ========================================== */
+
+bool MQTT_Shadow_Init(const char *prefix, MQTT_ShadowHandler handler)
+{
+    if (prefix == NULL) return false;
+
+    int n = snprintf(topic_reported, sizeof(topic_reported), "%s/reported", prefix);
+    if (n < 0 || n >= (int)sizeof(topic_reported)) return false;
+    snprintf(topic_desired, sizeof(topic_desired), "%s/desired", prefix);
+    snprintf(topic_get, sizeof(topic_get), "%s/get", prefix);
+
+    change_handler = handler;
+#ifdef MQTT_SHADOW_PERSIST
+    MQTT_Shadow_Restore();
+#endif
+    return MQTT_SubscribeStream(topic_desired, 0, MQTT_Shadow_OnDesiredStream);
+}
+
+bool MQTT_Shadow_Define(const char *key, const char *initial)
+{
+    if (key == NULL || initial == NULL || strlen(initial) >= MQTT_SHADOW_VALUE_SIZE) return false;
+
+    MQTT_ShadowEntry_t *e = MQTT_Shadow_Find(key, (uint16_t)strlen(key));
+    if (e == NULL) {
+        if (entry_count >= MQTT_SHADOW_MAX_KEYS) return false;
+        e = &entries[entry_count++];
+        e->key = key;
+    }
+    strcpy(e->value, initial);
+    e->dirty = false;
+    return true;
+}
+
+const char *MQTT_Shadow_Get(const char *key)
+{
+    if (key == NULL) return NULL;
+
+    MQTT_ShadowEntry_t *e = MQTT_Shadow_Find(key, (uint16_t)strlen(key));
+    return e ? e->value : NULL;
+}
+
+bool MQTT_Shadow_Set(const char *key, const char *value)
+{
+    if (key == NULL || value == NULL || strlen(value) >= MQTT_SHADOW_VALUE_SIZE) return false;
+
+    MQTT_ShadowEntry_t *e = MQTT_Shadow_Find(key, (uint16_t)strlen(key));
+    if (e == NULL) return false;
+
+    if (strcmp(e->value, value) != 0) {
+        strcpy(e->value, value);
+        e->dirty = true;
+    }
+    return true;
+}
+
+uint32_t MQTT_Shadow_Version(void)
+{
+    return desired_version;
+}
+
+uint32_t MQTT_Shadow_Oversize(void)
+{
+    return oversize_count;
+}
+
+void MQTT_Shadow_Service(void)
+{
+    while (rx_tail != rx_head) {
+        MQTT_Shadow_OnDesired(rx_queue[rx_tail % MQTT_SHADOW_RX_QUEUE]);
+        rx_tail++;
+    }
+
+    if (!MQTT_IsConnected() || topic_desired[0] == '\0') return;
+
+    /* 1. 请求补发缺失的期望增量 */
+    if (get_pending) {
+        char ver[12];
+        snprintf(ver, sizeof(ver), "%lu", (unsigned long)desired_version);
+        if (MQTT_Publish(topic_get, ver)) {
+            get_pending = false;
+        }
+        return;
+    }
+
+    /* 2. 上报本地变化 */
+    MQTT_Shadow_Report();
+}
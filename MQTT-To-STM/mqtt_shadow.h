@@ -0,0 +1,139 @@
+/**
+  * @file    mqtt_shadow.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   设备影子：带版本号的键值存储，只交换变化的键 (增量文档)
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef __MQTT_SHADOW_H
+#define __MQTT_SHADOW_H
+
+#include "conn.h"
+
+/* ==========================================
+ * 用户配置区域
+ * ========================================== */
+#define MQTT_SHADOW_MAX_KEYS 16     /* 键数量上限 (不超过 32) */
+#define MQTT_SHADOW_VALUE_SIZE 24   /* 单个值最大长度 (含结束符) */
+#define MQTT_SHADOW_TOPIC_SIZE 64   /* 影子主题最大长度 (前缀 + 后缀) */
+#define MQTT_SHADOW_DOC_SIZE MQTT_PAYLOAD_SIZE /* 单条增量文档上限 (收发共用)，超出的期望增量丢弃并请求补发 */
+#define MQTT_SHADOW_RX_QUEUE 2      /* 待应用的期望增量条数 (2 的幂)，补发的增量多于此数时多请求一次补发 */
+#define MQTT_SHADOW_PERSIST /* 复位后保留版本号与键值，重连时不必全量重新同步 (约 410 B .noinit RAM)；注释本宏禁用 */
+
+/* ==========================================
+ * 报文格式 (前缀 <p> 由 MQTT_Shadow_Init 指定)
+ *
+ * <p>/desired   后端 → 设备，保留消息
+ *               "<base>:<ver>|k1=v1;k2=v2"  自版本 base 以来变化的键，应用后版本为 ver
+ *               "?"                          (非保留) 请求设备上报全部键
+ * <p>/reported  设备 → 后端，保留消息
+ *               "<base>:<ver>|k1=v1;..."     自上报版本 base 以来本地变化的键
+ * <p>/get       设备 → 后端
+ *               "<ver>"                      设备已应用到的期望版本，请后端补发之后的增量
+ *
+ * 同步过程：
+ * 1) 设备 (重新) 订阅 desired，服务器下发最后一条保留增量。ver 不大于本地版本时
+ *    说明已是最新，不产生任何流量；base 不大于本地版本时直接应用；
+ *    否则说明中间有缺口，设备发布 get，后端按版本补发增量。
+ * 2) 本地修改 (MQTT_Shadow_Set 或应用期望值) 标记为待上报，连接后只上报这些键。
+ * 因此重连时的同步流量只与变化的键数有关，与配置总量无关。
+ * 一条增量放不下时，后端拆成多条，版本依次递增 (如 5:6、6:7)。
+ * 键与值中不能出现 '='、';'、'|'。
+ * ========================================== */
+
+/**
+ * @brief 影子持久化记录
+ * @details 版本号必须与键值一同保存：只保留版本号时，复位后的初始值会被当作
+ *          已是最新版本，期望值再也不会下发。键定义 (名称与顺序) 变化后自动失效。
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t keys_hash;        /* 键名指纹 */
+    uint32_t desired_version;
+    uint32_t reported_version;
+    uint32_t dirty;            /* 待上报的键 (按定义顺序的位图) */
+    char values[MQTT_SHADOW_MAX_KEYS][MQTT_SHADOW_VALUE_SIZE];
+    uint32_t checksum;         /* 以上字段校验，必须位于末尾 */
+} MQTT_ShadowState;
+
+/**
+ * @brief 读取/保存影子状态 (弱函数，可重写，定义 MQTT_SHADOW_PERSIST 时使用)
+ * @details 默认保存在 .noinit RAM 段，仅在复位后保留；掉电保持请重写为写入
+ *          Flash 或备份域。只在版本号变化时保存 (应用一条期望增量或发出一条上报)，
+ *          写 Flash 的频率与同步次数相同。读取的数据由库自行校验，无效时返回任意内容即可。
+ */
+bool MQTT_Shadow_Load(MQTT_ShadowState *state);
+void MQTT_Shadow_Save(const MQTT_ShadowState *state);
+
+/**
+ * @brief 期望值变化回调 (在 MQTT_Shadow_Service 中执行)
+ * @param key 键
+ * @param value 新值
+ */
+typedef void (*MQTT_ShadowHandler)(const char *key, const char *value);
+
+/**
+ * @brief 初始化影子并订阅 <prefix>/desired
+ * @details 在全部 MQTT_Shadow_Define 之后调用。定义 MQTT_SHADOW_PERSIST 时在此恢复
+ *          复位前的版本号与键值，恢复的值与初始值不同时回调 handler。
+ *
+ * 示例：
+ *   void OnShadow(const char *key, const char *value) { ... }
+ *
+ *   MQTT_Shadow_Define("rate", "1000");
+ *   MQTT_Shadow_Define("led", "off");
+ *   MQTT_Shadow_Init("dev/xrak/shadow", OnShadow);
+ *   while (1) {
+ *       MQTT_Service();
+ *       MQTT_Shadow_Service();
+ *   }
+ *
+ * @param prefix 主题前缀 (内容被复制)
+ * @param handler 期望值变化回调 (可为 NULL)
+ * @return false 前缀过长或订阅表已满
+ */
+bool MQTT_Shadow_Init(const char *prefix, MQTT_ShadowHandler handler);
+
+/**
+ * @brief 定义一个键及其初始值
+ * @param key 键 (需为静态字符串)
+ * @param initial 初始值，不会触发上报
+ * @return false 键已满或值过长
+ */
+bool MQTT_Shadow_Define(const char *key, const char *initial);
+
+/**
+ * @brief 读取键的当前值
+ * @return 值；键不存在时返回 NULL
+ */
+const char *MQTT_Shadow_Get(const char *key);
+
+/**
+ * @brief 设备侧修改键值，值变化时在下次 MQTT_Shadow_Service 中上报
+ * @return false 键不存在或值过长
+ */
+bool MQTT_Shadow_Set(const char *key, const char *value);
+
+/**
+ * @brief 已应用的期望版本
+ */
+uint32_t MQTT_Shadow_Version(void);
+
+/**
+ * @brief 因单独一条增量也放不下 (键名 + 值超过 MQTT_SHADOW_DOC_SIZE) 而放弃上报的次数
+ * @details 不为 0 时请缩短键名或增大 MQTT_PAYLOAD_SIZE
+ */
+uint32_t MQTT_Shadow_Oversize(void);
+
+/**
+ * @brief 影子服务例程：应用收到的期望增量、上报本地变化、按需请求补发
+ * @details 与 MQTT_Service() 一同在主循环中周期性调用，每次至多发出一条消息
+ */
+void MQTT_Shadow_Service(void);
+
+#endif /* __MQTT_SHADOW_H */
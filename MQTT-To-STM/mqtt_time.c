@@ -0,0 +1,365 @@
+/**
+  * @file    mqtt_time.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   设备与后端的时钟同步 (NTP 式四时间戳交换) 及带采集时间戳的发布
+  *
+  * 应答经 MQTT_SubscribeStream 在接收路径上直接处理，t4 在解码出报文时立即
+  * 记录，不经过入站队列的延后分发，往返中不含回调排队时间。
+  * 64 位数值自行格式化 / 解析，不依赖 printf 的 %llu (newlib-nano 默认不支持)。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_time.h"
+#include <string.h>
+#include <stdio.h>
+
+#if MQTT_TIME_HISTORY < 3 || MQTT_TIME_HISTORY > 255
+#error "MQTT_TIME_HISTORY 超出范围 (3~255)"
+#endif
+
+/* ==========================================
+ * 私有变量
+ * ========================================== */
+typedef struct {
+    uint64_t local;  /* 交换中点的本地时间 */
+    int64_t offset;  /* 后端时间 - 本地时间 */
+} MQTT_TimeSample_t;
+
+static MQTT_TimeStatus status;
+static MQTT_TopicId req_id = MQTT_TOPIC_INVALID;
+
+/* HAL_GetTick 扩展为 64 位 (约 49.7 天回绕一次) */
+static uint32_t tick_last = 0;
+static uint32_t tick_high = 0;
+
+/* 当前一轮 */
+static bool round_due = true;  /* 立即开始新一轮 */
+static bool in_round = false;
+static uint32_t next_round = 0;
+static uint8_t burst_left = 0;
+static bool pending = false;   /* 有在途请求 */
+static uint16_t seq = 0;
+static uint32_t sent_tick = 0; /* 在途请求的 t1 */
+static bool burst_has = false;
+static uint32_t burst_rtt = 0;
+static MQTT_TimeSample_t burst_best;
+
+/* 历史轮次与修正模型: 后端时间 = local + ref_offset + (local - ref_local) × drift */
+static MQTT_TimeSample_t history[MQTT_TIME_HISTORY];
+static uint8_t history_count = 0;
+static uint8_t history_head = 0;
+static uint64_t ref_local = 0;
+static int64_t ref_offset = 0;
+static uint64_t last_now = 0;
+
+/* 时间戳前缀 "@<u64>,<u64>|"：两个至多 20 位的十进制数加 3 个分隔符 */
+#define MQTT_TIME_STAMP_MAX (2 * 20 + 3)
+
+/* 后端时间须落在 2000-01-01 ~ 2100-01-01 的 Unix 毫秒内，秒/微秒/纳秒或异常时钟的应答丢弃 */
+#define MQTT_TIME_UNIX_MS_MIN 946684800000ULL
+#define MQTT_TIME_UNIX_MS_MAX 4102444800000ULL
+
+static uint8_t stamp_buf[MQTT_TIME_STAMP_MAX + MQTT_TIME_PAYLOAD_MAX];
+
+/* ==========================================
+ * 辅助函数
+ * ========================================== */
+
+static uint64_t MQTT_Time_Local(void)
+{
+    uint32_t t = HAL_GetTick();
+    if (t < tick_last) tick_high++;
+    tick_last = t;
+    return ((uint64_t)tick_high << 32) | t;
+}
+
+/**
+ * @brief 过去某刻的 HAL_GetTick() 对应的 64 位本地时间
+ */
+static uint64_t MQTT_Time_LocalAt(uint32_t tick)
+{
+    uint64_t now = MQTT_Time_Local();
+    return now - (uint32_t)(tick_last - tick);
+}
+
+static uint64_t MQTT_Time_ToBackend(uint64_t local)
+{
+    int64_t dt = (int64_t)(local - ref_local);
+    return (uint64_t)((int64_t)local + ref_offset + dt * status.drift_ppb / 1000000000);
+}
+
+static uint8_t MQTT_Time_FormatU64(char *buf, uint64_t v)
+{
+    char tmp[20];
+    uint8_t n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    for (uint8_t i = 0; i < n; i++) {
+        buf[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+/**
+ * @brief 解析十进制数，并跳过其后的分隔符 sep (sep 为 0 时要求到达末尾)
+ */
+static bool MQTT_Time_ParseU64(const uint8_t **p, const uint8_t *end, char sep, uint64_t *out)
+{
+    uint64_t v = 0;
+    const uint8_t *s = *p;
+
+    if (s >= end || *s < '0' || *s > '9') return false;
+    while (s < end && *s >= '0' && *s <= '9') {
+        v = v * 10 + (uint64_t)(*s++ - '0');
+    }
+    if (sep != 0) {
+        if (s >= end || *s != (uint8_t)sep) return false;
+        s++;
+    } else if (s != end) {
+        return false;
+    }
+    *p = s;
+    *out = v;
+    return true;
+}
+
+/**
+ * @brief 应答回调 (接收路径内，不可发布)
+ */
+static void MQTT_Time_OnReply(const uint8_t *payload, uint32_t len)
+{
+    uint32_t t4 = HAL_GetTick();
+    const uint8_t *p = payload, *end = payload + len;
+    uint16_t id = 0;
+    uint64_t t1, t2, t3;
+
+    if (!pending || len < 5) return;
+    for (int i = 0; i < 4; i++) {
+        uint8_t c = *p++;
+        uint8_t digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else return;
+        id = (uint16_t)((id << 4) | digit);
+    }
+    if (*p++ != '|' || !MQTT_Time_ParseU64(&p, end, ',', &t1) || !MQTT_Time_ParseU64(&p, end, ',', &t2) ||
+        !MQTT_Time_ParseU64(&p, end, 0, &t3)) {
+        return;
+    }
+    /* 迟到的应答 (已超时) 序号不符，丢弃 */
+    if (id != seq || t1 != sent_tick || t3 < t2) return;
+    if (t2 < MQTT_TIME_UNIX_MS_MIN || t3 > MQTT_TIME_UNIX_MS_MAX) return;
+
+    pending = false;
+    status.exchanges++;
+
+    uint32_t elapsed = t4 - sent_tick;
+    uint64_t served = t3 - t2;
+    uint32_t rtt = (served >= elapsed) ? 0 : (uint32_t)(elapsed - served);
+    uint64_t l4 = MQTT_Time_LocalAt(t4);
+    uint64_t l1 = l4 - elapsed;
+
+    if (!burst_has || rtt < burst_rtt) {
+        burst_has = true;
+        burst_rtt = rtt;
+        burst_best.local = l1 + elapsed / 2;
+        burst_best.offset = ((int64_t)(t2 - l1) + (int64_t)(t3 - l4)) / 2;
+    }
+}
+
+/**
+ * @brief 一轮结束：记录本轮最佳样本，更新频偏与修正模型
+ */
+static void MQTT_Time_FinishRound(void)
+{
+    /* 后端时钟跳变 (如被人工校时)：旧历史不再可用 */
+    if (status.synced) {
+        int64_t predicted = (int64_t)MQTT_Time_ToBackend(burst_best.local) - (int64_t)burst_best.local;
+        int64_t diff = burst_best.offset - predicted;
+        if (diff > MQTT_TIME_STEP_MS || diff < -MQTT_TIME_STEP_MS) {
+            history_count = 0;
+            status.drift_ppb = 0;
+            last_now = 0;
+        }
+    }
+
+    history[history_head] = burst_best;
+    history_head = (uint8_t)((history_head + 1) % MQTT_TIME_HISTORY);
+    if (history_count < MQTT_TIME_HISTORY) history_count++;
+
+    ref_local = burst_best.local;
+    ref_offset = burst_best.offset;
+
+    /* 偏移对本地时间做最小二乘；每轮只算一次，用 double 不影响实时性 */
+    uint8_t oldest = (uint8_t)((history_head + MQTT_TIME_HISTORY - history_count) % MQTT_TIME_HISTORY);
+    if (history_count >= 3 && burst_best.local - history[oldest].local >= MQTT_TIME_DRIFT_SPAN_MS) {
+        const MQTT_TimeSample_t *base = &history[oldest];
+        double mx = 0, my = 0, sxx = 0, sxy = 0;
+
+        for (uint8_t i = 0; i < history_count; i++) {
+            mx += (double)(history[i].local - base->local);
+            my += (double)(history[i].offset - base->offset);
+        }
+        mx /= history_count;
+        my /= history_count;
+        for (uint8_t i = 0; i < history_count; i++) {
+            double dx = (double)(history[i].local - base->local) - mx;
+            double dy = (double)(history[i].offset - base->offset) - my;
+            sxx += dx * dx;
+            sxy += dx * dy;
+        }
+
+        double slope = sxy / sxx;
+        if (slope <= MQTT_TIME_MAX_DRIFT_PPM * 1e-6 && slope >= -MQTT_TIME_MAX_DRIFT_PPM * 1e-6) {
+            double x = (double)(burst_best.local - base->local);
+            status.drift_ppb = (int32_t)(slope * 1e9);
+            ref_offset = base->offset + (int64_t)(my + slope * (x - mx));
+        }
+    }
+
+    status.synced = true;
+    status.offset_ms = ref_offset;
+    status.rtt_ms = burst_rtt;
+    status.rounds++;
+}
+
+static void MQTT_Time_SendRequest(uint32_t now)
+{
+    char buf[16];
+    int n;
+
+    if (++seq == 0) seq = 1;
+    n = snprintf(buf, sizeof(buf), "%04X|%lu", seq, (unsigned long)now);
+    sent_tick = now;
+    pending = true; /* 发送失败也按超时处理，避免每次服务都重发 */
+    burst_left--;
+    MQTT_PublishById(req_id, (const uint8_t *)buf, (uint16_t)n);
+}
+
+/* ==========================================
+ * 公共接口函数实现
+ * ========================================== */
+
+bool MQTT_Time_Init(const char *topic)
+{
+    char reply_topic[64 + sizeof(MQTT_TIME_REPLY_SUFFIX)];
+
+    /* 截断后会订阅到错误的应答主题 */
+    int n = snprintf(reply_topic, sizeof(reply_topic), "%s%s", topic, MQTT_TIME_REPLY_SUFFIX);
+    if (n < 0 || (size_t)n >= sizeof(reply_topic)) return false;
+
+    req_id = MQTT_RegisterTopic(topic);
+    if (req_id == MQTT_TOPIC_INVALID) return false;
+
+    if (!MQTT_SubscribeStream(reply_topic, 0, MQTT_Time_OnReply)) {
+        req_id = MQTT_TOPIC_INVALID;
+        return false;
+    }
+    round_due = true;
+    return true;
+}
+
+void MQTT_Time_Service(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    (void)MQTT_Time_Local(); /* 定期调用以跟踪 HAL_GetTick 回绕 */
+    if (req_id == MQTT_TOPIC_INVALID) return;
+    if (!MQTT_IsConnected()) {
+        pending = false; /* 断线期间的应答已丢失，重连后继续本轮 */
+        return;
+    }
+
+    if (pending) {
+        if (now - sent_tick < MQTT_TIME_TIMEOUT_MS) return;
+        pending = false;
+        status.timeouts++;
+    }
+
+    if (burst_left > 0) {
+        MQTT_Time_SendRequest(now);
+        return;
+    }
+
+    if (in_round) {
+        in_round = false;
+        if (burst_has) MQTT_Time_FinishRound();
+        next_round = now + (burst_has ? MQTT_TIME_INTERVAL_MS : MQTT_TIME_RETRY_MS);
+    }
+
+    if (round_due || (int32_t)(now - next_round) >= 0) {
+        round_due = false;
+        in_round = true;
+        burst_has = false;
+        burst_left = MQTT_TIME_BURST;
+        MQTT_Time_SendRequest(now);
+    }
+}
+
+uint32_t MQTT_Time_NextDeadline(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    if (req_id == MQTT_TOPIC_INVALID || !MQTT_IsConnected()) return MQTT_WAIT_FOREVER;
+    if (pending) {
+        uint32_t elapsed = now - sent_tick;
+        return (elapsed >= MQTT_TIME_TIMEOUT_MS) ? 0 : MQTT_TIME_TIMEOUT_MS - elapsed;
+    }
+    if (burst_left > 0 || in_round || round_due) return 0;
+    return ((int32_t)(next_round - now) > 0) ? next_round - now : 0;
+}
+
+void MQTT_Time_Sync(void)
+{
+    if (!in_round) round_due = true;
+}
+
+uint64_t MQTT_Time_Now(void)
+{
+    if (!status.synced) return 0;
+
+    /* 修正模型更新后可能回退几毫秒：保持单调，调用者可直接相减 */
+    uint64_t now = MQTT_Time_ToBackend(MQTT_Time_Local());
+    if (now < last_now) now = last_now;
+    last_now = now;
+    return now;
+}
+
+uint64_t MQTT_Time_FromTick(uint32_t tick)
+{
+    if (!status.synced) return 0;
+    return MQTT_Time_ToBackend(MQTT_Time_LocalAt(tick));
+}
+
+bool MQTT_Time_Publish(MQTT_TopicId id, uint32_t capture_tick, const uint8_t *payload, uint16_t len)
+{
+    if (len > MQTT_TIME_PAYLOAD_MAX) return false;
+    if (!status.synced) return MQTT_PublishById(id, payload, len);
+
+    uint64_t capture = MQTT_Time_FromTick(capture_tick);
+    char *p = (char *)stamp_buf;
+    *p++ = '@';
+    p += MQTT_Time_FormatU64(p, capture);
+    *p++ = ',';
+    p += MQTT_Time_FormatU64(p, MQTT_Time_Now()); /* 最后取发送时刻，紧接着发出 */
+    *p++ = '|';
+
+    uint16_t head = (uint16_t)(p - (char *)stamp_buf);
+    memcpy(&stamp_buf[head], payload, len);
+    if (!MQTT_PublishById(id, stamp_buf, (uint16_t)(head + len))) return false;
+    status.stamped++;
+    return true;
+}
+
+const MQTT_TimeStatus *MQTT_Time_GetStatus(void)
+{
+    return &status;
+}
@@ -0,0 +1,127 @@
+/**
+  * @file    mqtt_time.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   设备与后端的时钟同步 (NTP 式四时间戳交换) 及带采集时间戳的发布
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef __MQTT_TIME_H
+#define __MQTT_TIME_H
+
+#include "conn.h"
+
+/* ==========================================
+ * 用户配置区域
+ * ========================================== */
+#define MQTT_TIME_REPLY_SUFFIX "/reply" /* 应答主题 = 请求主题 + 后缀 */
+#define MQTT_TIME_INTERVAL_MS 60000     /* 已同步后的同步周期 */
+#define MQTT_TIME_RETRY_MS 5000         /* 尚未同步或上一轮全部超时时的重试周期 */
+#define MQTT_TIME_BURST 4               /* 每轮连续交换次数，取往返最短的一次 */
+#define MQTT_TIME_TIMEOUT_MS 2000       /* 单次交换的超时 */
+#define MQTT_TIME_HISTORY 8             /* 估计频偏使用的历史轮数 (>= 3) */
+#define MQTT_TIME_DRIFT_SPAN_MS 30000   /* 历史跨度不足此值时不估计频偏 (偏移噪声会被放大) */
+#define MQTT_TIME_MAX_DRIFT_PPM 500     /* 频偏估计的上限，超出视为异常而忽略 */
+#define MQTT_TIME_STEP_MS 1000          /* 偏移与预测相差超过此值视为后端时钟跳变，丢弃历史 */
+#define MQTT_TIME_PAYLOAD_MAX 128       /* MQTT_Time_Publish 的消息内容上限 (不含时间戳) */
+
+/* ==========================================
+ * 报文格式
+ * 请求: 主题 <topic>，内容 "<seq>|<t1>"
+ * 应答: 主题 <topic>/reply，内容 "<seq>|<t1>,<t2>,<t3>"
+ *   <seq> 4 位十六进制序号；t1 为设备发出请求时的 HAL_GetTick()，后端原样带回；
+ *   t2 / t3 为后端收到请求 / 发出应答时的 Unix 毫秒时间 (须在 2000~2100 年之间，否则丢弃)。
+ * 设备收到应答时记 t4，则
+ *   往返 = (t4 - t1) - (t3 - t2)，偏移 = ((t2 - t1) + (t3 - t4)) / 2
+ * 每轮取往返最短的一次交换，排队造成的非对称延迟最小；多轮偏移对本地时间做
+ * 最小二乘，斜率即本地晶振相对后端的频偏。
+ *
+ * 带时间戳的消息 (MQTT_Time_Publish):
+ *   "@<capture>,<send>|<原内容>"
+ *   capture 为数据采集时刻、send 为实际发出时刻，均为后端时钟的 Unix 毫秒。
+ *   后端收到时记 rx，则 send - capture 为设备内排队耗时，rx - send 为网络
+ *   (串口 + WiFi + Broker) 耗时。
+ * ========================================== */
+
+/**
+ * @brief 同步状态 (只读)
+ */
+typedef struct {
+  bool synced;         /* 至少完成过一轮同步 */
+  int64_t offset_ms;   /* 后端时间 - 本地 HAL_GetTick 时间 (最近一轮) */
+  int32_t drift_ppb;   /* 本地时钟相对后端的频偏 (十亿分之一)，正值表示本地偏慢 */
+  uint32_t rtt_ms;     /* 最近一轮的最短往返 */
+  uint32_t rounds;     /* 完成的轮数 */
+  uint32_t exchanges;  /* 收到的有效应答 */
+  uint32_t timeouts;   /* 超时的交换 */
+  uint32_t stamped;    /* 带时间戳发出的消息 */
+} MQTT_TimeStatus;
+
+/**
+ * @brief 启用时钟同步
+ * @details 注册请求主题并订阅应答主题，连接后由 MQTT_Time_Service 自动开始第一轮。
+ *          后端需订阅请求主题并按上述格式应答 (dev.py clock 或 fleetsim broker)。
+ *
+ *   MQTT_Time_Init("dev/" MQTT_CLIENT_ID "/time");
+ *
+ * @param topic 请求主题 (需为静态字符串，不可含通配符)
+ * @return false 主题过长 (加应答后缀超过 64 字节)，或主题注册表、订阅表已满
+ */
+bool MQTT_Time_Init(const char *topic);
+
+/**
+ * @brief 同步服务例程：发出请求、处理超时、每轮结束时更新偏移与频偏
+ * @details 与 MQTT_Service() 一同在主循环中周期性调用
+ */
+void MQTT_Time_Service(void);
+
+/**
+ * @brief 距离 MQTT_Time_Service 下一次需要运行的毫秒数，可与 MQTT_Idle 配合
+ */
+uint32_t MQTT_Time_NextDeadline(void);
+
+/**
+ * @brief 立即开始新一轮同步 (如重连后、或刚完成耗时较长的操作后)
+ */
+void MQTT_Time_Sync(void);
+
+/**
+ * @brief 当前后端时间 (Unix 毫秒)，已按频偏修正且单调不减
+ * @return 尚未同步时返回 0
+ */
+uint64_t MQTT_Time_Now(void);
+
+/**
+ * @brief 把过去某刻的 HAL_GetTick() 换算为后端时间
+ * @details 采集数据时只记 HAL_GetTick()，发出时再换算，采集路径上不做 64 位运算
+ * @return 尚未同步时返回 0
+ */
+uint64_t MQTT_Time_FromTick(uint32_t tick);
+
+/**
+ * @brief 发布带采集时间戳的消息
+ * @details 内容前加 "@<capture>,<send>|"。尚未同步时原样发布，不加时间戳。
+ *
+ *   uint32_t t = HAL_GetTick();
+ *   float v = Sensor_Read();
+ *   ...
+ *   MQTT_Time_Publish(tele_id, t, (const uint8_t *)buf, len);
+ *
+ * @param id 已注册主题
+ * @param capture_tick 数据采集时的 HAL_GetTick()
+ * @param payload 消息内容 (可含二进制)
+ * @param len 消息长度，不超过 MQTT_TIME_PAYLOAD_MAX
+ * @return false 未连接、内容过长或发送失败
+ */
+bool MQTT_Time_Publish(MQTT_TopicId id, uint32_t capture_tick, const uint8_t *payload, uint16_t len);
+
+/**
+ * @brief 获取同步状态
+ */
+const MQTT_TimeStatus *MQTT_Time_GetStatus(void);
+
+#endif /* __MQTT_TIME_H */
@@ -0,0 +1,206 @@
+/**
+  * @file    mqtt_trace.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   飞行记录器：关键事件写入复位后保留的环形缓冲，重启后经 MQTT 分批上传
+  *
+  * 环形缓冲与连接缓存一样放在 .noinit 段，看门狗 / 软件复位后内容不变，
+  * 设备卡死被复位后仍能看到卡死前最后的 AT 交互。记录按写入顺序编号，
+  * 上传进度 (flushed) 也保存在段内，上传中途复位后从断点继续。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_trace.h"
+#include <string.h>
+
+#ifdef MQTT_TRACE
+
+#if (MQTT_TRACE_SIZE & (MQTT_TRACE_SIZE - 1)) != 0
+#error "MQTT_TRACE_SIZE 须为 2 的幂"
+#endif
+#if MQTT_TRACE_BATCH < 1 || MQTT_TRACE_BATCH > 255 || MQTT_TRACE_BATCH > MQTT_TRACE_SIZE
+#error "MQTT_TRACE_BATCH 超出范围 (1~255，且不大于 MQTT_TRACE_SIZE)"
+#endif
+
+#define MQTT_TRACE_MAGIC 0x4D545231 /* "MTR1" */
+#define MQTT_TRACE_VERSION 1
+#define MQTT_TRACE_HEADER 12
+
+/* ==========================================
+ * 私有变量
+ * ========================================== */
+typedef struct {
+    uint32_t magic;
+    uint32_t check;   /* ~magic ^ boot：上电后的随机内容几乎不可能同时满足 */
+    uint32_t boot;
+    uint32_t seq;     /* 已写入的记录总数，下一条写入 rec[seq % SIZE] */
+    uint32_t flushed; /* 已上传到的序号 */
+    MQTT_TraceRecord rec[MQTT_TRACE_SIZE];
+} MQTT_TraceRing_t;
+
+/* 需在链接脚本中声明 .noinit (NOLOAD) 段 */
+static MQTT_TraceRing_t ring __attribute__((section(".noinit")));
+
+static bool booted = false;
+static uint32_t flush_end = 0; /* 上传截止序号 (不含) */
+static MQTT_TopicId trace_id = MQTT_TOPIC_INVALID;
+static MQTT_TraceStatus status;
+static uint8_t batch_buf[MQTT_TRACE_HEADER + MQTT_TRACE_BATCH * sizeof(MQTT_TraceRecord)];
+
+/* ==========================================
+ * 辅助函数
+ * ========================================== */
+
+/**
+ * @brief 首次使用时校验保留的缓冲区，记录启动事件
+ * @details 上电后内容随机，校验失败则清空；复位后保留的记录全部列入待上传
+ */
+static void MQTT_Trace_Boot(void)
+{
+    booted = true;
+
+    if (ring.magic != MQTT_TRACE_MAGIC || ring.check != (~MQTT_TRACE_MAGIC ^ ring.boot) ||
+        (int32_t)(ring.seq - ring.flushed) < 0) {
+        memset(&ring, 0, sizeof(ring));
+        ring.magic = MQTT_TRACE_MAGIC;
+    } else {
+        status.restored = (ring.seq != ring.flushed);
+    }
+    ring.boot++;
+    ring.check = ~MQTT_TRACE_MAGIC ^ ring.boot;
+    flush_end = ring.seq;
+
+    MQTT_TraceEvent(MQTT_EV_BOOT, MQTT_TRACE_PH_INSTANT, MQTT_TraceResetCause());
+}
+
+static void MQTT_Trace_PutU32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/* ==========================================
+ * 公共接口函数实现
+ * ========================================== */
+
+void MQTT_TraceEvent(uint8_t event, uint8_t phase, uint16_t arg)
+{
+    if (!booted) MQTT_Trace_Boot();
+
+    uint32_t now = MQTT_TraceClock();
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    MQTT_TraceRecord *r = &ring.rec[ring.seq & (MQTT_TRACE_SIZE - 1)];
+    r->time_us = now;
+    r->event = event;
+    r->phase = phase;
+    r->arg = arg;
+    ring.seq++;
+    __set_PRIMASK(primask);
+}
+
+uint16_t MQTT_TraceHash(const void *data, uint16_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t hash = 2166136261u;
+    while (len--) {
+        hash ^= *p++;
+        hash *= 16777619u;
+    }
+    return (uint16_t)((hash >> 16) ^ hash);
+}
+
+bool MQTT_Trace_Init(const char *topic)
+{
+    if (!booted) MQTT_Trace_Boot();
+    trace_id = MQTT_RegisterTopic(topic);
+    return trace_id != MQTT_TOPIC_INVALID;
+}
+
+void MQTT_Trace_Service(void)
+{
+    if (!booted) MQTT_Trace_Boot();
+    if (trace_id == MQTT_TOPIC_INVALID || !MQTT_IsConnected() || !MQTT_Trace_Pending()) return;
+
+    /* 复制一批记录；发布本身也会写入新记录，复制期间不能被覆盖 */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (ring.seq - ring.flushed > MQTT_TRACE_SIZE) {
+        status.lost += ring.seq - ring.flushed - MQTT_TRACE_SIZE;
+        ring.flushed = ring.seq - MQTT_TRACE_SIZE;
+    }
+    uint32_t first = ring.flushed;
+    uint32_t n = ((int32_t)(flush_end - first) > 0) ? flush_end - first : 0;
+    if (n > MQTT_TRACE_BATCH) n = MQTT_TRACE_BATCH;
+
+    batch_buf[0] = 'T';
+    batch_buf[1] = 'R';
+    batch_buf[2] = MQTT_TRACE_VERSION;
+    batch_buf[3] = (uint8_t)n;
+    MQTT_Trace_PutU32(&batch_buf[4], first);
+    MQTT_Trace_PutU32(&batch_buf[8], ring.boot);
+    /* 记录按内存布局直接复制：Cortex-M 为小端，与上传格式一致 */
+    for (uint32_t i = 0; i < n; i++) {
+        memcpy(&batch_buf[MQTT_TRACE_HEADER + i * sizeof(MQTT_TraceRecord)],
+               &ring.rec[(first + i) & (MQTT_TRACE_SIZE - 1)], sizeof(MQTT_TraceRecord));
+    }
+    __set_PRIMASK(primask);
+
+    if (n == 0) return; /* 待上传的记录已全部被覆盖 */
+    if (MQTT_PublishById(trace_id, batch_buf, (uint16_t)(MQTT_TRACE_HEADER + n * sizeof(MQTT_TraceRecord)))) {
+        ring.flushed = first + n;
+    }
+}
+
+void MQTT_Trace_Flush(void)
+{
+    if (!booted) MQTT_Trace_Boot();
+    flush_end = ring.seq;
+}
+
+bool MQTT_Trace_Pending(void)
+{
+    return (int32_t)(flush_end - ring.flushed) > 0;
+}
+
+const MQTT_TraceStatus *MQTT_Trace_GetStatus(void)
+{
+    if (!booted) MQTT_Trace_Boot();
+    status.boot = ring.boot;
+    status.seq = ring.seq;
+    status.flushed = ring.flushed;
+    return &status;
+}
+
+__weak uint32_t MQTT_TraceClock(void)
+{
+#ifdef SysTick
+    /* 毫秒计数与 SysTick 当前值须取自同一毫秒：前后两次读数不同则重读 */
+    uint32_t ms, val;
+    do {
+        ms = HAL_GetTick();
+        val = SysTick->VAL;
+    } while (ms != HAL_GetTick());
+    uint32_t load = SysTick->LOAD + 1;
+    return ms * 1000u + (load - val) * 1000u / load;
+#else
+    return HAL_GetTick() * 1000u;
+#endif
+}
+
+__weak uint16_t MQTT_TraceResetCause(void)
+{
+#ifdef RCC_CSR_IWDGRSTF
+    return (uint16_t)(RCC->CSR >> 24);
+#else
+    return 0;
+#endif
+}
+
+#endif /* MQTT_TRACE */
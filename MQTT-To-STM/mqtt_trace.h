@@ -0,0 +1,142 @@
+/**
+  * @file    mqtt_trace.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   飞行记录器：关键事件写入复位后保留的环形缓冲，重启后经 MQTT 分批上传
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef __MQTT_TRACE_H
+#define __MQTT_TRACE_H
+
+#include "conn.h"
+
+/* ==========================================
+ * 用户配置区域 (总开关 MQTT_TRACE 位于 conn.h)
+ * ========================================== */
+#define MQTT_TRACE_SIZE 512  /* 环形缓冲记录条数，需为 2 的幂 (每条 8 字节) */
+#define MQTT_TRACE_BATCH 32  /* 每条上传消息携带的记录数 (<= 255) */
+
+/* ==========================================
+ * 记录格式 (8 字节，小端)
+ *   time_us  MQTT_TraceClock() 微秒时间戳，约 71 分钟回绕，转换工具按顺序展开
+ *   event    事件类型 MQTT_TraceEventId
+ *   phase    'B' 开始 / 'E' 结束 / 'i' 瞬时 / 'C' 计数 (与 Chrome trace 的 ph 相同)
+ *   arg      事件参数，含义见各事件
+ *
+ * 上传消息 (MQTT_Trace_Init 指定的主题):
+ *   "TR" [版本 1][条数 n][首条序号 u32][本次启动次数 u32] + n 条记录
+ * 序号在各次启动间连续递增，后端据此排序去重、发现丢失的记录。
+ * host/trace2chrome.py 把收集到的消息转换为 Chrome trace (chrome://tracing / Perfetto)。
+ * ========================================== */
+typedef struct {
+  uint32_t time_us;
+  uint8_t event;
+  uint8_t phase;
+  uint16_t arg;
+} MQTT_TraceRecord;
+
+#define MQTT_TRACE_PH_BEGIN 'B'
+#define MQTT_TRACE_PH_END 'E'
+#define MQTT_TRACE_PH_INSTANT 'i'
+#define MQTT_TRACE_PH_COUNTER 'C'
+
+typedef enum {
+  MQTT_EV_BOOT = 1,  /* i: 启动，arg 为 MQTT_TraceResetCause() */
+  MQTT_EV_AT,        /* B: AT 指令名哈希 (0 表示只等待响应)；E: 0 成功 / 1 失败 / 2 超时 */
+  MQTT_EV_SEND,      /* B: 报文长度 (AT 后端即 AT+CIPSEND 长度)；E: 0 成功 / 1 失败 */
+  MQTT_EV_STAGE,     /* B: 建链阶段 MQTT_TraceStage；E: 0 成功 / 1 失败 */
+  MQTT_EV_QUEUE,     /* C: 入站队列深度 */
+  MQTT_EV_CALLBACK,  /* B: 主题哈希；E: 无 */
+  MQTT_EV_USER = 64, /* 应用自定义事件从此开始 */
+} MQTT_TraceEventId;
+
+typedef enum {
+  MQTT_STAGE_OPEN = 1, /* 传输后端建链 (含以下 AT 阶段) */
+  MQTT_STAGE_AT_CHECK, /* AT 基础检查 */
+  MQTT_STAGE_WIFI,     /* WiFi 查询与接入 */
+  MQTT_STAGE_LINK,     /* TCP / SSL 连接 */
+  MQTT_STAGE_CONNECT,  /* MQTT CONNECT */
+} MQTT_TraceStage;
+
+/**
+ * @brief 上传状态 (只读)
+ */
+typedef struct {
+  uint32_t boot;      /* 启动次数 (记录器首次初始化后累计) */
+  uint32_t seq;       /* 已写入的记录总数 */
+  uint32_t flushed;   /* 已上传到的序号 */
+  uint32_t lost;      /* 上传前已被覆盖的记录 */
+  bool restored;      /* 本次启动时缓冲区内有上次保留的记录 */
+} MQTT_TraceStatus;
+
+#ifdef MQTT_TRACE
+
+/**
+ * @brief 写入一条记录 (可在中断中调用，约几十个周期)
+ * @details 协议栈内部经 MQTT_TRACE_* 宏调用；应用可用 MQTT_EV_USER 起的事件号
+ *          记录自己的阶段，如 MQTT_TraceEvent(MQTT_EV_USER, MQTT_TRACE_PH_BEGIN, 0)
+ */
+void MQTT_TraceEvent(uint8_t event, uint8_t phase, uint16_t arg);
+
+/**
+ * @brief 名称哈希 (FNV-1a 折叠为 16 位)，转换工具用同一算法还原 AT 指令与主题名
+ */
+uint16_t MQTT_TraceHash(const void *data, uint16_t len);
+
+#define MQTT_TRACE_BEGIN(ev, arg) MQTT_TraceEvent((ev), MQTT_TRACE_PH_BEGIN, (uint16_t)(arg))
+#define MQTT_TRACE_END(ev, arg) MQTT_TraceEvent((ev), MQTT_TRACE_PH_END, (uint16_t)(arg))
+#define MQTT_TRACE_COUNTER(ev, arg) MQTT_TraceEvent((ev), MQTT_TRACE_PH_COUNTER, (uint16_t)(arg))
+
+/**
+ * @brief 启用上传：注册主题，连接后由 MQTT_Trace_Service 分批发出上次保留的记录
+ * @param topic 上传主题 (需为静态字符串)
+ * @return false 主题注册表已满
+ */
+bool MQTT_Trace_Init(const char *topic);
+
+/**
+ * @brief 上传服务例程：已连接且有待上传记录时，每次调用发出一批
+ * @details 与 MQTT_Service() 一同在主循环中周期性调用
+ */
+void MQTT_Trace_Service(void);
+
+/**
+ * @brief 把截至目前的全部记录加入上传 (如后端下发诊断命令、或检测到异常时)
+ */
+void MQTT_Trace_Flush(void);
+
+/**
+ * @brief 是否还有待上传的记录
+ */
+bool MQTT_Trace_Pending(void);
+
+const MQTT_TraceStatus *MQTT_Trace_GetStatus(void);
+
+/**
+ * @brief 微秒时钟 (弱函数，可重写)
+ * @details 默认由 HAL_GetTick() 与 SysTick 计数值合成；有空闲的 32 位定时器或
+ *          DWT 周期计数器时可重写以降低开销
+ */
+uint32_t MQTT_TraceClock(void);
+
+/**
+ * @brief 复位原因 (弱函数，可重写)，记入启动事件的参数
+ * @details 默认返回 RCC->CSR 的复位标志位 (高 8 位)。标志需软件清除，应用读取
+ *          后可调用 __HAL_RCC_CLEAR_RESET_FLAGS()，否则多次复位的标志会累积
+ */
+uint16_t MQTT_TraceResetCause(void);
+
+#else
+
+#define MQTT_TRACE_BEGIN(ev, arg) ((void)0)
+#define MQTT_TRACE_END(ev, arg) ((void)0)
+#define MQTT_TRACE_COUNTER(ev, arg) ((void)0)
+
+#endif /* MQTT_TRACE */
+
+#endif /* __MQTT_TRACE_H */
@@ -0,0 +1,94 @@
+/**
+  * @file    mqtt_transport.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   MQTT 传输层抽象：协议引擎只通过本接口收发字节流
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef __MQTT_TRANSPORT_H
+#define __MQTT_TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 分段发送的一段数据
+ */
+typedef struct {
+    const uint8_t *data;
+    uint16_t len;
+} MQTT_IoVec;
+
+/**
+ * @brief 传输后端
+ * @details 所有函数均为非阻塞或有界阻塞，ctx 为后端私有数据。
+ *          已提供的后端：
+ *          - MQTT_TransportAT：ESP8266 AT 指令 (conn.c，默认)
+ *          - MQTT_SocketTransportInit：BSD 套接字，POSIX 或 LwIP (mqtt_transport_socket.c)
+ *          - MQTT_TransportSPI：SPI 二进制链路 (mqtt_transport_spi.c，定义 MQTT_SPI_HANDLE)
+ */
+typedef struct {
+    const char *name;
+
+    /* 建立到服务器的字节流链路 (含网络接入等前置步骤) */
+    bool (*open)(void *ctx);
+
+    /* 按顺序发送各段，全部写出才返回 true；各段合起来是一个完整报文 */
+    bool (*writev)(void *ctx, const MQTT_IoVec *iov, uint8_t iovcnt);
+
+    /* 不阻塞即可读取的字节数 */
+    uint32_t (*readable)(void *ctx);
+
+    /* 读取至多 len 字节：返回读到的字节数，0 表示暂无数据，-1 表示链路已断开 */
+    int32_t (*read)(void *ctx, uint8_t *buf, uint32_t len);
+
+    /* 关闭链路 */
+    void (*close)(void *ctx);
+
+    /* 推进后台处理 (如 AT 后端处理串口数据与主动上报)，可为 NULL */
+    void (*poll)(void *ctx);
+
+    void *ctx;
+} MQTT_Transport;
+
+/**
+ * @brief 通知协议引擎链路已断开 (conn.c 实现)
+ * @details 后端在 readable/read/poll 中发现对端关闭、网络断开时调用，可在中断中调用。
+ *          会话立即标记为断开并结束 MQTT_Idle 睡眠，下一次 MQTT_Service 进入重连。
+ */
+void MQTT_LinkLost(void);
+
+/* ==========================================
+ * 套接字后端 (mqtt_transport_socket.c)
+ * 定义 MQTT_TRANSPORT_LWIP 时使用 LwIP 套接字，否则使用 POSIX 套接字
+ * ========================================== */
+typedef struct {
+    const char *host;
+    uint16_t port;
+    int fd;
+} MQTT_SocketCtx;
+
+/**
+ * @brief 初始化套接字后端
+ *
+ * @param t [out] 传输后端，交给 MQTT_SetTransport
+ * @param ctx [out] 后端私有数据，生命周期需覆盖 t 的使用期
+ * @param host 服务器地址 (域名或 IP)
+ * @param port 服务器端口
+ */
+void MQTT_SocketTransportInit(MQTT_Transport *t, MQTT_SocketCtx *ctx, const char *host, uint16_t port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MQTT_TRANSPORT_H */
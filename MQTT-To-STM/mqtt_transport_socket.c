@@ -0,0 +1,212 @@
+/**
+  * @file    mqtt_transport_socket.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   MQTT 套接字传输后端 (POSIX / LwIP)
+  *
+  * 适用于 W5500 + LwIP、以太网 MAC + LwIP 等带 TCP/IP 协议栈的板子，
+  * 以及在主机上以原生套接字速度运行协议引擎。
+  * 定义 MQTT_TRANSPORT_LWIP 时使用 LwIP 套接字 (需 LWIP_SOCKET、LWIP_DNS、
+  * LWIP_SO_RCVBUF 以支持 FIONREAD、LWIP_SOCKET_POLL 以支持发送等待)，否则使用 POSIX 套接字。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "mqtt_transport.h"
+#include <string.h>
+#include <stdio.h>
+
+#ifdef MQTT_TRANSPORT_LWIP
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#define sock_socket      lwip_socket
+#define sock_connect     lwip_connect
+#define sock_setsockopt  lwip_setsockopt
+#define sock_writev      lwip_writev
+#define sock_recv        lwip_recv
+#define sock_poll        lwip_poll
+#define sock_ioctl       lwip_ioctl
+#define sock_fcntl       lwip_fcntl
+#define sock_close       lwip_close
+#define sock_getaddrinfo lwip_getaddrinfo
+#define sock_freeaddrinfo lwip_freeaddrinfo
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define sock_socket      socket
+#define sock_connect     connect
+#define sock_setsockopt  setsockopt
+#define sock_writev      writev
+#define sock_recv        recv
+#define sock_poll        poll
+#define sock_ioctl       ioctl
+#define sock_fcntl       fcntl
+#define sock_close       close
+#define sock_getaddrinfo getaddrinfo
+#define sock_freeaddrinfo freeaddrinfo
+#endif
+
+/* 单次 writev 的最大段数 (发布报文最多 3 段) */
+#define SOCKET_MAX_IOV 4
+
+/* 发送缓冲区持续满的最长等待 (ms)，超时视为链路失效 */
+#define SOCKET_WRITE_TIMEOUT_MS 3000
+
+static bool Socket_Open(void *ctx)
+{
+    MQTT_SocketCtx *s = (MQTT_SocketCtx *)ctx;
+    struct addrinfo hints, *res = NULL;
+    char port[8];
+    int one = 1;
+
+    if (s->fd >= 0) {
+        sock_close(s->fd);
+        s->fd = -1;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(port, sizeof(port), "%u", s->port);
+    if (sock_getaddrinfo(s->host, port, &hints, &res) != 0 || res == NULL) {
+        return false;
+    }
+
+    /* 阻塞建连，之后切换为非阻塞读取 */
+    int fd = sock_socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0 && sock_connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        sock_close(fd);
+        fd = -1;
+    }
+    sock_freeaddrinfo(res);
+    if (fd < 0) {
+        return false;
+    }
+
+    /* MQTT 报文小而频繁：关闭 Nagle，避免与对端延迟 ACK 叠加 */
+    sock_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    sock_fcntl(fd, F_SETFL, sock_fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    s->fd = fd;
+    return true;
+}
+
+static bool Socket_Writev(void *ctx, const MQTT_IoVec *iov, uint8_t iovcnt)
+{
+    MQTT_SocketCtx *s = (MQTT_SocketCtx *)ctx;
+    struct iovec vec[SOCKET_MAX_IOV];
+    int count = 0;
+
+    if (s->fd < 0 || iovcnt > SOCKET_MAX_IOV) return false;
+
+    for (uint8_t i = 0; i < iovcnt; i++) {
+        if (iov[i].len == 0) continue;
+        vec[count].iov_base = (void *)iov[i].data;
+        vec[count].iov_len = iov[i].len;
+        count++;
+    }
+
+    /* 非阻塞套接字：发送缓冲区满时等待可写，直到整个报文写出 */
+    int first = 0;
+    while (first < count) {
+        ssize_t n = sock_writev(s->fd, &vec[first], count - first);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+
+            struct pollfd pfd = {s->fd, POLLOUT, 0};
+            int ready = sock_poll(&pfd, 1, SOCKET_WRITE_TIMEOUT_MS);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready <= 0 || (pfd.revents & (POLLERR | POLLHUP))) return false; /* 超时或出错 */
+            continue;
+        }
+        while (first < count && (size_t)n >= vec[first].iov_len) {
+            n -= vec[first].iov_len;
+            first++;
+        }
+        if (first < count) {
+            vec[first].iov_base = (uint8_t *)vec[first].iov_base + n;
+            vec[first].iov_len -= n;
+        }
+    }
+    return true;
+}
+
+/* 链路已断开：立即关闭，避免之后每次查询都重复报告断开 */
+static void Socket_Lost(MQTT_SocketCtx *s)
+{
+    sock_close(s->fd);
+    s->fd = -1;
+    MQTT_LinkLost();
+}
+
+static uint32_t Socket_Readable(void *ctx)
+{
+    MQTT_SocketCtx *s = (MQTT_SocketCtx *)ctx;
+    int n = 0;
+
+    if (s->fd < 0 || sock_ioctl(s->fd, FIONREAD, &n) != 0 || n < 0) {
+        return 0;
+    }
+    if (n == 0) {
+        /* 无数据时区分"暂无"与"对端已关闭"：窥视 1 字节，返回 0 即 EOF */
+        uint8_t probe;
+        ssize_t r = sock_recv(s->fd, &probe, 1, MSG_PEEK);
+        if (r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            Socket_Lost(s);
+        }
+        return 0;
+    }
+    return (uint32_t)n;
+}
+
+static int32_t Socket_Read(void *ctx, uint8_t *buf, uint32_t len)
+{
+    MQTT_SocketCtx *s = (MQTT_SocketCtx *)ctx;
+
+    if (s->fd < 0) return -1;
+    if (len == 0) return 0;
+
+    ssize_t n = sock_recv(s->fd, buf, len, 0);
+    if (n > 0) return (int32_t)n;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return 0;
+    Socket_Lost(s); /* 对端关闭或出错 */
+    return -1;
+}
+
+static void Socket_Close(void *ctx)
+{
+    MQTT_SocketCtx *s = (MQTT_SocketCtx *)ctx;
+
+    if (s->fd >= 0) {
+        sock_close(s->fd);
+        s->fd = -1;
+    }
+}
+
+void MQTT_SocketTransportInit(MQTT_Transport *t, MQTT_SocketCtx *ctx, const char *host, uint16_t port)
+{
+    ctx->host = host;
+    ctx->port = port;
+    ctx->fd = -1;
+
+    t->name = "socket";
+    t->open = Socket_Open;
+    t->writev = Socket_Writev;
+    t->readable = Socket_Readable;
+    t->read = Socket_Read;
+    t->close = Socket_Close;
+    t->poll = NULL;
+    t->ctx = ctx;
+}
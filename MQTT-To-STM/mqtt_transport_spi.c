@@ -0,0 +1,249 @@
+/**
+  * @file    mqtt_transport_spi.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   MQTT SPI 传输后端：经 SPI + DMA 与运行配套固件的 WiFi 模块交换二进制帧
+  *
+  * 协议见 spi_link.h。与 AT 后端相比没有文本指令解析、没有 CIPSEND 握手，
+  * 每次传输双向各携带至多 SPI_LINK_MAX_PAYLOAD 字节，链路层负责 CRC、重发与流控。
+  * 在 conn.h 中定义 MQTT_SPI_HANDLE 后启用，然后在 MQTT_Start 前调用
+  * MQTT_SetTransport(&MQTT_TransportSPI)。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "conn.h"
+
+#ifdef MQTT_SPI_HANDLE
+
+#include "spi.h"
+#include "spi_link.h"
+#include <string.h>
+
+static SPI_Link spi_link;
+static uint8_t spi_tx_block[SPI_LINK_BLOCK];
+static uint8_t spi_rx_block[SPI_LINK_BLOCK];
+static volatile bool spi_done = false;
+static uint32_t spi_last_xfer = 0;
+static uint8_t spi_state = SPI_LINK_DOWN; /* 模块最近上报的 TCP 链路状态 */
+
+/* 控制通道消息重组 */
+static uint8_t ctrl_buf[256];
+static uint16_t ctrl_len = 0;
+
+/* ==========================================
+ * 底层传输
+ * ========================================== */
+
+/**
+ * @brief 完成一次块交换：生成发送块 → DMA 全双工传输 → 处理收到的块
+ */
+static bool SPI_Transfer(void)
+{
+    SPI_LinkBuild(&spi_link, spi_tx_block);
+
+    spi_done = false;
+    HAL_GPIO_WritePin(MQTT_SPI_CS_PORT, MQTT_SPI_CS_PIN, GPIO_PIN_RESET);
+    if (HAL_SPI_TransmitReceive_DMA(MQTT_SPI_HANDLE, spi_tx_block, spi_rx_block, SPI_LINK_BLOCK) != HAL_OK) {
+        HAL_GPIO_WritePin(MQTT_SPI_CS_PORT, MQTT_SPI_CS_PIN, GPIO_PIN_SET);
+        return false;
+    }
+
+    uint32_t start = HAL_GetTick();
+    while (!spi_done) {
+        if (HAL_GetTick() - start > AT_CMD_TIMEOUT_SHORT) {
+            HAL_SPI_Abort(MQTT_SPI_HANDLE);
+            HAL_GPIO_WritePin(MQTT_SPI_CS_PORT, MQTT_SPI_CS_PIN, GPIO_PIN_SET);
+            return false;
+        }
+    }
+    HAL_GPIO_WritePin(MQTT_SPI_CS_PORT, MQTT_SPI_CS_PIN, GPIO_PIN_SET);
+    spi_last_xfer = HAL_GetTick();
+
+    SPI_LinkReceive(&spi_link, spi_rx_block);
+    return true;
+}
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+    if (hspi == MQTT_SPI_HANDLE) {
+        spi_done = true;
+    }
+}
+
+/**
+ * @brief 处理控制通道上已到齐的消息
+ */
+static void SPI_CtrlProcess(void)
+{
+    ctrl_len += SPI_LinkRead(&spi_link, SPI_LINK_CH_CTRL, &ctrl_buf[ctrl_len], sizeof(ctrl_buf) - ctrl_len);
+
+    while (ctrl_len > 0 && ctrl_len >= 1 + ctrl_buf[0]) {
+        uint8_t msg_len = ctrl_buf[0];
+        if (msg_len >= 2 && ctrl_buf[1] == SPI_CTRL_STATUS) {
+            spi_state = ctrl_buf[2];
+        }
+        ctrl_len -= 1 + msg_len;
+        memmove(ctrl_buf, &ctrl_buf[1 + msg_len], ctrl_len);
+    }
+}
+
+/**
+ * @brief 推进链路：模块请求 (READY 有效)、本端有待发数据或空闲超过
+ *        MQTT_SPI_IDLE_MS (刷新信用) 时发起传输，单次最多 MQTT_SPI_BURST 次
+ */
+static void SPI_Pump(void)
+{
+    for (uint8_t i = 0; i < MQTT_SPI_BURST; i++) {
+        bool ready = HAL_GPIO_ReadPin(MQTT_SPI_READY_PORT, MQTT_SPI_READY_PIN) == GPIO_PIN_SET;
+        if (!ready && !SPI_LinkPending(&spi_link) &&
+            HAL_GetTick() - spi_last_xfer < MQTT_SPI_IDLE_MS) {
+            break;
+        }
+        if (!SPI_Transfer()) break;
+    }
+    SPI_CtrlProcess();
+}
+
+/**
+ * @brief 写入控制消息并等待模块上报状态
+ */
+static bool SPI_CtrlRequest(const uint8_t *msg, uint8_t len, uint32_t timeout)
+{
+    uint8_t prefix = len;
+
+    if (SPI_LinkWritable(&spi_link, SPI_LINK_CH_CTRL) < 1 + len) return false;
+    SPI_LinkWrite(&spi_link, SPI_LINK_CH_CTRL, &prefix, 1);
+    SPI_LinkWrite(&spi_link, SPI_LINK_CH_CTRL, msg, len);
+
+    spi_state = SPI_LINK_DOWN;
+    uint32_t start = HAL_GetTick();
+    while (HAL_GetTick() - start < timeout) {
+        SPI_Pump();
+        if (spi_state != SPI_LINK_DOWN) break;
+    }
+    return spi_state == SPI_LINK_UP;
+}
+
+/**
+ * @brief 向控制消息追加字符串
+ * @param with_nul 是否连同结束符一起追加 (作为字段分隔)
+ * @return false 剩余空间不足 (SSID、密码或服务器地址过长)
+ */
+static bool SPI_CtrlAppend(uint8_t *msg, uint8_t size, uint8_t *len, const char *str, bool with_nul)
+{
+    size_t n = strlen(str) + (with_nul ? 1 : 0);
+    if (n > (size_t)(size - *len)) return false;
+    memcpy(&msg[*len], str, n);
+    *len += (uint8_t)n;
+    return true;
+}
+
+/* ==========================================
+ * 传输后端接口
+ * ========================================== */
+
+static bool SPIT_Open(void *ctx)
+{
+    uint8_t msg[128];
+    uint8_t len = 0;
+    (void)ctx;
+
+    SPI_LinkInit(&spi_link);
+    ctrl_len = 0;
+
+    /* 1. 联网 */
+    msg[len++] = SPI_CTRL_WIFI;
+    if (!SPI_CtrlAppend(msg, sizeof(msg), &len, WIFI_SSID, true) ||
+        !SPI_CtrlAppend(msg, sizeof(msg), &len, WIFI_PASSWORD, false)) {
+        return false;
+    }
+    if (!SPI_CtrlRequest(msg, len, AT_CMD_TIMEOUT_WIFI)) return false;
+
+    /* 2. 建立 TCP/SSL 链路 */
+    len = 0;
+    msg[len++] = SPI_CTRL_OPEN;
+#ifdef MQTT_USE_SSL
+    msg[len++] = 1;
+#else
+    msg[len++] = 0;
+#endif
+    msg[len++] = MQTT_PORT & 0xFF;
+    msg[len++] = MQTT_PORT >> 8;
+    if (!SPI_CtrlAppend(msg, sizeof(msg), &len, MQTT_BROKER, false)) return false;
+    return SPI_CtrlRequest(msg, len, AT_CMD_TIMEOUT_LONG);
+}
+
+static bool SPIT_Writev(void *ctx, const MQTT_IoVec *iov, uint8_t iovcnt)
+{
+    (void)ctx;
+
+    for (uint8_t i = 0; i < iovcnt; i++) {
+        const uint8_t *p = iov[i].data;
+        uint16_t left = iov[i].len;
+        uint32_t start = HAL_GetTick();
+
+        /* 发送缓冲区满时推进链路，等待对端确认腾出空间 */
+        while (left > 0) {
+            uint16_t n = SPI_LinkWrite(&spi_link, SPI_LINK_CH_DATA, p, left);
+            p += n;
+            left -= n;
+            if (left == 0) break;
+            if (spi_state != SPI_LINK_UP || HAL_GetTick() - start > AT_CMD_TIMEOUT_NORMAL) return false;
+            SPI_Pump();
+        }
+    }
+    SPI_Pump();
+    return true;
+}
+
+static uint32_t SPIT_Readable(void *ctx)
+{
+    (void)ctx;
+    return SPI_LinkReadable(&spi_link, SPI_LINK_CH_DATA);
+}
+
+static int32_t SPIT_Read(void *ctx, uint8_t *buf, uint32_t len)
+{
+    (void)ctx;
+
+    if (len > 0xFFFF) len = 0xFFFF;
+    uint16_t n = SPI_LinkRead(&spi_link, SPI_LINK_CH_DATA, buf, (uint16_t)len);
+    if (n == 0 && spi_state != SPI_LINK_UP) return -1;
+    return n;
+}
+
+static void SPIT_Close(void *ctx)
+{
+    uint8_t prefix = 1, op = SPI_CTRL_CLOSE;
+    (void)ctx;
+
+    if (SPI_LinkWritable(&spi_link, SPI_LINK_CH_CTRL) >= 2) {
+        SPI_LinkWrite(&spi_link, SPI_LINK_CH_CTRL, &prefix, 1);
+        SPI_LinkWrite(&spi_link, SPI_LINK_CH_CTRL, &op, 1);
+        SPI_Pump();
+    }
+    spi_state = SPI_LINK_DOWN;
+}
+
+static void SPIT_Poll(void *ctx)
+{
+    (void)ctx;
+    SPI_Pump();
+}
+
+const MQTT_Transport MQTT_TransportSPI = {
+    "SPI link",
+    SPIT_Open,
+    SPIT_Writev,
+    SPIT_Readable,
+    SPIT_Read,
+    SPIT_Close,
+    SPIT_Poll,
+    NULL
+};
+
+#endif /* MQTT_SPI_HANDLE */
@@ -0,0 +1,282 @@
+/**
+  * @file    spi_link.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   主机 ↔ WiFi 模块 SPI 二进制链路协议 (不依赖 HAL，可在主机上编译)
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "spi_link.h"
+#include <string.h>
+
+#if (SPI_LINK_RING_SIZE & (SPI_LINK_RING_SIZE - 1)) != 0
+#error "SPI_LINK_RING_SIZE 必须为 2 的幂"
+#endif
+
+#define RING_MASK (SPI_LINK_RING_SIZE - 1)
+
+/* ==========================================
+ * 环形缓冲区
+ * ========================================== */
+
+static uint16_t Ring_Count(const SPI_Ring *r)
+{
+    return (uint16_t)(r->head - r->tail);
+}
+
+static uint16_t Ring_Free(const SPI_Ring *r)
+{
+    return SPI_LINK_RING_SIZE - Ring_Count(r);
+}
+
+static void Ring_Push(SPI_Ring *r, const uint8_t *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        r->buf[(r->head + i) & RING_MASK] = data[i];
+    }
+    r->head += len;
+}
+
+/* 从 tail + offset 处复制 len 字节，不移动 tail */
+static void Ring_Peek(const SPI_Ring *r, uint16_t offset, uint8_t *out, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        out[i] = r->buf[(r->tail + offset + i) & RING_MASK];
+    }
+}
+
+/* ==========================================
+ * 辅助函数
+ * ========================================== */
+
+/* CRC16-CCITT (多项式 0x1021) 查表：每字节一次查表，按位计算在 MCU 上约慢 8 倍 */
+static const uint16_t crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
+uint16_t SPI_LinkCrc16(const uint8_t *data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+    while (len--) {
+        crc = (uint16_t)((crc << 8) ^ crc16_table[(crc >> 8) ^ *data++]);
+    }
+    return crc;
+}
+
+/**
+ * @brief 取一个新数据帧：轮询各通道，负载受待发数据、对端信用与单帧上限约束
+ * @return 新帧；无可发数据时返回 NULL
+ */
+static const SPI_LinkFrame *SPI_LinkNewFrame(SPI_Link *link)
+{
+    for (uint8_t n = 0; n < SPI_LINK_CHANNELS; n++) {
+        uint8_t ch = (uint8_t)((link->rr + n) % SPI_LINK_CHANNELS);
+        uint16_t avail = Ring_Count(&link->tx[ch]) - link->in_flight[ch];
+        uint16_t credit = (link->peer_credit[ch] > link->in_flight[ch])
+                        ? (uint16_t)(link->peer_credit[ch] - link->in_flight[ch]) : 0;
+        uint16_t len = avail;
+        if (len > credit) len = credit;
+        if (len > SPI_LINK_MAX_PAYLOAD) len = SPI_LINK_MAX_PAYLOAD;
+        if (len == 0) continue;
+
+        SPI_LinkFrame *f = &link->out[link->out_count++];
+        f->seq = ++link->tx_seq;
+        f->channel = ch;
+        f->len = len;
+        link->in_flight[ch] += len;
+        link->rr = (uint8_t)((ch + 1) % SPI_LINK_CHANNELS);
+        return f;
+    }
+    return NULL;
+}
+
+/* 帧 f 的数据在通道发送缓冲区中的偏移：之前同通道未确认帧的长度之和 */
+static uint16_t SPI_LinkFrameOffset(const SPI_Link *link, const SPI_LinkFrame *f)
+{
+    uint16_t offset = 0;
+    for (const SPI_LinkFrame *p = link->out; p < f; p++) {
+        if (p->channel == f->channel) offset += p->len;
+    }
+    return offset;
+}
+
+/* ==========================================
+ * 公共接口函数实现
+ * ========================================== */
+
+void SPI_LinkInit(SPI_Link *link)
+{
+    memset(link, 0, sizeof(*link));
+    link->rx_expect = 1;
+}
+
+uint16_t SPI_LinkWrite(SPI_Link *link, uint8_t channel, const uint8_t *data, uint16_t len)
+{
+    if (channel >= SPI_LINK_CHANNELS) return 0;
+
+    uint16_t room = Ring_Free(&link->tx[channel]);
+    if (len > room) len = room;
+    Ring_Push(&link->tx[channel], data, len);
+    return len;
+}
+
+uint16_t SPI_LinkRead(SPI_Link *link, uint8_t channel, uint8_t *buf, uint16_t len)
+{
+    if (channel >= SPI_LINK_CHANNELS) return 0;
+
+    SPI_Ring *r = &link->rx[channel];
+    uint16_t count = Ring_Count(r);
+    if (len > count) len = count;
+    Ring_Peek(r, 0, buf, len);
+    r->tail += len;
+    return len;
+}
+
+uint16_t SPI_LinkReadable(const SPI_Link *link, uint8_t channel)
+{
+    return (channel < SPI_LINK_CHANNELS) ? Ring_Count(&link->rx[channel]) : 0;
+}
+
+uint16_t SPI_LinkWritable(const SPI_Link *link, uint8_t channel)
+{
+    return (channel < SPI_LINK_CHANNELS) ? Ring_Free(&link->tx[channel]) : 0;
+}
+
+bool SPI_LinkPending(const SPI_Link *link)
+{
+    if (link->ack_due || link->out_count > 0) return true;
+    for (uint8_t ch = 0; ch < SPI_LINK_CHANNELS; ch++) {
+        if (Ring_Count(&link->tx[ch]) > link->in_flight[ch]) return true;
+    }
+    return false;
+}
+
+void SPI_LinkBuild(SPI_Link *link, uint8_t *block)
+{
+    const SPI_LinkFrame *f = NULL;
+
+    /* 1. 选择要发送的帧：回退后的重发 > 新帧 > 确认停滞时从最早未确认帧重发
+     *    (对端的确认最快在下一次传输中到达，停滞两次才判定丢失) */
+    if (link->next_send < link->out_count) {
+        f = &link->out[link->next_send++];
+        link->stats.retransmits++;
+    } else if (link->out_count < SPI_LINK_WINDOW && (f = SPI_LinkNewFrame(link)) != NULL) {
+        link->next_send++;
+    } else if (link->out_count > 0 && ++link->stall >= 2) {
+        link->stall = 0;
+        link->next_send = 0;
+        f = &link->out[link->next_send++];
+        link->stats.retransmits++;
+    }
+
+    /* 2. 报头：seq / ack / 通道 / 长度 / 各通道信用 */
+    uint16_t len = f ? f->len : 0;
+    block[0] = SPI_LINK_MAGIC;
+    block[1] = f ? f->seq : 0;
+    block[2] = (uint8_t)(link->rx_expect - 1);
+    block[3] = f ? f->channel : SPI_LINK_IDLE;
+    block[4] = len & 0xFF;
+    block[5] = len >> 8;
+    for (uint8_t ch = 0; ch < SPI_LINK_CHANNELS; ch++) {
+        uint16_t credit = Ring_Free(&link->rx[ch]);
+        block[6 + 2 * ch] = credit & 0xFF;
+        block[7 + 2 * ch] = credit >> 8;
+    }
+
+    /* 3. 负载与 CRC */
+    if (f) {
+        Ring_Peek(&link->tx[f->channel], SPI_LinkFrameOffset(link, f), &block[SPI_LINK_HEADER], len);
+        link->stats.data_frames++;
+    }
+    uint16_t crc = SPI_LinkCrc16(block, SPI_LINK_HEADER + len);
+    block[SPI_LINK_HEADER + len] = crc & 0xFF;
+    block[SPI_LINK_HEADER + len + 1] = crc >> 8;
+
+    link->ack_due = false;
+    link->stats.blocks++;
+}
+
+void SPI_LinkReceive(SPI_Link *link, const uint8_t *block)
+{
+    /* 1. 校验：任何错误都整块丢弃，对端因收不到确认而重发 */
+    uint16_t len = block[4] | (block[5] << 8);
+    if (block[0] != SPI_LINK_MAGIC || len > SPI_LINK_MAX_PAYLOAD) {
+        link->stats.crc_errors++;
+        return;
+    }
+    uint16_t crc = block[SPI_LINK_HEADER + len] | (block[SPI_LINK_HEADER + len + 1] << 8);
+    if (SPI_LinkCrc16(block, SPI_LINK_HEADER + len) != crc) {
+        link->stats.crc_errors++;
+        return;
+    }
+
+    /* 2. 对端信用 */
+    for (uint8_t ch = 0; ch < SPI_LINK_CHANNELS; ch++) {
+        link->peer_credit[ch] = block[6 + 2 * ch] | (block[7 + 2 * ch] << 8);
+    }
+
+    /* 3. 确认：释放 seq <= ack 的帧及其发送缓冲区数据 */
+    uint8_t ack = block[2];
+    uint8_t popped = 0;
+    while (popped < link->out_count && (int8_t)(ack - link->out[popped].seq) >= 0) {
+        const SPI_LinkFrame *f = &link->out[popped];
+        link->tx[f->channel].tail += f->len;
+        link->in_flight[f->channel] -= f->len;
+        link->stats.tx_bytes += f->len;
+        popped++;
+    }
+    if (popped > 0) {
+        link->out_count -= popped;
+        memmove(link->out, link->out + popped, link->out_count * sizeof(SPI_LinkFrame));
+        link->next_send = (link->next_send > popped) ? (uint8_t)(link->next_send - popped) : 0;
+        link->stall = 0;
+    }
+
+    /* 4. 数据：只接收按序且放得下的帧 */
+    uint8_t ch = block[3];
+    if (ch == SPI_LINK_IDLE || len == 0) return;
+
+    link->ack_due = true;
+    if (ch < SPI_LINK_CHANNELS && block[1] == link->rx_expect && Ring_Free(&link->rx[ch]) >= len) {
+        Ring_Push(&link->rx[ch], &block[SPI_LINK_HEADER], len);
+        link->rx_expect++;
+        link->stats.rx_bytes += len;
+    } else {
+        link->stats.rx_dropped++;
+    }
+}
@@ -0,0 +1,167 @@
+/**
+  * @file    spi_link.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   主机 ↔ WiFi 模块 SPI 二进制链路协议 (不依赖 HAL，可在主机上编译)
+  *
+  * 链路模型：
+  *   SPI 全双工，主机为主机端 (master)。每次传输双方同时交换一个固定长度的块
+  *   (SPI_LINK_BLOCK 字节)，模块有数据时拉高 READY 引脚请求主机发起传输。
+  *
+  * 块格式 (小端)：
+  *   [0]      魔数 0xA5
+  *   [1]      序号 seq (数据帧有效，空闲帧为 0)
+  *   [2]      确认号 ack：已按序接收的最后一个 seq
+  *   [3]      通道号，0xFF 表示空闲帧 (仅携带 ack 与信用)
+  *   [4..5]   负载长度
+  *   [6..]    信用：每通道 2 字节，本端该通道接收缓冲区剩余字节数
+  *   [...]    负载
+  *   [...]    CRC16-CCITT (覆盖从魔数到负载末尾)
+  *   其余字节无意义
+  *
+  * 可靠性：回退 N 帧 (窗口 SPI_LINK_WINDOW)，CRC 错误或缓冲区不足的帧直接丢弃，
+  *   发送端无新帧可发且确认停滞时从最早未确认帧重发。
+  * 流控：发送端只在对端通道信用足够时发送，数据不会因对端缓冲区满而丢失。
+  *
+  * 通道 0 为控制通道，消息格式 [长度][操作码][参数...] (长度含操作码)：
+  *   SPI_CTRL_WIFI   主机→模块  [SSID][0][密码] (模块已联网时直接回 STATUS)
+  *   SPI_CTRL_OPEN   主机→模块  [类型 0=TCP 1=SSL][端口 u16][主机名...]
+  *   SPI_CTRL_CLOSE  主机→模块  无参数
+  *   SPI_CTRL_STATUS 模块→主机  [状态 SPI_LINK_DOWN / SPI_LINK_UP / SPI_LINK_FAILED]
+  * 通道 1 为 TCP 字节流。模块端固件 (如 ESP8266/ESP32 上的 ESP-IDF 程序) 需实现同一协议。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef __SPI_LINK_H
+#define __SPI_LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ==========================================
+ * 配置 (两端必须一致)
+ * ========================================== */
+#ifndef SPI_LINK_BLOCK
+#define SPI_LINK_BLOCK 256     /* 每次传输的块长度 */
+#endif
+#ifndef SPI_LINK_CHANNELS
+#define SPI_LINK_CHANNELS 2    /* 通道数：0 控制，1 数据 */
+#endif
+#ifndef SPI_LINK_RING_SIZE
+#define SPI_LINK_RING_SIZE 512 /* 每通道收/发缓冲区大小 (2 的幂) */
+#endif
+#ifndef SPI_LINK_WINDOW
+#define SPI_LINK_WINDOW 4      /* 未确认帧上限 */
+#endif
+
+#define SPI_LINK_MAGIC 0xA5
+#define SPI_LINK_IDLE 0xFF
+#define SPI_LINK_HEADER (6 + 2 * SPI_LINK_CHANNELS)
+#define SPI_LINK_MAX_PAYLOAD (SPI_LINK_BLOCK - SPI_LINK_HEADER - 2)
+
+#define SPI_LINK_CH_CTRL 0
+#define SPI_LINK_CH_DATA 1
+
+#define SPI_CTRL_OPEN 0x01
+#define SPI_CTRL_CLOSE 0x02
+#define SPI_CTRL_WIFI 0x03
+#define SPI_CTRL_STATUS 0x81
+
+#define SPI_LINK_DOWN 0
+#define SPI_LINK_UP 1
+#define SPI_LINK_FAILED 2
+
+/* ==========================================
+ * 数据结构
+ * ========================================== */
+typedef struct {
+    uint8_t buf[SPI_LINK_RING_SIZE];
+    uint16_t head; /* 写入位置 (自由递增，取模使用) */
+    uint16_t tail; /* 读取位置 */
+} SPI_Ring;
+
+typedef struct {
+    uint8_t seq;
+    uint8_t channel;
+    uint16_t len;
+} SPI_LinkFrame;
+
+typedef struct {
+    uint32_t blocks;        /* 交换的块数 */
+    uint32_t data_frames;   /* 发出的数据帧 (含重发) */
+    uint32_t retransmits;   /* 重发帧数 */
+    uint32_t crc_errors;    /* 魔数/长度/CRC 错误的块 */
+    uint32_t rx_dropped;    /* 乱序、重复或缓冲区不足而丢弃的数据帧 */
+    uint32_t tx_bytes;      /* 已确认的负载字节 */
+    uint32_t rx_bytes;      /* 已接收的负载字节 */
+} SPI_LinkStats;
+
+typedef struct {
+    SPI_Ring tx[SPI_LINK_CHANNELS];
+    SPI_Ring rx[SPI_LINK_CHANNELS];
+    uint16_t peer_credit[SPI_LINK_CHANNELS]; /* 对端最近通告的剩余空间 */
+    uint16_t in_flight[SPI_LINK_CHANNELS];   /* 已发出未确认的字节 */
+    SPI_LinkFrame out[SPI_LINK_WINDOW];      /* 未确认帧，按 seq 递增 */
+    uint8_t out_count;
+    uint8_t next_send;                       /* out 中下一个要发送的下标 */
+    uint8_t tx_seq;                          /* 最近分配的 seq */
+    uint8_t rx_expect;                       /* 期望收到的 seq */
+    uint8_t rr;                              /* 通道轮询起点 */
+    uint8_t stall;                           /* 无新帧可发且确认未推进的传输次数 */
+    bool ack_due;                            /* 收到数据帧后需回送确认 */
+    SPI_LinkStats stats;
+} SPI_Link;
+
+/* ==========================================
+ * 接口
+ * ========================================== */
+
+void SPI_LinkInit(SPI_Link *link);
+
+/**
+ * @brief 写入通道发送缓冲区
+ * @return 实际写入的字节数 (缓冲区满时少于 len)
+ */
+uint16_t SPI_LinkWrite(SPI_Link *link, uint8_t channel, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief 从通道接收缓冲区读取
+ * @return 实际读取的字节数
+ */
+uint16_t SPI_LinkRead(SPI_Link *link, uint8_t channel, uint8_t *buf, uint16_t len);
+
+uint16_t SPI_LinkReadable(const SPI_Link *link, uint8_t channel);
+uint16_t SPI_LinkWritable(const SPI_Link *link, uint8_t channel);
+
+/**
+ * @brief 是否需要发起传输 (有待发/未确认数据或待回送的确认)
+ */
+bool SPI_LinkPending(const SPI_Link *link);
+
+/**
+ * @brief 生成下一次传输要发出的块
+ * @param block SPI_LINK_BLOCK 字节
+ */
+void SPI_LinkBuild(SPI_Link *link, uint8_t *block);
+
+/**
+ * @brief 处理一次传输收到的块
+ * @param block SPI_LINK_BLOCK 字节
+ */
+void SPI_LinkReceive(SPI_Link *link, const uint8_t *block);
+
+uint16_t SPI_LinkCrc16(const uint8_t *data, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SPI_LINK_H */
@@ -7,6 +7,10 @@
 #include "esp_camera.h"
 // 包含WiFi库
 #include <WiFi.h>
+#include <WiFiUdp.h>
+// 共享采集帧池与UDP分片帧格式
+#include "frame_pool.h"
+#include "udp_frame.h"
 
 // ===========================
 // 摄像头型号配置（在board_config.h中选择）
@@ -19,9 +23,21 @@
 const char *ssid = "van";          // WiFi名称
 const char *password = "amkk5637"; // WiFi密码
 
-// 定义你的接收端服务器地址（比如你电脑的 IP）
-// const char* serverIP = "192.168.1.100";
-// const uint16_t serverPort = 8888;
+// ===========================
+// UDP推流配置（默认关闭，只提供HTTP视频流）
+// ===========================
+// 每帧JPEG切成不超过 UDP_FRAME_DATAGRAM 字节的分片发送，帧格式见 udp_frame.h，
+// 电脑端用 host/udprecv 接收重组。启用方法：把 serverIP 改为接收端的实际地址，
+// 再取消下面 UDP_STREAM 的注释。推流期间占用一个帧池订阅名额，采集任务不会休眠
+// #define UDP_STREAM
+const char *serverIP = "";        // 接收端服务器地址（比如你电脑的 IP），为空或无效时不推流
+const uint16_t serverPort = 8888; // 接收端端口
+
+#if defined(UDP_STREAM)
+WiFiUDP udp;
+IPAddress serverAddr;
+bool udpStreaming = false; // 接收端地址有效且已订阅帧池
+#endif
 
 // 函数声明
 void startCameraServer(); // 启动摄像头HTTP服务器
@@ -154,24 +170,87 @@ void setup() {
   Serial.println("");
   Serial.println("WiFi connected");
 
-  udp.begin(8888);
+  // 启动HTTP服务器：控制页面在80端口，MJPEG视频流在81端口（多个客户端共享同一路采集）
+  startCameraServer();
+  Serial.print("Camera Ready! Use 'http://");
+  Serial.print(WiFi.localIP());
+  Serial.println("' to connect");
+
+#if defined(UDP_STREAM)
+  // 只有配置了有效的接收端才订阅帧池（占用一个订阅名额），否则采集任务照常在无人观看时休眠；
+  // setup()与loop()运行在同一任务中，订阅对loop()有效
+  if (!serverAddr.fromString(serverIP)) {
+    Serial.println("UDP stream disabled: serverIP is not a valid address");
+  } else if (!frame_pool_subscribe()) {
+    Serial.println("UDP stream disabled: frame pool subscribers full");
+  } else {
+    udp.begin(serverPort);
+    udpStreaming = true;
+    Serial.printf("UDP stream to %s:%u\n", serverIP, serverPort);
+  }
+#endif
 }
 
-#include <WiFiUdp.h>
+#if defined(UDP_STREAM)
+// 发送一个分片；lwIP发送缓冲暂满时endPacket失败，稍等后重试
+static bool udpSendFragment(const uint8_t *header, const uint8_t *data, size_t len) {
+  for (int attempt = 0; attempt < 3; attempt++) {
+    udp.beginPacket(serverAddr, serverPort);
+    udp.write(header, UDP_FRAME_HEADER_SIZE);
+    udp.write(data, len);
+    if (udp.endPacket()) {
+      return true;
+    }
+    delay(2);
+  }
+  return false;
+}
+#endif
+
 // 主循环函数
 void loop() {
-  camera_fb_t *fb = esp_camera_fb_get();
-  if (fb) {
-    // UDP发送JPEG帧
-    udp.beginPacket(serverIP, serverPort);
-
-    // 添加帧头：帧编号 + 时间戳 + 数据长度
-    uint32_t frame_num = millis();
-    udp.write((uint8_t *)&frame_num, 4);
-    udp.write((uint8_t *)fb->buf, fb->len);
-
-    udp.endPacket();
-    esp_camera_fb_return(fb);
+#if defined(UDP_STREAM)
+  static uint32_t lastSeq = 0;
+  static uint32_t frameId = 0;
+
+  if (!udpStreaming) {
+    delay(10000);
+    return;
+  }
+
+  // 每次只取最新帧：发送期间采集到的帧直接跳过，不会积压延迟
+  pool_frame_t *frame = frame_pool_acquire(lastSeq, pdMS_TO_TICKS(1000));
+  if (!frame) {
+    return;
   }
-  delay(33); // ~30fps
+  lastSeq = frame->seq;
+
+  // 帧头：帧编号 + 分片序号/总数 + 采集时间戳 + JPEG长度
+  udp_frame_header_t h;
+  h.frame_id = frameId++;
+  h.capture_ms = (uint32_t)(frame->timestamp.tv_sec * 1000 + frame->timestamp.tv_usec / 1000);
+  h.jpeg_size = frame->len;
+  h.frag_size = UDP_FRAME_PAYLOAD;
+  h.frag_count = udp_frame_fragment_count(frame->len, UDP_FRAME_PAYLOAD);
+
+  uint8_t header[UDP_FRAME_HEADER_SIZE];
+  for (uint16_t i = 0; i < h.frag_count; i++) {
+    size_t offset = (size_t)i * UDP_FRAME_PAYLOAD;
+    size_t len = frame->len - offset;
+    if (len > UDP_FRAME_PAYLOAD) {
+      len = UDP_FRAME_PAYLOAD;
+    }
+    h.frag_index = i;
+    udp_frame_header_pack(header, &h);
+    if (!udpSendFragment(header, frame->buf + offset, len)) {
+      // 本帧已不完整，剩余分片不再发送，接收端会将其作废
+      log_w("UDP frame %u dropped at fragment %u/%u", h.frame_id, i, h.frag_count);
+      break;
+    }
+  }
+  frame_pool_release(frame);
+#else
+  // 视频流由HTTP服务器任务处理，主循环无事可做
+  delay(10000);
+#endif
 }
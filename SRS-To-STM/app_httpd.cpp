@@ -20,6 +20,7 @@
 #include "sdkconfig.h"
 #include "camera_index.h"
 #include "board_config.h"
+#include "frame_pool.h"
 
 #if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
 #include "esp32-hal-log.h"
@@ -55,8 +56,6 @@ typedef struct {
   int *values;  //array to be filled with values
 } ra_filter_t;
 
-static ra_filter_t ra_filter;
-
 static ra_filter_t *ra_filter_init(ra_filter_t *filter, size_t sample_size) {
   memset(filter, 0, sizeof(ra_filter_t));
 
@@ -205,96 +204,155 @@ static esp_err_t capture_handler(httpd_req_t *req) {
   return res;
 }
 
-static esp_err_t stream_handler(httpd_req_t *req) {
-  camera_fb_t *fb = NULL;
-  struct timeval _timestamp;
-  esp_err_t res = ESP_OK;
-  size_t _jpg_buf_len = 0;
-  uint8_t *_jpg_buf = NULL;
-  char *part_buf[128];
+// 每个 MJPEG 客户端一个发送任务，帧来自 frame_pool 的共享槽
+#define STREAM_TASK_STACK 4096
+#define STREAM_TASK_PRIO 5
+#define STREAM_FRAME_TIMEOUT_MS 3000  // 超过该时间没有新帧则断开
 
-  static int64_t last_frame = 0;
-  if (!last_frame) {
-    last_frame = esp_timer_get_time();
+typedef struct {
+  httpd_req_t *req;     // httpd_req_async_handler_begin 得到的请求副本
+  int64_t last_frame;   // 上一帧发送完成的时刻，各客户端独立计算帧率
+  ra_filter_t ra_filter;
+  int fd;
+  uint32_t sent;        // 已发送帧数
+  uint32_t dropped;     // 发送上一帧期间被更新帧替换、没有发给本客户端的帧数
+  uint32_t frame_ms;    // 最近两帧发送完成的间隔
+  uint32_t latency_ms;  // 最近一帧从采集到发送完成的耗时
+} stream_client_t;
+
+// 当前客户端列表，供 /stream_stats 读取
+static stream_client_t *stream_clients[FRAME_POOL_MAX_CLIENTS];
+static portMUX_TYPE stream_clients_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void stream_client_register(stream_client_t *client, bool add) {
+  taskENTER_CRITICAL(&stream_clients_lock);
+  for (int i = 0; i < FRAME_POOL_MAX_CLIENTS; i++) {
+    if (stream_clients[i] == (add ? NULL : client)) {
+      stream_clients[i] = add ? client : NULL;
+      break;
+    }
   }
+  taskEXIT_CRITICAL(&stream_clients_lock);
+}
 
-  res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
-  if (res != ESP_OK) {
-    return res;
+#if defined(LED_GPIO_NUM)
+static void update_stream_led() {
+  frame_pool_stats_t stats;
+  frame_pool_get_stats(&stats);
+  isStreaming = stats.clients > 0;
+  enable_led(isStreaming);
+}
+#endif
+
+static esp_err_t stream_send_frame(httpd_req_t *req, const pool_frame_t *frame) {
+  char part_buf[128];
+  esp_err_t res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
+  if (res == ESP_OK) {
+    size_t hlen = snprintf(part_buf, sizeof(part_buf), _STREAM_PART, frame->len, (int)frame->timestamp.tv_sec, (int)frame->timestamp.tv_usec);
+    res = httpd_resp_send_chunk(req, part_buf, hlen);
   }
+  if (res == ESP_OK) {
+    res = httpd_resp_send_chunk(req, (const char *)frame->buf, frame->len);
+  }
+  return res;
+}
 
+static void stream_task(void *arg) {
+  stream_client_t *client = (stream_client_t *)arg;
+  httpd_req_t *req = client->req;
+  uint32_t last_seq = 0;
+
+  if (!frame_pool_subscribe()) {
+    log_e("Too many stream clients");
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_send(req, NULL, 0);
+    httpd_req_async_handler_complete(req);
+    free(client);
+    vTaskDelete(NULL);
+    return;
+  }
+
+  httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
   httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
   httpd_resp_set_hdr(req, "X-Framerate", "60");
 
 #if defined(LED_GPIO_NUM)
-  isStreaming = true;
-  enable_led(true);
+  update_stream_led();
 #endif
 
+  ra_filter_init(&client->ra_filter, 20);
+  client->last_frame = esp_timer_get_time();
+  client->fd = httpd_req_to_sockfd(req);
+  stream_client_register(client, true);
+
+  // 最新帧优先：每次只持有最新一帧的引用，发送期间到达的帧全部跳过并计入 dropped。
+  // 慢客户端只会降低自己的帧率，不会占住摄像头缓冲区，也不会拖慢其他客户端
   while (true) {
-    fb = esp_camera_fb_get();
-    if (!fb) {
+    pool_frame_t *frame = frame_pool_acquire(last_seq, pdMS_TO_TICKS(STREAM_FRAME_TIMEOUT_MS));
+    if (!frame) {
       log_e("Camera capture failed");
-      res = ESP_FAIL;
-    } else {
-      _timestamp.tv_sec = fb->timestamp.tv_sec;
-      _timestamp.tv_usec = fb->timestamp.tv_usec;
-      if (fb->format != PIXFORMAT_JPEG) {
-        bool jpeg_converted = frame2jpg(fb, 80, &_jpg_buf, &_jpg_buf_len);
-        esp_camera_fb_return(fb);
-        fb = NULL;
-        if (!jpeg_converted) {
-          log_e("JPEG compression failed");
-          res = ESP_FAIL;
-        }
-      } else {
-        _jpg_buf_len = fb->len;
-        _jpg_buf = fb->buf;
-      }
-    }
-    if (res == ESP_OK) {
-      res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
-    }
-    if (res == ESP_OK) {
-      size_t hlen = snprintf((char *)part_buf, 128, _STREAM_PART, _jpg_buf_len, _timestamp.tv_sec, _timestamp.tv_usec);
-      res = httpd_resp_send_chunk(req, (const char *)part_buf, hlen);
-    }
-    if (res == ESP_OK) {
-      res = httpd_resp_send_chunk(req, (const char *)_jpg_buf, _jpg_buf_len);
+      break;
     }
-    if (fb) {
-      esp_camera_fb_return(fb);
-      fb = NULL;
-      _jpg_buf = NULL;
-    } else if (_jpg_buf) {
-      free(_jpg_buf);
-      _jpg_buf = NULL;
+    if (last_seq) {
+      client->dropped += frame->seq - last_seq - 1;
     }
+    last_seq = frame->seq;
+    size_t frame_len = frame->len;
+    int64_t captured_us = (int64_t)frame->timestamp.tv_sec * 1000000 + frame->timestamp.tv_usec;
+    esp_err_t res = stream_send_frame(req, frame);
+    frame_pool_release(frame);
     if (res != ESP_OK) {
       log_e("Send frame failed");
       break;
     }
-    int64_t fr_end = esp_timer_get_time();
 
-    int64_t frame_time = fr_end - last_frame;
-    last_frame = fr_end;
+    int64_t fr_end = esp_timer_get_time();
+    int64_t frame_time = fr_end - client->last_frame;
+    client->last_frame = fr_end;
 
     frame_time /= 1000;
+    client->sent++;
+    client->frame_ms = (uint32_t)frame_time;
+    // 摄像头驱动的时间戳取自 esp_timer，与 fr_end 同一时基
+    client->latency_ms = (uint32_t)((fr_end - captured_us) / 1000);
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
-    uint32_t avg_frame_time = ra_filter_run(&ra_filter, frame_time);
+    uint32_t avg_frame_time = ra_filter_run(&client->ra_filter, frame_time);
 #endif
     log_i(
-      "MJPG: %uB %ums (%.1ffps), AVG: %ums (%.1ffps)", (uint32_t)(_jpg_buf_len), (uint32_t)frame_time, 1000.0 / (uint32_t)frame_time, avg_frame_time,
-      1000.0 / avg_frame_time
+      "MJPG[%d]: %uB %ums (%.1ffps), AVG: %ums (%.1ffps), latency %ums, dropped %u", client->fd, (uint32_t)(frame_len), (uint32_t)frame_time,
+      1000.0 / (uint32_t)frame_time, avg_frame_time, 1000.0 / avg_frame_time, client->latency_ms, client->dropped
     );
   }
 
+  stream_client_register(client, false);
+  frame_pool_unsubscribe();
 #if defined(LED_GPIO_NUM)
-  isStreaming = false;
-  enable_led(false);
+  update_stream_led();
 #endif
 
-  return res;
+  httpd_req_async_handler_complete(req);
+  free(client->ra_filter.values);
+  free(client);
+  vTaskDelete(NULL);
+}
+
+// 把请求交给独立的发送任务后立即返回，httpd 任务可以继续接受其他客户端
+static esp_err_t stream_handler(httpd_req_t *req) {
+  stream_client_t *client = (stream_client_t *)calloc(1, sizeof(stream_client_t));
+  if (!client) {
+    return httpd_resp_send_500(req);
+  }
+  if (httpd_req_async_handler_begin(req, &client->req) != ESP_OK) {
+    free(client);
+    return httpd_resp_send_500(req);
+  }
+  if (xTaskCreate(stream_task, "mjpeg", STREAM_TASK_STACK, client, STREAM_TASK_PRIO, NULL) != pdPASS) {
+    log_e("Stream task creation failed");
+    httpd_resp_send_500(client->req);
+    httpd_req_async_handler_complete(client->req);
+    free(client);
+  }
+  return ESP_OK;
 }
 
 static esp_err_t parse_get(httpd_req_t *req, char **obuf) {
@@ -489,6 +547,36 @@ static esp_err_t status_handler(httpd_req_t *req) {
   return httpd_resp_send(req, json_response, strlen(json_response));
 }
 
+static esp_err_t stream_stats_handler(httpd_req_t *req) {
+  static char json_response[128 + FRAME_POOL_MAX_CLIENTS * 96];
+  stream_client_t clients[FRAME_POOL_MAX_CLIENTS];
+  int count = 0;
+  frame_pool_stats_t pool;
+
+  // 先在锁内复制计数，格式化放在锁外
+  frame_pool_get_stats(&pool);
+  taskENTER_CRITICAL(&stream_clients_lock);
+  for (int i = 0; i < FRAME_POOL_MAX_CLIENTS; i++) {
+    if (stream_clients[i]) {
+      clients[count++] = *stream_clients[i];
+    }
+  }
+  taskEXIT_CRITICAL(&stream_clients_lock);
+
+  char *p = json_response;
+  p += sprintf(p, "{\"captured\":%u,\"pool_full\":%u,\"failed\":%u,\"clients\":[", pool.captured, pool.pool_full, pool.failed);
+  for (int i = 0; i < count; i++) {
+    p += sprintf(
+      p, "%s{\"fd\":%d,\"sent\":%u,\"dropped\":%u,\"frame_ms\":%u,\"latency_ms\":%u}", i ? "," : "", clients[i].fd, clients[i].sent,
+      clients[i].dropped, clients[i].frame_ms, clients[i].latency_ms
+    );
+  }
+  p += sprintf(p, "]}");
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  return httpd_resp_send(req, json_response, p - json_response);
+}
+
 static esp_err_t xclk_handler(httpd_req_t *req) {
   char *buf = NULL;
   char _xclk[32];
@@ -749,6 +837,19 @@ void startCameraServer() {
 #endif
   };
 
+  httpd_uri_t stream_stats_uri = {
+    .uri = "/stream_stats",
+    .method = HTTP_GET,
+    .handler = stream_stats_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = true,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+  };
+
   httpd_uri_t xclk_uri = {
     .uri = "/xclk",
     .method = HTTP_GET,
@@ -814,7 +915,9 @@ void startCameraServer() {
 #endif
   };
 
-  ra_filter_init(&ra_filter, 20);
+  if (!frame_pool_start()) {
+    log_e("Frame pool task creation failed");
+  }
 
   log_i("Starting web server on port: '%d'", config.server_port);
   if (httpd_start(&camera_httpd, &config) == ESP_OK) {
@@ -823,6 +926,7 @@ void startCameraServer() {
     httpd_register_uri_handler(camera_httpd, &status_uri);
     httpd_register_uri_handler(camera_httpd, &capture_uri);
     httpd_register_uri_handler(camera_httpd, &bmp_uri);
+    httpd_register_uri_handler(camera_httpd, &stream_stats_uri);
 
     httpd_register_uri_handler(camera_httpd, &xclk_uri);
     httpd_register_uri_handler(camera_httpd, &reg_uri);
@@ -0,0 +1,251 @@
+/**
+  * @file    frame_pool.cpp
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   单路采集、多路共享的 JPEG 帧池
+  *
+  * 引用计数规则：槽的 refs 为 0 即空闲；采集任务写入期间占 1 个引用，
+  * 发布后该引用转为"最新帧"的引用，被下一帧替换时释放；消费者每次
+  * frame_pool_acquire 加 1、frame_pool_release 减 1。计数与最新帧指针
+  * 由同一个自旋锁保护，临界区内只做整数运算。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "frame_pool.h"
+#include <string.h>
+#include "esp_camera.h"
+#include "esp_heap_caps.h"
+#include "img_converters.h"
+#include "sdkconfig.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#endif
+
+static pool_frame_t slots[FRAME_POOL_SLOTS];
+static pool_frame_t *latest = NULL;
+static uint32_t next_seq = 1;
+static TaskHandle_t subscribers[FRAME_POOL_MAX_CLIENTS];
+static int subscriber_count = 0;
+static TaskHandle_t capture_handle = NULL;
+static frame_pool_stats_t stats;
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 申请槽内存：优先 PSRAM，没有 PSRAM 时退回内部 RAM
+static uint8_t *slot_alloc(size_t size) {
+  uint8_t *buf = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!buf) {
+    buf = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_8BIT);
+  }
+  return buf;
+}
+
+// 取一个空闲槽并标记为写入中；没有空闲槽返回 NULL
+static pool_frame_t *take_free_slot(void) {
+  pool_frame_t *slot = NULL;
+  taskENTER_CRITICAL(&pool_lock);
+  for (int i = 0; i < FRAME_POOL_SLOTS; i++) {
+    if (slots[i].refs == 0) {
+      slot = &slots[i];
+      slot->refs = 1;
+      break;
+    }
+  }
+  taskEXIT_CRITICAL(&pool_lock);
+  return slot;
+}
+
+static void put_ref(pool_frame_t *frame) {
+  taskENTER_CRITICAL(&pool_lock);
+  frame->refs--;
+  taskEXIT_CRITICAL(&pool_lock);
+}
+
+// 把摄像头帧写入槽：JPEG 直接复制，其他格式先转换为 JPEG
+static bool fill_slot(pool_frame_t *slot, camera_fb_t *fb) {
+  if (fb->format != PIXFORMAT_JPEG) {
+    uint8_t *jpg = NULL;
+    size_t jpg_len = 0;
+    if (!frame2jpg(fb, FRAME_POOL_JPEG_QUALITY, &jpg, &jpg_len)) {
+      log_e("JPEG compression failed");
+      return false;
+    }
+    // 转换结果本身就是新分配的缓冲区，直接接管
+    free(slot->buf);
+    slot->buf = jpg;
+    slot->len = jpg_len;
+    slot->cap = jpg_len;
+    return true;
+  }
+
+  if (fb->len > slot->cap) {
+    // 按 1/8 余量扩容，避免画面复杂度小幅波动时反复分配
+    size_t cap = fb->len + fb->len / 8;
+    free(slot->buf);
+    slot->buf = slot_alloc(cap);
+    slot->cap = slot->buf ? cap : 0;
+    if (!slot->buf) {
+      log_e("Frame slot allocation failed (%u B)", (uint32_t)cap);
+      return false;
+    }
+  }
+  memcpy(slot->buf, fb->buf, fb->len);
+  slot->len = fb->len;
+  return true;
+}
+
+// 发布为最新帧并通知所有订阅者
+static void publish(pool_frame_t *slot) {
+  TaskHandle_t notify[FRAME_POOL_MAX_CLIENTS];
+  int n = 0;
+
+  taskENTER_CRITICAL(&pool_lock);
+  if (subscriber_count == 0) {
+    // 写入期间最后一个订阅者已离开：不再发布，下一个订阅者不会拿到这帧旧画面
+    slot->refs--;
+    taskEXIT_CRITICAL(&pool_lock);
+    return;
+  }
+  slot->seq = next_seq++;
+  if (latest) {
+    latest->refs--;
+  }
+  latest = slot;
+  stats.captured++;
+  for (int i = 0; i < FRAME_POOL_MAX_CLIENTS; i++) {
+    if (subscribers[i]) {
+      notify[n++] = subscribers[i];
+    }
+  }
+  taskEXIT_CRITICAL(&pool_lock);
+
+  for (int i = 0; i < n; i++) {
+    xTaskNotifyGive(notify[i]);
+  }
+}
+
+static void capture_task(void *arg) {
+  (void)arg;
+  for (;;) {
+    if (subscriber_count == 0) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+
+    camera_fb_t *fb = esp_camera_fb_get();
+    if (!fb) {
+      log_e("Camera capture failed");
+      stats.failed++;
+      vTaskDelay(pdMS_TO_TICKS(10));
+      continue;
+    }
+
+    pool_frame_t *slot = take_free_slot();
+    if (!slot) {
+      // 所有槽都被占用 (有消费者同时持有多帧)：丢弃本帧，摄像头缓冲区照常归还
+      stats.pool_full++;
+      esp_camera_fb_return(fb);
+      continue;
+    }
+
+    bool filled = fill_slot(slot, fb);
+    slot->timestamp = fb->timestamp;
+    esp_camera_fb_return(fb);
+    if (!filled) {
+      stats.failed++;
+      put_ref(slot);
+      continue;
+    }
+    publish(slot);
+  }
+}
+
+bool frame_pool_start(void) {
+  if (capture_handle) {
+    return true;
+  }
+  return xTaskCreatePinnedToCore(capture_task, "frame_pool", FRAME_POOL_TASK_STACK, NULL, FRAME_POOL_TASK_PRIO, &capture_handle, FRAME_POOL_TASK_CORE)
+         == pdPASS;
+}
+
+bool frame_pool_subscribe(void) {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  bool added = false;
+  bool first = false;
+
+  taskENTER_CRITICAL(&pool_lock);
+  for (int i = 0; i < FRAME_POOL_MAX_CLIENTS; i++) {
+    if (!subscribers[i]) {
+      subscribers[i] = self;
+      first = (subscriber_count++ == 0);
+      added = true;
+      break;
+    }
+  }
+  taskEXIT_CRITICAL(&pool_lock);
+
+  if (first && capture_handle) {
+    xTaskNotifyGive(capture_handle);
+  }
+  return added;
+}
+
+void frame_pool_unsubscribe(void) {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+  taskENTER_CRITICAL(&pool_lock);
+  for (int i = 0; i < FRAME_POOL_MAX_CLIENTS; i++) {
+    if (subscribers[i] == self) {
+      subscribers[i] = NULL;
+      subscriber_count--;
+      break;
+    }
+  }
+  // 没有订阅者后丢掉最新帧，下一个订阅者不会拿到停止采集前的旧画面
+  if (subscriber_count == 0 && latest) {
+    latest->refs--;
+    latest = NULL;
+  }
+  taskEXIT_CRITICAL(&pool_lock);
+}
+
+pool_frame_t *frame_pool_acquire(uint32_t last_seq, TickType_t timeout) {
+  TickType_t start = xTaskGetTickCount();
+
+  for (;;) {
+    pool_frame_t *frame = NULL;
+    taskENTER_CRITICAL(&pool_lock);
+    if (latest && latest->seq != last_seq) {
+      frame = latest;
+      frame->refs++;
+    }
+    taskEXIT_CRITICAL(&pool_lock);
+    if (frame) {
+      return frame;
+    }
+
+    // 通知是计数型的：检查与等待之间发布的帧不会错过
+    TickType_t waited = xTaskGetTickCount() - start;
+    if (waited >= timeout) {
+      return NULL;
+    }
+    ulTaskNotifyTake(pdTRUE, timeout - waited);
+  }
+}
+
+void frame_pool_release(pool_frame_t *frame) {
+  if (frame) {
+    put_ref(frame);
+  }
+}
+
+void frame_pool_get_stats(frame_pool_stats_t *out) {
+  taskENTER_CRITICAL(&pool_lock);
+  *out = stats;
+  out->clients = subscriber_count;
+  taskEXIT_CRITICAL(&pool_lock);
+}
@@ -0,0 +1,93 @@
+/**
+  * @file    frame_pool.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   单路采集、多路共享的 JPEG 帧池
+  *
+  * 采集任务独占摄像头：每取到一帧，复制到一个空闲槽 (PSRAM) 后立即归还
+  * 摄像头缓冲区，再把该槽发布为"最新帧"。任意数量的消费者 (MJPEG 客户端等)
+  * 对最新帧加引用后直接从槽中发送，不再各自复制；引用全部释放后槽回到空闲。
+  * 没有订阅者时采集任务休眠，不占用摄像头。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// ===========================
+// 用户配置区域
+// ===========================
+#define FRAME_POOL_MAX_CLIENTS 4        // 最多同时订阅的消费者 (MJPEG 客户端与 UDP 推流各占一个)
+#define FRAME_POOL_TASK_STACK 4096      // 采集任务栈大小
+#define FRAME_POOL_TASK_PRIO 5          // 采集任务优先级 (与 httpd 相同)
+#define FRAME_POOL_TASK_CORE tskNO_AFFINITY
+#define FRAME_POOL_JPEG_QUALITY 80      // 非 JPEG 像素格式时的转换质量
+
+// 帧槽数量：每个消费者最多持有一帧，再加最新帧与正在写入的一帧，
+// 采集任务因此总能找到空闲槽，慢客户端不会让采集停顿。
+// 槽内存按需分配，实际占用随同时在发送的不同帧数增长
+#define FRAME_POOL_SLOTS (FRAME_POOL_MAX_CLIENTS + 2)
+
+// 共享帧：消费者只读，持有期间内容不变
+typedef struct {
+  uint8_t *buf;              // JPEG 数据
+  size_t len;                // JPEG 长度
+  size_t cap;                // 槽容量 (内部使用)
+  struct timeval timestamp;  // 采集时刻 (摄像头驱动给出)
+  uint32_t seq;              // 帧序号，从 1 开始递增
+  int refs;                  // 引用计数 (内部使用，"最新帧"本身占一个引用)
+} pool_frame_t;
+
+typedef struct {
+  uint32_t captured;   // 已发布的帧数
+  uint32_t pool_full;  // 没有空闲槽而丢弃的帧 (消费者遵守单帧持有约定时应为 0)
+  uint32_t failed;     // 采集或 JPEG 转换失败次数
+  int clients;         // 当前订阅者数量
+} frame_pool_stats_t;
+
+/**
+ * @brief 创建采集任务 (在 esp_camera_init 之后调用一次)
+ * @return false 任务创建失败
+ */
+bool frame_pool_start(void);
+
+/**
+ * @brief 当前任务订阅新帧通知；第一个订阅者使采集任务开始工作
+ * @return false 订阅者已满 (FRAME_POOL_MAX_CLIENTS)
+ */
+bool frame_pool_subscribe(void);
+
+/**
+ * @brief 当前任务取消订阅；最后一个订阅者离开后采集任务休眠
+ */
+void frame_pool_unsubscribe(void);
+
+/**
+ * @brief 获取最新帧的引用，等待序号不同于 last_seq 的帧出现
+ * @param last_seq 上次处理的帧序号 (首次传 0)
+ * @param timeout 最长等待时间
+ * @return 帧引用，用完后须调用 frame_pool_release；超时返回 NULL
+ * @note 调用任务须已订阅，否则只能靠超时轮询。同一时刻只应持有一帧 (先释放再获取)，
+ *       FRAME_POOL_SLOTS 按此计算；等待期间发布的多帧只返回最新的一帧
+ */
+pool_frame_t *frame_pool_acquire(uint32_t last_seq, TickType_t timeout);
+
+/**
+ * @brief 释放帧引用
+ */
+void frame_pool_release(pool_frame_t *frame);
+
+void frame_pool_get_stats(frame_pool_stats_t *stats);
+
+#endif  // FRAME_POOL_H
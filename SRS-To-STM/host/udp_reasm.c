@@ -0,0 +1,223 @@
+/**
+  * @file    udp_reasm.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   UDP 分片帧重组 (Linux)
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "udp_reasm.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* 新到帧编号比已完成的编号落后超过此值，视为发送端重启 (编号从 0 重新开始) */
+#define UDP_REASM_RESYNC 256
+
+typedef struct {
+    bool used;
+    udp_frame_header_t header; /* 首个分片的头，frag_index 无意义 */
+    uint16_t received;
+    uint64_t first_ms;
+    uint8_t *bitmap;           /* 已收到的分片，每片 1 位 */
+    uint8_t *data;
+} Slot;
+
+struct udp_reasm {
+    uint32_t max_frame;
+    int slot_count;
+    uint32_t timeout_ms;
+    udp_reasm_cb cb;
+    void *user;
+    Slot *slots;
+    bool have_floor;
+    uint32_t floor;            /* 编号不大于此值的帧已交付或已作废 */
+    bool have_delivered;
+    uint32_t last_delivered;
+    udp_reasm_stats_t stats;
+};
+
+/* ==========================================
+ * 辅助函数
+ * ========================================== */
+
+/* 帧编号按 32 位回绕比较 */
+static bool Before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+static void Abandon(udp_reasm_t *r, Slot *s)
+{
+    r->stats.incomplete++;
+    r->stats.missing += s->header.frag_count - s->received;
+    if (!r->have_floor || Before(r->floor, s->header.frame_id)) {
+        r->floor = s->header.frame_id;
+        r->have_floor = true;
+    }
+    s->used = false;
+}
+
+static void Reset(udp_reasm_t *r)
+{
+    for (int i = 0; i < r->slot_count; i++) {
+        if (r->slots[i].used) Abandon(r, &r->slots[i]);
+    }
+    r->have_floor = false;
+    r->have_delivered = false;
+}
+
+/* 为新帧分配重组槽：优先空槽，否则挤出编号最早的帧；新帧比所有在途帧都早时返回 NULL */
+static Slot *Allocate(udp_reasm_t *r, const udp_frame_header_t *h, uint64_t now_ms)
+{
+    Slot *victim = NULL;
+    for (int i = 0; i < r->slot_count; i++) {
+        Slot *s = &r->slots[i];
+        if (!s->used) {
+            victim = s;
+            break;
+        }
+        if (!victim || Before(s->header.frame_id, victim->header.frame_id)) victim = s;
+    }
+    if (victim->used) {
+        if (Before(h->frame_id, victim->header.frame_id)) return NULL;
+        Abandon(r, victim);
+    }
+
+    victim->used = true;
+    victim->header = *h;
+    victim->received = 0;
+    victim->first_ms = now_ms;
+    memset(victim->bitmap, 0, (h->frag_count + 7u) / 8u);
+    return victim;
+}
+
+static void Deliver(udp_reasm_t *r, Slot *s)
+{
+    uint32_t id = s->header.frame_id;
+
+    /* 更早的在途帧已不可能按序交付 */
+    for (int i = 0; i < r->slot_count; i++) {
+        if (r->slots[i].used && &r->slots[i] != s && Before(r->slots[i].header.frame_id, id)) {
+            Abandon(r, &r->slots[i]);
+        }
+    }
+    if (r->have_delivered) r->stats.lost += id - r->last_delivered - 1;
+    r->have_delivered = true;
+    r->last_delivered = id;
+    r->have_floor = true;
+    r->floor = id;
+    r->stats.frames++;
+    r->stats.bytes += s->header.jpeg_size;
+    s->used = false;
+
+    if (r->cb) r->cb(r->user, s->data, &s->header);
+}
+
+/* ==========================================
+ * 公共接口函数实现
+ * ========================================== */
+
+udp_reasm_t *udp_reasm_create(uint32_t max_frame, int slots, uint32_t timeout_ms, udp_reasm_cb cb, void *user)
+{
+    if (slots < 1 || max_frame == 0) return NULL;
+    udp_reasm_t *r = (udp_reasm_t *)calloc(1, sizeof(udp_reasm_t));
+    if (!r) return NULL;
+    r->max_frame = max_frame;
+    r->slot_count = slots;
+    r->timeout_ms = timeout_ms;
+    r->cb = cb;
+    r->user = user;
+    r->slots = (Slot *)calloc((size_t)slots, sizeof(Slot));
+    if (!r->slots) {
+        free(r);
+        return NULL;
+    }
+    for (int i = 0; i < slots; i++) {
+        r->slots[i].bitmap = (uint8_t *)malloc(65536 / 8);
+        r->slots[i].data = (uint8_t *)malloc(max_frame);
+        if (!r->slots[i].bitmap || !r->slots[i].data) {
+            udp_reasm_destroy(r);
+            return NULL;
+        }
+    }
+    return r;
+}
+
+void udp_reasm_destroy(udp_reasm_t *r)
+{
+    if (!r) return;
+    for (int i = 0; i < r->slot_count; i++) {
+        free(r->slots[i].bitmap);
+        free(r->slots[i].data);
+    }
+    free(r->slots);
+    free(r);
+}
+
+int udp_reasm_push(udp_reasm_t *r, const uint8_t *packet, size_t len, uint64_t now_ms)
+{
+    udp_frame_header_t h;
+    const uint8_t *data;
+    int n = udp_frame_parse(packet, len, &h, &data);
+    if (n < 0 || h.jpeg_size > r->max_frame) {
+        r->stats.invalid++;
+        return 0;
+    }
+
+    if (r->have_floor && !Before(r->floor, h.frame_id)) {
+        if (r->floor - h.frame_id <= UDP_REASM_RESYNC) {
+            r->stats.late++;
+            return 0;
+        }
+        Reset(r);
+    }
+
+    Slot *s = NULL;
+    for (int i = 0; i < r->slot_count; i++) {
+        if (r->slots[i].used && r->slots[i].header.frame_id == h.frame_id) {
+            s = &r->slots[i];
+            break;
+        }
+    }
+    if (!s) {
+        s = Allocate(r, &h, now_ms);
+        if (!s) {
+            r->stats.late++;
+            return 0;
+        }
+    } else if (s->header.jpeg_size != h.jpeg_size || s->header.frag_size != h.frag_size) {
+        r->stats.invalid++;
+        return 0;
+    }
+
+    uint8_t bit = (uint8_t)(1u << (h.frag_index & 7));
+    if (s->bitmap[h.frag_index >> 3] & bit) {
+        r->stats.duplicates++;
+        return 0;
+    }
+    s->bitmap[h.frag_index >> 3] |= bit;
+    memcpy(s->data + (size_t)h.frag_index * h.frag_size, data, (size_t)n);
+    r->stats.fragments++;
+
+    if (++s->received < s->header.frag_count) return 0;
+    Deliver(r, s);
+    return 1;
+}
+
+void udp_reasm_expire(udp_reasm_t *r, uint64_t now_ms)
+{
+    for (int i = 0; i < r->slot_count; i++) {
+        Slot *s = &r->slots[i];
+        if (s->used && now_ms - s->first_ms >= r->timeout_ms) Abandon(r, s);
+    }
+}
+
+const udp_reasm_stats_t *udp_reasm_stats(const udp_reasm_t *r)
+{
+    return &r->stats;
+}
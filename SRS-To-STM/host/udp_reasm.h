@@ -0,0 +1,75 @@
+/**
+  * @file    udp_reasm.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   UDP 分片帧重组 (Linux)：把 udp_frame.h 格式的报文拼回整帧 JPEG
+  *
+  * 同时重组最多 slots 帧，容忍分片乱序与重复。帧按编号顺序交付：
+  * 一帧收齐后，编号更早、仍未收齐的帧不可能再按序交付，立即作废；
+  * 晚于已交付帧到达的分片直接丢弃。未收齐的帧超过 timeout_ms 也作废。
+  * 库本身不读写套接字，调用者把收到的报文逐个交给 udp_reasm_push。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef UDP_REASM_H
+#define UDP_REASM_H
+
+#include "udp_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 整帧回调，jpeg 仅在回调期间有效
+ */
+typedef void (*udp_reasm_cb)(void *user, const uint8_t *jpeg, const udp_frame_header_t *frame);
+
+typedef struct {
+    uint64_t frames;     /* 交付的整帧 */
+    uint64_t bytes;      /* 交付的 JPEG 字节 */
+    uint64_t fragments;  /* 接收的有效分片 (不含重复) */
+    uint64_t duplicates; /* 重复分片 */
+    uint64_t late;       /* 所属帧已交付或已作废后才到达的分片 */
+    uint64_t invalid;    /* 格式错误、与同帧其他分片矛盾或超过 max_frame 的报文 */
+    uint64_t incomplete; /* 收到部分分片后作废的帧 */
+    uint64_t missing;    /* 作废帧中缺少的分片 */
+    uint64_t lost;       /* 首帧至最新交付帧之间没有交付的帧 (含 incomplete 与一片未到的帧) */
+} udp_reasm_stats_t;
+
+typedef struct udp_reasm udp_reasm_t;
+
+/**
+ * @brief 创建重组器
+ * @param max_frame 最大帧长 (字节)，每个重组槽按此预分配
+ * @param slots 同时重组的帧数 (>= 1)，网络乱序跨越的帧数越多需要越大
+ * @param timeout_ms 未收齐的帧最长保留时间
+ * @return 内存不足时返回 NULL
+ */
+udp_reasm_t *udp_reasm_create(uint32_t max_frame, int slots, uint32_t timeout_ms, udp_reasm_cb cb, void *user);
+
+void udp_reasm_destroy(udp_reasm_t *r);
+
+/**
+ * @brief 处理一个报文
+ * @param now_ms 当前时间 (任意单调毫秒时钟)，用于超时判断
+ * @return 本报文使一帧收齐并交付时返回 1，否则返回 0
+ */
+int udp_reasm_push(udp_reasm_t *r, const uint8_t *packet, size_t len, uint64_t now_ms);
+
+/**
+ * @brief 作废超时的未收齐帧；没有报文到达时也应周期性调用
+ */
+void udp_reasm_expire(udp_reasm_t *r, uint64_t now_ms);
+
+const udp_reasm_stats_t *udp_reasm_stats(const udp_reasm_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UDP_REASM_H */
@@ -0,0 +1,328 @@
+/**
+  * @file    udpbench.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   UDP 分片帧回环测试：重组吞吐、丢包 / 乱序 / 重复处理
+  *
+  * 用法:
+  *   udpbench [--frames 2000] [--size 40000] [--fps 0] [--loss 0] [--reorder 0]
+  *            [--dup 0] [--datagram 1400] [--slots 4] [--timeout-ms 200]
+  *
+  * 发送线程按 udp_frame.h 格式把伪 JPEG 帧 (长度在 --size 上下 25% 内随机，
+  * 内容由帧编号生成) 切片后经 127.0.0.1 发给接收线程，接收线程用 udp_reasm
+  * 重组并逐字节校验。--loss / --reorder / --dup 为每个分片被丢弃、与本帧稍后
+  * 的分片交换顺序、被重复发送的百分比。--fps 0 表示不限速，此时内核接收
+  * 缓冲区溢出造成的丢包单独统计。重组耗时只计 udp_reasm_push 本身。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "udp_reasm.h"
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SEND_RING 4096 /* 记录每帧首片发出时刻，按帧编号取模 */
+
+typedef struct {
+    /* 参数 */
+    uint32_t frames;
+    uint32_t size;
+    double fps;
+    double loss, reorder, dup;
+    uint16_t datagram;
+    int slots;
+    uint32_t timeout_ms;
+
+    int rx_fd;
+    struct sockaddr_in addr;
+    volatile int sender_done;
+    uint64_t send_start[SEND_RING];
+
+    /* 发送端统计 */
+    uint64_t tx_fragments, tx_dropped, tx_dup, tx_swapped;
+
+    /* 接收端统计 */
+    uint64_t rx_packets;
+    uint64_t corrupt;
+    uint64_t push_ns;      /* udp_reasm_push 总耗时 */
+    uint64_t callback_ns;  /* 其中交付回调 (校验) 的耗时，不计入重组 */
+    double *latency_ms;
+    uint32_t latency_count;
+} Bench;
+
+static uint64_t NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t Lcg(uint32_t *s)
+{
+    *s = *s * 1103515245u + 12345u;
+    return *s >> 8;
+}
+
+static bool Chance(uint32_t *s, double percent)
+{
+    return percent > 0 && (Lcg(s) % 1000000u) < (uint32_t)(percent * 10000.0);
+}
+
+/* 帧内容与长度都由帧编号决定，接收端据此校验 */
+static uint32_t FrameSize(const Bench *b, uint32_t id)
+{
+    uint32_t s = id * 2654435761u + 1;
+    uint32_t span = b->size / 2;
+    return b->size - b->size / 4 + (span ? Lcg(&s) % span : 0);
+}
+
+static void FillFrame(uint8_t *buf, uint32_t len, uint32_t id)
+{
+    uint32_t s = id ^ 0x5A5A5A5Au;
+    for (uint32_t i = 0; i < len; i++) buf[i] = (uint8_t)Lcg(&s);
+}
+
+static int CompareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* ==========================================
+ * 接收线程
+ * ========================================== */
+
+static uint8_t *verify_buf;
+
+static void OnFrame(void *user, const uint8_t *jpeg, const udp_frame_header_t *frame)
+{
+    Bench *b = (Bench *)user;
+    uint64_t t0 = NowNs();
+    uint64_t start = __atomic_load_n(&b->send_start[frame->frame_id % SEND_RING], __ATOMIC_ACQUIRE);
+    if (b->latency_count < b->frames) b->latency_ms[b->latency_count++] = (double)(t0 - start) / 1e6;
+
+    if (frame->jpeg_size != FrameSize(b, frame->frame_id)) {
+        b->corrupt++;
+    } else {
+        FillFrame(verify_buf, frame->jpeg_size, frame->frame_id);
+        if (memcmp(verify_buf, jpeg, frame->jpeg_size) != 0) b->corrupt++;
+    }
+    b->callback_ns += NowNs() - t0;
+}
+
+static void *Receiver(void *arg)
+{
+    Bench *b = (Bench *)arg;
+    udp_reasm_t *r = udp_reasm_create(b->size * 2, b->slots, b->timeout_ms, OnFrame, b);
+    uint8_t packet[65536];
+    uint64_t idle_since = 0;
+
+    verify_buf = (uint8_t *)malloc(b->size * 2);
+    if (!r || !verify_buf) {
+        fprintf(stderr, "内存不足\n");
+        exit(1);
+    }
+
+    for (;;) {
+        struct pollfd pfd = {b->rx_fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, 20);
+        uint64_t now = NowNs();
+        if (ready <= 0) {
+            udp_reasm_expire(r, now / 1000000u);
+            /* 发送结束且 200 ms 内没有新报文后退出 */
+            if (b->sender_done) {
+                if (!idle_since) idle_since = now;
+                if (now - idle_since > 200000000u) break;
+            }
+            continue;
+        }
+        idle_since = 0;
+        ssize_t n;
+        while ((n = recv(b->rx_fd, packet, sizeof(packet), MSG_DONTWAIT)) > 0) {
+            b->rx_packets++;
+            uint64_t t0 = NowNs();
+            udp_reasm_push(r, packet, (size_t)n, t0 / 1000000u);
+            b->push_ns += NowNs() - t0;
+        }
+    }
+    /* 剩余在途帧全部按超时作废 */
+    udp_reasm_expire(r, UINT64_MAX);
+
+    const udp_reasm_stats_t *st = udp_reasm_stats(r);
+    printf("重组: 交付 %llu 帧 %.1f MB，作废 %llu 帧 (缺 %llu 片)，间隔丢失 %llu 帧\n",
+           (unsigned long long)st->frames, st->bytes / 1e6, (unsigned long long)st->incomplete,
+           (unsigned long long)st->missing, (unsigned long long)st->lost);
+    printf("分片: 有效 %llu，重复 %llu，迟到 %llu，无效 %llu\n", (unsigned long long)st->fragments,
+           (unsigned long long)st->duplicates, (unsigned long long)st->late, (unsigned long long)st->invalid);
+    udp_reasm_stats_t *copy = (udp_reasm_stats_t *)malloc(sizeof(*copy));
+    *copy = *st;
+    udp_reasm_destroy(r);
+    free(verify_buf);
+    return copy;
+}
+
+/* ==========================================
+ * 发送端
+ * ========================================== */
+
+static void SendFrame(Bench *b, int fd, uint32_t id, uint8_t *frame, uint32_t *rng)
+{
+    uint32_t len = FrameSize(b, id);
+    uint16_t frag_size = (uint16_t)(b->datagram - UDP_FRAME_HEADER_SIZE);
+    udp_frame_header_t h;
+    h.frame_id = id;
+    h.capture_ms = (uint32_t)(NowNs() / 1000000u);
+    h.jpeg_size = len;
+    h.frag_size = frag_size;
+    h.frag_count = udp_frame_fragment_count(len, frag_size);
+    FillFrame(frame, len, id);
+
+    /* 发送顺序：按 --reorder 与后面 1~4 片交换 */
+    static uint16_t order[65536];
+    for (uint16_t i = 0; i < h.frag_count; i++) order[i] = i;
+    for (uint16_t i = 0; i + 1 < h.frag_count; i++) {
+        if (Chance(rng, b->reorder)) {
+            uint16_t j = (uint16_t)(i + 1 + Lcg(rng) % 4);
+            if (j >= h.frag_count) j = (uint16_t)(h.frag_count - 1);
+            uint16_t t = order[i];
+            order[i] = order[j];
+            order[j] = t;
+            b->tx_swapped++;
+        }
+    }
+
+    __atomic_store_n(&b->send_start[id % SEND_RING], NowNs(), __ATOMIC_RELEASE);
+    uint8_t packet[65536];
+    for (uint16_t k = 0; k < h.frag_count; k++) {
+        uint16_t i = order[k];
+        uint32_t offset = (uint32_t)i * frag_size;
+        uint32_t n = (i + 1 < h.frag_count) ? frag_size : len - offset;
+        h.frag_index = i;
+        udp_frame_header_pack(packet, &h);
+        memcpy(packet + UDP_FRAME_HEADER_SIZE, frame + offset, n);
+
+        if (Chance(rng, b->loss)) {
+            b->tx_dropped++;
+            continue;
+        }
+        int copies = Chance(rng, b->dup) ? 2 : 1;
+        b->tx_dup += (uint64_t)(copies - 1);
+        for (int c = 0; c < copies; c++) {
+            if (sendto(fd, packet, UDP_FRAME_HEADER_SIZE + n, 0, (const struct sockaddr *)&b->addr, sizeof(b->addr)) >= 0) {
+                b->tx_fragments++;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static Bench b;
+    b.frames = 2000;
+    b.size = 40000;
+    b.datagram = UDP_FRAME_DATAGRAM;
+    b.slots = 4;
+    b.timeout_ms = 200;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--frames") == 0) b.frames = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--size") == 0) b.size = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--fps") == 0) b.fps = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--loss") == 0) b.loss = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--reorder") == 0) b.reorder = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--dup") == 0) b.dup = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--datagram") == 0) b.datagram = (uint16_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--slots") == 0) b.slots = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--timeout-ms") == 0) b.timeout_ms = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else {
+            fprintf(stderr, "未知参数: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (b.frames == 0 || b.size < 4 || b.datagram <= UDP_FRAME_HEADER_SIZE || b.slots < 1) {
+        fprintf(stderr, "参数超出范围\n");
+        return 1;
+    }
+
+    /* 接收端口由内核分配；接收缓冲区尽量放大 (受 net.core.rmem_max 限制) */
+    b.rx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int rcvbuf = 8 << 20;
+    setsockopt(b.rx_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    b.addr.sin_family = AF_INET;
+    b.addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(b.addr);
+    if (bind(b.rx_fd, (struct sockaddr *)&b.addr, sizeof(b.addr)) != 0 ||
+        getsockname(b.rx_fd, (struct sockaddr *)&b.addr, &alen) != 0) {
+        perror("bind");
+        return 1;
+    }
+    int tx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    b.latency_ms = (double *)malloc(sizeof(double) * b.frames);
+    uint8_t *frame = (uint8_t *)malloc(b.size * 2);
+
+    pthread_t rx;
+    pthread_create(&rx, NULL, Receiver, &b);
+
+    uint32_t rng = 1;
+    uint64_t start = NowNs();
+    uint64_t tx_bytes = 0;
+    for (uint32_t id = 0; id < b.frames; id++) {
+        if (b.fps > 0) {
+            uint64_t due = start + (uint64_t)(id * 1e9 / b.fps);
+            uint64_t now = NowNs();
+            if (due > now) {
+                struct timespec ts = {(time_t)((due - now) / 1000000000u), (long)((due - now) % 1000000000u)};
+                nanosleep(&ts, NULL);
+            }
+        }
+        SendFrame(&b, tx_fd, id, frame, &rng);
+        tx_bytes += FrameSize(&b, id);
+    }
+    uint64_t send_ns = NowNs() - start;
+    b.sender_done = 1;
+
+    udp_reasm_stats_t *st;
+    pthread_join(rx, (void **)&st);
+    double wall_s = (double)(NowNs() - start - 200000000u) / 1e9; /* 扣除接收端退出前的空闲等待 */
+
+    uint64_t kernel_drop = b.tx_fragments - b.rx_packets;
+    uint32_t frags = udp_frame_fragment_count(b.size, (uint16_t)(b.datagram - UDP_FRAME_HEADER_SIZE));
+    printf("发送: %u 帧 %.1f MB，%llu 个报文 (注入丢弃 %llu，重复 %llu，交换 %llu)，用时 %.2f s\n", b.frames,
+           tx_bytes / 1e6, (unsigned long long)b.tx_fragments, (unsigned long long)b.tx_dropped,
+           (unsigned long long)b.tx_dup, (unsigned long long)b.tx_swapped, send_ns / 1e9);
+    printf("接收: %llu 个报文，内核丢弃 %llu\n", (unsigned long long)b.rx_packets, (unsigned long long)kernel_drop);
+    printf("交付率: %.2f%% (按每帧约 %u 片、分片丢失率 %.2f%% 估计的理论值 %.2f%%)，校验错误 %llu\n",
+           100.0 * st->frames / b.frames, frags, b.loss, 100.0 * pow(1.0 - b.loss / 100.0, frags),
+           (unsigned long long)b.corrupt);
+    uint64_t reasm_ns = b.push_ns - b.callback_ns;
+    printf("吞吐: %.1f MB/s，%.1f 帧/s (墙钟)；重组 %.0f ns/报文，%.0f MB/s (udp_reasm_push 扣除回调)\n",
+           st->bytes / 1e6 / wall_s, st->frames / wall_s, b.rx_packets ? (double)reasm_ns / b.rx_packets : 0.0,
+           reasm_ns ? st->bytes / 1e6 / (reasm_ns / 1e9) : 0.0);
+    if (b.latency_count > 0) {
+        qsort(b.latency_ms, b.latency_count, sizeof(double), CompareDouble);
+        printf("首片发出至交付: p50 %.3f ms，p99 %.3f ms，最大 %.3f ms\n", b.latency_ms[b.latency_count / 2],
+               b.latency_ms[(size_t)(b.latency_count * 0.99)], b.latency_ms[b.latency_count - 1]);
+    }
+
+    /* 无注入丢包且内核未丢包时应全部交付 */
+    bool ok = b.corrupt == 0 && (b.loss > 0 || kernel_drop > 0 || st->frames == b.frames);
+    free(st);
+    free(frame);
+    free(b.latency_ms);
+    close(tx_fd);
+    close(b.rx_fd);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+/**
+  * @file    udprecv.c
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   UDP 分片帧接收端：接收 CameraWebServer.ino 的 UDP 推流并重组为 JPEG
+  *
+  * 用法:
+  *   udprecv [--port 8888] [--latest latest.jpg] [--save 目录] [--max-frame 1048576]
+  *           [--slots 4] [--timeout-ms 500]
+  *
+  * --latest 把最新一帧原子地覆盖写入指定文件 (先写临时文件再改名，查看器不会
+  * 读到半帧)；--save 把每一帧按编号保存到目录。每秒打印帧率、码率、丢失统计，
+  * 以及相对延迟：接收时刻与设备采集时刻之差减去迄今最小值，反映网络排队与
+  * 重组带来的额外延迟 (两端时钟不需要同步)。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#include "udp_reasm.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *latest_path = NULL;
+static const char *save_dir = NULL;
+
+static uint64_t NowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+/* 每秒统计 */
+static uint32_t second_frames = 0;
+static uint64_t second_bytes = 0;
+static int64_t min_offset = INT64_MAX;
+static int64_t offset_sum = 0;
+
+static void WriteFile(const char *path, const uint8_t *data, uint32_t len)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return;
+    }
+    fwrite(data, 1, len, f);
+    fclose(f);
+}
+
+static void OnFrame(void *user, const uint8_t *jpeg, const udp_frame_header_t *frame)
+{
+    (void)user;
+    second_frames++;
+    second_bytes += frame->jpeg_size;
+
+    /* 设备毫秒时钟 32 位回绕约 49 天，此处按差值计算不受影响 */
+    int64_t offset = (int64_t)(uint32_t)((uint32_t)NowMs() - frame->capture_ms);
+    if (offset < min_offset) min_offset = offset;
+    offset_sum += offset;
+
+    if (latest_path) {
+        char tmp[512];
+        snprintf(tmp, sizeof(tmp), "%s.tmp", latest_path);
+        WriteFile(tmp, jpeg, frame->jpeg_size);
+        rename(tmp, latest_path);
+    }
+    if (save_dir) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/frame_%08lu.jpg", save_dir, (unsigned long)frame->frame_id);
+        WriteFile(path, jpeg, frame->jpeg_size);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t port = 8888;
+    uint32_t max_frame = 1 << 20;
+    int slots = 4;
+    uint32_t timeout_ms = 500;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--port") == 0) port = (uint16_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--latest") == 0) latest_path = argv[i + 1];
+        else if (strcmp(argv[i], "--save") == 0) save_dir = argv[i + 1];
+        else if (strcmp(argv[i], "--max-frame") == 0) max_frame = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--slots") == 0) slots = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--timeout-ms") == 0) timeout_ms = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else {
+            fprintf(stderr, "未知参数: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int rcvbuf = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("bind");
+        return 1;
+    }
+
+    udp_reasm_t *r = udp_reasm_create(max_frame, slots, timeout_ms, OnFrame, NULL);
+    if (!r) {
+        fprintf(stderr, "内存不足\n");
+        return 1;
+    }
+    const udp_reasm_stats_t *st = udp_reasm_stats(r);
+    printf("监听 UDP %u\n", port);
+    printf("%6s %7s %9s %8s %8s %8s %8s %12s\n", "秒", "帧/s", "kB/s", "丢失", "作废", "重复", "迟到", "相对延迟(ms)");
+
+    static uint8_t packet[65536];
+    uint64_t start = NowMs(), last_report = start;
+    for (;;) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) > 0) {
+            ssize_t n = recv(fd, packet, sizeof(packet), 0);
+            if (n > 0) udp_reasm_push(r, packet, (size_t)n, NowMs());
+        }
+        uint64_t now = NowMs();
+        udp_reasm_expire(r, now);
+        if (now - last_report >= 1000) {
+            last_report = now;
+            double delay = second_frames ? (double)offset_sum / second_frames - (double)min_offset : 0.0;
+            printf("%6llu %7u %9.1f %8llu %8llu %8llu %8llu %12.1f\n", (unsigned long long)((now - start) / 1000),
+                   second_frames, second_bytes / 1000.0, (unsigned long long)st->lost,
+                   (unsigned long long)st->incomplete, (unsigned long long)st->duplicates,
+                   (unsigned long long)st->late, delay);
+            fflush(stdout);
+            second_frames = 0;
+            second_bytes = 0;
+            offset_sum = 0;
+        }
+    }
+}
@@ -0,0 +1,137 @@
+/**
+  * @file    udp_frame.h
+  * @author  Thecnfor
+  * @version V1.0.0
+  * @date    2026-10-18
+  * @brief   UDP 分片帧格式：设备端 (CameraWebServer.ino) 与主机端 (host/udp_reasm.c) 共用
+  *
+  * 每帧 JPEG 切成若干个不超过 UDP_FRAME_DATAGRAM 字节的报文，每个报文带 24 字节头:
+  *
+  *   偏移  长度  字段
+  *   0     2     magic       0x4A46 ("FJ")
+  *   2     1     version     1
+  *   3     1     header_len  24，以后扩展字段时接收端按此跳过
+  *   4     4     frame_id    帧编号，每发送一帧加 1 (接收端据此统计整帧丢失)
+  *   8     4     capture_ms  采集时刻 (设备启动后的毫秒数)
+  *   12    4     jpeg_size   整帧 JPEG 长度
+  *   16    2     frag_index  分片序号，从 0 开始
+  *   18    2     frag_count  本帧分片总数
+  *   20    2     frag_size   除最后一片外每片的数据长度，数据偏移 = frag_index * frag_size
+  *   22    2     reserved    0
+  *
+  * 多字节字段均为小端。分片可乱序、重复到达，接收端按偏移拼接。
+  *
+  * -----------------------------------------------------------------------------
+  * 修改历史:
+  * [2026-10-18] Thecnfor: 创建文件
+  * -----------------------------------------------------------------------------
+  */
+#ifndef UDP_FRAME_H
+#define UDP_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ===========================
+// 用户配置区域
+// ===========================
+// 每个报文的 UDP 负载上限 (头 + 数据)。以太网 MTU 1500 减去 IP/UDP 头为 1472，
+// 这里再留出 PPPoE / VPN 等封装的余量，同时不超过 WiFiUDP 的 1460 字节发送缓冲
+#define UDP_FRAME_DATAGRAM 1400
+
+#define UDP_FRAME_MAGIC 0x4A46
+#define UDP_FRAME_VERSION 1
+#define UDP_FRAME_HEADER_SIZE 24
+#define UDP_FRAME_PAYLOAD (UDP_FRAME_DATAGRAM - UDP_FRAME_HEADER_SIZE)
+
+typedef struct {
+  uint32_t frame_id;
+  uint32_t capture_ms;
+  uint32_t jpeg_size;
+  uint16_t frag_index;
+  uint16_t frag_count;
+  uint16_t frag_size;
+} udp_frame_header_t;
+
+static inline void udp_frame_put16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void udp_frame_put32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t udp_frame_get16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t udp_frame_get32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief 一帧需要的分片数；超过 65535 片 (约 88 MB) 的帧返回 0
+ */
+static inline uint16_t udp_frame_fragment_count(uint32_t jpeg_size, uint16_t frag_size) {
+  uint64_t n = ((uint64_t)jpeg_size + frag_size - 1) / frag_size;
+  return (n == 0 || n > 0xFFFF) ? 0 : (uint16_t)n;
+}
+
+/**
+ * @brief 写入 UDP_FRAME_HEADER_SIZE 字节的报文头
+ */
+static inline void udp_frame_header_pack(uint8_t *p, const udp_frame_header_t *h) {
+  udp_frame_put16(p, UDP_FRAME_MAGIC);
+  p[2] = UDP_FRAME_VERSION;
+  p[3] = UDP_FRAME_HEADER_SIZE;
+  udp_frame_put32(p + 4, h->frame_id);
+  udp_frame_put32(p + 8, h->capture_ms);
+  udp_frame_put32(p + 12, h->jpeg_size);
+  udp_frame_put16(p + 16, h->frag_index);
+  udp_frame_put16(p + 18, h->frag_count);
+  udp_frame_put16(p + 20, h->frag_size);
+  udp_frame_put16(p + 22, 0);
+}
+
+/**
+ * @brief 解析并校验报文
+ * @param packet 整个 UDP 报文
+ * @param len 报文长度
+ * @param h 解析结果
+ * @param data 分片数据起始位置
+ * @return 长度与字段自洽返回分片数据长度，否则返回 -1
+ */
+static inline int udp_frame_parse(const uint8_t *packet, size_t len, udp_frame_header_t *h, const uint8_t **data) {
+  if (len < UDP_FRAME_HEADER_SIZE || udp_frame_get16(packet) != UDP_FRAME_MAGIC || packet[2] != UDP_FRAME_VERSION) {
+    return -1;
+  }
+  size_t header_len = packet[3];
+  if (header_len < UDP_FRAME_HEADER_SIZE || header_len > len) {
+    return -1;
+  }
+  h->frame_id = udp_frame_get32(packet + 4);
+  h->capture_ms = udp_frame_get32(packet + 8);
+  h->jpeg_size = udp_frame_get32(packet + 12);
+  h->frag_index = udp_frame_get16(packet + 16);
+  h->frag_count = udp_frame_get16(packet + 18);
+  h->frag_size = udp_frame_get16(packet + 20);
+
+  if (h->frag_size == 0 || h->frag_count == 0 || h->frag_index >= h->frag_count
+      || udp_frame_fragment_count(h->jpeg_size, h->frag_size) != h->frag_count) {
+    return -1;
+  }
+  uint32_t offset = (uint32_t)h->frag_index * h->frag_size;
+  uint32_t expect = (h->frag_index + 1 < h->frag_count) ? h->frag_size : h->jpeg_size - offset;
+  if (len - header_len != expect) {
+    return -1;
+  }
+  *data = packet + header_len;
+  return (int)expect;
+}
+
+#endif  // UDP_FRAME_H
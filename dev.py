@@ -1,5 +1,8 @@
 import paho.mqtt.client as mqtt
-import msvcrt
+import argparse
+import math
+import sys
+import threading
 import time
 import random
 
@@ -8,6 +11,77 @@ BROKER = "emqx.van.xrak.xyz"
 PORT = 1883
 TOPIC = "LED"
 
+# 延迟探测：设备端 MQTT_Test_Run() 的 OnTestCmd 会把 test/cmd 的内容加上 "Echo: " 发回 test/reply
+PROBE_CMD_TOPIC = "test/cmd"
+PROBE_REPLY_TOPIC = "test/reply"
+
+
+# ==========================================
+# 跨平台按键读取
+# ==========================================
+try:
+    import msvcrt
+
+    class KeyReader:
+        def __enter__(self):
+            return self
+
+        def __exit__(self, *exc):
+            return False
+
+        def read(self):
+            """非阻塞读取一个按键，无按键返回 None"""
+            if not msvcrt.kbhit():
+                return None
+            try:
+                return msvcrt.getch().decode('utf-8').lower()
+            except UnicodeDecodeError:
+                return None
+
+except ImportError:
+    import select
+    import termios
+    import tty
+
+    class KeyReader:
+        def __enter__(self):
+            self.fd = sys.stdin.fileno()
+            self.old = termios.tcgetattr(self.fd)
+            tty.setcbreak(self.fd)
+            return self
+
+        def __exit__(self, *exc):
+            termios.tcsetattr(self.fd, termios.TCSADRAIN, self.old)
+            return False
+
+        def read(self):
+            """非阻塞读取一个按键，无按键返回 None"""
+            if select.select([sys.stdin], [], [], 0)[0]:
+                return sys.stdin.read(1).lower()
+            return None
+
+
+def create_client():
+    # 兼容 paho-mqtt 2.x 和 1.x
+    if hasattr(mqtt, 'CallbackAPIVersion'):
+        return mqtt.Client(mqtt.CallbackAPIVersion.VERSION1)
+    return mqtt.Client()
+
+
+def connect(client, broker, port):
+    print(f"正在连接到 {broker}...")
+    try:
+        client.connect(broker, port, 60)
+    except Exception as e:
+        print(f"连接出错: {e}")
+        return False
+    client.loop_start()
+    return True
+
+
+# ==========================================
+# 交互模式：按键控制 LED
+# ==========================================
 def on_connect(client, userdata, flags, rc):
     if rc == 0:
         print(f"成功连接到 MQTT Broker: {BROKER}")
@@ -19,38 +93,22 @@ def on_connect(client, userdata, flags, rc):
     else:
         print(f"连接失败，返回码: {rc}")
 
-def main():
-    # 兼容 paho-mqtt 2.x 和 1.x
-    if hasattr(mqtt, 'CallbackAPIVersion'):
-        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION1)
-    else:
-        client = mqtt.Client()
-        
+
+def run_interactive(args):
+    client = create_client()
     client.on_connect = on_connect
 
-    print(f"正在连接到 {BROKER}...")
-    try:
-        client.connect(BROKER, PORT, 60)
-    except Exception as e:
-        print(f"连接出错: {e}")
+    if not connect(client, args.broker, args.port):
         return
 
-    client.loop_start()
-
     is_on = False
 
     try:
-        while True:
-            if msvcrt.kbhit():
-                # 读取按键
-                key_byte = msvcrt.getch()
-                try:
-                    key = key_byte.decode('utf-8').lower()
-                except UnicodeDecodeError:
-                    continue
-                
+        with KeyReader() as keys:
+            while True:
+                key = keys.read()
                 msg = None
-                
+
                 if key == '1':
                     msg = "ON"
                     is_on = True
@@ -63,12 +121,12 @@ def main():
                 elif key == 'q':
                     print("退出程序...")
                     break
-                
+
                 if msg:
                     client.publish(TOPIC, msg)
                     print(f"已向主题 '{TOPIC}' 发送: {msg}")
-                
-            time.sleep(0.1)
+
+                time.sleep(0.1)
 
     except KeyboardInterrupt:
         print("\n用户中断")
@@ -77,5 +135,260 @@ def main():
         client.disconnect()
         print("连接已断开")
 
+
+# ==========================================
+# 探测模式：往返延迟 / 丢包 / 乱序
+# ==========================================
+class ProbeStats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.rtt_ms = {}       # seq -> RTT (ms)
+        self.duplicates = 0
+        self.reordered = 0
+        self.max_seq = -1
+
+    def on_reply(self, seq, sent_ns, recv_ns):
+        with self.lock:
+            if seq in self.rtt_ms:
+                self.duplicates += 1
+                return
+            if seq < self.max_seq:
+                self.reordered += 1
+            self.max_seq = max(self.max_seq, seq)
+            self.rtt_ms[seq] = (recv_ns - sent_ns) / 1e6
+
+
+def parse_echo(payload):
+    """解析 "Echo: seq=<n> t=<ns>"，格式不符返回 None"""
+    if not payload.startswith("Echo: "):
+        return None
+    fields = dict(item.split("=", 1) for item in payload[6:].split() if "=" in item)
+    try:
+        return int(fields["seq"]), int(fields["t"])
+    except (KeyError, ValueError):
+        return None
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return float("nan")
+    k = (len(sorted_values) - 1) * p
+    lo = math.floor(k)
+    hi = math.ceil(k)
+    return sorted_values[lo] + (sorted_values[hi] - sorted_values[lo]) * (k - lo)
+
+
+def print_histogram(values, width=40):
+    """按 2 的幂分桶打印 RTT 直方图"""
+    if not values:
+        return
+    buckets = {}
+    for v in values:
+        edge = 2 ** max(0, math.ceil(math.log2(max(v, 1e-3))))
+        buckets[edge] = buckets.get(edge, 0) + 1
+    peak = max(buckets.values())
+    prev = 0
+    for edge in sorted(buckets):
+        count = buckets[edge]
+        bar = "#" * max(1, round(count * width / peak))
+        print(f"  {prev:>7.0f} - {edge:>7.0f} ms | {count:>6} {bar}")
+        prev = edge
+
+
+def run_probe(args):
+    stats = ProbeStats()
+    connected = threading.Event()
+
+    def on_probe_connect(client, userdata, flags, rc):
+        if rc == 0:
+            client.subscribe(PROBE_REPLY_TOPIC, qos=0)
+            connected.set()
+        else:
+            print(f"连接失败，返回码: {rc}")
+
+    def on_message(client, userdata, msg):
+        recv_ns = time.perf_counter_ns()
+        parsed = parse_echo(msg.payload.decode("utf-8", errors="replace"))
+        if parsed:
+            stats.on_reply(parsed[0], parsed[1], recv_ns)
+
+    client = create_client()
+    client.on_connect = on_probe_connect
+    client.on_message = on_message
+
+    if not connect(client, args.broker, args.port):
+        return
+    if not connected.wait(10):
+        print("连接超时")
+        client.loop_stop()
+        return
+
+    interval = 1.0 / args.rate
+    print(f"探测: {args.count} 条, {args.rate} 条/秒, 主题 {PROBE_CMD_TOPIC} -> {PROBE_REPLY_TOPIC}")
+
+    sent = 0
+    start = time.perf_counter()
+    try:
+        for seq in range(args.count):
+            # 按绝对时间表发送，避免累计漂移
+            delay = start + seq * interval - time.perf_counter()
+            if delay > 0:
+                time.sleep(delay)
+            client.publish(PROBE_CMD_TOPIC, f"seq={seq} t={time.perf_counter_ns()}")
+            sent += 1
+        time.sleep(args.timeout)
+    except KeyboardInterrupt:
+        print("\n用户中断")
+    finally:
+        client.loop_stop()
+        client.disconnect()
+
+    with stats.lock:
+        rtts = sorted(stats.rtt_ms.values())
+        received = len(rtts)
+        reordered = stats.reordered
+        duplicates = stats.duplicates
+
+    lost = sent - received
+    print("\n=== 探测结果 ===")
+    print(f"发送 {sent}  收到 {received}  丢失 {lost} ({(lost / sent * 100) if sent else 0:.2f}%)")
+    print(f"乱序 {reordered}  重复 {duplicates}")
+    if rtts:
+        print(f"RTT (ms): min {rtts[0]:.1f}  p50 {percentile(rtts, 0.5):.1f}  "
+              f"p90 {percentile(rtts, 0.9):.1f}  p99 {percentile(rtts, 0.99):.1f}  "
+              f"max {rtts[-1]:.1f}  mean {sum(rtts) / received:.1f}")
+        print_histogram(rtts)
+
+    if args.csv:
+        with open(args.csv, "w") as f:
+            f.write("seq,rtt_ms\n")
+            for seq in range(sent):
+                rtt = stats.rtt_ms.get(seq)
+                f.write(f"{seq},{'' if rtt is None else f'{rtt:.3f}'}\n")
+        print(f"明细已写入 {args.csv}")
+
+
+# ==========================================
+# 时钟同步模式：设备时钟同步后端 + 单向延迟统计
+# ==========================================
+def unix_ms():
+    return time.time_ns() // 1000000
+
+
+def parse_stamp(payload):
+    """解析 "@<capture>,<send>|..."，格式不符返回 None"""
+    if not payload.startswith(b"@"):
+        return None
+    head, sep, _ = payload[1:48].partition(b"|")
+    capture, comma, send = head.partition(b",")
+    if not sep or not comma:
+        return None
+    try:
+        return int(capture), int(send)
+    except ValueError:
+        return None
+
+
+def print_delays(title, queue, network):
+    queue = sorted(queue)
+    network = sorted(network)
+    print(f"{title} {len(queue)} 条  设备排队 (ms): p50 {percentile(queue, 0.5):.0f}  "
+          f"p99 {percentile(queue, 0.99):.0f}  max {queue[-1]}  |  "
+          f"网络 (ms): p50 {percentile(network, 0.5):.0f}  "
+          f"p99 {percentile(network, 0.99):.0f}  max {network[-1]}")
+
+
+def run_clock(args):
+    """应答设备 MQTT_Time_Init() 的同步请求；统计 MQTT_Time_Publish() 消息的单向延迟。
+    后端时钟即本机系统时间，应保持 NTP 同步。"""
+    lock = threading.Lock()
+    window = ([], [])   # 本统计周期的 (排队, 网络)
+    total = ([], [])
+    replies = [0]
+    connected = threading.Event()
+
+    def on_clock_connect(client, userdata, flags, rc):
+        if rc == 0:
+            client.subscribe(args.sync, qos=0)
+            client.subscribe(args.watch, qos=0)
+            connected.set()
+        else:
+            print(f"连接失败，返回码: {rc}")
+
+    def on_message(client, userdata, msg):
+        rx = unix_ms()
+        if msg.topic.endswith("/time"):
+            seq, sep, t1 = msg.payload.decode("ascii", errors="replace").partition("|")
+            if sep and len(seq) == 4 and t1.isdigit():
+                client.publish(msg.topic + "/reply", f"{seq}|{t1},{rx},{unix_ms()}")
+                with lock:
+                    replies[0] += 1
+            return
+        stamp = parse_stamp(msg.payload)
+        if stamp is None or stamp[1] < stamp[0]:
+            return
+        capture, send = stamp
+        with lock:
+            for bucket in (window, total):
+                bucket[0].append(send - capture)
+                bucket[1].append(max(0, rx - send))
+
+    client = create_client()
+    client.on_connect = on_clock_connect
+    client.on_message = on_message
+    if not connect(client, args.broker, args.port):
+        return
+    if not connected.wait(10):
+        print("连接超时")
+        client.loop_stop()
+        return
+
+    print(f"时钟同步: 应答 {args.sync}，统计 {args.watch} 中带时间戳的消息 (Ctrl+C 结束)")
+    try:
+        while True:
+            time.sleep(args.report)
+            with lock:
+                if window[0]:
+                    print_delays(f"[同步应答 {replies[0]}]", *window)
+                window[0].clear()
+                window[1].clear()
+    except KeyboardInterrupt:
+        print("\n用户中断")
+    finally:
+        client.loop_stop()
+        client.disconnect()
+
+    if total[0]:
+        print_delays("\n=== 合计 ===", *total)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="STM32 MQTT 调试工具")
+    parser.add_argument("--broker", default=BROKER)
+    parser.add_argument("--port", type=int, default=PORT)
+    sub = parser.add_subparsers(dest="mode")
+
+    sub.add_parser("led", help="按键控制 LED (默认)")
+
+    probe = sub.add_parser("probe", help="往返延迟探测 (需设备运行 MQTT_Test_Run)")
+    probe.add_argument("--rate", type=float, default=5.0, help="每秒发送条数")
+    probe.add_argument("--count", type=int, default=100, help="发送总条数")
+    probe.add_argument("--timeout", type=float, default=5.0, help="发送结束后等待迟到响应的秒数")
+    probe.add_argument("--csv", help="将每条消息的 RTT 写入 CSV 文件")
+
+    clock = sub.add_parser("clock", help="设备时钟同步后端与单向延迟统计 (需设备调用 MQTT_Time_Init)")
+    clock.add_argument("--sync", default="dev/+/time", help="同步请求主题过滤器 (以 /time 结尾)")
+    clock.add_argument("--watch", default="dev/#", help="统计单向延迟的主题过滤器")
+    clock.add_argument("--report", type=float, default=10.0, help="统计输出周期 (秒)")
+
+    args = parser.parse_args()
+    if args.mode == "probe":
+        run_probe(args)
+    elif args.mode == "clock":
+        run_clock(args)
+    else:
+        run_interactive(args)
+
+
 if __name__ == "__main__":
     main()